@@ -14,9 +14,11 @@
         'src/rcib/PendingTask.cc',
         'src/rcib/ref_counted.cc',
         'src/rcib/Thread.cc',
+        'src/rcib/ThreadPool.cc',
         'src/rcib/util_tools.cc',
         'src/rcib/WeakPtr.cc',
         'src/rcib/Event/WaitableEvent.cc',
+        'src/rcib/Event/FutexEvent.cc',
         'src/rcib/time/time.cc',
         'src/rcib/roler.cc',
         'src/delayed/delayed.cc',
@@ -24,15 +26,20 @@
         'src/hash/sha/sha.cc',
         'src/hash/hash.cc',
         'src/ed25519/ed25519/keypair.c',
+        'src/ed25519/ed25519/key.c',
         'src/ed25519/ed25519/sign.c',
+        'src/ed25519/ed25519/batch.c',
         'src/ed25519/ed25519/open.c',
         'src/ed25519/ed25519/crypto_verify_32.c',
         'src/ed25519/ed25519/ge_double_scalarmult.c',
         'src/ed25519/ed25519/ge_frombytes.c',
+        'src/ed25519/ed25519/ge_frombytes_canonical.c',
         'src/ed25519/ed25519/ge_scalarmult_base.c',
+        'src/ed25519/ed25519/ge_scalarmult_base_wide.c',
         'src/ed25519/ed25519/ge_precomp_0.c',
         'src/ed25519/ed25519/ge_p2_0.c',
         'src/ed25519/ed25519/ge_p2_dbl.c',
+        'src/ed25519/ed25519/ge_torsion_free.c',
         'src/ed25519/ed25519/ge_p3_0.c',
         'src/ed25519/ed25519/ge_p3_dbl.c',
         'src/ed25519/ed25519/ge_p3_to_p2.c',
@@ -57,6 +64,7 @@
         'src/ed25519/ed25519/fe_sq2.c',
         'src/ed25519/ed25519/fe_invert.c',
         'src/ed25519/ed25519/fe_tobytes.c',
+        'src/ed25519/ed25519/fe51.c',
         'src/ed25519/ed25519/fe_isnegative.c',
         'src/ed25519/ed25519/fe_isnonzero.c',
         'src/ed25519/ed25519/fe_frombytes.c',
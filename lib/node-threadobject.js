@@ -1,48 +1,127 @@
 const rcib = require('../build/Release/hydra.node')
 const THREAD = rcib.THREAD
 
+// opts.priority: 'interactive' jumps ahead of queued 'bulk' work (the default)
+function priorityOf(opts) {
+  const priority = opts && opts.priority ? opts.priority : 'bulk'
+  if ('interactive' === priority) {
+    return rcib.PRIORITY_INTERACTIVE
+  }
+  if ('bulk' === priority) {
+    return rcib.PRIORITY_BULK
+  }
+  throw new Error('priority should be one of {interactive, bulk}')
+}
+
+// what the native side reports the result to: a callback, null for the
+// sink, or undefined for a native promise that carries promise.taskId.
+// callbacks run from the completion round like any node callback, so
+// they are passed as they are
+function targetOf(opts, cb) {
+  if (opts && opts.sink) {
+    return null
+  }
+  if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
+    return cb
+  }
+  return undefined
+}
+
+// opts.out: a Buffer (a slab shared by many requests, say) the result is
+// written to at opts.offset instead of into a new Buffer. the result is
+// then the number of bytes written
+function outputOf(opts) {
+  if (!opts || !opts.out) {
+    return []
+  }
+  return [opts.out, opts.offset || 0]
+}
+
+// the native calls return false once the thread is closed
+function submitted(ret, target) {
+  if (false === ret && undefined === target) {
+    return Promise.reject(new Error('thread is not running'))
+  }
+  return ret
+}
+
+// the seed (32 bytes) or private key (64) a signer is made from
+function signerKeyOf(key) {
+  if (key && key.privateKey) {
+    key = key.privateKey
+  }
+  return Buffer.isBuffer(key) ? key : Buffer.from(key, 'hex')
+}
+
 function Thread() {
-  const o = {
+  const thread_ = new THREAD()
+
+  return {
     close() {
-      thread_.close();
+      thread_.close()
     },
     isRunning() {
-      return thread_.isRunning();
+      return thread_.isRunning()
     },
     delayByMil(mils, cb) {
-      thread_.delayByMil(mils, function(err) {
-        setImmediate(() => cb(err))
-      })
+      const target = targetOf(null, cb)
+      return submitted(thread_.delayByMil(mils, target), target)
     },
     delayBySec(secs, cb) {
-      thread_.delayBySec(secs, function(err) {
-        setImmediate(() => cb(err))
-      })
+      const target = targetOf(null, cb)
+      return submitted(thread_.delayBySec(secs, target), target)
     },
     delayByMin(mins, cb) {
-      thread_.delayByMin(mins, function(err) {
-        setImmediate(() => cb(err))
-      })
+      const target = targetOf(null, cb)
+      return submitted(thread_.delayByMin(mins, target), target)
     },
     delayByHour(hours, cb) {
-      thread_.delayByHour(hours, function(err) {
-        setImmediate(() => cb(err))
-      })
+      const target = targetOf(null, cb)
+      return submitted(thread_.delayByHour(hours, target), target)
     },
     numOfTasks() {
       return thread_.queNum()
     },
-    sign(hash, Key, cb) {
-      if (!Buffer.isBuffer(hash)) {
-        hash = Buffer.from(hash, 'hex')
+    // withdraws a queued task, its callback gets an ECANCELED error.
+    // returns false if the task already ran or is running
+    cancel(taskId) {
+      return thread_.cancel(taskId)
+    },
+    // sink(ids, errors, results) gets the results of the submissions made
+    // with { sink: true } in batches, once per round of completions. the
+    // arrays are parallel; errors[i] is null on success. null removes it
+    setSink(sink) {
+      return thread_.setSink(sink || null)
+    },
+    sign(message, Key, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
+      }
+      if (!Buffer.isBuffer(message)) {
+        message = Buffer.from(message, 'hex')
+      }
+      const target = targetOf(opts, cb)
+      return submitted(thread_.sign(message, Key, target, priorityOf(opts), ...outputOf(opts)), target)
+    },
+    // a handle for signing many messages with one key: the key is expanded
+    // once, into memory kept out of swap where the system allows it.
+    // key is a seed or a keyPair; pass the handle to sign in place of the key
+    createSigner(key, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
       }
-      thread_.sign(hash, Key, function(err, rets) {
-        setImmediate(() => cb(err, rets))
-      })
+      const target = targetOf(opts, cb)
+      return submitted(thread_.createSigner(signerKeyOf(key), target, priorityOf(opts)), target)
     },
-    verify(hash, signature, pKey, cb) {
-      if (!Buffer.isBuffer(hash)) {
-        hash = Buffer.from(hash, 'hex')
+    verify(message, signature, pKey, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
+      }
+      if (!Buffer.isBuffer(message)) {
+        message = Buffer.from(message, 'hex')
       }
       if (!Buffer.isBuffer(signature)) {
         signature = Buffer.from(signature, 'hex')
@@ -50,88 +129,147 @@ function Thread() {
       if (!Buffer.isBuffer(pKey)) {
         pKey = Buffer.from(pKey, 'hex')
       }
-      thread_.verify(hash, signature, pKey, function(err, rets) {
-        setImmediate(() => cb(err, rets));
-      })
-    },
-    sha2(param, cb) {
-      const type = param.type ? param.type : 256
-      const data = Buffer.isBuffer(param.data) ? param.data : Buffer.from(param.data, 'utf8')
-      if (256 === type || 384 === type || 512 === type) {
-        thread_.sha2(type, data, function(err, rets) {
-          setImmediate(() => cb(err, rets))
-        });
-      } else {
-        setImmediate(() => cb(new Error('type should be one of {256,384,512}')))
-      }
-    }
-  }
-
-  const thread_ =  new THREAD()
-  Promise.promisifyAll(o, {suffix: 'Async'})
-
-  return {
-    close() {
-      o.close()
-    },
-    isRunning() {
-      return o.isRunning()
-    },
-    delayByMil(mils, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.delayByMil(mils, cb);
-      } else {
-        return o.delayByMilAsync(mils);
-      }
+      const target = targetOf(opts, cb)
+      return submitted(thread_.verify(message, signature, pKey, target, priorityOf(opts)), target)
     },
-    delayBySec(secs, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.delayBySec(secs, cb);
-      } else {
-        return o.delayBySecAsync(secs);
+    // the result is an array of booleans, one per signature
+    verifyBatch(messages, signatures, pKeys, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
       }
+      const toBuffer = (v) => Buffer.isBuffer(v) ? v : Buffer.from(v, 'hex')
+      const target = targetOf(opts, cb)
+      return submitted(thread_.verifyBatch(messages.map(toBuffer), signatures.map(toBuffer),
+        pKeys.map(toBuffer), target, priorityOf(opts)), target)
     },
-    delayByMin(mins, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.delayByMin(mins, cb);
-      } else {
-        return o.delayByMinAsync(mins);
+    // bulk verify in one call, spread over all workers. input is either
+    // { records, messageLength }: records of signature(64) | publicKey(32) | message
+    // or { messages, offsets, signatures, publicKeys }: message i is
+    // messages[offsets[i], offsets[i + 1]), signatures and keys back to back.
+    // the result is a bitmap Buffer, bit i (lsb first) set when record i is valid
+    verifyPacked(input, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
       }
-    },
-    delayByHour(hours, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.delayByHour(hours, cb);
-      } else {
-        return o.delayByHourAsync(hours);
+      const target = targetOf(opts, cb)
+      if (input.records) {
+        return submitted(thread_.verifyRecords(input.records, input.messageLength,
+          target, priorityOf(opts)), target)
       }
+      const offsets = input.offsets instanceof Uint32Array ? input.offsets : Uint32Array.from(input.offsets)
+      return submitted(thread_.verifyPacked(input.messages, offsets, input.signatures,
+        input.publicKeys, target, priorityOf(opts)), target)
     },
-    numOfTasks() {
-      return o.numOfTasks()
-    },
-    sign(message, Key, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.sign(message, Key, cb)
-      } else {
-        return o.signAsync(message, Key)
+    // derives many keypairs on all workers. seeds is a Buffer of 32 byte
+    // seeds back to back, or an array of seeds. the result is
+    // { publicKeys, privateKeys }: keypair i is publicKeys[32i, 32i + 32)
+    // and privateKeys[64i, 64i + 64), as makeKeypair would make them
+    makeKeypairs(seeds, opts, cb) {
+      if (typeof opts === 'function') {
+        cb = opts
+        opts = undefined
       }
-    },
-    verify(message, signature, pKey, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.verify(message, signature, pKey, cb)
-      } else {
-        return o.verifyAsync(message, signature, pKey)
+      if (!Buffer.isBuffer(seeds)) {
+        seeds = Buffer.concat(seeds.map((v) => Buffer.isBuffer(v) ? v : Buffer.from(v, 'hex')))
       }
+      const target = targetOf(opts, cb)
+      return submitted(thread_.makeKeypairs(seeds, target, priorityOf(opts)), target)
     },
     sha2(param, cb) {
-      if (cb && typeof cb === 'function' && cb.constructor.name === 'Function') {
-        o.sha2(param, cb)
-      } else {
-        return o.sha2Async(param)
+      const type = param.type ? param.type : 256
+      const data = Buffer.isBuffer(param.data) ? param.data : Buffer.from(param.data, 'utf8')
+      const target = targetOf(param, cb)
+      if (256 !== type && 384 !== type && 512 !== type) {
+        const err = new Error('type should be one of {256,384,512}')
+        if (target) {
+          // never call back before returning
+          return setImmediate(() => target(err))
+        }
+        if (undefined === target) {
+          return Promise.reject(err)
+        }
+        throw err
       }
+      return submitted(thread_.sha2(type, data, target, priorityOf(param), ...outputOf(param)), target)
     }
   }
 }
 
+// all Thread objects share one pool of workers, one per cpu by default.
+// the size can only be changed before the first Thread is created
+Thread.setPoolSize = (size) => {
+  return rcib.setPoolSize(size)
+}
+
+// results are called back in rounds of at most opts.callbacks callbacks or
+// opts.millis milliseconds (default 5ms, 0 for no bound), the rest on the
+// next turn of the event loop
+Thread.setCompletionBudget = (opts) => {
+  const callbacks = opts && opts.callbacks ? opts.callbacks : 0
+  const millis = opts && opts.millis ? opts.millis : 0
+  rcib.setCompletionBudget(callbacks, millis)
+}
+
+// {delivered, deferred, deferredRounds, backlog, maxCallbacks, maxMillis}
+Thread.completionStats = () => {
+  return rcib.completionStats()
+}
+
+// request and result objects are recycled; in a steady state "created"
+// stops growing. { requests, hashResults, ed25519Results: { created,
+// reused, idle }, handles: { slots, idle } }
+Thread.allocationStats = () => {
+  return rcib.allocationStats()
+}
+
+// indexes of the records a verifyPacked bitmap marks invalid
+Thread.invalidOf = (bitmap, count) => {
+  const bad = []
+  for (let i = 0; i < count; ++i) {
+    if (!(bitmap[i >> 3] & (1 << (i & 7)))) {
+      bad.push(i)
+    }
+  }
+  return bad
+}
+
+// jobs estimated below ns run on the calling thread; their results still
+// arrive asynchronously. The costs are measured on a worker once the first
+// Thread is created, and nothing runs inline before that. By default only
+// hashes far below a worker round trip do; sign and verify run inline only
+// under a threshold set here. 0 turns it off, a negative value restores
+// the default
+Thread.setInlineThreshold = (ns) => {
+  rcib.setInlineThreshold(ns)
+}
+
+// { thresholdNs, calibratedNs, inlined }
+Thread.inlineStats = () => {
+  return rcib.inlineStats()
+}
+
+// verify keeps the decoded public keys of recent signers, up to bytes of
+// memory (8MB, some 5000 keys, by default). 0 turns the cache off
+Thread.setKeyCacheSize = (bytes) => {
+  rcib.setKeyCacheSize(bytes)
+}
+
+// { hits, misses, entries, bytes, capacity }
+Thread.keyCacheStats = () => {
+  return rcib.keyCacheStats()
+}
+
+// makeKeypair, sign and createSigner multiply the base point by the key.
+// window 5 uses a bigger table for it (about 100KB, compiled in), which
+// makes that about a fifth faster; 0 goes back to the built-in 30KB.
+// Any time, also while workers sign; false for other windows. Build with
+// ED25519_BASE_WINDOW=5 to start with it
+Thread.setBaseWindow = (window) => {
+  return rcib.setBaseWindow(window)
+}
+
 Thread.makeKeypair = (seed) => {
   if (!Buffer.isBuffer(seed)) {
     seed = Buffer.from(seed, 'hex')
@@ -146,6 +284,11 @@ Thread.sign = (hash, Key) => {
   return rcib.signSync(hash, Key)
 }
 
+// { publicKey, locked }, for Thread.sign and thread.sign
+Thread.createSigner = (key) => {
+  return rcib.createSignerSync(signerKeyOf(key))
+}
+
 Thread.verify = (hash, signature, pKey) => {
   if (!Buffer.isBuffer(hash)) {
     hash = Buffer.from(hash, 'hex')
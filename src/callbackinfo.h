@@ -30,8 +30,9 @@ namespace rcib {
   };
   //static
   void CallbackInfo::Free(void* data, void*) {
-    base::Thread *thr = static_cast<base::Thread*>(data);
+    base::TaskRunner *thr = static_cast<base::TaskRunner*>(data);
     if (!thr) return;
+    RcibHelper::GetInstance()->SetSink(thr, nullptr);
     delete thr;
   }
   //static
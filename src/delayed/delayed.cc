@@ -27,6 +27,8 @@ void DelayedHelper::DelayByHour(rcib::async_req * req) {
 }
 
 void DelayedHelper::CommonPross(rcib::async_req * req) {
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
   rcib::RcibHelper::DoNopAsync(req);
   rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
 }
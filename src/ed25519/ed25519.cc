@@ -1,5 +1,104 @@
 #include "../rcib.h"
 #include "ed25519.h"
+#include <openssl/rand.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// Slots for expanded keys, carved out of pages that are locked once, so
+// that a node holding many signers does not run into the locked memory
+// limit a page each. The first slot of a page records whether the lock
+// took.
+class LockedSlots {
+public:
+  enum { kSlot = 128 };
+
+  static LockedSlots* GetInstance() {
+    static LockedSlots This;
+    return &This;
+  }
+
+  unsigned char* Take(bool* locked) {
+    AutoCritSecLock<CriticalSection> lock(lock_, true);
+    if (free_.empty() && !AddPage())
+      return nullptr;
+    unsigned char* slot = free_.back();
+    free_.pop_back();
+    *locked = PageOf(slot)[0] != 0;
+    return slot;
+  }
+
+  void Give(unsigned char* slot) {
+    volatile unsigned char* p = slot;
+    for (int i = 0; i < kSlot; ++i)
+      p[i] = 0;
+    AutoCritSecLock<CriticalSection> lock(lock_, true);
+    free_.push_back(slot);
+  }
+
+private:
+  LockedSlots() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    page_ = info.dwPageSize;
+#else
+    page_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+  unsigned char* PageOf(unsigned char* slot) const {
+    return reinterpret_cast<unsigned char*>(reinterpret_cast<uintptr_t>(slot) & ~(page_ - 1));
+  }
+
+  bool AddPage() {
+    unsigned char* page;
+    bool locked;
+#ifdef _WIN32
+    page = static_cast<unsigned char*>(VirtualAlloc(NULL, page_, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if (!page)
+      return false;
+    locked = VirtualLock(page, page_) != 0;
+#else
+    void* mapped = mmap(NULL, page_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == mapped)
+      return false;
+    page = static_cast<unsigned char*>(mapped);
+    locked = mlock(page, page_) == 0;
+#ifdef MADV_DONTDUMP
+    madvise(page, page_, MADV_DONTDUMP);
+#endif
+#endif
+    page[0] = locked ? 1 : 0;
+    for (size_t offset = page_ - kSlot; offset >= kSlot; offset -= kSlot)
+      free_.push_back(page + offset);
+    return true;
+  }
+
+  CriticalSection lock_;
+  std::vector<unsigned char*> free_;
+  size_t page_;
+};
+
+// the handle template; handles keep the signer in internal field 0
+v8::Persistent<v8::FunctionTemplate> signer_template;
+
+// a weak reference to a handle and the signer it owns
+struct SignerOwner {
+  v8::Persistent<v8::Object> handle;
+  Ed25519Signer* signer;
+};
+
+void FreeSigner(const v8::WeakCallbackInfo<SignerOwner>& data) {
+  SignerOwner* owner = data.GetParameter();
+  owner->handle.Reset();
+  delete owner->signer;
+  delete owner;
+}
+
+}  // namespace
 
 //constructor
 Ed25519Data::Ed25519Data() {
@@ -7,6 +106,157 @@ Ed25519Data::Ed25519Data() {
   _privateKey = nullptr;
   _seed = nullptr;
   _mlen = 0;
+  _signer = nullptr;
+}
+
+Ed25519Signer::Ed25519Signer(unsigned char* esk, bool locked)
+  :_esk(esk), _locked(locked) {
+}
+
+Ed25519Signer::~Ed25519Signer() {
+  LockedSlots::GetInstance()->Give(_esk);
+}
+
+//static
+Ed25519Signer* Ed25519Signer::New(const unsigned char* sk, size_t len) {
+  bool locked = false;
+  unsigned char* esk = LockedSlots::GetInstance()->Take(&locked);
+  if (!esk)
+    return nullptr;
+  if (32 == len) {
+    // seed | public key in the upper half of the slot, expanded below it
+    memcpy(esk + 64, sk, 32);
+    crypto_sign_keypair(esk + 96, esk + 64);
+    crypto_sign_expand(esk, esk + 64);
+    memset(esk + 96, 0, 32);
+  } else {
+    crypto_sign_expand(esk, sk);
+  }
+  return new Ed25519Signer(esk, locked);
+}
+
+KeyCache::KeyCache()
+  :capacity_(kDefaultCapacity) {
+  uint64_t seed = 0;
+  if (RAND_bytes(reinterpret_cast<unsigned char*>(&seed), sizeof(seed)) != 1)
+    seed = uv_hrtime();
+  for (int i = 0; i < kShards; ++i)
+    shards_[i].index = Index(64, Hash(seed));
+}
+//static
+KeyCache* KeyCache::GetInstance() {
+  static KeyCache This;
+  return &This;
+}
+
+size_t KeyCache::Hash::operator()(const PublicKey& pk) const {
+  uint64_t h = seed;
+  for (int i = 0; i < 4; ++i) {
+    uint64_t word;
+    memcpy(&word, pk.bytes + 8 * i, 8);
+    h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+  return static_cast<size_t>(h);
+}
+
+size_t KeyCache::EntryBytes() {
+  return crypto_sign_key_size() + sizeof(Key) + 2 * 32 + 128;
+}
+
+scoped_refptr<KeyCache::Key> KeyCache::Get(const unsigned char* pk) {
+  PublicKey id;
+  memcpy(id.bytes, pk, 32);
+  Shard* shard = &shards_[pk[0] % kShards];
+  {
+    AutoCritSecLock<CriticalSection> lock(shard->lock, true);
+    Index::iterator it = shard->index.find(id);
+    if (it != shard->index.end()) {
+      ++shard->hits;
+      if (it->second != shard->lru.begin())
+        shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+      return it->second->second;
+    }
+    ++shard->misses;
+  }
+  // decode outside the lock, a miss (with the torsion test) costs about a third of a verify
+  crypto_sign_key* decoded = crypto_sign_key_new(pk);
+  if (!decoded)
+    return NULL;
+  scoped_refptr<Key> key = new Key(decoded);
+  AutoCritSecLock<CriticalSection> lock(shard->lock, true);
+  if (capacity_ / kShards < EntryBytes() || shard->index.count(id))
+    return key;
+  shard->lru.push_front(std::make_pair(id, key));
+  shard->index[id] = shard->lru.begin();
+  EvictLocked(shard);
+  return key;
+}
+
+void KeyCache::SetCapacity(size_t bytes) {
+  capacity_ = bytes;
+  for (int i = 0; i < kShards; ++i) {
+    AutoCritSecLock<CriticalSection> lock(shards_[i].lock, true);
+    EvictLocked(&shards_[i]);
+  }
+}
+
+KeyCache::Stats KeyCache::stats() {
+  Stats stats;
+  stats.hits = 0;
+  stats.misses = 0;
+  stats.entries = 0;
+  for (int i = 0; i < kShards; ++i) {
+    AutoCritSecLock<CriticalSection> lock(shards_[i].lock, true);
+    stats.hits += shards_[i].hits;
+    stats.misses += shards_[i].misses;
+    stats.entries += shards_[i].index.size();
+  }
+  stats.bytes = stats.entries * EntryBytes();
+  stats.capacity = capacity_;
+  return stats;
+}
+
+void KeyCache::EvictLocked(Shard* shard) {
+  while (!shard->lru.empty() && shard->index.size() * EntryBytes() > capacity_ / kShards) {
+    shard->index.erase(shard->lru.back().first);
+    shard->lru.pop_back();
+  }
+}
+
+//static
+void Ed25519Signer::Init(v8::Isolate* isolate) {
+  v8::Local<v8::FunctionTemplate> t = v8::FunctionTemplate::New(isolate);
+  t->SetClassName(v8::String::NewFromUtf8(isolate, "SIGNER", v8::NewStringType::kNormal).ToLocalChecked());
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  signer_template.Reset(isolate, t);
+}
+
+//static
+v8::Local<v8::Object> Ed25519Signer::Wrap(v8::Isolate* isolate, Ed25519Signer* signer) {
+  v8::Local<v8::FunctionTemplate> t = v8::Local<v8::FunctionTemplate>::New(isolate, signer_template);
+  v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+  v8::Local<v8::Object> handle = t->GetFunction(ctx).ToLocalChecked()->NewInstance(ctx).ToLocalChecked();
+  handle->SetAlignedPointerInInternalField(0, signer);
+  handle->Set(ctx, v8::String::NewFromUtf8(isolate, "publicKey", v8::NewStringType::kNormal).ToLocalChecked(),
+    node::Encode(isolate, reinterpret_cast<const char *>(signer->public_key()), 32, node::encoding::BUFFER)).FromJust();
+  handle->Set(ctx, v8::String::NewFromUtf8(isolate, "locked", v8::NewStringType::kNormal).ToLocalChecked(),
+    v8::Boolean::New(isolate, signer->locked())).FromJust();
+  SignerOwner* owner = new SignerOwner;
+  owner->handle.Reset(isolate, handle);
+  owner->signer = signer;
+  owner->handle.SetWeak(owner, FreeSigner, v8::WeakCallbackType::kParameter);
+  return handle;
+}
+
+//static
+const Ed25519Signer* Ed25519Signer::Unwrap(v8::Isolate* isolate, v8::Local<v8::Value> value) {
+  if (signer_template.IsEmpty() || !value->IsObject())
+    return nullptr;
+  v8::Local<v8::FunctionTemplate> t = v8::Local<v8::FunctionTemplate>::New(isolate, signer_template);
+  if (!t->HasInstance(value))
+    return nullptr;
+  return static_cast<Ed25519Signer*>(value.As<v8::Object>()->GetAlignedPointerFromInternalField(0));
 }
 
 // constructor
@@ -19,10 +269,21 @@ Ed25519Helper* Ed25519Helper::GetInstance() {
 }
 
 void Ed25519Helper::Sign(const Ed25519Data &data, rcib::async_req * req) {
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
   unsigned char publicKeyData[32];
   unsigned char privateKeyData[64];
   unsigned char * privateKey;
   Ed25519Re *hre = reinterpret_cast<Ed25519Re *>(req->out);
+  unsigned char *signature = hre->_out ? hre->_out : hre->data;
+  if (data._signer) {
+    if (crypto_sign_detached_expanded(signature, data._msg, data._mlen, data._signer->expanded()) == 0)
+      req->result = 64;
+    else
+      rcib::RcibHelper::EMark2(req, "no memory to hash the message");
+    rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
+    return;
+  }
   if (data._seed) {
     for (int i = 0; i < 32; ++i) {
       privateKeyData[i] = data._seed[i];
@@ -32,19 +293,124 @@ void Ed25519Helper::Sign(const Ed25519Data &data, rcib::async_req * req) {
   } else {
     privateKey = data._privateKey;
   }
-  unsigned long long sigLen = data._mlen + 64;
-  unsigned char *signatureMessageData = (unsigned char*)malloc(sigLen);
-  crypto_sign(signatureMessageData, &sigLen, data._msg, data._mlen, privateKey);
-  for (int i = 0; i < 64; ++i) {
-    hre->data[i] = signatureMessageData[i];
+  if (crypto_sign_detached(signature, data._msg, data._mlen, privateKey) == 0)
+    req->result = 64;
+  else
+    rcib::RcibHelper::EMark2(req, "no memory to hash the message");
+  rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
+}
+
+void Ed25519Helper::CreateSigner(const Ed25519Data& data, rcib::async_req * req) {
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
+  Ed25519SignerRe *hre = reinterpret_cast<Ed25519SignerRe *>(req->out);
+  if (data._seed) {
+    hre->_signer = Ed25519Signer::New(data._seed, 32);
+  } else {
+    hre->_signer = Ed25519Signer::New(data._privateKey, 64);
+  }
+  if (hre->_signer) {
+    req->result = 1;
+  } else {
+    req->result = -1;
+    req->error = "no memory for the signer";
   }
-  free(signatureMessageData);
-  req->result = 64;
   rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
 }
 
 void Ed25519Helper::Verify(const Ed25519Data& data, rcib::async_req * req) {
-  bool relt = (crypto_sign_verify(data._seed, data._msg, data._mlen, data._privateKey) == 0);
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
+  bool relt = VerifyOne(data._seed, data._msg, data._mlen, data._privateKey);
   req->result = relt ? 1 : 0;
   rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
 }
+
+void Ed25519Helper::VerifyBatch(rcib::async_req * req) {
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
+  Ed25519BatchRe *hre = reinterpret_cast<Ed25519BatchRe *>(req->out);
+  size_t n = hre->_valid.size();
+  if (n) {
+    VerifyMany(&hre->_msgs[0], &hre->_mlens[0], &hre->_sigs[0],
+      &hre->_pks[0], n, &hre->_valid[0]);
+  }
+  req->result = static_cast<ssize_t>(n);
+  rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
+}
+
+void Ed25519Helper::VerifyShard(rcib::async_req * req, size_t begin, size_t end) {
+  Ed25519PackedRe *hre = reinterpret_cast<Ed25519PackedRe *>(req->out);
+  // the first shard to run claims the job, the others follow it unless
+  // the job was cancelled first
+  if (req->cancel_flag.Start() || !req->cancel_flag.IsCancelled()) {
+    size_t n = end - begin;
+    std::vector<const unsigned char*> msgs(n), sigs(n), pks(n);
+    std::vector<size_t> mlens(n);
+    std::vector<int> valid(n);
+    for (size_t i = 0; i < n; ++i) {
+      size_t k = begin + i;
+      sigs[i] = hre->_sigs + k * hre->_sig_stride;
+      pks[i] = hre->_pks + k * hre->_pk_stride;
+      if (!hre->_offsets.empty()) {
+        msgs[i] = hre->_msgs + hre->_offsets[k];
+        mlens[i] = hre->_offsets[k + 1] - hre->_offsets[k];
+      } else {
+        msgs[i] = hre->_msgs + k * hre->_msg_stride;
+        mlens[i] = hre->_msg_len;
+      }
+    }
+    if (n) {
+      VerifyMany(&msgs[0], &mlens[0], &sigs[0], &pks[0], n, &valid[0]);
+    }
+    // shards start on a byte boundary, so no two write the same byte
+    for (size_t i = 0; i < n; ++i) {
+      if (valid[i]) {
+        hre->_bitmap[(begin + i) >> 3] |= static_cast<unsigned char>(1 << ((begin + i) & 7));
+      }
+    }
+  }
+  if (base::subtle::Barrier_AtomicIncrement(&hre->_shards, -1) == 0) {
+    req->result = static_cast<ssize_t>(hre->_n);
+    rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
+  }
+}
+
+void Ed25519Helper::KeypairShard(rcib::async_req * req, size_t begin, size_t end) {
+  Ed25519KeypairsRe *hre = reinterpret_cast<Ed25519KeypairsRe *>(req->out);
+  if (req->cancel_flag.Start() || !req->cancel_flag.IsCancelled()) {
+    if (end > begin) {
+      crypto_sign_keypairs(&hre->_publicKeys[32 * begin], &hre->_privateKeys[64 * begin], end - begin);
+    }
+  }
+  if (base::subtle::Barrier_AtomicIncrement(&hre->_shards, -1) == 0) {
+    req->result = static_cast<ssize_t>(hre->_n);
+    rcib::RcibHelper::GetInstance()->Uv_Send(req, NULL);
+  }
+}
+
+bool Ed25519Helper::VerifyOne(const unsigned char* sig, const unsigned char* msg, size_t mlen,
+  const unsigned char* pk) {
+  KeyCache* cache = KeyCache::GetInstance();
+  if (!cache->enabled())
+    return crypto_sign_verify(sig, msg, mlen, pk) == 0;
+  scoped_refptr<KeyCache::Key> key = cache->Get(pk);
+  return key.get() && crypto_sign_verify_key(sig, msg, mlen, key->get()) == 0;
+}
+
+void Ed25519Helper::VerifyMany(const unsigned char* const* msgs, const size_t* mlens,
+  const unsigned char* const* sigs, const unsigned char* const* pks, size_t n, int* valid) {
+  KeyCache* cache = KeyCache::GetInstance();
+  if (!cache->enabled()) {
+    crypto_sign_verify_batch(msgs, mlens, sigs, pks, n, valid);
+    return;
+  }
+  // the references keep the keys alive until the batch is done
+  std::vector<scoped_refptr<KeyCache::Key> > held(n);
+  std::vector<const crypto_sign_key*> keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    held[i] = cache->Get(pks[i]);
+    keys[i] = held[i].get() ? held[i]->get() : NULL;
+  }
+  crypto_sign_verify_batch_keys(msgs, mlens, sigs, &keys[0], n, valid);
+}
@@ -3,6 +3,8 @@
 
 #include "ed25519/ed25519.h"
 
+class Ed25519Signer;
+
 class Ed25519Data {
 public:
   Ed25519Data();
@@ -10,20 +12,64 @@ public:
   }
 
   unsigned char* _msg;
-  unsigned int _mlen;
+  size_t _mlen;
   unsigned char* _privateKey; // or as pub
   unsigned char* _seed;  //or as signature
+  const Ed25519Signer* _signer;  // signs instead of the key when set
+};
+
+// A private key expanded once (see crypto_sign_expand) so that signing
+// only does the per message work. The expansion sits in locked memory,
+// out of swap and core dumps where the system allows it. A JS handle owns
+// the signer and frees it when collected; requests pin the handle.
+class Ed25519Signer {
+public:
+  // |sk| is a seed (32 bytes) or a seed and public key (64); NULL when out
+  // of memory
+  static Ed25519Signer* New(const unsigned char* sk, size_t len);
+  ~Ed25519Signer();
+
+  const unsigned char* expanded() const {
+    return _esk;
+  }
+  const unsigned char* public_key() const {
+    return _esk + 64;
+  }
+  bool locked() const {
+    return _locked;
+  }
+
+  // the handle template, once per process
+  static void Init(v8::Isolate* isolate);
+  // a new handle that owns |signer|
+  static v8::Local<v8::Object> Wrap(v8::Isolate* isolate, Ed25519Signer* signer);
+  // the signer of a handle, NULL for anything else
+  static const Ed25519Signer* Unwrap(v8::Isolate* isolate, v8::Local<v8::Value> value);
+
+private:
+  Ed25519Signer(unsigned char* esk, bool locked);
+
+  unsigned char* _esk;
+  bool _locked;
+  DISALLOW_COPY_AND_ASSIGN_(Ed25519Signer);
 };
 
 class Ed25519Re : public rcib::Param {
 public:
+  POOLED(Ed25519Re)
+
   enum SubTypes {
     NONE = 0,
     SIGN,
-    VERIFY
+    VERIFY,
+    VERIFY_BATCH,
+    VERIFY_PACKED,
+    CREATE_SIGNER,
+    MAKE_KEYPAIRS
   };
 
-  explicit Ed25519Re(base::WeakPtr<base::Thread> thr, SubTypes type) {
+  explicit Ed25519Re(base::WeakPtr<base::TaskRunner> thr, SubTypes type) {
+    _out = nullptr;
     _type = type;
     _thr = thr;
     if(thr.get()) thr->IncComputational();
@@ -33,10 +79,185 @@ public:
     if (_thr.get()) _thr->DecComputational();
   }
   unsigned char data[64];
-  base::WeakPtr<base::Thread> _thr;
+  unsigned char* _out;  // caller's Buffer; written instead of data when set
+  base::WeakPtr<base::TaskRunner> _thr;
   SubTypes _type;
 };
 
+// Tuples of a verifyBatch call. The pointers are into Buffers pinned for
+// the request; |valid| is filled by the worker.
+class Ed25519BatchRe : public Ed25519Re {
+public:
+  POOLED(Ed25519BatchRe)
+
+  explicit Ed25519BatchRe(base::WeakPtr<base::TaskRunner> thr, size_t n)
+    : Ed25519Re(thr, VERIFY_BATCH), _msgs(n), _mlens(n), _sigs(n), _pks(n), _valid(n) {
+  }
+
+  std::vector<const unsigned char*> _msgs;
+  std::vector<size_t> _mlens;
+  std::vector<const unsigned char*> _sigs;
+  std::vector<const unsigned char*> _pks;
+  std::vector<int> _valid;
+};
+
+// A createSigner job; the worker expands the key into |_signer|, which
+// the result handle then owns.
+class Ed25519SignerRe : public Ed25519Re {
+public:
+  POOLED(Ed25519SignerRe)
+
+  explicit Ed25519SignerRe(base::WeakPtr<base::TaskRunner> thr)
+    : Ed25519Re(thr, CREATE_SIGNER), _signer(nullptr) {
+  }
+  virtual ~Ed25519SignerRe() {
+    delete _signer;
+  }
+
+  Ed25519Signer* _signer;
+};
+
+// A verifyPacked job. Record i has its signature at sigs + i * sig_stride,
+// its key at pks + i * pk_stride and its message either at
+// msgs + i * msg_stride, msg_len bytes, or, when there are offsets, at
+// msgs + offsets[i] up to msgs + offsets[i + 1]. The job is cut into shards
+// that run on different workers; the last one to finish sends the result.
+class Ed25519PackedRe : public Ed25519Re {
+public:
+  POOLED(Ed25519PackedRe)
+
+  explicit Ed25519PackedRe(base::WeakPtr<base::TaskRunner> thr, size_t n)
+    : Ed25519Re(thr, VERIFY_PACKED), _n(n), _bitmap((n + 7) / 8) {
+    _sigs = _pks = _msgs = nullptr;
+    _sig_stride = _pk_stride = _msg_stride = _msg_len = 0;
+    _shards = 0;
+  }
+
+  size_t _n;
+  const unsigned char* _sigs;
+  size_t _sig_stride;
+  const unsigned char* _pks;
+  size_t _pk_stride;
+  const unsigned char* _msgs;
+  size_t _msg_stride;
+  size_t _msg_len;
+  std::vector<uint32_t> _offsets;
+  // bit i (lsb first) is set when record i is valid
+  std::vector<unsigned char> _bitmap;
+  // shards still running
+  volatile base::subtle::Atomic32 _shards;
+};
+
+// A makeKeypairs job, cut into shards like a verifyPacked one. The seeds
+// are copied into the first halves of |_privateKeys| and the shards
+// derive the keys in place.
+class Ed25519KeypairsRe : public Ed25519Re {
+public:
+  POOLED(Ed25519KeypairsRe)
+
+  explicit Ed25519KeypairsRe(base::WeakPtr<base::TaskRunner> thr, const unsigned char* seeds, size_t n)
+    : Ed25519Re(thr, MAKE_KEYPAIRS), _n(n), _publicKeys(32 * n), _privateKeys(64 * n) {
+    for (size_t i = 0; i < n; ++i) {
+      memcpy(&_privateKeys[64 * i], seeds + 32 * i, 32);
+    }
+    _shards = 0;
+  }
+  virtual ~Ed25519KeypairsRe() {
+    volatile unsigned char* p = _privateKeys.data();
+    for (size_t i = 0; i < _privateKeys.size(); ++i)
+      p[i] = 0;
+  }
+
+  size_t _n;
+  std::vector<unsigned char> _publicKeys;
+  std::vector<unsigned char> _privateKeys;
+  // shards still running
+  volatile base::subtle::Atomic32 _shards;
+};
+
+// Public keys decoded for verification, kept most recently used first up
+// to a byte budget. Entries are reference counted, so a worker keeps the
+// key it looked up even when another one evicts it meanwhile. The cache
+// is split into shards by the first byte of the key, each with its own
+// lock, table and share of the budget, so workers looking up different
+// keys rarely wait on each other.
+class KeyCache {
+public:
+  class Key : public base::RefCountedThreadSafe<Key> {
+  public:
+    explicit Key(crypto_sign_key* key) : key_(key) {
+    }
+    const crypto_sign_key* get() const {
+      return key_;
+    }
+
+  private:
+    friend class base::RefCountedThreadSafe<Key>;
+    ~Key() {
+      crypto_sign_key_free(key_);
+    }
+    crypto_sign_key* key_;
+  };
+
+  struct Stats {
+    double hits;
+    double misses;
+    size_t entries;
+    size_t bytes;
+    size_t capacity;
+  };
+
+  enum { kDefaultCapacity = 8 << 20 };
+
+  KeyCache();
+  static KeyCache* GetInstance();
+  // the decoded key of |pk|, NULL when it is not a point
+  scoped_refptr<Key> Get(const unsigned char* pk);
+  // 0 turns the cache off
+  void SetCapacity(size_t bytes);
+  bool enabled() const {
+    return capacity_ > 0;
+  }
+  Stats stats();
+
+private:
+  enum { kShards = 16 };
+
+  struct PublicKey {
+    unsigned char bytes[32];
+    bool operator==(const PublicKey& other) const {
+      return 0 == memcmp(bytes, other.bytes, 32);
+    }
+  };
+  // keyed with a random seed, so chosen keys cannot pile up in one bucket
+  struct Hash {
+    Hash() : seed(0) {
+    }
+    explicit Hash(uint64_t seed) : seed(seed) {
+    }
+    size_t operator()(const PublicKey& pk) const;
+    uint64_t seed;
+  };
+  typedef std::list<std::pair<PublicKey, scoped_refptr<Key> > > Entries;
+  typedef std::unordered_map<PublicKey, Entries::iterator, Hash> Index;
+  struct Shard {
+    Shard() : hits(0), misses(0) {
+    }
+    CriticalSection lock;
+    Entries lru;
+    Index index;
+    double hits;
+    double misses;
+  };
+
+  // what an entry takes, with the key bytes and the list and table nodes
+  static size_t EntryBytes();
+  void EvictLocked(Shard* shard);
+
+  Shard shards_[kShards];
+  volatile size_t capacity_;
+};
+
 class Ed25519Helper {
 public:
   explicit Ed25519Helper();
@@ -46,6 +267,20 @@ public:
   void Sign(const Ed25519Data &data, rcib::async_req * req);
   // Verify
   void Verify(const Ed25519Data& data, rcib::async_req * req);
+  // Verify many, the tuples are in req->out
+  void VerifyBatch(rcib::async_req * req);
+  // Expand the seed or private key of a createSigner job
+  void CreateSigner(const Ed25519Data& data, rcib::async_req * req);
+  // One shard of a verifyPacked job, records [begin, end)
+  void VerifyShard(rcib::async_req * req, size_t begin, size_t end);
+  // One shard of a makeKeypairs job, keys [begin, end)
+  void KeypairShard(rcib::async_req * req, size_t begin, size_t end);
+  // crypto_sign_verify through the key cache
+  static bool VerifyOne(const unsigned char* sig, const unsigned char* msg, size_t mlen,
+    const unsigned char* pk);
+  // crypto_sign_verify_batch through the key cache
+  static void VerifyMany(const unsigned char* const* msgs, const size_t* mlens,
+    const unsigned char* const* sigs, const unsigned char* const* pks, size_t n, int* valid);
 };
 
 #endif
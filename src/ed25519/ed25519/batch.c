@@ -0,0 +1,468 @@
+#include "ed25519.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "ge.h"
+#include "key.h"
+#include "sc.h"
+
+/*
+Batch verification.
+
+crypto_sign_verify accepts (R,s) on m under A when sB - hA encodes to
+R, h = H(R,A,m), see open.c. For random 128 bit z_i the batch checks
+
+  sum z_i (-R_i) + sum (z_i h_i) (-A_i) + (sum z_i s_i) B = 0
+
+with one multi-scalar multiplication over all -R_i and -A_i, plus one
+fixed base multiplication. Up to STRAUS_MAX signatures that is Straus
+over the odd multiples ge_double_scalarmult_table makes (a decoded key
+has them already), above it Pippenger with signed radix 2^c buckets.
+When every R_i and A_i lies in the subgroup of prime order l, a bad
+signature leaves the sum nonzero except with probability 2^-128. When a
+batch fails it is split in halves, down to BATCH_MIN signatures which
+are verified one by one, so a few bad signatures in a large batch cost
+little extra.
+
+A component of order 2, 4 or 8 in R or A would only be caught when z_i
+is odd, so no such point goes into a batch: a signature under such an A
+is verified alone, and one whose R has such a component is invalid
+under any other A, since sB - hA has none. ge_torsion_free_vartime
+costs about a quarter of a verify, and a decoded key keeps its answer.
+The batch then agrees with crypto_sign_verify on every signature.
+*/
+
+/*
+Measured against crypto_sign_verify_key on one x86-64 core: a batch of
+decoded keys is ahead from 4 signatures on. Under public keys each A
+takes a torsion test as well, and the batch only catches up at about
+BATCH_MIN_PK. Straus and Pippenger cross at about 64 signatures.
+*/
+#define BATCH_MIN 4
+#define BATCH_MIN_PK 32
+#define STRAUS_MAX 64
+
+/* the odd multiples -R, -3R, ..., -15R and the same of A, as
+   ge_double_scalarmult_table makes them; a batch over STRAUS_MAX
+   signatures only fills in the first of each */
+typedef struct {
+  ge_cached negR[8];
+  ge_cached negAi[8];
+  const ge_cached *negA;  /* negAi, or the table of a decoded key */
+  unsigned char z[32];   /* random, 128 bits */
+  unsigned char zh[32];  /* z h mod l */
+  unsigned char s[32];
+} batch_entry;
+
+/* the signatures of one call; keys is set instead of pk for
+   crypto_sign_verify_batch_keys */
+typedef struct {
+  const unsigned char *const *m;
+  const size_t *mlen;
+  const unsigned char *const *sig;
+  const unsigned char *const *pk;
+  const crypto_sign_key *const *keys;
+} batch_input;
+
+static const unsigned char zero[32];
+
+static int verify_one(const batch_input *in, size_t k)
+{
+  if (in->keys) {
+    return in->keys[k] && crypto_sign_verify_key(in->sig[k], in->m[k], in->mlen[k], in->keys[k]) == 0;
+  }
+  return crypto_sign_verify(in->sig[k], in->m[k], in->mlen[k], in->pk[k]) == 0;
+}
+
+/* signed digits of a in radix 2^c, each in [-2^(c-1), 2^(c-1)] */
+static void recode(signed char *d, const unsigned char *a, int c, int windows)
+{
+  int carry = 0;
+  int i;
+
+  for (i = 0; i < windows; ++i) {
+    int bit = i * c;
+    int v = 0;
+    if (bit < 256) {
+      int byte = bit >> 3;
+      unsigned int word = a[byte];
+      if (byte + 1 < 32) word |= (unsigned int)a[byte + 1] << 8;
+      v = (word >> (bit & 7)) & ((1 << c) - 1);
+    }
+    v += carry;
+    if (v > (1 << (c - 1))) {
+      v -= 1 << c;
+      carry = 1;
+    } else {
+      carry = 0;
+    }
+    d[i] = (signed char)v;
+  }
+}
+
+static void p3_add(ge_p3 *r, const ge_p3 *p, const ge_p3 *q)
+{
+  ge_cached c;
+  ge_p1p1 t;
+  ge_p3_to_cached(&c, q);
+  ge_add(&t, p, &c);
+  ge_p1p1_to_p3(r, &t);
+}
+
+static int window_bits(size_t points)
+{
+  if (points < 32) return 3;
+  if (points < 128) return 4;
+  if (points < 512) return 5;
+  if (points < 2048) return 6;
+  return 7;
+}
+
+/* r = sum scalars[i] points[i]; 0 on allocation failure */
+static int msm(ge_p3 *r, const ge_cached *const *points,
+  const unsigned char *const *scalars, size_t n)
+{
+  int c = window_bits(n);
+  int windows = (256 + c - 1) / c + 1;
+  int nbuckets = 1 << (c - 1);
+  signed char *digits;
+  ge_p3 *buckets;
+  ge_p3 running;
+  ge_p3 sum;
+  ge_p1p1 t;
+  ge_p2 p2;
+  size_t i;
+  int w;
+  int j;
+  int k;
+
+  digits = (signed char *)malloc(n * windows);
+  buckets = (ge_p3 *)malloc(nbuckets * sizeof(ge_p3));
+  if (!digits || !buckets) {
+    free(digits);
+    free(buckets);
+    return 0;
+  }
+  for (i = 0; i < n; ++i)
+    recode(digits + i * windows, scalars[i], c, windows);
+
+  ge_p3_0(r);
+  for (w = windows - 1; w >= 0; --w) {
+    if (w != windows - 1) {
+      ge_p3_to_p2(&p2, r);
+      for (k = 0; k < c - 1; ++k) {
+        ge_p2_dbl(&t, &p2);
+        ge_p1p1_to_p2(&p2, &t);
+      }
+      ge_p2_dbl(&t, &p2);
+      ge_p1p1_to_p3(r, &t);
+    }
+
+    for (j = 0; j < nbuckets; ++j)
+      ge_p3_0(&buckets[j]);
+    for (i = 0; i < n; ++i) {
+      int d = digits[i * windows + w];
+      if (d > 0) {
+        ge_add(&t, &buckets[d - 1], points[i]);
+        ge_p1p1_to_p3(&buckets[d - 1], &t);
+      } else if (d < 0) {
+        ge_sub(&t, &buckets[-d - 1], points[i]);
+        ge_p1p1_to_p3(&buckets[-d - 1], &t);
+      }
+    }
+
+    /* sum_j (j+1) bucket[j], by running sums from the top */
+    ge_p3_0(&running);
+    ge_p3_0(&sum);
+    for (j = nbuckets - 1; j >= 0; --j) {
+      p3_add(&running, &running, &buckets[j]);
+      p3_add(&sum, &sum, &running);
+    }
+    p3_add(r, r, &sum);
+  }
+
+  free(digits);
+  free(buckets);
+  return 1;
+}
+
+/* r = sum z_i (-R_i) + sum zh_i (-A_i) by Pippenger; 0 on no memory */
+static int pippenger(ge_p3 *r, batch_entry *const *e, size_t n)
+{
+  const ge_cached **points;
+  const unsigned char **scalars;
+  size_t i;
+  int ok;
+
+  points = (const ge_cached **)malloc(2 * n * sizeof(*points));
+  scalars = (const unsigned char **)malloc(2 * n * sizeof(*scalars));
+  if (!points || !scalars) {
+    free(points);
+    free(scalars);
+    return 0;
+  }
+  for (i = 0; i < n; ++i) {
+    points[2 * i] = &e[i]->negR[0];
+    scalars[2 * i] = e[i]->z;
+    points[2 * i + 1] = &e[i]->negA[0];
+    scalars[2 * i + 1] = e[i]->zh;
+  }
+  ok = msm(r, points, scalars, 2 * n);
+  free(points);
+  free(scalars);
+  return ok;
+}
+
+/*
+the same sum by Straus: ge_double_scalarmult_cached over all the
+tables at once, so the 256 doublings are shared and there are no
+buckets to sum up. Cheaper than Pippenger up to about STRAUS_MAX.
+*/
+static int straus(ge_p3 *r, batch_entry *const *e, size_t n)
+{
+  signed char *digits;
+  ge_p1p1 t;
+  ge_p3 u;
+  ge_p2 p2;
+  size_t i;
+  int k;
+
+  digits = (signed char *)malloc(n * 512);
+  if (!digits) return 0;
+  for (i = 0; i < n; ++i) {
+    ge_slide(digits + 512 * i, e[i]->z);
+    ge_slide(digits + 512 * i + 256, e[i]->zh);
+  }
+
+  ge_p3_0(r);
+  ge_p2_0(&p2);
+  for (k = 255; k >= 0; --k) {
+    for (i = 0; i < 2 * n; ++i)
+      if (digits[256 * i + k]) break;
+    if (i < 2 * n) break;
+  }
+
+  for (; k >= 0; --k) {
+    ge_p2_dbl(&t, &p2);
+    for (i = 0; i < n; ++i) {
+      const signed char *d = digits + 512 * i + k;
+      if (d[0] > 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_add(&t, &u, &e[i]->negR[d[0] / 2]);
+      } else if (d[0] < 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_sub(&t, &u, &e[i]->negR[-d[0] / 2]);
+      }
+      if (d[256] > 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_add(&t, &u, &e[i]->negA[d[256] / 2]);
+      } else if (d[256] < 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_sub(&t, &u, &e[i]->negA[-d[256] / 2]);
+      }
+    }
+    if (k > 0) {
+      ge_p1p1_to_p2(&p2, &t);
+    } else {
+      ge_p1p1_to_p3(r, &t);
+    }
+  }
+
+  free(digits);
+  return 1;
+}
+
+/* 1 if every entry of the batch is valid, 0 if not, -1 on no memory */
+static int batch_holds(batch_entry *const *e, size_t n, int tables)
+{
+  unsigned char zs[32];
+  ge_p3 r;
+  ge_p3 sB;
+  ge_cached c;
+  ge_p1p1 t;
+  ge_p2 sum;
+  fe check;
+  size_t i;
+  int ok;
+
+  ok = tables ? straus(&r, e, n) : pippenger(&r, e, n);
+  if (!ok) return -1;
+
+  memset(zs, 0, 32);
+  for (i = 0; i < n; ++i)
+    sc_muladd(zs, e[i]->z, e[i]->s, zs);
+  ge_scalarmult_base(&sB, zs);
+  ge_p3_to_cached(&c, &sB);
+  ge_add(&t, &r, &c);
+  ge_p1p1_to_p2(&sum, &t);
+  /* the identity: x = X/Z = 0, y = Y/Z = 1 */
+  fe_sub(check, sum.Y, sum.Z);
+  return !fe_isnonzero(sum.X) && !fe_isnonzero(check);
+}
+
+static void verify_each(const size_t *index, size_t n, const batch_input *in, int *valid)
+{
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    size_t k = index[i];
+    valid[k] = verify_one(in, k);
+  }
+}
+
+static void verify_range(batch_entry *const *e, const size_t *index, size_t n,
+  int tables, const batch_input *in, int *valid)
+{
+  int holds;
+  size_t half;
+
+  if (n <= BATCH_MIN) {
+    verify_each(index, n, in, valid);
+    return;
+  }
+  holds = batch_holds(e, n, tables);
+  if (holds > 0) return;  /* valid[] was preset to 1 */
+  if (holds < 0) {
+    verify_each(index, n, in, valid);
+    return;
+  }
+  half = n / 2;
+  verify_range(e, index, half, tables, in, valid);
+  verify_range(e + half, index + half, n - half, tables, in, valid);
+}
+
+static int verify_batch(const batch_input *in, size_t n, int *valid)
+{
+  batch_entry *entries;
+  batch_entry **live;
+  size_t *index;
+  unsigned char *z;
+  size_t count = 0;
+  int tables = n <= STRAUS_MAX;
+  unsigned char h[64];
+  EVP_MD_CTX *hash;
+  ge_p3 p;
+  size_t i;
+  int all = 1;
+
+  entries = NULL;
+  live = NULL;
+  index = NULL;
+  z = NULL;
+  hash = NULL;
+  if (n > (in->keys ? BATCH_MIN : BATCH_MIN_PK) && n <= INT_MAX / 16) {
+    entries = (batch_entry *)malloc(n * sizeof(batch_entry));
+    live = (batch_entry **)malloc(n * sizeof(batch_entry *));
+    index = (size_t *)malloc(n * sizeof(size_t));
+    z = (unsigned char *)malloc(n * 16);
+    hash = EVP_MD_CTX_new();
+  }
+  /* a small batch, no memory or no randomness: one by one */
+  if (!entries || !live || !index || !z || !hash || RAND_bytes(z, (int)(n * 16)) != 1) {
+    free(entries);
+    free(live);
+    free(index);
+    free(z);
+    EVP_MD_CTX_free(hash);
+    for (i = 0; i < n; ++i) {
+      valid[i] = verify_one(in, i);
+      all &= valid[i];
+    }
+    return all ? 0 : -1;
+  }
+
+  for (i = 0; i < n; ++i) {
+    batch_entry *e = &entries[count];
+    const unsigned char *sig = in->sig[i];
+    const unsigned char *pk;
+    valid[i] = 0;
+    if (sig[63] & 224) continue;
+    if (in->keys) {
+      if (!in->keys[i]) continue;
+      if (!in->keys[i]->torsion_free) {
+        valid[i] = verify_one(in, i);
+        continue;
+      }
+      pk = in->keys[i]->pk;
+      e->negA = in->keys[i]->Ai;
+    } else {
+      pk = in->pk[i];
+      if (ge_frombytes_negate_vartime(&p, pk) != 0) continue;
+      if (!ge_torsion_free_vartime(&p)) {
+        valid[i] = verify_one(in, i);
+        continue;
+      }
+      if (tables) {
+        ge_double_scalarmult_table(e->negAi, &p);
+      } else {
+        ge_p3_to_cached(&e->negAi[0], &p);
+      }
+      e->negA = e->negAi;
+    }
+    /* R has to be the canonical encoding of sB - hA */
+    if (ge_frombytes_canonical_negate_vartime(&p, sig) != 0) continue;
+    if (!ge_torsion_free_vartime(&p)) continue;
+    if (tables) {
+      ge_double_scalarmult_table(e->negR, &p);
+    } else {
+      ge_p3_to_cached(&e->negR[0], &p);
+    }
+
+    if (EVP_DigestInit_ex(hash, EVP_sha512(), NULL) != 1 ||
+        EVP_DigestUpdate(hash, sig, 32) != 1 ||
+        EVP_DigestUpdate(hash, pk, 32) != 1 ||
+        EVP_DigestUpdate(hash, in->m[i], in->mlen[i]) != 1 ||
+        EVP_DigestFinal_ex(hash, h, NULL) != 1) {
+      valid[i] = verify_one(in, i);
+      continue;
+    }
+    sc_reduce(h);
+
+    memcpy(e->z, z + 16 * i, 16);
+    memset(e->z + 16, 0, 16);
+    sc_muladd(e->zh, e->z, h, zero);
+    memcpy(e->s, sig + 32, 32);
+    valid[i] = 1;
+    live[count] = e;
+    index[count] = i;
+    ++count;
+  }
+
+  verify_range(live, index, count, tables, in, valid);
+
+  for (i = 0; i < n; ++i)
+    all &= valid[i];
+  free(entries);
+  free(live);
+  free(index);
+  free(z);
+  EVP_MD_CTX_free(hash);
+  return all ? 0 : -1;
+}
+
+int crypto_sign_verify_batch(const unsigned char *const *m, const size_t *mlen,
+  const unsigned char *const *sig, const unsigned char *const *pk,
+  size_t n, int *valid)
+{
+  batch_input in;
+  in.m = m;
+  in.mlen = mlen;
+  in.sig = sig;
+  in.pk = pk;
+  in.keys = NULL;
+  return verify_batch(&in, n, valid);
+}
+
+int crypto_sign_verify_batch_keys(const unsigned char *const *m, const size_t *mlen,
+  const unsigned char *const *sig, const crypto_sign_key *const *keys,
+  size_t n, int *valid)
+{
+  batch_input in;
+  in.m = m;
+  in.mlen = mlen;
+  in.sig = sig;
+  in.pk = NULL;
+  in.keys = keys;
+  return verify_batch(&in, n, valid);
+}
@@ -0,0 +1 @@
+1859910466990425,932731440258426,1072319116312658,1815898335770999,633789495995903
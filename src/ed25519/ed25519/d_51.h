@@ -0,0 +1 @@
+929955233495203,466365720129213,1662059464998953,2033849074728123,1442794654840575
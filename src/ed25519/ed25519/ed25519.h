@@ -8,12 +8,42 @@ extern "C" {
 #endif
 
 	int crypto_sign_keypair(unsigned char *pk, unsigned char *sk);
+	/* n keypairs at once: sk is n 64 byte keys, seeds in the first halves */
+	int crypto_sign_keypairs(unsigned char *pk, unsigned char *sk, size_t n);
 	int crypto_sign_open(unsigned char *m, unsigned long long *mlen, const unsigned char *sm,
 						 unsigned long long smlen, const unsigned char *pk);
 	int crypto_sign(unsigned char *sm, unsigned long long *smlen, const unsigned char *m,
 					unsigned long long mlen, const unsigned char *sk);
+	int crypto_sign_detached(unsigned char *sig, const unsigned char *m,
+							 unsigned long long mlen, const unsigned char *sk);
+	/* esk: 96 bytes, the secret scalar, the nonce prefix and the public key */
+	int crypto_sign_expand(unsigned char *esk, const unsigned char *sk);
+	int crypto_sign_detached_expanded(unsigned char *sig, const unsigned char *m,
+									  unsigned long long mlen, const unsigned char *esk);
+	/*
+	 window 5: key generation and signing use the compiled in table of 16
+	 multiples of B per radix 32 digit (some 100KB), 0 the built-in radix
+	 16 tables. Safe while other threads sign. -1 on any other window
+	*/
+	int crypto_sign_base_window(int window);
 	int crypto_sign_verify(const unsigned char *signature, const unsigned char *message,
 						   size_t message_len, const unsigned char *public_key);
+	int crypto_sign_verify_batch(const unsigned char *const *m, const size_t *mlen,
+								 const unsigned char *const *sig, const unsigned char *const *pk,
+								 size_t n, int *valid);
+
+	/* a public key decoded once, for verifying many of its signatures */
+	typedef struct crypto_sign_key crypto_sign_key;
+	/* NULL when pk does not decode to a point (or there is no memory) */
+	crypto_sign_key *crypto_sign_key_new(const unsigned char *pk);
+	void crypto_sign_key_free(crypto_sign_key *key);
+	size_t crypto_sign_key_size(void);
+	int crypto_sign_verify_key(const unsigned char *signature, const unsigned char *message,
+							   size_t message_len, const crypto_sign_key *key);
+	/* crypto_sign_verify_batch over decoded keys; a NULL key fails its signature */
+	int crypto_sign_verify_batch_keys(const unsigned char *const *m, const size_t *mlen,
+									  const unsigned char *const *sig, const crypto_sign_key *const *keys,
+									  size_t n, int *valid);
 #ifdef __cplusplus
 }
 #endif
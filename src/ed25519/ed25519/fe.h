@@ -2,17 +2,30 @@
 #define FE_H
 
 #include "crypto_int32.h"
-
-typedef crypto_int32 fe[10];
+#include "crypto_uint64.h"
 
 /*
 fe means field element.
 Here the field is \Z/(2^255-19).
+
+Where the compiler has a 64x64->128 bit multiply (64-bit gcc and clang),
+an element is five 51 bit limbs, see fe51.c. Elsewhere, or when
+ED25519_REF10 is defined, it is the ref10 form:
 An element t, entries t[0]...t[9], represents the integer
 t[0]+2^26 t[1]+2^51 t[2]+2^77 t[3]+2^102 t[4]+...+2^230 t[9].
 Bounds on each t[i] vary depending on context.
 */
 
+#if !defined(ED25519_REF10) && defined(__SIZEOF_INT128__)
+#define ED25519_FE51
+#endif
+
+#ifdef ED25519_FE51
+typedef crypto_uint64 fe[5];
+#else
+typedef crypto_int32 fe[10];
+#endif
+
 #define fe_frombytes crypto_sign_ed25519_ref10_fe_frombytes
 #define fe_tobytes crypto_sign_ed25519_ref10_fe_tobytes
 #define fe_copy crypto_sign_ed25519_ref10_fe_copy
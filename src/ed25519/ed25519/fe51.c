@@ -0,0 +1,230 @@
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+The five limb backend, for 64-bit compilers with a 64x64->128 bit
+multiply. An element t, entries t[0]...t[4], represents the integer
+t[0]+2^51 t[1]+2^102 t[2]+2^153 t[3]+2^204 t[4].
+Every function carries its result back to 51 bit limbs (the lowest may
+be a little over), which is what every function takes, so results can
+be fed to one another in any order, as the ge code does.
+fe_invert and fe_pow22523 are shared with ref10: they only call fe_sq
+and fe_mul.
+*/
+
+typedef unsigned __int128 crypto_uint128;
+
+#define MASK51 (((crypto_uint64) 1 << 51) - 1)
+
+static crypto_uint64 load_8(const unsigned char *in)
+{
+  crypto_uint64 result = 0;
+  int i;
+  for (i = 7;i >= 0;--i) result = (result << 8) | in[i];
+  return result;
+}
+
+/* limbs below 2^51, plus at most 19 * 2^13 in h[0] */
+static void carry(fe h)
+{
+  crypto_uint64 c;
+  c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+  c = h[1] >> 51; h[1] &= MASK51; h[2] += c;
+  c = h[2] >> 51; h[2] &= MASK51; h[3] += c;
+  c = h[3] >> 51; h[3] &= MASK51; h[4] += c;
+  c = h[4] >> 51; h[4] &= MASK51; h[0] += c * 19;
+}
+
+void fe_0(fe h)
+{
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+void fe_1(fe h)
+{
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+void fe_copy(fe h,const fe f)
+{
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+/* Preconditions: b in {0,1}. */
+void fe_cmov(fe f,const fe g,unsigned int b)
+{
+  crypto_uint64 mask = (crypto_uint64) 0 - b;
+  f[0] ^= (f[0] ^ g[0]) & mask;
+  f[1] ^= (f[1] ^ g[1]) & mask;
+  f[2] ^= (f[2] ^ g[2]) & mask;
+  f[3] ^= (f[3] ^ g[3]) & mask;
+  f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+void fe_add(fe h,const fe f,const fe g)
+{
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+  carry(h);
+}
+
+/* 4p, so that f - g does not go below zero for g below 2^53 */
+#define FOUR_P0 0x1fffffffffffb4ULL
+#define FOUR_P1 0x1ffffffffffffcULL
+
+void fe_sub(fe h,const fe f,const fe g)
+{
+  h[0] = f[0] + FOUR_P0 - g[0];
+  h[1] = f[1] + FOUR_P1 - g[1];
+  h[2] = f[2] + FOUR_P1 - g[2];
+  h[3] = f[3] + FOUR_P1 - g[3];
+  h[4] = f[4] + FOUR_P1 - g[4];
+  carry(h);
+}
+
+void fe_neg(fe h,const fe f)
+{
+  h[0] = FOUR_P0 - f[0];
+  h[1] = FOUR_P1 - f[1];
+  h[2] = FOUR_P1 - f[2];
+  h[3] = FOUR_P1 - f[3];
+  h[4] = FOUR_P1 - f[4];
+  carry(h);
+}
+
+/* sums of 128-bit products, carried back into 51-bit limbs */
+static void reduce128(fe h,crypto_uint128 r0,crypto_uint128 r1,crypto_uint128 r2,
+  crypto_uint128 r3,crypto_uint128 r4)
+{
+  crypto_uint64 c;
+  r1 += (crypto_uint64) (r0 >> 51); h[0] = (crypto_uint64) r0 & MASK51;
+  r2 += (crypto_uint64) (r1 >> 51); h[1] = (crypto_uint64) r1 & MASK51;
+  r3 += (crypto_uint64) (r2 >> 51); h[2] = (crypto_uint64) r2 & MASK51;
+  r4 += (crypto_uint64) (r3 >> 51); h[3] = (crypto_uint64) r3 & MASK51;
+  c = (crypto_uint64) (r4 >> 51); h[4] = (crypto_uint64) r4 & MASK51;
+  h[0] += c * 19;
+  c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+}
+
+void fe_mul(fe h,const fe f,const fe g)
+{
+  crypto_uint64 f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  crypto_uint64 g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  crypto_uint64 g1_19 = 19 * g1;
+  crypto_uint64 g2_19 = 19 * g2;
+  crypto_uint64 g3_19 = 19 * g3;
+  crypto_uint64 g4_19 = 19 * g4;
+  crypto_uint128 r0, r1, r2, r3, r4;
+
+  r0 = (crypto_uint128) f0 * g0 + (crypto_uint128) f1 * g4_19 + (crypto_uint128) f2 * g3_19
+     + (crypto_uint128) f3 * g2_19 + (crypto_uint128) f4 * g1_19;
+  r1 = (crypto_uint128) f0 * g1 + (crypto_uint128) f1 * g0 + (crypto_uint128) f2 * g4_19
+     + (crypto_uint128) f3 * g3_19 + (crypto_uint128) f4 * g2_19;
+  r2 = (crypto_uint128) f0 * g2 + (crypto_uint128) f1 * g1 + (crypto_uint128) f2 * g0
+     + (crypto_uint128) f3 * g4_19 + (crypto_uint128) f4 * g3_19;
+  r3 = (crypto_uint128) f0 * g3 + (crypto_uint128) f1 * g2 + (crypto_uint128) f2 * g1
+     + (crypto_uint128) f3 * g0 + (crypto_uint128) f4 * g4_19;
+  r4 = (crypto_uint128) f0 * g4 + (crypto_uint128) f1 * g3 + (crypto_uint128) f2 * g2
+     + (crypto_uint128) f3 * g1 + (crypto_uint128) f4 * g0;
+  reduce128(h, r0, r1, r2, r3, r4);
+}
+
+void fe_sq(fe h,const fe f)
+{
+  crypto_uint64 f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  crypto_uint64 f0_2 = 2 * f0;
+  crypto_uint64 f1_2 = 2 * f1;
+  crypto_uint64 f1_38 = 38 * f1;
+  crypto_uint64 f2_38 = 38 * f2;
+  crypto_uint64 f3_19 = 19 * f3;
+  crypto_uint64 f3_38 = 38 * f3;
+  crypto_uint64 f4_19 = 19 * f4;
+  crypto_uint128 r0, r1, r2, r3, r4;
+
+  r0 = (crypto_uint128) f0 * f0 + (crypto_uint128) f1_38 * f4 + (crypto_uint128) f2_38 * f3;
+  r1 = (crypto_uint128) f0_2 * f1 + (crypto_uint128) f2_38 * f4 + (crypto_uint128) f3_19 * f3;
+  r2 = (crypto_uint128) f0_2 * f2 + (crypto_uint128) f1 * f1 + (crypto_uint128) f3_38 * f4;
+  r3 = (crypto_uint128) f0_2 * f3 + (crypto_uint128) f1_2 * f2 + (crypto_uint128) f4_19 * f4;
+  r4 = (crypto_uint128) f0_2 * f4 + (crypto_uint128) f1_2 * f3 + (crypto_uint128) f2 * f2;
+  reduce128(h, r0, r1, r2, r3, r4);
+}
+
+/* h = 2 * f * f */
+void fe_sq2(fe h,const fe f)
+{
+  fe_sq(h,f);
+  fe_add(h,h,h);
+}
+
+void fe_mul121666(fe h,const fe f)
+{
+  reduce128(h,
+    (crypto_uint128) f[0] * 121666,
+    (crypto_uint128) f[1] * 121666,
+    (crypto_uint128) f[2] * 121666,
+    (crypto_uint128) f[3] * 121666,
+    (crypto_uint128) f[4] * 121666);
+}
+
+/* Ignores the top bit of s[31], as the ref10 version does. */
+void fe_frombytes(fe h,const unsigned char *s)
+{
+  h[0] = load_8(s) & MASK51;
+  h[1] = (load_8(s + 6) >> 3) & MASK51;
+  h[2] = (load_8(s + 12) >> 6) & MASK51;
+  h[3] = (load_8(s + 19) >> 1) & MASK51;
+  h[4] = (load_8(s + 24) >> 12) & MASK51;
+}
+
+/* The unique representative in [0, p), little endian. */
+void fe_tobytes(unsigned char *s,const fe f)
+{
+  crypto_uint64 t[5];
+  crypto_uint64 w;
+  int i;
+
+  fe_copy(t,f);
+  carry(t);
+  carry(t);
+  /* now t < 2^255; add 19 and see whether that reaches 2^255 */
+  t[0] += 19;
+  carry(t);
+  /* t + 19 (mod 2^255) - 19 = t - p if t >= p, else t + 2^255 - p */
+  t[0] += ((crypto_uint64) 1 << 51) - 19;
+  t[1] += ((crypto_uint64) 1 << 51) - 1;
+  t[2] += ((crypto_uint64) 1 << 51) - 1;
+  t[3] += ((crypto_uint64) 1 << 51) - 1;
+  t[4] += ((crypto_uint64) 1 << 51) - 1;
+  t[1] += t[0] >> 51; t[0] &= MASK51;
+  t[2] += t[1] >> 51; t[1] &= MASK51;
+  t[3] += t[2] >> 51; t[2] &= MASK51;
+  t[4] += t[3] >> 51; t[3] &= MASK51;
+  t[4] &= MASK51;
+
+  w = t[0] | (t[1] << 51);
+  for (i = 0;i < 8;++i) s[i] = (unsigned char) (w >> (8 * i));
+  w = (t[1] >> 13) | (t[2] << 38);
+  for (i = 0;i < 8;++i) s[8 + i] = (unsigned char) (w >> (8 * i));
+  w = (t[2] >> 26) | (t[3] << 25);
+  for (i = 0;i < 8;++i) s[16 + i] = (unsigned char) (w >> (8 * i));
+  w = (t[3] >> 39) | (t[4] << 12);
+  for (i = 0;i < 8;++i) s[24 + i] = (unsigned char) (w >> (8 * i));
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 h = 0
 */
@@ -17,3 +19,5 @@ void fe_0(fe h)
   h[8] = 0;
   h[9] = 0;
 }
+
+#endif
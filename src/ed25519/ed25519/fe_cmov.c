@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 Replace (f,g) with (g,g) if b == 1;
 replace (f,g) with (f,g) if b == 0.
@@ -61,3 +63,5 @@ void fe_cmov(fe f,const fe g,unsigned int b)
   f[8] = f8 ^ x8;
   f[9] = f9 ^ x9;
 }
+
+#endif
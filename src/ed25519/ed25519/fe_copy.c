@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 h = f
 */
@@ -27,3 +29,5 @@ void fe_copy(fe h,const fe f)
   h[8] = f8;
   h[9] = f9;
 }
+
+#endif
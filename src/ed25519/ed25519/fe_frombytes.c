@@ -1,4 +1,6 @@
 #include "fe.h"
+
+#ifndef ED25519_FE51
 #include "crypto_int64.h"
 #include "crypto_uint64.h"
 
@@ -71,3 +73,5 @@ void fe_frombytes(fe h,const unsigned char *s)
   h[8] = h8;
   h[9] = h9;
 }
+
+#endif
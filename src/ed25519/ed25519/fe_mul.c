@@ -1,4 +1,6 @@
 #include "fe.h"
+
+#ifndef ED25519_FE51
 #include "crypto_int64.h"
 
 /*
@@ -251,3 +253,5 @@ void fe_mul(fe h,const fe f,const fe g)
   h[8] = h8;
   h[9] = h9;
 }
+
+#endif
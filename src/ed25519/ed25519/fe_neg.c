@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 h = -f
 
@@ -43,3 +45,5 @@ void fe_neg(fe h,const fe f)
   h[8] = h8;
   h[9] = h9;
 }
+
+#endif
@@ -1,4 +1,6 @@
 #include "fe.h"
+
+#ifndef ED25519_FE51
 #include "crypto_int64.h"
 
 /*
@@ -158,3 +160,5 @@ void fe_sq2(fe h,const fe f)
   h[8] = h8;
   h[9] = h9;
 }
+
+#endif
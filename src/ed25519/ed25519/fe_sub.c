@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 h = f - g
 Can overlap h with f or g.
@@ -55,3 +57,5 @@ void fe_sub(fe h,const fe f,const fe g)
   h[8] = h8;
   h[9] = h9;
 }
+
+#endif
@@ -1,5 +1,7 @@
 #include "fe.h"
 
+#ifndef ED25519_FE51
+
 /*
 Preconditions:
   |h| bounded by 1.1*2^26,1.1*2^25,1.1*2^26,1.1*2^25,etc.
@@ -117,3 +119,5 @@ void fe_tobytes(unsigned char *s,const fe h)
   s[30] = h9 >> 10;
   s[31] = h9 >> 18;
 }
+
+#endif
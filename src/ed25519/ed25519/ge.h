@@ -53,6 +53,8 @@ typedef struct {
 #define ge_frombytes_negate_vartime crypto_sign_ed25519_ref10_ge_frombytes_negate_vartime
 #define ge_tobytes crypto_sign_ed25519_ref10_ge_tobytes
 #define ge_p3_tobytes crypto_sign_ed25519_ref10_ge_p3_tobytes
+#define ge_frombytes_canonical_negate_vartime crypto_sign_ed25519_ref10_ge_frombytes_canonical_negate_vartime
+#define ge_torsion_free_vartime crypto_sign_ed25519_ref10_ge_torsion_free_vartime
 
 #define ge_p2_0 crypto_sign_ed25519_ref10_ge_p2_0
 #define ge_p3_0 crypto_sign_ed25519_ref10_ge_p3_0
@@ -69,11 +71,17 @@ typedef struct {
 #define ge_add crypto_sign_ed25519_ref10_ge_add
 #define ge_sub crypto_sign_ed25519_ref10_ge_sub
 #define ge_scalarmult_base crypto_sign_ed25519_ref10_ge_scalarmult_base
+#define ge_scalarmult_base_wide crypto_sign_ed25519_ref10_ge_scalarmult_base_wide
 #define ge_double_scalarmult_vartime crypto_sign_ed25519_ref10_ge_double_scalarmult_vartime
+#define ge_double_scalarmult_table crypto_sign_ed25519_ref10_ge_double_scalarmult_table
+#define ge_double_scalarmult_cached crypto_sign_ed25519_ref10_ge_double_scalarmult_cached
+#define ge_slide crypto_sign_ed25519_ref10_ge_slide
 
 extern void ge_tobytes(unsigned char *,const ge_p2 *);
 extern void ge_p3_tobytes(unsigned char *,const ge_p3 *);
 extern int ge_frombytes_negate_vartime(ge_p3 *,const unsigned char *);
+extern int ge_frombytes_canonical_negate_vartime(ge_p3 *,const unsigned char *);
+extern int ge_torsion_free_vartime(const ge_p3 *);
 
 extern void ge_p2_0(ge_p2 *);
 extern void ge_p3_0(ge_p3 *);
@@ -90,6 +98,11 @@ extern void ge_msub(ge_p1p1 *,const ge_p3 *,const ge_precomp *);
 extern void ge_add(ge_p1p1 *,const ge_p3 *,const ge_cached *);
 extern void ge_sub(ge_p1p1 *,const ge_p3 *,const ge_cached *);
 extern void ge_scalarmult_base(ge_p3 *,const unsigned char *);
+/* 0 when crypto_sign_base_window has not switched to the wide table */
+extern int ge_scalarmult_base_wide(ge_p3 *,const unsigned char *);
 extern void ge_double_scalarmult_vartime(ge_p2 *,const unsigned char *,const ge_p3 *,const unsigned char *);
+extern void ge_double_scalarmult_table(ge_cached *,const ge_p3 *);
+extern void ge_double_scalarmult_cached(ge_p2 *,const unsigned char *,const ge_cached *,const unsigned char *);
+extern void ge_slide(signed char *,const unsigned char *);
 
 #endif
@@ -1,6 +1,7 @@
 #include "ge.h"
 
-static void slide(signed char *r,const unsigned char *a)
+/* a in signed digits, each 0 or odd in [-15,15] */
+void ge_slide(signed char *r,const unsigned char *a)
 {
   int i;
   int b;
@@ -33,7 +34,11 @@ static void slide(signed char *r,const unsigned char *a)
 }
 
 static ge_precomp Bi[8] = {
+#ifdef ED25519_FE51
+#include "base2_51.h"
+#else
 #include "base2.h"
+#endif
 } ;
 
 /*
@@ -43,18 +48,12 @@ and b = b[0]+256*b[1]+...+256^31 b[31].
 B is the Ed25519 base point (x,4/5) with x positive.
 */
 
-void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A,const unsigned char *b)
+/* Ai = A,3A,5A,7A,9A,11A,13A,15A */
+void ge_double_scalarmult_table(ge_cached *Ai,const ge_p3 *A)
 {
-  signed char aslide[256];
-  signed char bslide[256];
-  ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
   ge_p1p1 t;
   ge_p3 u;
   ge_p3 A2;
-  int i;
-
-  slide(aslide,a);
-  slide(bslide,b);
 
   ge_p3_to_cached(&Ai[0],A);
   ge_p3_dbl(&t,A); ge_p1p1_to_p3(&A2,&t);
@@ -65,6 +64,27 @@ void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A
   ge_add(&t,&A2,&Ai[4]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[5],&u);
   ge_add(&t,&A2,&Ai[5]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[6],&u);
   ge_add(&t,&A2,&Ai[6]); ge_p1p1_to_p3(&u,&t); ge_p3_to_cached(&Ai[7],&u);
+}
+
+void ge_double_scalarmult_vartime(ge_p2 *r,const unsigned char *a,const ge_p3 *A,const unsigned char *b)
+{
+  ge_cached Ai[8];
+
+  ge_double_scalarmult_table(Ai,A);
+  ge_double_scalarmult_cached(r,a,Ai,b);
+}
+
+/* as ge_double_scalarmult_vartime, with the table of A already made */
+void ge_double_scalarmult_cached(ge_p2 *r,const unsigned char *a,const ge_cached *Ai,const unsigned char *b)
+{
+  signed char aslide[256];
+  signed char bslide[256];
+  ge_p1p1 t;
+  ge_p3 u;
+  int i;
+
+  ge_slide(aslide,a);
+  ge_slide(bslide,b);
 
   ge_p2_0(r);
 
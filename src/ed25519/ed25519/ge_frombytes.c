@@ -1,11 +1,19 @@
 #include "ge.h"
 
 static const fe d = {
+#ifdef ED25519_FE51
+#include "d_51.h"
+#else
 #include "d.h"
+#endif
 } ;
 
 static const fe sqrtm1 = {
+#ifdef ED25519_FE51
+#include "sqrtm1_51.h"
+#else
 #include "sqrtm1.h"
+#endif
 } ;
 
 int ge_frombytes_negate_vartime(ge_p3 *h,const unsigned char *s)
@@ -0,0 +1,21 @@
+#include "ge.h"
+
+/*
+ge_frombytes_negate_vartime, rejecting the encodings no point encodes
+to: y >= q, and x = 0 with the sign bit set
+*/
+
+int ge_frombytes_canonical_negate_vartime(ge_p3 *h,const unsigned char *s)
+{
+  unsigned char y[32];
+  fe t;
+  int i;
+
+  if (ge_frombytes_negate_vartime(h,s) != 0) return -1;
+  fe_frombytes(t,s);
+  fe_tobytes(y,t);
+  y[31] |= s[31] & 128;
+  for (i = 0;i < 32;++i) if (y[i] != s[i]) return -1;
+  if ((s[31] & 128) && !fe_isnonzero(h->X)) return -1;
+  return 0;
+}
@@ -5,7 +5,11 @@ r = p
 */
 
 static const fe d2 = {
+#ifdef ED25519_FE51
+#include "d2_51.h"
+#else
 #include "d2.h"
+#endif
 } ;
 
 extern void ge_p3_to_cached(ge_cached *r,const ge_p3 *p)
@@ -28,7 +28,11 @@ static void cmov(ge_precomp *t,ge_precomp *u,unsigned char b)
 
 /* base[i][j] = (j+1)*256^i*B */
 static ge_precomp base[32][8] = {
+#ifdef ED25519_FE51
+#include "base_51.h"
+#else
 #include "base.h"
+#endif
 } ;
 
 static void select(ge_precomp *t,int pos,signed char b)
@@ -70,6 +74,8 @@ void ge_scalarmult_base(ge_p3 *h,const unsigned char *a)
   ge_precomp t;
   int i;
 
+  if (ge_scalarmult_base_wide(h,a)) return;
+
   for (i = 0;i < 32;++i) {
     e[2 * i + 0] = (a[i] >> 0) & 15;
     e[2 * i + 1] = (a[i] >> 4) & 15;
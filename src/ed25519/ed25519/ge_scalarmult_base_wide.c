@@ -0,0 +1,128 @@
+#include "ed25519.h"
+#include "ge.h"
+#include "crypto_uint32.h"
+
+/* masks as wide as a limb vectorize */
+#ifdef ED25519_FE51
+typedef crypto_uint64 limb;
+#else
+typedef crypto_int32 limb;
+#endif
+
+/*
+The wide table: radix 32 signed digits, one row per digit,
+wide[i][j] = (j+1)*32^i*B, generated like base.h. There are no
+doublings, and a digit costs one addition and a scan of its 16 entries,
+against two additions (and a quarter of the doublings) per 8 bits with
+base[][] in ge_scalarmult_base.c: about 20% less time for some 100KB.
+Wider windows were slower: their longer rows cost more to scan than the
+additions they save.
+*/
+static const ge_precomp wide[52][16] = {
+#ifdef ED25519_FE51
+#include "wide5_51.h"
+#else
+#include "wide5.h"
+#endif
+} ;
+
+/*
+Whether ge_scalarmult_base uses wide. The table is constant, so this is
+all there is to share between threads, and either value gives the same
+points: a relaxed atomic is enough.
+*/
+#if defined(ED25519_BASE_WINDOW) && ED25519_BASE_WINDOW != 5
+#error ED25519_BASE_WINDOW can only be 5
+#endif
+#ifdef ED25519_BASE_WINDOW
+static int wide_on = 1;
+#else
+static int wide_on = 0;
+#endif
+
+#if defined(__GNUC__)
+#define load_wide_on() __atomic_load_n(&wide_on,__ATOMIC_RELAXED)
+#define store_wide_on(v) __atomic_store_n(&wide_on,v,__ATOMIC_RELAXED)
+#else
+#define load_wide_on() (*(volatile int *) &wide_on)
+#define store_wide_on(v) (*(volatile int *) &wide_on = (v))
+#endif
+
+static void cmov(ge_precomp *t,const ge_precomp *u,unsigned char b)
+{
+  limb mask = -(limb) b;
+  unsigned int k;
+
+  /* inline and branch free, so the compiler can vectorize the row scan */
+  for (k = 0;k < sizeof(fe) / sizeof(t->yplusx[0]);++k) {
+    t->yplusx[k] ^= (t->yplusx[k] ^ u->yplusx[k]) & mask;
+    t->yminusx[k] ^= (t->yminusx[k] ^ u->yminusx[k]) & mask;
+    t->xy2d[k] ^= (t->xy2d[k] ^ u->xy2d[k]) & mask;
+  }
+}
+
+/* 1 when b == c, for 0 <= b, c < 2^31 */
+static unsigned char equal(crypto_uint32 b,crypto_uint32 c)
+{
+  crypto_uint32 y = b ^ c;
+  y -= 1;
+  y >>= 31;
+  return y;
+}
+
+static void select_row(ge_precomp *t,const ge_precomp *row,int b)
+{
+  ge_precomp minust;
+  unsigned char bnegative = ((crypto_uint32) b) >> 31;
+  crypto_uint32 babs = b - (((-(int) bnegative) & b) << 1);
+  int j;
+
+  ge_precomp_0(t);
+  for (j = 0;j < 16;++j) cmov(t,&row[j],equal(babs,j + 1));
+  fe_copy(minust.yplusx,t->yminusx);
+  fe_copy(minust.yminusx,t->yplusx);
+  fe_neg(minust.xy2d,t->xy2d);
+  cmov(t,&minust,bnegative);
+}
+
+int ge_scalarmult_base_wide(ge_p3 *h,const unsigned char *a)
+{
+  int e[52];
+  int carry;
+  ge_p1p1 r;
+  ge_precomp t;
+  int i;
+
+  if (!load_wide_on()) return 0;
+
+  for (i = 0;i < 52;++i) {
+    int bit = i * 5;
+    int v = a[bit >> 3] >> (bit & 7);
+    if ((bit >> 3) + 1 < 32) v |= a[(bit >> 3) + 1] << (8 - (bit & 7));
+    e[i] = v & 31;
+  }
+  /* each e[i] is between 0 and 31, e[51] between 0 and 15 */
+
+  carry = 0;
+  for (i = 0;i < 51;++i) {
+    e[i] += carry;
+    carry = (e[i] + 16) >> 5;
+    e[i] -= carry << 5;
+  }
+  e[51] += carry;
+  /* each e[i] is between -16 and 16 */
+
+  ge_p3_0(h);
+  for (i = 0;i < 52;++i) {
+    select_row(&t,wide[i],e[i]);
+    ge_madd(&r,h,&t); ge_p1p1_to_p3(h,&r);
+  }
+  return 1;
+}
+
+int crypto_sign_base_window(int window)
+{
+  if (window != 0 && window != 5) return -1;
+  store_wide_on(window == 5);
+  return 0;
+}
@@ -0,0 +1,164 @@
+#include "ge.h"
+
+static const fe sqrtm1 = {
+#ifdef ED25519_FE51
+#include "sqrtm1_51.h"
+#else
+#include "sqrtm1.h"
+#endif
+} ;
+
+/* c = sqrt(A+2), A = 486662: (1,c) has order 4 on v^2 = u^3 + Au^2 + u */
+static const fe c = {
+#ifdef ED25519_FE51
+#include "sqrt486664_51.h"
+#else
+#include "sqrt486664.h"
+#endif
+} ;
+
+/* kappa = sqrt(sqrtm1 (A^2 - 4)) */
+static const fe kappa = {
+#ifdef ED25519_FE51
+#include "kappa_51.h"
+#else
+#include "kappa.h"
+#endif
+} ;
+
+/*
+return 1 if p lies in the subgroup of prime order l, 0 if it has a
+component of order 2, 4 or 8
+
+On the Montgomery form v^2 = u^3 + Au^2 + u, u = (1+y)/(1-y),
+v = sqrt(-(A+2)) u/x, the points of order dividing 8 form a cyclic
+group, so p is in the prime order subgroup iff p = 2q with q = 4q'.
+p = 2q needs u to be a square w^2; then a half q has
+u_q^2 + 2bu_q + 1 = 0 with b = -u + v/w, for the one sign of w that
+makes b^2 - 1 a square. The two b^2 - 1 multiply to u^2 (A^2 - 4), so
+one exponentiation finds the root of whichever is a square. q = 4q' iff
+the Tate pairing of (1,c) and q is 1, that is iff (v_q - c u_q)^2/u_q
+is a fourth power. Three exponentiations in all, against about 250
+doublings for l p.
+*/
+
+int ge_torsion_free_vartime(const ge_p3 *p)
+{
+  fe un;
+  fe ud;
+  fe w;
+  fe t;
+  fe t3;
+  fe check;
+  fe sz;
+  fe xw;
+  fe bn;
+  fe bd;
+  fe e;
+  fe r;
+  fe r2;
+  fe k;
+  fe g;
+  fe a;
+  fe n;
+
+  if (!fe_isnonzero(p->X)) {
+    /* the identity, or (0,-1) of order 2 */
+    fe_sub(check,p->Y,p->Z);
+    return !fe_isnonzero(check);
+  }
+
+  /* w = sqrt(u), u = un/ud */
+  fe_add(un,p->Z,p->Y);
+  fe_sub(ud,p->Z,p->Y);
+  fe_sq(t3,ud);
+  fe_mul(t3,t3,ud);       /* ud^3 */
+  fe_sq(w,t3);
+  fe_mul(w,w,ud);
+  fe_mul(w,w,un);
+  fe_pow22523(w,w);
+  fe_mul(w,w,t3);
+  fe_mul(w,w,un);         /* un ud^3 (un ud^7)^((q-5)/8) */
+  fe_sq(t,w);
+  fe_mul(t,t,ud);
+  fe_sub(check,t,un);
+  if (fe_isnonzero(check)) {
+    fe_add(check,t,un);
+    if (fe_isnonzero(check)) return 0;
+    fe_mul(w,w,sqrtm1);
+  }
+
+  /* b = bn/bd = un (sZ - Xw) / (ud Xw), s = sqrt(-(A+2)) = c sqrtm1 */
+  fe_mul(sz,c,sqrtm1);
+  fe_mul(sz,sz,p->Z);
+  fe_mul(xw,p->X,w);
+  fe_sub(bn,sz,xw);
+  fe_mul(bn,bn,un);
+  fe_mul(bd,ud,xw);
+  fe_sub(t,bn,bd);
+  fe_add(t3,bn,bd);
+  fe_mul(e,t,t3);         /* e = bn^2 - bd^2 */
+  fe_pow22523(r,e);
+  fe_mul(r,r,e);          /* r = e^((q+3)/8) */
+
+  /* u_q = a/bd with a = sqrt(e) - bn */
+  fe_sq(r2,r);
+  fe_sub(check,r2,e);
+  if (!fe_isnonzero(check)) {
+    fe_sub(a,r,bn);
+  } else {
+    fe_add(check,r2,e);
+    if (!fe_isnonzero(check)) {
+      fe_mul(a,r,sqrtm1);
+      fe_sub(a,a,bn);
+    } else {
+      /*
+      e is not a square and r^2 = +-sqrtm1 e; with the other sign of w,
+      bn' = un (sZ + Xw), bd' = -bd, sqrt(e') = un^2 X^2 kappa'/r where
+      kappa'^2 = +-sqrtm1 (A^2 - 4): u_q = (un^2 X^2 kappa' - bn' r)/(r bd')
+      */
+      fe_mul(t,e,sqrtm1);
+      fe_sub(check,r2,t);
+      fe_mul(k,kappa,un);
+      if (fe_isnonzero(check)) fe_mul(k,k,sqrtm1);
+      fe_mul(k,k,un);
+      fe_mul(k,k,p->X);
+      fe_mul(k,k,p->X);
+      fe_add(bn,sz,xw);
+      fe_mul(bn,bn,un);
+      fe_mul(bn,bn,r);
+      fe_sub(a,k,bn);
+      fe_neg(bd,bd);
+      fe_mul(bd,bd,r);
+    }
+  }
+
+  /* v_q = (u_q^2 - 1)/(2w), n = 2w bd^2 (v_q - c u_q) */
+  fe_sub(t,a,bd);
+  fe_add(t3,a,bd);
+  fe_mul(n,t,t3);
+  fe_mul(t,a,bd);
+  fe_mul(t,t,w);
+  fe_mul(t,t,c);
+  fe_add(t,t,t);
+  fe_sub(n,n,t);
+
+  /* (v_q - c u_q)^2/u_q times fourth powers: 4 n^2 a^3 w^2 bd */
+  fe_sq2(g,n);
+  fe_sq(t,a);
+  fe_mul(t,t,a);
+  fe_mul(g,g,t);
+  fe_sq(t,w);
+  fe_mul(g,g,t);
+  fe_mul(g,g,bd);
+  fe_add(g,g,g);
+  if (!fe_isnonzero(g)) return 0;
+
+  /* g^((q-1)/4) = (g^((q-5)/8))^2 g */
+  fe_pow22523(t,g);
+  fe_sq(t,t);
+  fe_mul(t,t,g);
+  fe_1(check);
+  fe_sub(check,t,check);
+  return !fe_isnonzero(check);
+}
@@ -0,0 +1 @@
+21717894,-14484504,14254104,16133428,27204230,-16538040,-32551320,-8512262,11776239,31849478
@@ -0,0 +1 @@
+1279761226359686,1082696039759895,1141950763702918,1680551548243559,2137382299349230
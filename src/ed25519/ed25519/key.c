@@ -0,0 +1,28 @@
+#include "ed25519.h"
+#include <stdlib.h>
+#include <string.h>
+#include "key.h"
+
+crypto_sign_key *crypto_sign_key_new(const unsigned char *pk)
+{
+  crypto_sign_key *key;
+  ge_p3 A;
+
+  if (ge_frombytes_negate_vartime(&A,pk) != 0) return NULL;
+  key = (crypto_sign_key *)malloc(sizeof(crypto_sign_key));
+  if (!key) return NULL;
+  memcpy(key->pk,pk,32);
+  ge_double_scalarmult_table(key->Ai,&A);
+  key->torsion_free = ge_torsion_free_vartime(&A);
+  return key;
+}
+
+void crypto_sign_key_free(crypto_sign_key *key)
+{
+  free(key);
+}
+
+size_t crypto_sign_key_size(void)
+{
+  return sizeof(crypto_sign_key);
+}
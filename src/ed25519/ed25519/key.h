@@ -0,0 +1,18 @@
+#ifndef KEY_H
+#define KEY_H
+
+#include "ge.h"
+
+/*
+A public key decoded for crypto_sign_verify_key: the encoding, the
+odd multiples of -A that ge_double_scalarmult_cached walks over, and
+whether A lies in the prime order subgroup, which batch.c needs.
+*/
+
+struct crypto_sign_key {
+  unsigned char pk[32];
+  ge_cached Ai[8];
+  int torsion_free;
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "ed25519.h"
 #include <openssl/sha.h>
 #include "ge.h"
@@ -19,3 +20,58 @@ int crypto_sign_keypair(unsigned char *pk, unsigned char *sk)
   for (i = 0;i < 32;++i) sk[32 + i] = pk[i];
   return 0;
 }
+
+/* keys that share a field inversion in crypto_sign_keypairs */
+#define KEYPAIR_CHUNK 64
+
+/*
+crypto_sign_keypair for n keys: sk holds n 64 byte keys with the seed in
+the first half of each. ge_p3_tobytes inverts Z for each key; here the Zs
+of a chunk are inverted at once (Montgomery's trick), three multiplies
+each instead of an inversion.
+*/
+int crypto_sign_keypairs(unsigned char *pk, unsigned char *sk, size_t n)
+{
+  unsigned char h[64];
+  ge_p3 A[KEYPAIR_CHUNK];
+  fe prefix[KEYPAIR_CHUNK];
+  fe inv;
+  fe zinv;
+  fe x;
+  fe y;
+  size_t done;
+  size_t m;
+  size_t i;
+
+  for (done = 0;done < n;done += m) {
+    m = n - done < KEYPAIR_CHUNK ? n - done : KEYPAIR_CHUNK;
+    for (i = 0;i < m;++i) {
+      SHA512(sk + 64 * (done + i), 32, h);
+      h[0] &= 248;
+      h[31] &= 63;
+      h[31] |= 64;
+      ge_scalarmult_base(&A[i],h);
+    }
+
+    /* prefix[i] = Z_0 * ... * Z_i */
+    fe_copy(prefix[0],A[0].Z);
+    for (i = 1;i < m;++i) fe_mul(prefix[i],prefix[i - 1],A[i].Z);
+    /* inv = 1 / prefix[i], from the last down */
+    fe_invert(inv,prefix[m - 1]);
+    for (i = m;i-- > 0;) {
+      unsigned char *p = pk + 32 * (done + i);
+      if (i > 0) {
+        fe_mul(zinv,inv,prefix[i - 1]);
+        fe_mul(inv,inv,A[i].Z);
+      } else {
+        fe_copy(zinv,inv);
+      }
+      fe_mul(x,A[i].X,zinv);
+      fe_mul(y,A[i].Y,zinv);
+      fe_tobytes(p,y);
+      p[31] ^= fe_isnegative(x) << 7;
+      memcpy(sk + 64 * (done + i) + 32, p, 32);
+    }
+  }
+  return 0;
+}
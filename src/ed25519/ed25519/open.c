@@ -1,7 +1,9 @@
 #include "ed25519.h"
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 #include "crypto_verify_32.h"
 #include "ge.h"
+#include "key.h"
 #include "sc.h"
 
 int crypto_sign_open(
@@ -39,29 +41,30 @@ int crypto_sign_open(
   return 0;
 }
 
-int crypto_sign_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+static int verify_table(const unsigned char *signature, const unsigned char *message, size_t message_len,
+                        const unsigned char *public_key, const ge_cached *Ai) {
     unsigned char h[64];
     unsigned char checker[32];
-    SHA512_CTX hash;
-    ge_p3 A;
+    EVP_MD_CTX *hash;
     ge_p2 R;
+    int ok;
 
-    if (signature[63] & 224) {
-        return -1;
+    hash = EVP_MD_CTX_new();
+    if (!hash) {
+        return -4;
     }
-
-    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
-        return -2;
+    ok = EVP_DigestInit_ex(hash, EVP_sha512(), NULL) == 1 &&
+         EVP_DigestUpdate(hash, signature, 32) == 1 &&
+         EVP_DigestUpdate(hash, public_key, 32) == 1 &&
+         EVP_DigestUpdate(hash, message, message_len) == 1 &&
+         EVP_DigestFinal_ex(hash, h, NULL) == 1;
+    EVP_MD_CTX_free(hash);
+    if (!ok) {
+        return -4;
     }
 
-    SHA512_Init(&hash);
-    SHA512_Update(&hash, signature, 32);
-    SHA512_Update(&hash, public_key, 32);
-    SHA512_Update(&hash, message, message_len);
-    SHA512_Final(h, &hash);
-
     sc_reduce(h);
-    ge_double_scalarmult_vartime(&R, h, &A, signature + 32);
+    ge_double_scalarmult_cached(&R, h, Ai, signature + 32);
     ge_tobytes(checker, &R);
 
     if (!(crypto_verify_32(checker, signature) == 0)) {
@@ -70,3 +73,27 @@ int crypto_sign_verify(const unsigned char *signature, const unsigned char *mess
 
     return 0;
 }
+
+int crypto_sign_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+    ge_cached Ai[8];
+    ge_p3 A;
+
+    if (signature[63] & 224) {
+        return -1;
+    }
+
+    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
+        return -2;
+    }
+
+    ge_double_scalarmult_table(Ai, &A);
+    return verify_table(signature, message, message_len, public_key, Ai);
+}
+
+int crypto_sign_verify_key(const unsigned char *signature, const unsigned char *message, size_t message_len, const crypto_sign_key *key) {
+    if (signature[63] & 224) {
+        return -1;
+    }
+
+    return verify_table(signature, message, message_len, key->pk, key->Ai);
+}
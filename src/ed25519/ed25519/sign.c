@@ -1,41 +1,93 @@
+#include <string.h>
 #include "ed25519.h"
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 #include "ge.h"
 #include "sc.h"
 
+/*
+The signed message is the detached signature followed by m. m is moved
+into place first (it may overlap sm) and signed from there, so nothing
+else is copied or allocated.
+*/
 int crypto_sign(
   unsigned char *sm,unsigned long long *smlen,
   const unsigned char *m,unsigned long long mlen,
   const unsigned char *sk
 )
 {
-  unsigned char az[64];
+  memmove(sm + 64, m, mlen);
+  *smlen = mlen + 64;
+  return crypto_sign_detached(sm, sm + 64, mlen, sk);
+}
+
+/*
+esk = the clamped scalar a (32 bytes), the nonce prefix (32) and the
+public key (32) of sk, all a signature needs besides the message
+*/
+int crypto_sign_expand(unsigned char *esk,const unsigned char *sk)
+{
+  int i;
+
+  SHA512(sk, 32, esk);
+  esk[0] &= 248;
+  esk[31] &= 63;
+  esk[31] |= 64;
+  for (i = 0;i < 32;++i) esk[64 + i] = sk[32 + i];
+  return 0;
+}
+
+/* crypto_sign_detached with sk already expanded */
+int crypto_sign_detached_expanded(
+  unsigned char *sig,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *esk
+)
+{
   unsigned char r[64];
   unsigned char hram[64];
+  EVP_MD_CTX *hash;
   ge_p3 R;
-  unsigned long long i;
 
-  SHA512(sk, 32, az);
-  // crypto_hash_sha512(az,sk,32);
-  az[0] &= 248;
-  az[31] &= 63;
-  az[31] |= 64;
+  hash = EVP_MD_CTX_new();
+  if (!hash) return -1;
 
-  *smlen = mlen + 64;
-  for (i = 0;i < mlen;++i) sm[64 + i] = m[i];
-  for (i = 0;i < 32;++i) sm[32 + i] = az[32 + i];
-  SHA512(sm + 32, mlen + 32, r);
-  // crypto_hash_sha512(r,sm + 32,mlen + 32);
-  for (i = 0;i < 32;++i) sm[32 + i] = sk[32 + i];
+  if (EVP_DigestInit_ex(hash, EVP_sha512(), NULL) != 1 ||
+      EVP_DigestUpdate(hash, esk + 32, 32) != 1 ||
+      EVP_DigestUpdate(hash, m, mlen) != 1 ||
+      EVP_DigestFinal_ex(hash, r, NULL) != 1) {
+    EVP_MD_CTX_free(hash);
+    return -1;
+  }
 
   sc_reduce(r);
   ge_scalarmult_base(&R,r);
-  ge_p3_tobytes(sm,&R);
+  ge_p3_tobytes(sig,&R);
 
-  SHA512(sm, mlen + 64, hram);
-  // crypto_hash_sha512(hram,sm,mlen + 64);
+  if (EVP_DigestInit_ex(hash, EVP_sha512(), NULL) != 1 ||
+      EVP_DigestUpdate(hash, sig, 32) != 1 ||
+      EVP_DigestUpdate(hash, esk + 64, 32) != 1 ||
+      EVP_DigestUpdate(hash, m, mlen) != 1 ||
+      EVP_DigestFinal_ex(hash, hram, NULL) != 1) {
+    EVP_MD_CTX_free(hash);
+    return -1;
+  }
+  EVP_MD_CTX_free(hash);
   sc_reduce(hram);
-  sc_muladd(sm + 32,hram,az,r);
+  sc_muladd(sig + 32,hram,esk,r);
 
   return 0;
 }
+
+/* same signature as crypto_sign, without the signed message copy */
+int crypto_sign_detached(
+  unsigned char *sig,
+  const unsigned char *m,unsigned long long mlen,
+  const unsigned char *sk
+)
+{
+  unsigned char esk[96];
+
+  crypto_sign_expand(esk,sk);
+  return crypto_sign_detached_expanded(sig,m,mlen,esk);
+}
@@ -0,0 +1 @@
+-8930344,-9583591,26444492,-3752533,-26044487,743697,2900628,-5634116,-25139868,5270574
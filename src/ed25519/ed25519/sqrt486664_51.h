@@ -0,0 +1 @@
+1608655899704280,1999971613377227,49908634785720,1873700692181652,353702208628067
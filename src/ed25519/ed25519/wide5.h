@@ -0,0 +1,4264 @@
+{
+ {
+  { 25967493,-14356035,29566456,3660896,-12694345,4014787,27544626,-11754271,-6079156,2047605 },
+  { -12545711,934262,-2722910,3049990,-727428,9406986,12720692,5043384,19500929,-15469378 },
+  { -8738181,4489570,9688441,-14785194,10184609,-12363380,29287919,11864899,-24514362,-4438546 },
+ },
+ {
+  { -12815894,-12976347,-21581243,11784320,-25355658,-2750717,-11717903,-3814571,-358445,-10211303 },
+  { -21703237,6903825,27185491,6451973,-29577724,-9554005,-15616551,11189268,-26829678,-5319081 },
+  { 26966642,11152617,32442495,15396054,14353839,-12752335,-3128826,-9541118,-15472047,-4166697 },
+ },
+ {
+  { 15636291,-9688557,24204773,-7912398,616977,-16685262,27787600,-14772189,28944400,-1550024 },
+  { 16568933,4717097,-11556148,-1102322,15682896,-11807043,16354577,-11775962,7689662,11199574 },
+  { 30464156,-5976125,-11779434,-15670865,23220365,15915852,7512774,10017326,-17749093,-9920357 },
+ },
+ {
+  { -17036878,13921892,10945806,-6033431,27105052,-16084379,-28926210,15006023,3284568,-6276540 },
+  { 23599295,-8306047,-11193664,-7687416,13236774,10506355,7464579,9656445,13059162,10374397 },
+  { 7798556,16710257,3033922,2874086,28997861,2835604,32406664,-3839045,-641708,-101325 },
+ },
+ {
+  { 10861363,11473154,27284546,1981175,-30064349,12577861,32867885,14515107,-15438304,10819380 },
+  { 4708026,6336745,20377586,9066809,-11272109,6594696,-25653668,12483688,-12668491,5581306 },
+  { 19563160,16186464,-29386857,4097519,10237984,-4348115,28542350,13850243,-23678021,-15815942 },
+ },
+ {
+  { -15371964,-12862754,32573250,4720197,-26436522,5875511,-19188627,-15224819,-9818940,-12085777 },
+  { -8549212,109983,15149363,2178705,22900618,4543417,3044240,-15689887,1762328,14866737 },
+  { -18199695,-15951423,-10473290,1707278,-17185920,3916101,-28236412,3959421,27914454,4383652 },
+ },
+ {
+  { 5153746,9909285,1723747,-2777874,30523605,5516873,19480852,5230134,-23952439,-15175766 },
+  { -30269007,-3463509,7665486,10083793,28475525,1649722,20654025,16520125,30598449,7715701 },
+  { 28881845,14381568,9657904,3680757,-20181635,7843316,-31400660,1370708,29794553,-1409300 },
+ },
+ {
+  { 14499471,-2729599,-33191113,-4254652,28494862,14271267,30290735,10876454,-33154098,2381726 },
+  { -7195431,-2655363,-14730155,462251,-27724326,3941372,-6236617,3696005,-32300832,15351955 },
+  { 27431194,8222322,16448760,-3907995,-18707002,11938355,-32961401,-2970515,29551813,10109425 },
+ },
+ {
+  { -22518993,-6692182,14201702,-8745502,-23510406,8844726,18474211,-1361450,-13062696,13821877 },
+  { -6455177,-7839871,3374702,-4740862,-27098617,-10571707,31655028,-7212327,18853322,-14220951 },
+  { 4566830,-12963868,-28974889,-12240689,-7602672,-2830569,-8514358,-10431137,2207753,-3209784 },
+ },
+ {
+  { -10455903,-10160979,720868,10531007,18339027,-11188666,-25054770,4039083,-24465831,-15814183 },
+  { -26181155,13984649,-33165634,-5034672,1302625,-2344616,30122747,14700686,-20671221,871949 },
+  { -3082024,-11880191,6822408,6201219,7614579,-13519607,-11565132,-6488093,-12121099,3872940 },
+ },
+ {
+  { -25154831,-4185821,29681144,7868801,-6854661,-9423865,-12437364,-663000,-31111463,-16132436 },
+  { 25576264,-2703214,7349804,-11814844,16472782,9300885,3844789,15725684,171356,6466918 },
+  { 23103977,13316479,9739013,-16149481,817875,-15038942,8965339,-14088058,-30714912,16193877 },
+ },
+ {
+  { -14781127,-10481494,-30065593,12501415,-31229705,1732500,-26306760,-5568322,32035790,1977023 },
+  { 20796620,-2040467,-10186578,8807827,9358078,14015453,-16926933,6140170,-30890494,-1745996 },
+  { -7060141,-10144224,-16679467,-14871951,-2509975,9921634,28069242,1630201,22136893,14621332 },
+ },
+ {
+  { -33521811,3180713,-2394130,14003687,-16903474,-16270840,17238398,4729455,-18074513,9256800 },
+  { -25182317,-4174131,32336398,5036987,-21236817,11360617,22616405,9761698,-19827198,630305 },
+  { -13720693,2639453,-24237460,-7406481,9494427,-5774029,-6554551,-15960994,-2449256,-14291300 },
+ },
+ {
+  { -14598651,1850128,19981535,180093,-33513985,8502742,-5897708,12976969,-14392111,-4539005 },
+  { 1512064,14848309,6700027,8313829,-12998968,15484842,-13928265,1720870,-20597816,12043177 },
+  { -31581310,7430623,-1404204,-9628338,-4157856,13310891,-1066977,-7179388,-3306582,9633273 },
+ },
+ {
+  { -3151181,-5046075,9282714,6866145,-31907062,-863023,-18940575,15033784,25105118,-7894876 },
+  { -24326370,15950226,-31801215,-14592823,-11662737,-5090925,1573892,-2625887,2198790,-15804619 },
+  { -3099351,10324967,-2241613,7453183,-5446979,-2735503,-13812022,-16236442,-32461234,-12290683 },
+ },
+ {
+  { 26223094,-12506805,-817594,-6574538,-18413955,13765386,18686369,-3396849,-7690672,5303412 },
+  { 20852230,1340053,-15306791,6107716,-23311853,8966632,-17691495,-15696681,-20600407,-13383612 },
+  { -24458581,-6348954,15021041,7419977,24989846,1575285,-1464843,14432789,-30182382,8836379 },
+ },
+},
+{
+ {
+  { 25502114,10391924,-26826463,-4050907,-26716962,3269111,7668966,-13852660,-8419601,-520106 },
+  { -24607933,-125399,27759914,11704479,-13092015,-4246277,-31528997,7225004,-27484501,2725107 },
+  { -27564026,11085236,-17642282,12970677,-175541,5844177,-25815899,-6927864,-28278469,-10902258 },
+ },
+ {
+  { 1486148,257970,33324453,14599991,21718373,12985333,-7620229,-14188035,11555299,-15970292 },
+  { -6462181,-12130342,6177105,-16246374,-8117458,9121956,16433140,14850752,11457245,14449899 },
+  { -1000256,6079,25942700,-9008072,-29696963,8709793,-3663384,13501444,-31660106,-13571732 },
+ },
+ {
+  { 25121076,8602287,29936647,-6877539,-33413339,-6767260,-20407100,4635621,19352480,7360883 },
+  { -20371192,-3368241,3938506,1520415,22365898,1723267,26933925,-15185683,-1996297,7239312 },
+  { 32757571,923933,-12720547,-8693969,14249519,5990430,18635548,12333130,1140694,9249959 },
+ },
+ {
+  { 18572438,13390462,-1291416,-13971098,-21571726,-14145612,21104946,-15003393,18527392,-8247942 },
+  { -8672907,-5790586,22819840,15232814,-27083876,-8187835,-27833833,-10942465,-18512588,-3852411 },
+  { 16280619,-12797117,-352962,9451951,-19811304,12151784,-19903486,5076884,-16935204,-3175527 },
+ },
+ {
+  { -24871467,5425581,17716838,10985097,8640936,-9668870,-19553502,-1248934,-22709033,4591957 },
+  { -20817406,3961522,-10336543,6106757,-26602368,-5424018,-20820941,-15309870,-8303267,9814604 },
+  { -1219317,-5502025,-24930203,-9989216,20459080,-5237891,24158534,-3961414,-3796142,-1233873 },
+ },
+ {
+  { -3648119,8985904,8449029,-13858542,2548723,7989757,32070705,181656,4012876,-6835727 },
+  { -26190635,-7270013,7493220,11174063,-33394279,-6458091,-21599441,-860747,-18869077,2406715 },
+  { 17519448,-12710078,-20279334,11779198,-26611857,497932,-9107401,-9155650,22252287,-686166 },
+ },
+ {
+  { -12181218,2869238,-32213597,3168563,-640179,-1546219,-7974659,15519561,18897078,-9682372 },
+  { -6293904,10765543,27436262,-392179,-11436451,12569978,-26315117,954356,3222510,5109554 },
+  { -3350784,4069278,28740825,-13313459,921600,-16511450,30322797,-8463659,9184862,-1312264 },
+ },
+ {
+  { -13657040,-13155431,-31283750,11777098,21447386,6519384,-2378284,-1627556,10092783,-4764171 },
+  { 27939166,14210322,4677035,16277044,-22964462,-12398139,-32508754,12005538,-17810127,12803510 },
+  { 17228999,-15661624,-1233527,300140,-1224870,-11714777,30364213,-9038194,18016357,4397660 },
+ },
+ {
+  { -508542,12526917,19418733,-13995048,21199985,11576269,-31792562,16021052,-28978650,12735065 },
+  { -11494,-16293455,25690032,2957957,-5824500,14889844,21062043,-9707749,-19369423,-10478600 },
+  { 10202576,-8462384,-676234,8926532,11789349,-1419763,13599996,-11283397,20163161,-5186619 },
+ },
+ {
+  { -9350990,3360005,-5335520,-9365668,-30659646,6514737,-14719626,12330014,21964254,-1402074 },
+  { -8897203,-15788862,4865095,7428824,10436171,3930218,-16697024,8628972,9046073,-224980 },
+  { 4665048,8535604,-1472949,-5823663,646915,-5969913,25642625,-663478,-32790514,2036870 },
+ },
+ {
+  { 12131024,15139946,-6477570,10001506,21225647,13635291,25168415,-14895917,913646,-12560828 },
+  { -32549710,13397560,13125954,-8362986,-10348392,7909952,30417013,-14493965,29014388,-1206770 },
+  { -29040095,-8954446,32466874,13055285,-21775251,-16041571,-18558332,-6793879,22012788,1903882 },
+ },
+ {
+  { 31929769,-13072267,5212673,-10102105,-9841413,-3338319,-6699982,7526587,13941129,5771333 },
+  { -10721723,4023189,-25086152,3693144,23934375,14736874,8083540,4259571,-10204585,-3402719 },
+  { -27457501,491301,6446163,-16668504,-27645868,-14829722,-9413183,8338063,-15744623,1500949 },
+ },
+ {
+  { -28822031,3914820,-20278463,1909755,-19886861,-4565980,9717308,-13980357,2741281,14087432 },
+  { -1336619,-12942297,-14178276,8575742,-11398906,-14790401,-32401558,-12009914,-11002728,-1113018 },
+  { 15635227,65800,-1623229,-11611344,1900852,-13448630,-1710028,7906701,-28312961,-7218456 },
+ },
+ {
+  { 31011833,-11302649,-6729075,4583914,28601879,7904713,-12817840,-5507795,6598692,111464 },
+  { -30561397,11767672,25621946,-9316755,21609108,-6603511,-30377874,-15389351,-12931907,581419 },
+  { 2607346,13197673,32717344,2343267,-28927540,14355111,-27113052,4155848,-5147614,-16465344 },
+ },
+ {
+  { 25707565,5381412,1409433,-6528025,2890318,4282766,-8211622,-10577745,-24254632,15830181 },
+  { 24028087,1652912,2999375,-12400765,-24465480,16108860,-2500579,-8804481,20282869,12459583 },
+  { 16926611,7208943,25801126,6378915,-3082667,15969041,-1953806,7132407,28480128,1676877 },
+ },
+ {
+  { -10958843,-7690207,4776341,-14954238,27850028,-15602212,-26619106,14544525,-17477504,982639 },
+  { 29253598,15796703,-2863982,-9908884,10057023,3163536,7332899,-4120128,-21047696,9934963 },
+  { 5793303,16271923,-24131614,-10116404,29188560,1206517,-14747930,4559895,-30123922,-10897950 },
+ },
+},
+{
+ {
+  { -26088264,-4011052,-17013699,-3537628,-6726793,1920897,-22321305,-9447443,4535768,1569007 },
+  { -2255422,14606630,-21692440,-8039818,28430649,8775819,-30494562,3044290,31848280,12543772 },
+  { -22028579,2943893,-31857513,6777306,13784462,-4292203,-27377195,-2062731,7718482,14474653 },
+ },
+ {
+  { 2379352,11839345,-4110402,-5988665,11274298,794957,212801,-14594663,23527084,-16458268 },
+  { 33431127,-11130478,-17838966,-15626900,8909499,8376530,-32625340,4087881,-15188911,-14416214 },
+  { 1767683,7197987,-13205226,-2022635,-13091350,448826,5799055,4357868,-4774191,-16323038 },
+ },
+ {
+  { -10879818,11147915,25025096,-188642,-25807629,4805283,-26572268,5858744,-29739747,-14318028 },
+  { 29249999,1587251,8425330,14672795,21823829,4482432,-25758594,-6020393,31066466,-14893670 },
+  { 2068553,-502519,19176914,5065616,-12365598,25867,12956327,-12067126,-29725911,13902655 },
+ },
+ {
+  { -29755419,6305835,-22834437,1218102,14106849,-3320406,33180036,7098280,16480428,-10816293 },
+  { -25409045,-2090218,-3321267,6706121,1684499,-3393205,-5561614,-6662956,6948745,-9283878 },
+  { 18131284,-12160957,-11401895,-5986896,-5516845,-492965,-4079275,1219798,-15173186,3647927 },
+ },
+ {
+  { -27580085,3590082,-26936008,-11432116,-9296840,3149719,-5501468,-1151429,12822193,-2227426 },
+  { -18987436,3002438,20098016,-12242403,13392443,-9855045,-20364211,15543406,26453399,14854884 },
+  { 6764305,7047422,-29893622,-12919448,21921618,-7057340,-7455479,-9729523,-14115001,3183103 },
+ },
+ {
+  { 1523420,10679202,9635317,-15851024,28859785,-12786361,-24155424,-4145839,-9301569,-9425859 },
+  { -19738691,-16507562,5247887,13042635,-27496796,14584524,-13999115,-11262217,8479559,-6787305 },
+  { 16146780,10277822,-626749,-16422649,-7166447,516564,16825489,14881655,13218624,-13374208 },
+ },
+ {
+  { -5932237,-2168516,-681669,3767204,-7138641,14757636,-7970699,4524991,12715145,8916839 },
+  { -33368147,-7733513,8002537,-4666348,618845,-15992581,24524264,-8687385,32662893,-8480454 },
+  { -29940530,-13914854,27576384,-2384063,-2022165,-1788456,20995247,16295875,29283517,9949342 },
+ },
+ {
+  { -22513286,12246326,-18464073,-7350751,33281396,9110981,1027358,-6331104,7679661,2842418 },
+  { -12261954,-5253859,6370637,4487386,-9942686,-11121872,-1484289,3910609,8734779,-9653790 },
+  { 20187343,-12265314,-5076413,1625266,-5489572,4035687,31030596,-7400186,-25735164,2419199 },
+ },
+ {
+  { 19147792,6164570,20688326,10417915,-27729753,10594950,-22153678,19370,-27191450,12402326 },
+  { 161954,8426605,-7530599,11200950,-20911759,-16368119,-27050361,7142381,-12257552,16606068 },
+  { 21164120,14190972,23904952,-1694215,12358955,-9609917,-30203209,2487295,31896676,10697451 },
+ },
+ {
+  { -23589264,7731365,13267315,10305203,12254267,15803904,-12743384,6378291,12010309,-3242795 },
+  { -1432035,-2908739,-2118816,15594986,-18175543,14667394,22853746,14404375,-12409250,-7242666 },
+  { 30311170,-3959860,11001050,-12177515,22768237,14406656,29392430,7486720,-764509,15889556 },
+ },
+ {
+  { 28638931,10166894,-12992197,4589030,3165861,-14217271,-16247107,968790,-6088870,16388647 },
+  { 25741468,-6320606,-28514596,15578857,-7100230,-3752896,-8583145,-817244,7714769,10883471 },
+  { -23700357,-9360936,6283266,15122367,-16167596,12989553,-6987064,12127926,16384980,7563646 },
+ },
+ {
+  { 11080345,5771544,-25438435,2341831,33357664,-7709139,989408,10996986,7088054,-1307096 },
+  { -32057391,2062735,-27657054,14997402,-24256513,747392,-18904030,8416795,26888753,-5729108 },
+  { -9858810,4617589,-12692517,-2172298,21515963,12161333,7668390,-3483423,-581023,-10257578 },
+ },
+ {
+  { -32796164,10187568,-31872432,14145307,17312899,-1951449,-29949768,6621865,16463832,5769668 },
+  { 10182958,9614238,10360629,8382591,10453695,2327364,1656995,-243318,-23929904,4071234 },
+  { -12468744,-16053502,-25289967,-7914194,-27866112,-11794047,2716328,-15161697,-450966,154112 },
+ },
+ {
+  { 24420748,9481110,19972966,-15722536,-18334731,-10546401,-16761253,5816652,25059298,-1457221 },
+  { 20240252,-9121168,-30639459,-8966118,-27558520,-8882088,-779313,11039021,22207789,9842208 },
+  { 3160704,1780284,-11785238,4574308,2863317,-7441694,-28914973,5800492,9511713,10675239 },
+ },
+ {
+  { -8686081,9238460,21639710,7557139,22891556,-12778705,2288825,3175568,-15158933,6381981 },
+  { -20011738,-15393207,-24078111,3086937,18287597,7626983,2486164,-9897901,33024195,16532810 },
+  { 6496670,14757337,12645948,-1193134,-26799955,1098560,-29634103,-8158936,-2691296,-6987207 },
+ },
+ {
+  { -15739746,-11220585,19995470,-7561731,-31096311,-2785751,23370033,2652913,-19683896,-1586607 },
+  { 21052810,-1610886,13610781,11319631,-3579929,-8738841,29919090,7572283,29080032,-5602195 },
+  { -20410884,9161070,2962171,-11180144,9727648,-11619100,-30948360,-4939465,29083304,-638292 },
+ },
+},
+{
+ {
+  { -18641829,-1151976,-25627818,7354577,-16878411,-13424373,-13158667,14873054,24830217,7401132 },
+  { 8228420,-5980670,8316609,-4287605,-2919655,-1418908,-26013645,1778869,-18502634,-6918179 },
+  { -3491920,11306418,7963539,-6275618,32872270,4872405,-31217624,-13497777,-21941853,2607490 },
+ },
+ {
+  { 6721966,13833823,-23523388,-1551314,26354293,-11863321,23365147,-3949732,7390890,2759800 },
+  { 4409041,2052381,23373853,10530217,7676779,-12885954,21302353,-4264057,1244380,-12919645 },
+  { -4421239,7169619,4982368,-2957590,30256825,-2777540,14086413,9208236,15886429,16489664 },
+ },
+ {
+  { -32723686,-5608236,15422366,-9451627,-17154558,-5569906,28189532,15776693,-23678771,5933643 },
+  { -5308487,-4192663,-14910229,-12888069,27055386,9084965,-5907109,12564117,-31941327,13660060 },
+  { -30855755,-5532874,29688937,-13078163,-30174254,14643103,-23672218,-8058552,-3541156,-15907758 },
+ },
+ {
+  { 1996075,10375649,14346367,13311202,-6874135,-16438411,-13693198,398369,-30606455,-712933 },
+  { -25307465,9795880,-2777414,14878809,-33531835,14780363,13348553,12076947,-30836462,5113182 },
+  { -17770784,11797796,31950843,13929123,-25888302,12288344,-30341101,-7336386,13847711,5387222 },
+ },
+ {
+  { -28253793,7977721,-32947738,-12351888,-27706242,1013593,-16759661,-9973867,-12292892,-15193610 },
+  { 21178012,4236341,-20220754,12750391,33166281,12992930,17732892,-12503123,15487487,-9881407 },
+  { -23759416,10537922,7512859,-6824031,4814724,8542209,-22178020,8845973,27734648,3743089 },
+ },
+ {
+  { -18582163,-3416217,17824843,-2340966,22744343,-10442611,8763061,3617786,-19600662,10370991 },
+  { 20246567,-14369378,22358229,-543712,18507283,-10413996,14554437,-8746092,32232924,16763880 },
+  { 9648505,10094563,26416693,14745928,-30374318,-6472621,11094161,15689506,3140038,-16510092 },
+ },
+ {
+  { -30945244,-3273992,31671313,-3759524,-18362321,-594867,-15307004,-7961107,-8976912,376090 },
+  { -10653070,-13482154,-15964613,11779602,-28737961,-3871453,-7055085,11162631,-14313790,16421003 },
+  { 12245269,16442700,-10594512,-5337095,457867,1228848,28574557,-14090273,-17021319,8670638 },
+ },
+ {
+  { -16160072,5472695,31895588,4744994,8823515,10365685,-27224800,9448613,-28774454,366295 },
+  { 19153450,11523972,-11096490,-6503142,-24647631,5420647,28344573,8041113,719605,11671788 },
+  { 8678025,2694440,-6808014,2517372,4964326,11152271,-15432916,-15266516,27000813,-10195553 },
+ },
+ {
+  { -25908677,9477567,-17515599,-12918540,-28637046,5061221,-31692853,-14136355,-15937401,-148334 },
+  { -3971575,14642881,-29874519,1979357,12005905,12023288,29685857,-1608967,26583920,-6344485 },
+  { 17035771,12664273,29693371,12617166,-8501561,-12236625,14605771,-5284684,-12713705,-14966169 },
+ },
+ {
+  { -15157904,7134312,8639287,-2814877,-7235688,10421742,564065,5336097,6750977,-14521026 },
+  { 11836410,-3979488,26297894,16080799,23455045,15735944,1695823,-8819122,8169720,16220347 },
+  { -18115838,8653647,17578566,-6092619,-8025777,-16012763,-11144307,-2627664,-5990708,-14166033 },
+ },
+ {
+  { 17613345,2787698,29757580,-7194368,-25101103,-2228939,-22121794,3965388,21184614,-5889445 },
+  { 4628965,-9289679,4443,606121,-32808067,-13880029,33346237,-2182255,32534202,-6701800 },
+  { 14319532,-11873124,-29324350,-9173296,32025495,8755380,8210229,13506557,2396717,13453748 },
+ },
+ {
+  { -23308498,-10968312,15213228,-10081214,-30853605,-11050004,27884329,2847284,2655861,1738395 },
+  { -27537433,-14253021,-25336301,-8002780,-9370762,8129821,21651608,-3239336,-19087449,-11005278 },
+  { 1533110,3437855,23735889,459276,29970501,11335377,26030092,5821408,10478196,8544890 },
+ },
+ {
+  { -344584,12154381,-17674391,13368946,-29769456,-14840505,29003297,13731757,-25426270,11048205 },
+  { -3536311,-6031189,-4453244,-15020843,-26482604,8258879,10210648,8094884,-9157738,-16332350 },
+  { -18004873,4052426,21920309,15701360,-25454009,-6102899,32723651,-6674307,-15550134,-860429 },
+ },
+ {
+  { 32173121,-16129311,24896207,3921497,22579056,-3410854,19270449,12217473,17789017,-3395995 },
+  { -30552961,-2228401,-15578829,-10147201,13243889,517024,15479401,-3853233,30460520,1052596 },
+  { -11614875,13323618,32618793,8175907,-15230173,12596687,27491595,-4612359,3179268,-9478891 },
+ },
+ {
+  { 28828138,11128694,22152726,-11878205,21179965,8106116,17793700,-7610728,-18979417,3163939 },
+  { -18608806,-15010505,-19499188,-15341152,-20810208,-1529632,-17440425,-1189568,21362816,-10327643 },
+  { 25329434,10180152,-12468947,-11650603,-21687645,-15909721,-32114709,4988993,33331871,-13039822 },
+ },
+ {
+  { 31947069,-14366651,-4640583,-15339921,-15125977,-6039709,-14756777,-16411740,19072640,-9511060 },
+  { 11685058,11822410,3158003,-13952594,33402194,-4165066,5977896,-5215017,473099,5040608 },
+  { -20290863,8198642,-27410132,11602123,1290375,-2799760,28326862,1721092,-19558642,-3131606 },
+ },
+},
+{
+ {
+  { 19274469,-5125445,2025249,13387528,-26551745,-13237864,8572282,-5701955,-7605577,3755890 },
+  { -1003765,-3998347,-29431273,5708148,20949970,-10765004,2582995,4041757,28570893,242978 },
+  { 24217466,683998,12990241,-14980929,24711442,2582675,-18704628,-10573407,27632805,10325174 },
+ },
+ {
+  { -1376293,10581090,17601840,-2177403,-23669777,2515960,7946113,5265099,-30565938,15659181 },
+  { 11690190,-256939,-28435932,7575499,-10373362,8175929,-1669485,-6706172,-29188463,11378246 },
+  { 3934827,-895850,14579491,-4161754,26542055,14629900,-19665954,12702562,-9783987,-15825989 },
+ },
+ {
+  { -7905285,-7567146,24242009,-9981986,-10005548,2864673,-12432996,-290370,-32192614,-12380245 },
+  { 21648538,5875995,-25737427,5595486,-2079098,2667116,-30134869,-9286435,2742570,-4025892 },
+  { -17630385,-4775178,-17556574,-12786114,22223083,9281306,25269654,16741825,7733910,-4295804 },
+ },
+ {
+  { 18931912,-5979763,8372851,-1816752,17694526,-3581508,-27130390,-2408709,18843966,-5880493 },
+  { 31572541,1387635,-27527774,1197914,-15555676,13484267,-12740138,13093864,20957081,-3614436 },
+  { 11695417,-11068051,-11229652,-9956937,-13423087,6286991,6574490,-8543138,-31992930,-3252886 },
+ },
+ {
+  { 4406854,-203587,23268839,-16188749,3696359,-3025310,-2374384,-14048190,25835549,14199049 },
+  { -9053661,9666137,17702016,13681030,31673492,-7546596,25994291,7426565,11705204,-499004 },
+  { -9704638,7750859,4780558,-9879028,3972007,-1273251,9397471,6020439,9390255,-13657745 },
+ },
+ {
+  { -4038073,4122774,15819690,-2689661,32461321,5475061,7223123,15194198,6509018,-10905669 },
+  { -9539544,2095849,29789961,61126,24968268,-13581175,-2582874,-12225942,13866993,1421457 },
+  { -4214256,-4717999,22567784,3736576,19253254,-4356505,28225722,-14220075,2798085,8570919 },
+ },
+ {
+  { -21155172,-14003898,8717306,-11400688,17970583,10837346,31185163,-6616264,6612499,-14261069 },
+  { 8368990,-7533904,-5084524,4262330,745608,13759847,-15288234,15767429,-2114388,-1422552 },
+  { 16253406,-12125540,5328056,520783,7323359,-5067190,25388761,-12503796,13788611,15592195 },
+ },
+ {
+  { -18007641,-11299895,-22979045,15904833,-24466524,-2430858,14251255,-13476220,30848991,13037900 },
+  { 113900,16486627,15167557,-13760546,21770965,-6995991,13113953,-1349366,-31585887,10056458 },
+  { 25229681,-12266646,5569512,8982737,32063203,-5581096,-1437669,4966335,13017505,11031479 },
+ },
+ {
+  { -26294597,4730095,-16544977,-10929219,-3421623,15165497,4724359,1955409,14977778,-49192 },
+  { -2727118,-981409,-10085422,116685,-18506519,1791136,-19312178,-9617812,-19311299,-10601958 },
+  { 27565335,5595909,-17787629,13778296,31190745,-3069030,21213892,11418028,-19541047,15939744 },
+ },
+ {
+  { 16850169,-8996436,-4481538,12016857,-27101114,-8680430,-6266309,-10352967,-18614135,-5821359 },
+  { -14512851,-1017831,-24762516,6426576,-12480815,-13493287,30360378,-1597860,11572277,-8359034 },
+  { -5134594,-13393844,1488762,9424355,-17254797,1267019,20571831,-5952862,32433560,-10171027 },
+ },
+ {
+  { -10111520,-16015270,14650912,-12469556,-21341610,-7882094,12466540,14608749,6229290,-9338061 },
+  { 1493628,7316591,-8235485,-14211380,30393151,1473282,-10718407,11315570,-4171135,-13796380 },
+  { 23256211,7123862,-19477794,9285235,32045282,13188552,-2661327,1753847,-33306116,1624329 },
+ },
+ {
+  { 11891931,-11545996,-30888798,1033462,22381147,10994015,-23405517,-16299913,-15918279,-2815226 },
+  { 19835770,14555215,-28862036,-12190709,19878816,-9591938,-31046389,-5528839,24184435,-13427156 },
+  { 11364751,-13739623,-3404619,689249,31972255,5569569,-13722890,-4749785,5354749,6408875 },
+ },
+ {
+  { -16249467,3451746,2364097,-13229053,-14492667,9039454,-21150741,-1734589,-12907138,8884888 },
+  { -30077295,-6481710,-32382800,-8162903,21366547,-11608322,9100928,-2474596,-27332631,-3742390 },
+  { -14174879,133507,-28969940,-7208802,-29150037,-1404085,-5821703,4352362,-11442165,4927022 },
+ },
+ {
+  { -32887459,-8479002,-30236479,5955623,-24527345,14384943,-12755770,-5086009,-3588923,-9050202 },
+  { -23489464,9319502,-16716390,15978717,8028184,2087422,20612946,8183027,-23941448,1851955 },
+  { -16755540,14544707,11429239,-4453879,-2192969,14145566,-6887014,-11313067,-27492893,15063904 },
+ },
+ {
+  { -31082173,10610270,-4305948,16546898,14492886,1768266,18492514,-2986103,10922399,-3770948 },
+  { -7370282,-7408695,-16364285,-2030071,-10387640,12760971,21969852,-16447264,25017654,-12698683 },
+  { -10203005,9377171,17137137,-11434997,761568,-15215715,-9365568,-10256943,12145272,-12317906 },
+ },
+ {
+  { 7881532,10687937,7578723,7738378,-18951012,-2553952,21820786,8076149,-27868496,11538389 },
+  { -19935666,3899861,18283497,-6801568,-15728660,-11249211,8754525,7446702,-5676054,5797016 },
+  { -11295600,-3793569,-15782110,-7964573,12708869,-8456199,2014099,-9050574,-2369172,-5877341 },
+ },
+},
+{
+ {
+  { -22472376,-11568741,-27682020,1146375,18956691,16640559,1192730,-3714199,15123619,10811505 },
+  { 14352098,-3419715,-18942044,10822655,32750596,4699007,-70363,15776356,-28886779,-11974553 },
+  { -28241164,-8072475,-4978962,-5315317,29416931,1847569,-20654173,-16484855,4714547,-9600655 },
+ },
+ {
+  { 26660628,-15677655,8393734,358047,-7401291,992988,-23904233,858697,20571223,8420556 },
+  { 14620715,13067227,-15447274,8264467,14106269,15080814,33531827,12516406,-21574435,-12476749 },
+  { 236881,10476226,57258,-14677024,6472998,2466984,17258519,7256740,8791136,15069930 },
+ },
+ {
+  { 24474287,4968103,22267082,4407354,24063882,-8325180,-18816887,13594782,33514650,7021958 },
+  { -11566906,-6565505,-21365085,15928892,-26158305,4315421,-25948728,-3916677,-21480480,12868082 },
+  { -28635013,13504661,19988037,-2132761,21078225,6443208,-21446107,2244500,-12455797,-8089383 },
+ },
+ {
+  { 9770129,9586738,26496094,4324120,1556511,-3550024,27453819,4763127,-19179614,5867134 },
+  { -32765025,1927590,31726409,-4753295,23962434,-16019500,27846559,5931263,-29749703,-16108455 },
+  { 27461885,-2977536,22380810,1815854,-23033753,-3031938,7283490,-15148073,-19526700,7734629 },
+ },
+ {
+  { -30064841,-12085520,2466357,6943536,-1782842,8942919,12429608,-16601621,31552132,-11965825 },
+  { -3992666,-15761246,10273403,-7853414,-297900,5328910,-29200001,2969350,-2525924,15629671 },
+  { 16047067,12573271,1231538,-12163433,-8373660,16199795,-4841905,-6808052,7979562,16573404 },
+ },
+ {
+  { -25045654,-6772332,6297730,8959344,27474155,13029696,21770666,8339878,-27194104,12070239 },
+  { 21990015,1877144,27485240,14594077,-21562082,7786145,16129244,-16649296,9122695,-4775938 },
+  { -10282967,-8612075,-30635749,-2716348,-1200337,6624620,128299,4748541,11754453,-14381885 },
+ },
+ {
+  { -21350083,14353151,-25673668,-3904908,-26202088,981749,-2324083,-2656799,-19555745,11813207 },
+  { -23364165,1348131,26104925,-7018841,27065263,-13663733,-31246340,5684504,-567693,-4454169 },
+  { -9835992,3179439,-31558350,10684083,-14537167,-5044361,-3193675,-9929006,-19274569,8398311 },
+ },
+ {
+  { -7747423,9283212,16885577,15459439,25972200,15573013,-33536708,522134,-27572165,11723471 },
+  { 2772043,16117691,1948422,1594977,11683210,14644609,19125577,-11518681,-30198843,-4147809 },
+  { -14970719,-16387341,-14039331,-11274100,13553527,6014471,8651844,4302826,944768,9457783 },
+ },
+ {
+  { -11569865,-16467052,-20430913,-7672834,16285502,-16610035,-1811611,4313635,-10227540,-5167630 },
+  { 28134321,13513197,6073170,9574505,-28079945,-11966735,22591105,-12553149,-32256136,346230 },
+  { 25336417,9395722,15057061,6687530,32001515,14894404,27163812,-749528,3237266,-2877457 },
+ },
+ {
+  { 17984982,-8426405,-20439385,-10829520,-526360,8306049,10796549,-4504801,-16235003,11096416 },
+  { 8233749,311379,-22636909,-711047,930704,8734160,28944960,-6204438,-25692311,-15804639 },
+  { -7164500,-11370085,-27221283,-1743729,17748126,-9941080,24716156,-5405448,5480816,9570947 },
+ },
+ {
+  { 23763977,-16120072,-22972053,1290879,5694158,2778369,6529040,341495,2295450,-942755 },
+  { -9585604,-8812809,-12636374,12339508,-10668573,4718972,-28463897,2596792,-17962677,-16069422 },
+  { 8907021,5971149,-21647111,-7223158,5596298,8172880,3463830,12601145,31022814,-15133961 },
+ },
+ {
+  { -31560595,4567277,1543472,1953983,-19503461,-15843165,26618116,1806909,29904870,-10024224 },
+  { -12084147,8708916,-16171301,-2067152,16354581,-13829718,-9133005,15573576,19259132,12177782 },
+  { -9637321,11237249,-26078966,-7004162,3620427,-5878849,2930912,10464079,-10042206,-8644615 },
+ },
+ {
+  { -30904700,-3100039,-19633123,5597715,18098812,-4552212,-27201932,-14508919,-1474582,5652989 },
+  { -27737362,13287062,33373640,8077115,-12754531,-7866412,-15474471,7229883,-4841109,-3707260 },
+  { -3315093,12331103,-8841905,-1763943,2626306,-14132319,-13526512,-13025374,-13586725,-5007288 },
+ },
+ {
+  { -8262543,1494657,16999864,11595089,5777103,2765524,5563354,-7922644,23024644,2994718 },
+  { -12046127,1755469,6136049,8856353,251551,-5196770,-12537674,-10430040,32733932,-8953713 },
+  { 6254253,2008850,-17073134,-5104748,-7231687,-3290875,22703460,10027795,12136463,-14277724 },
+ },
+ {
+  { 26045634,-14166740,-13996505,-16061903,25766825,-4324629,17624257,-7886448,24251444,15370985 },
+  { -4099377,-4951846,-25568066,10732539,21607276,1431451,-16116348,-2923269,20294782,14598748 },
+  { 21750055,-11761710,-27449941,-10202218,-30956241,7283175,-18195879,-4613428,-5206503,9360329 },
+ },
+ {
+  { 25367933,9925423,1217074,10032740,15893633,-7285020,-21001184,13591837,15590119,6888531 },
+  { -1053008,-3203632,-15488193,5115517,-19937346,3036256,-16932496,9411692,11827739,-10643384 },
+  { 11974674,3048430,-771228,-4998519,-19084529,-1036918,27844685,12465445,-19625526,-12787241 },
+ },
+},
+{
+ {
+  { 7654660,7028247,-28691608,540979,-19280698,-5394104,9795209,8516409,13848267,-1499300 },
+  { 30465487,-13875670,357144,-6273628,-4648327,10924293,4789084,2863329,27548793,-6193966 },
+  { 4433141,3224307,-2806764,5354430,31289755,-461331,22067864,-4713425,2154528,4684644 },
+ },
+ {
+  { 13874816,-13376467,30152726,-13956199,-23325064,13021371,-24134600,14450792,13790612,-10418809 },
+  { 18487466,935344,-33484627,-8443849,11904660,6601985,-7750533,16303926,-15507119,-6926203 },
+  { -19759966,11298845,14718846,13623030,-16980751,6469663,-19011727,11615538,11731611,768756 },
+ },
+ {
+  { 7412304,6136424,-10222376,-2174735,-1330527,-10545240,-7378832,-13628712,33375168,8266486 },
+  { 26433354,-12312941,6562825,12902180,27135363,3213284,7040880,-2107596,-24019488,-15463872 },
+  { -9280122,-3211043,-22976686,-5794441,1136543,-1924810,-26128016,6375111,19323228,4342228 },
+ },
+ {
+  { -8010264,-9590817,-11120403,6196038,29344158,-13430885,7585295,-3176626,18549497,15302069 },
+  { -32658337,-6171222,-7672793,-11051681,6258878,13504381,10458790,-6418461,-8872242,8424746 },
+  { 24687205,8613276,-30667046,-3233545,1863892,-1830544,19206234,7134917,-11284482,-828919 },
+ },
+ {
+  { -183856,7253880,-9729217,-4426510,-9604158,8929434,-11880237,11398065,-30953095,16679086 },
+  { 28663812,13673569,-3261921,-3738579,-15306941,999305,-14749383,4021623,-9959381,11833053 },
+  { 6422792,-8825252,-24714630,-16254302,2241289,1726479,11414623,10754927,-3268217,8249867 },
+ },
+ {
+  { -10702335,3317731,-30313478,-15012290,-16477779,3877467,-26316042,11185581,-25922590,-12440520 },
+  { -5346748,14583773,-17737243,9857100,-19569058,13765643,25667707,6333629,-27496517,-16254087 },
+  { 23508527,-2974387,-18892984,-8662945,-19683935,-13212212,30378340,4786462,18434702,-9356530 },
+ },
+ {
+  { -18143090,11421526,33171776,2769327,11473713,9278914,33413959,-12733299,-5271062,-12638207 },
+  { 13092958,-958948,-4034161,-10191082,18688819,-11348829,-20979749,-15236783,-28894503,-9289995 },
+  { -23414889,-8707427,-22310171,-11701512,8019208,-3880757,9831298,-14423348,23496782,14171864 },
+ },
+ {
+  { 11334899,-9218022,8025293,12707519,17523892,-10476071,10243738,-14685461,-5066034,16498837 },
+  { 8911542,6887158,-9584260,-6958590,11145641,-9543680,17303925,-14124238,6536641,10543906 },
+  { -28946384,15479763,-17466835,568876,-1497683,11223454,-2669190,-16625574,-27235709,8876771 },
+ },
+ {
+  { 4980929,-15981616,5986258,-1739171,19735389,-14019607,22873617,15476713,-6649846,-12725189 },
+  { 30881955,2643915,29506573,8452620,-22484260,5562652,12683917,11341547,18919380,-2965740 },
+  { -14069010,4905618,-15888044,7970553,20469839,-16746609,-27600414,-15635408,-29730810,-1479823 },
+ },
+ {
+  { 13959286,-2228995,-10874380,-6152087,15323191,3749276,11219370,4335378,4843384,-6008891 },
+  { -18484516,11138640,-12961547,14219019,21273775,7900507,8188084,-13396131,-28976531,-13298926 },
+  { 11930052,11115893,-18311029,-1030810,-32648981,13849959,22930654,-4811060,25399588,98655 },
+ },
+ {
+  { -180937,-14672787,26925304,2340664,-13404042,-12168310,15661986,4975785,1486389,-1411020 },
+  { -22780918,808092,-18973409,-10480813,20104436,-11158130,23371527,-12941756,10772114,-2301828 },
+  { -821154,-6112357,29268884,5393644,-24013625,-15215458,-32675913,-5658819,33062948,-6725796 },
+ },
+ {
+  { -25742899,-12566864,-15649966,-846607,-33026686,-796288,-33481822,15824474,-604426,-9039817 },
+  { 10330056,70051,7957388,-9002667,9764902,15609756,27698697,-4890037,1657394,3084098 },
+  { 10477963,-7470260,12119566,-13250805,29016247,-5365589,31280319,14396151,-30233575,15272409 },
+ },
+ {
+  { 7002873,-7390759,12805954,14721563,-28766931,-3068011,17720489,8883576,2473738,8797873 },
+  { 27437967,-11442011,1772381,-8237281,-7599905,14113154,16088777,3107068,-9565273,13145052 },
+  { -3431032,9985685,-23977715,-5103358,24104018,2378458,6203237,6021787,-10326221,15187406 },
+ },
+ {
+  { -33017465,6886659,11378792,-4119015,-16344191,-3122927,3733352,-78741,13706760,10736894 },
+  { 3452270,11131577,-998551,4945333,1203700,2858523,13620307,-5889702,-15672065,-4354715 },
+  { -4166734,-1690867,22640957,-2775134,29005212,-11816751,10249401,-15313265,22844490,9390774 },
+ },
+ {
+  { -1384602,1788034,32732921,-13975284,-8580962,-15167752,1980395,-16070620,-8560363,15751230 },
+  { 31298277,-7825875,-8280290,7459461,1118630,-6926251,23035008,-13765092,26233151,-10977524 },
+  { -28518081,12593259,4379388,8139854,24335121,15694043,-27443151,-9749442,8958968,-13863389 },
+ },
+ {
+  { -12288309,3169463,28813183,16658753,25116432,-5630466,-25173957,-12636138,-25014757,1950504 },
+  { -26180358,9489187,11053416,-14746161,-31053720,5825630,-8384306,-8767532,15341279,8373727 },
+  { 28685821,7759505,-14378516,-12002860,-31971820,4079242,298136,-10232602,-2878207,15190420 },
+ },
+},
+{
+ {
+  { -19443170,-15512900,-20797467,-12445323,-29824447,10229461,-27444329,-15000531,-5996870,15664672 },
+  { 23294591,-16632613,-22650781,-8470978,27844204,11461195,13099750,-2460356,18151676,13417686 },
+  { -24722913,-4176517,-31150679,5988919,-26858785,6685065,1661597,-12551441,15271676,-15452665 },
+ },
+ {
+  { -20258635,-7120467,11453541,-6332845,32959413,13781704,-10523784,10616930,-7375307,11149822 },
+  { 4536597,-7124298,27508502,7816921,29384726,-2965218,30191588,-11586218,-30257971,-11614795 },
+  { 77135,15628759,-27441852,9328400,3300633,-10653494,-15124044,8300023,12084288,3054740 },
+ },
+ {
+  { -21066416,-16335656,1418480,-2249444,-29140515,-6863088,30966460,-10764122,-29487651,-16744118 },
+  { 24485159,3801813,12181069,3794541,-27040812,11376829,2684982,-552979,-13858421,-1814025 },
+  { -10446330,4360688,-27175545,9531482,-6277101,2345533,10507026,9073548,25811668,14702422 },
+ },
+ {
+  { -17273444,14034146,11836332,-4781612,25536070,11173207,8964775,-4233782,25146892,13305965 },
+  { -23305164,-12173503,31479650,-15972020,-17779631,-14348649,-232634,3747945,-25152809,-1147712 },
+  { 27133824,586572,-21447921,805820,-4254913,701432,-25327283,7219467,1516428,4919925 },
+ },
+ {
+  { -23376253,-6713559,22002839,-10542330,-18741772,12800415,20798369,8296528,-17854891,-4763288 },
+  { -25362444,-6866329,-22708948,8133242,-32484064,16462759,14792217,-13549756,-18892987,-16321529 },
+  { 13481959,-6850402,6450258,6309599,27021795,8919059,-6625072,5391854,-25773726,-313457 },
+ },
+ {
+  { -8809150,15205857,29876534,8214191,25802562,-9431905,6190966,10041152,6949444,5277385 },
+  { -1558679,2968832,24781098,15495403,8788080,-16587504,23862282,-11100668,12990749,9708672 },
+  { 2402247,-15817821,-2184875,444291,1247189,-12666404,19858950,-6523465,4491850,11195713 },
+ },
+ {
+  { -24128848,2410946,-8955712,-13311617,-17947166,-14918161,-5836076,11108398,-2446569,10443296 },
+  { 14208913,-5449432,17227066,-16543065,-31583738,1542012,-17054311,5630761,-18446765,10349772 },
+  { -19403803,-395047,-15176694,2356783,-10561825,6172649,-1087757,9188343,25798419,-4314193 },
+ },
+ {
+  { 6109965,-1369913,26057601,-7352580,23168326,-9182544,3992655,2862676,15421102,-3405869 },
+  { -15770113,9030044,17073626,718504,-27225159,6870038,32915018,4714511,-31763938,-4043028 },
+  { -26071999,7984758,-28087167,8099324,-23473273,2221418,17986974,-10193023,19196845,14943647 },
+ },
+ {
+  { -19232828,-16401597,-4919246,2839540,-24795382,-11924144,-24052739,-10918869,-15212424,-16221734 },
+  { -25205365,-16560488,14709584,14589301,-24771563,-1917486,28501044,-6526092,-26562285,3348610 },
+  { 24196425,11554774,5534588,-14774962,-16738109,-10389332,3020113,-15524008,-31787108,-8442673 },
+ },
+ {
+  { -17690082,12669673,20380407,-9074644,-7674053,-4133441,6120570,-9623555,-10022611,-13437694 },
+  { -30064868,-10252561,7087359,7207762,19996121,5645904,31617719,9156087,-26563046,2059452 },
+  { 29720969,995338,-5496468,1238411,23470990,15773069,-16119314,5301623,-20495997,-1164366 },
+ },
+ {
+  { 846149,-3917905,1991869,4423279,4705258,-4024076,26104347,985396,-19027704,5621916 },
+  { -3361951,-7637792,-22768336,-283040,-21976273,11823421,-8457397,14969599,19112148,-13037704 },
+  { -26352154,1725880,1371906,7512866,-2202840,-4803896,-7290942,-12202453,16352304,4491254 },
+ },
+ {
+  { 3697542,-4629441,26797664,971220,-9819131,9864026,-96924,-16076052,-31780053,-4480985 },
+  { 13794499,9444875,16235673,-14688437,-9705715,13901471,32089413,-3557805,24520430,-3537902 },
+  { 16614970,-13710209,18395785,5370482,12553636,8976933,14955496,-14296187,-7530701,5174393 },
+ },
+ {
+  { 7555277,-3005083,-8557450,-1520087,-17488297,273312,-19877096,2843532,-24537491,-14733715 },
+  { 13771729,4269735,-8090748,13654968,2255266,10496515,-3858998,5071218,12218093,-8022339 },
+  { -12648526,-5320335,17678705,-3963946,-15058809,-1631910,-10181237,14791320,5100720,7084733 },
+ },
+ {
+  { 33211681,-1215545,9045064,-7636310,13201557,-7243860,30174131,9936993,-10159990,8077411 },
+  { 23153096,13841946,22477413,12324549,-6986529,1190805,26252247,-13237895,16454666,-16277057 },
+  { 173763,3663982,-8739130,3806570,-31441379,12952789,8828535,12263775,-6062884,-3037038 },
+ },
+ {
+  { -2257643,6579210,-7451646,3196423,-5406047,-13812097,9630044,-13354190,-13610903,3408563 },
+  { 7369623,1823719,-33536202,471901,14908271,6085177,2841645,-9375465,12230966,1027765 },
+  { -19662761,6936970,-29598262,-7451826,5721117,7097208,22162127,7126314,-13338978,3769528 },
+ },
+ {
+  { 14238208,-13232994,-16224806,2003324,8999610,-4207177,23598910,10246308,18611982,-6260531 },
+  { -8676618,7221067,-9815386,-5652509,20976677,-7121811,-1600797,-1498010,21150529,8555924 },
+  { -16560296,-13801631,31420781,-7275248,12463560,6639844,-28685603,15035685,14966100,-11633690 },
+ },
+},
+{
+ {
+  { 11433042,-13228665,8239631,-5279517,-1985436,-725718,-18698764,2167544,-6921301,-13440182 },
+  { -31436171,15575146,30436815,12192228,-22463353,9395379,-9917708,-8638997,12215110,12028277 },
+  { 14098400,6555944,23007258,5757252,-15427832,-12950502,30123440,4617780,-16900089,-655628 },
+ },
+ {
+  { -4026201,-15240835,11893168,13718664,-14809462,1847385,-15819999,10154009,23973261,-12684474 },
+  { -26531820,-3695990,-1908898,2534301,-31870557,-16550355,18341390,-11419951,32013174,-10103539 },
+  { -25479301,10876443,-11771086,-14625140,-12369567,1838104,21911214,6354752,4425632,-837822 },
+ },
+ {
+  { -10433389,-14612966,22229858,-3091047,-13191166,776729,-17415375,-12020462,4725005,14044970 },
+  { 19268650,-7304421,1555349,8692754,-21474059,-9910664,6347390,-1411784,-19522291,-16109756 },
+  { -24864089,12986008,-10898878,-5558584,-11312371,-148526,19541418,8180106,9282262,10282508 },
+ },
+ {
+  { -26205082,4428547,-8661196,-13194263,4098402,-14165257,15522535,8372215,5542595,-10702683 },
+  { -10562541,14895633,26814552,-16673850,-17480754,-2489360,-2781891,6993761,-18093885,10114655 },
+  { -20107055,-929418,31422704,10427861,-7110749,6150669,-29091755,-11529146,25953725,-106158 },
+ },
+ {
+  { -4234397,-8039292,-9119125,3046000,2101609,-12607294,19390020,6094296,-3315279,12831125 },
+  { -15998678,7578152,5310217,14408357,-33548620,-224739,31575954,6326196,7381791,-2421839 },
+  { -20902779,3296811,24736065,-16328389,18374254,7318640,6295303,8082724,-15362489,12339664 },
+ },
+ {
+  { 27724736,2291157,6088201,-14184798,1792727,5857634,13848414,15768922,25091167,14856294 },
+  { -18866652,8331043,24373479,8541013,-701998,-9269457,12927300,-12695493,-22182473,-9012899 },
+  { -11423429,-5421590,11632845,3405020,30536730,-11674039,-27260765,13866390,30146206,9142070 },
+ },
+ {
+  { 3924129,-15307516,-13817122,-10054960,12291820,-668366,-27702774,9326384,-8237858,4171294 },
+  { -15921940,16037937,6713787,16606682,-21612135,2790944,26396185,3731949,345228,-5462949 },
+  { -21327538,13448259,25284571,1143661,20614966,-8849387,2031539,-12391231,-16253183,-13582083 },
+ },
+ {
+  { 31016211,-16722429,26371392,-14451233,-5027349,14854137,17477601,3842657,28012650,-16405420 },
+  { -5075835,9368966,-8562079,-4600902,-15249953,6970560,-9189873,16292057,-8867157,3507940 },
+  { 29439664,3537914,23333589,6997794,-17555561,-11018068,-15209202,-15051267,-9164929,6580396 },
+ },
+ {
+  { 856458,3818719,19448662,10894052,24532667,-8031290,-6942843,-7633185,-20504466,-5941086 },
+  { -30220592,11364139,28139985,13630081,23278065,-5126183,-11001460,14617861,3452554,-7356773 },
+  { -19973575,69174,15544046,-13972864,18820029,-9403539,-3375150,6617236,-22637687,1134508 },
+ },
+ {
+  { -30028495,-7964067,31993424,13321794,-12801509,-5180085,1677203,-8247573,26977120,-50251 },
+  { 21872900,9897841,14833249,13506487,-30547264,-10341040,17421990,4028982,28852918,-10808122 },
+  { 6939750,-13339768,-25162737,-12102673,-17744091,13119947,-11774232,6355519,27675614,15562793 },
+ },
+ {
+  { 29797683,-12232491,-14920905,-4710610,-797900,13686371,18727326,9301801,24541936,-9768206 },
+  { -11921938,-10078045,-22125373,14413208,13717843,-3990871,-30378941,13837922,-15357751,2546028 },
+  { 22216023,-11433582,5618616,5123301,-6069233,15898516,5099169,-10085817,22765821,13338888 },
+ },
+ {
+  { -20150988,-865229,-18660994,207765,-3075731,8192686,11781798,-10104784,-28536052,-501200 },
+  { 7996366,-1776054,16521724,4691545,-14103069,-3354999,-30324745,-15597732,-3273750,-3200677 },
+  { 6576267,1876189,-9872120,13538299,-5233551,3787823,-21401029,-6109718,-2276078,-6330663 },
+ },
+ {
+  { -15037747,-15397877,22340307,-15339259,16125685,-5275034,16770516,837447,30436868,4152028 },
+  { -4019522,-7268057,23604078,12973879,14998860,3813301,-14669398,-15923951,23079978,-16288198 },
+  { -23958459,-13407802,-23599070,-15280460,31979801,-6213648,9862895,2562035,-24612330,-14889250 },
+ },
+ {
+  { 12646175,4012004,-20935122,-8022761,-7897068,12054158,-24566701,-352326,21837927,323704 },
+  { -572913,-1664246,-18383902,-16570886,6499418,15036444,220935,-6107028,2001703,-4018257 },
+  { -203017,14812141,27524763,-12759929,15360611,-7961311,-29468762,965309,22587766,-11320028 },
+ },
+ {
+  { 14039917,9054809,-17804633,5081345,4662378,11343506,-17780862,-2203524,-33307319,6514132 },
+  { 19843098,-104724,13314184,-9204699,-9697260,-5040369,2767428,1275735,-10321323,11109603 },
+  { 832007,10232264,-30501712,-16725515,2721888,-13268993,-12071669,12135364,-14690044,-4371445 },
+ },
+ {
+  { -2057689,-13794612,-24133317,-8462964,-15854653,11926895,24462524,-10400996,-8692214,-12157994 },
+  { -9483899,153323,31677098,14319101,1299253,816448,-15243115,5297074,4923922,11471160 },
+  { 19188924,16119364,-32390388,2999380,32178693,-9424395,-21396285,-10705542,-18306160,-7811606 },
+ },
+},
+{
+ {
+  { -12971386,13407111,-26731979,-7600085,6443508,-7595666,-20270123,-3340436,-27786526,-98287 },
+  { -16790999,-4431934,2967930,14371159,-8905849,-11582799,28841649,5898474,-12207839,-8552185 },
+  { -24369384,12934401,-20983894,-11610004,-33503754,-7565858,-2722696,-13433312,-4494273,-362586 },
+ },
+ {
+  { 23409055,7340959,29156936,15107907,-6620265,-4158425,26665342,-4693455,-25180668,-6278125 },
+  { -11486532,-4524797,25022595,-13549308,5513673,-4078739,-28846115,-5524381,-20106536,3415915 },
+  { 22717419,9458330,31735608,6303028,-9793359,-7104961,-32388032,10252174,19973013,8665651 },
+ },
+ {
+  { -25534676,-7391563,14352251,-1813240,-4178157,6595633,28183879,-3102081,-28261981,1288880 },
+  { -9717207,14510800,17156110,12896498,-25489701,-10513686,475507,-10734791,-9457471,12709967 },
+  { -7686662,-12318605,-31628145,4907649,-1012463,5640354,-13058649,-6640668,25962257,-15505028 },
+ },
+ {
+  { -17609474,-4152861,-19543099,5098039,-29348848,12420371,24509421,-1037150,-23559591,-7903522 },
+  { -14051170,-15163342,12298459,8559429,19812335,-9020791,-6307607,4484220,-28599798,13843190 },
+  { 28825950,-9845550,-24587047,12656477,-24129723,-12040139,-8525508,2482307,-17643768,-5811846 },
+ },
+ {
+  { 17329907,-7718505,19842850,10195749,17878449,-9849426,-15976602,13590026,-30373512,6332363 },
+  { 12506784,15591734,-20594631,-15955878,23183384,-15711123,-11085129,11622576,27398433,5379393 },
+  { 12362672,-13898351,26144774,11733510,698027,-9720078,13831409,-4357407,-6439336,-11103647 },
+ },
+ {
+  { 4282992,-16756658,11371450,-15683980,108042,-14949401,1348397,-5713729,15055443,13665141 },
+  { -15064320,-9412816,-21847969,3668917,-8912359,12739922,32721928,-5825397,27420086,-5456567 },
+  { -24366534,382437,30127404,-9295276,-33249745,-12096992,9244724,-4318992,33259419,2720895 },
+ },
+ {
+  { -1868030,11098369,-11260548,6693446,-12837914,-809108,-1108489,13506512,-15401080,6765144 },
+  { -8573550,6620190,12519139,5922229,26636686,-1189346,19627703,6527713,10990465,12941207 },
+  { -6452014,1441499,30173162,-10695388,13188,8393873,-7801108,6075254,5686177,-6406442 },
+ },
+ {
+  { -12185861,-7679788,16438269,10826160,-8696817,-6235611,17860444,-9273846,-2095802,9304567 },
+  { 20714564,-4336911,29088195,7406487,11426967,-5095705,14792667,-14608617,5289421,-477127 },
+  { -16665533,-10650790,-6160345,-13305760,9192020,-1802462,17271490,12349094,26939669,-3752294 },
+ },
+ {
+  { 9840761,-1383348,-22743645,-3679074,3697821,14603418,-8798161,1500833,5146411,-12093986 },
+  { 3644097,10278862,-22032362,-2709174,-7538097,-1867724,15267526,-6567062,4527544,-10427218 },
+  { -26965787,1675460,-8528961,-1947288,-8028581,9596777,-30075915,14233628,20107181,13036343 },
+ },
+ {
+  { -21677118,2316792,-28218618,-10179951,-27509290,7887377,7738826,-15813284,22596464,-11485477 },
+  { -30711382,-15384825,-29485767,255299,-5078785,-13802873,-31693775,16706170,7229486,-4340463 },
+  { 6655671,10422825,17443184,-4858355,25780122,9203465,30723293,-12167815,28755064,-10849474 },
+ },
+ {
+  { 9638771,-14922461,-10926220,-1987645,-26364780,13486165,16053615,9929664,29727233,696681 },
+  { -4142596,13879850,20997336,14422609,-17161758,-668961,31685404,-4389609,30360583,-15143426 },
+  { 24313801,13352114,-11355915,-2968243,-7152437,15656045,-2877136,150504,22657881,16417722 },
+ },
+ {
+  { 2981341,-1716247,-2152139,-12131417,-17484481,-8021423,-9129906,1479421,-5176550,140292 },
+  { -26823778,-3803958,-2661068,10068375,-2726383,-7586029,14733,-11082350,-27136721,1128641 },
+  { -9777444,15324184,19028135,4478194,13162549,6715073,19204941,5437426,31496997,-14448815 },
+ },
+ {
+  { 27343910,-15431792,3601812,7744110,19940031,-134198,6352225,13289534,27553107,-12510865 },
+  { -17470052,-4076096,2895583,-3298278,32892112,-1792543,-12101494,-5110343,23542517,4697667 },
+  { -32291148,9123658,31360517,-7852302,-25679991,15303942,-25175363,4346012,-24529517,3931713 },
+ },
+ {
+  { 20448610,-4861028,-23179890,-2545119,-28123255,-15245406,26483251,-10634817,-23151919,5342906 },
+  { -28237000,-13292828,-5751453,3096062,32469919,-9690104,5677079,-8852456,-4876146,2280604 },
+  { -14939241,-1617075,18118673,-13189507,200073,-13949113,-16696163,-4200567,-1665310,-7633765 },
+ },
+ {
+  { -958334,-2629630,3606643,5791943,-12305655,-2654627,3525364,-16587229,31505462,-7111083 },
+  { -32208153,15288900,5315698,14929078,20998383,13543053,31737850,-7969191,24111399,-12640937 },
+  { 28840478,1428476,-28798021,-11314656,-22970644,9396068,-3281690,-12433280,-10924580,14263195 },
+ },
+ {
+  { -12889898,9373458,31595848,16374215,21471720,13221525,-27283495,-12348559,-3698806,117887 },
+  { 22263325,-6560050,3984570,-11174646,-15114008,-566785,28311253,5358056,-23319780,541964 },
+  { 16259219,3261970,2309254,-15534474,-16885711,-4581916,24134070,-16705829,-13337066,-13552195 },
+ },
+},
+{
+ {
+  { -18603066,4762990,-926250,8885304,-28412480,-3187315,9781647,-10350059,32779359,5095274 },
+  { -33008130,-5214506,-32264887,-3685216,9460461,-9327423,-24601656,14506724,21639561,-2630236 },
+  { -16400943,-13112215,25239338,15531969,3987758,-4499318,-1289502,-6863535,17874574,558605 },
+ },
+ {
+  { 8139927,-6546497,32257646,-5890546,30375719,1886181,-21175108,15441252,28826358,-4123029 },
+  { 6267086,9695052,7709135,-16603597,-32869068,-1886135,14795160,-7840124,13746021,-1742048 },
+  { 28584902,7787108,-6732942,-15050729,22846041,-7571236,-3181936,-363524,4771362,-8419958 },
+ },
+ {
+  { -8032364,-704247,-17388100,13277582,20710629,2976906,4853429,14192122,-24983990,9472291 },
+  { -18806633,-796710,-4645136,8279527,8049298,7141207,-11239422,-5134155,21942737,-3177373 },
+  { -19365807,7606373,-10151095,6931475,-16979831,-3414477,287903,-5523370,-22802976,473055 },
+ },
+ {
+  { 17912732,-16092699,-23476692,3944828,-10517612,-7179213,20648131,3965321,25469530,-3442254 },
+  { 17267796,4369299,20216911,-7939165,-30519798,12392099,-15110587,-9548329,-20275099,-3661740 },
+  { -9788656,11359472,29586899,-11795605,1321283,-44743,28967383,3240535,-10200090,938826 },
+ },
+ {
+  { 19995698,-14869473,21733780,7271087,-33526056,1567729,11559245,4285709,8919020,8211320 },
+  { -31342735,7157393,5623109,8163183,-26777730,15033496,28918132,3421559,31066108,-952030 },
+  { 73735,5703762,4816505,5621744,95696,-3536840,21741868,-6856250,-19370432,-5862324 },
+ },
+ {
+  { 19718727,-11665483,-33419035,14383875,-1245457,-13328500,5183654,6759460,-9315996,411019 },
+  { 2635071,-6949286,-24784123,-8329913,19005633,-3301363,-11733424,9556722,6227827,-10823066 },
+  { 20722760,2199673,-20915574,11183975,19329394,3226336,-19102126,6685912,-7476329,9930534 },
+ },
+ {
+  { 11053003,3841192,27964335,366696,20767752,-10781921,-23709973,-3618570,-26398794,-7229948 },
+  { 28381678,15778838,11760291,1241910,-3674382,-6711404,-11610164,1704824,-18641853,10572510 },
+  { -32373313,-5625516,-5983304,-9317260,12767625,2257463,11956135,6783612,16163175,10524266 },
+ },
+ {
+  { -30063177,5835117,-28123481,-735266,5676682,-9446010,-30843342,10343790,-24897229,-1612201 },
+  { 25095668,-3632031,-25646677,15666421,-7485125,-8818634,10553094,15233358,-9930050,15528461 },
+  { 26598792,10725764,17168817,-12521779,-23850141,-10978889,-18530094,-11449726,-29909881,-8162213 },
+ },
+ {
+  { -8318532,-12636760,21717015,-2580894,21804605,-13841243,11927129,-10199743,16973957,-16071123 },
+  { -21264868,14313902,12180126,10524394,17275998,-15237935,11420153,-10625466,9690397,-3483465 },
+  { 846469,-816241,19449665,-12586366,-24674030,15047448,-18210608,1065907,-18273302,-5298951 },
+ },
+ {
+  { -15442323,-8255517,8206149,-10900137,29502183,11643472,14694065,-6830475,24747084,-1270704 },
+  { 28288790,8433161,-9525037,-1975094,26136821,-12164176,-18923543,4506800,2485564,255830 },
+  { -10519690,2450006,1645019,9012042,-7219985,-5339359,-24945065,14039789,28007951,-4738037 },
+ },
+ {
+  { 19968753,-7107377,12037051,12969516,30972052,14514991,-2548294,12304827,31917989,1317958 },
+  { -11948798,-7687151,21697570,9893844,-3656904,10493510,-21765360,11794312,28911981,-5470387 },
+  { 21996814,-2560087,23283746,7541733,-5776731,-6921647,-5156128,-15494238,12096625,-1088990 },
+ },
+ {
+  { 20858827,7716357,-20871520,10528024,-18963043,-10644188,-9151709,-11451866,1577263,-13006193 },
+  { -8264340,11670045,5858996,-13190140,23445499,-5786029,-4655634,13678963,1684698,-9952556 },
+  { 23771014,-13958892,-28853989,-16083794,23423949,-16633663,-18277778,3775198,-24631884,2402240 },
+ },
+ {
+  { 31104319,10380133,-544381,-6090915,30291780,-12456961,-29854295,7212734,11237062,-14129905 },
+  { 19711148,-9468178,-33254111,-4994134,3404859,7715587,981112,16348652,-2105858,-4887462 },
+  { -14435999,6853668,-9866281,7701234,-9274949,-4845546,-331979,14880194,6618018,-16359717 },
+ },
+ {
+  { 30079845,-11806721,-24908142,-4068090,-26173684,5736948,-1229355,11764498,-6614201,15736094 },
+  { 21015958,-15418770,14040455,5019259,28636236,1748556,27397006,-438522,-10107521,-5526075 },
+  { 29786748,3710360,24410277,-4251865,-8731657,805205,-4385538,-3041485,22455054,-2772167 },
+ },
+ {
+  { 26862404,852578,2867928,-4671779,28866252,-2896813,18241523,-12107321,-1697837,-8302419 },
+  { -5763891,13789138,11536636,2705072,-17359333,11957011,8938051,-16013653,7125828,4858143 },
+  { -33409148,-1567008,5579520,3018182,-2458904,11547642,-19313047,9406175,-23192632,6700561 },
+ },
+ {
+  { 22439197,6073835,-18681498,-3015329,352366,5109476,10943265,-16128583,30589587,12639673 },
+  { -3083565,-8358797,-9442335,-8713834,30259461,-7479673,2234642,10981484,-13673465,7924042 },
+  { 22652335,6515168,-25265582,13236281,28274803,13460880,-4372059,2427596,-20657332,-11572556 },
+ },
+},
+{
+ {
+  { 1151868,-12082912,-12248755,-9209951,-15023342,-12612269,17683376,-12601632,27176316,4618238 },
+  { 32070292,9778898,28212468,8406405,21384023,719879,7526632,-1635932,1232678,-9087008 },
+  { 11738445,12055293,17975421,-6256476,-15122178,867096,-13344125,-10936354,-12725087,13257295 },
+ },
+ {
+  { 24949256,6376279,-27466481,-8174608,-18646154,-9930606,33543569,-12141695,3569627,11342593 },
+  { 26514989,4740088,27912651,3697550,19331575,-11472339,6809886,4608608,7325975,-14801071 },
+  { -11618399,-14554430,-24321212,7655128,-1369274,5214312,-27400540,10258390,-17646694,-8186692 },
+ },
+ {
+  { -2799350,-12815864,-30690518,-10613242,20257281,-6608948,1273781,-12126839,23987157,-5261316 },
+  { 29591852,-2632899,-10629808,9551247,26924243,5550335,-25952492,3435650,-18179108,3211619 },
+  { 22967969,-13006764,-26711393,-15021611,4077757,-13823387,20200097,13831205,11057448,-11230371 },
+ },
+ {
+  { 11431204,15823007,26570245,14329124,18029990,4796082,-31446179,15580664,9280358,-3973687 },
+  { -160783,-10326257,-22855316,-4304997,-20861367,-13621002,-32810901,-11181622,-15545091,4387441 },
+  { -20799378,12194512,3937617,-5805892,-27154820,9340370,-24513992,8548137,20617071,-7482001 },
+ },
+ {
+  { 23113363,6985362,17980160,5826248,-12752327,3544160,-4353644,-7029754,-1733358,26712 },
+  { -32642667,-3189679,5037835,16063638,-30449736,13426648,-14814828,-16244086,-11983520,3427340 },
+  { 6728021,3943536,11519363,-1398696,3720035,-143752,5966363,12390845,19045309,-4878610 },
+ },
+ {
+  { -938825,-3930586,-8714311,16124718,24603125,-6225393,-13775352,-11875822,24345683,10325460 },
+  { -19855277,-1568885,-22202708,8714034,14007766,6928528,16318175,-1010689,4766743,3552007 },
+  { -21751364,-16730916,1351763,-803421,-4009670,3950935,3217514,14481909,10988822,-3994762 },
+ },
+ {
+  { -12197875,-16256853,-32066003,-7604192,-30517444,-9307610,-24817708,5858848,-25557,-1161751 },
+  { 5722528,7338237,24686771,-2741557,26931783,-2780045,-24984859,6984986,5959779,-16261507 },
+  { -31328839,-14228792,23784715,-14316545,3116047,-7508929,-1023953,1210679,24243173,394448 },
+ },
+ {
+  { 15564307,-14311570,3101243,5684148,30446780,-8051356,12677127,-6505343,-8295852,13296005 },
+  { -9442290,6624296,-30298964,-11913677,-4670981,-2057379,31521204,9614054,-30000824,12074674 },
+  { 4771191,-135239,14290749,-13089852,27992298,14998318,-1413936,-1556716,29832613,-16391035 },
+ },
+ {
+  { 17705402,16075175,-28271940,-10031868,-9816067,15596024,13063120,-16535871,-23433371,-555304 },
+  { -20522842,-12132874,-7293976,13841545,17630403,-2824644,18057750,-4887991,26735525,-10531510 },
+  { 13410102,13678834,13635867,-5238154,22203491,-147951,-12571811,1771254,10635645,2921068 },
+ },
+ {
+  { 7064884,-7541174,-19161962,-5067537,-18891269,-2912736,25825242,5293297,-27122660,13101590 },
+  { -2298563,2439670,-7466610,1719965,-27267541,-16328445,32512469,-5317593,-30356070,-4190957 },
+  { -30006540,10162316,-33180176,3981723,-16482138,-13070044,14413974,9515896,19568978,9628812 },
+ },
+ {
+  { 17406090,5493137,24147763,671209,-26377161,10934677,7906448,-11715235,-27694778,2934119 },
+  { -17357193,-1736245,28906516,1872635,10345191,15978500,28953514,-13430076,31928009,14888157 },
+  { -32749555,-6773543,24119225,-4780588,-19569004,-2269298,-27839206,-6934780,-18887152,8289297 },
+ },
+ {
+  { 33053803,199357,15894591,1583059,27380243,-4580435,-17838894,-6106839,-6291786,3437740 },
+  { -18978877,3884493,19469877,12726490,15913552,13614290,-22961733,70104,7463304,4176122 },
+  { -27124001,10659917,11482427,-16070381,12771467,-6635117,-32719404,-5322751,24216882,5944158 },
+ },
+ {
+  { 2064323,3389376,-5998736,12789760,23083186,2348986,24360274,-5056549,29183010,-12573071 },
+  { 18684094,1891650,12632721,15714948,8179424,-6783550,20471479,-9734884,-3600610,-838184 },
+  { -7052404,-1742398,4963621,9170670,-28926658,-8371706,-5164824,10219304,-27659048,-16611411 },
+ },
+ {
+  { 8894125,7450974,-2664149,-9765752,-28080517,-12389115,19345746,14680796,11632993,5847885 },
+  { 26942781,-2315317,9129564,-4906607,26024105,11769399,-11518837,6367194,-9727230,4782140 },
+  { 19916461,-4828410,-22910704,-11414391,25606324,-5972441,33253853,8220911,6358847,-1873857 },
+ },
+ {
+  { -17236652,-9464043,8392082,-6706172,30447167,-10339197,-28396654,4839893,4104598,-5250642 },
+  { 21282316,-12874263,24980506,12255539,-12170350,12246763,-15188061,11619134,11109367,3667527 },
+  { 21419756,-4859272,4451436,2056171,26610790,1176360,-563089,9704551,2877250,5467020 },
+ },
+ {
+  { 801428,-2081702,16569428,11065167,29875704,96627,7908388,-4480480,-13538503,1387155 },
+  { 19646058,5720633,-11416706,12814209,11607948,12749789,14147075,15156355,-21866831,11835260 },
+  { 19299512,1155910,28703737,14890794,2925026,7269399,26121523,15467869,-26560550,5052483 },
+ },
+},
+{
+ {
+  { 166991,-15976393,15612707,-12414786,3859799,10068474,15791766,8882529,-13904217,-16113556 },
+  { 5878335,-11030369,10377567,-1004952,-26821707,-12500491,-32589455,1330441,20157226,5246228 },
+  { -10703555,-5134677,32878464,10118550,-16188877,-13117789,-18307586,-12382964,4281976,2841433 },
+ },
+ {
+  { -7176526,-14530030,17755939,-8800171,13593436,-15587581,-7176951,11682802,-17650183,-11954511 },
+  { 24898741,9496464,5033731,6719600,19600974,9612324,29526147,4615092,-30745039,4637079 },
+  { -16993447,-570329,-1406964,2180914,-10106635,-10114385,981040,-16698728,-5368639,-15756431 },
+ },
+ {
+  { 29542070,-2182933,-7168690,-4764788,-12344156,4582134,29160811,-8922022,6050304,-14977506 },
+  { 20489514,11664490,-27510910,-10908666,18661539,-3332790,2854782,-14555153,2555760,-2911023 },
+  { -10712936,28558,6884883,-5300244,19667819,-14481644,423572,-7844175,16634613,11281690 },
+ },
+ {
+  { -16801750,-1762975,-22467725,9434440,-9951831,-8933476,27827120,-3222516,-32374318,7290746 },
+  { -16659543,-2982994,20476665,10859803,-32517917,4205786,-15350323,-1086381,17401998,-5907683 },
+  { 6969781,9774089,-5109431,16204799,-10945801,-14454277,29242247,-2434264,9253113,-5791284 },
+ },
+ {
+  { -3669226,3129507,31416816,-6565690,27965531,-13838685,-711700,-13280343,9391828,-7974698 },
+  { -27869520,10677334,-8828821,-2983317,-1840345,-12009354,20734475,12867382,-9533141,16434110 },
+  { 17014661,-6877276,-11191730,-1067110,-16537698,420500,-12178760,-4473581,8518315,15782726 },
+ },
+ {
+  { -7956,12772300,32978859,8517266,27953488,6824388,-1319335,7161177,11931082,-8295195 },
+  { 10460864,-11872344,17958900,-8539875,7777518,14231236,30537017,7189523,18087307,14485069 },
+  { -23257390,1423639,20207261,-5020483,-4218590,6221438,-26758641,-7211487,29919858,12403424 },
+ },
+ {
+  { -2469315,-11851734,4851051,-5102376,13157069,12165049,-27074990,-12296615,9797749,-1265251 },
+  { 6820283,9377919,124462,4395148,-26029759,-6727852,10086820,-413999,-11524269,13780629 },
+  { -19755809,5857808,-3720534,9870103,4940095,-13136305,-5936654,-3243695,33015652,13484 },
+ },
+ {
+  { -23811906,-14818544,25006789,7818556,2841551,-9159601,23314567,-6712687,-10834224,-2520603 },
+  { 7162490,8520820,-235608,2918152,-17043438,-12026913,6511583,-12247282,23271856,-4675124 },
+  { -19555662,2820406,-33502507,-949064,-14455339,-11775334,-6229176,2263280,30370950,-10340844 },
+ },
+ {
+  { -14153619,-5936245,26559889,-10275116,23091691,-6645492,27277322,-10480815,-7222825,-11061979 },
+  { -17922285,-2059844,-2788841,10082224,-23042987,7924064,-12557107,-11923649,29584993,-4861537 },
+  { 25563885,14404915,-26923773,-8377218,-1750972,12924822,-4663112,8390978,-19350274,-10414879 },
+ },
+ {
+  { 2802201,6388282,17974956,13015754,1622499,3408423,51105,6924884,-26833658,-16542012 },
+  { -28148458,-8415979,27555912,11302786,16785938,-14671332,32918065,5797731,-28766650,-10643504 },
+  { -26483368,-5660162,24602409,2152784,11687226,6476518,-3591987,8237920,30748916,9579252 },
+ },
+ {
+  { 32778029,-6592894,10575199,1309227,20063865,2366075,24290483,-14380474,19466830,-12966689 },
+  { -31419487,3753739,25834170,-12661978,28927836,-13031616,2559163,14797755,-12282020,-336596 },
+  { -11283032,965075,-10419109,1024677,4901738,-4222859,-8398458,-3200735,-23883412,3152440 },
+ },
+ {
+  { 8973235,15634443,22149738,6342817,6202129,6787876,16977729,146860,-11114185,10592439 },
+  { 17827488,15497598,-15844279,849808,-28255718,3399728,13330136,-6677954,-29239623,7587038 },
+  { -27148343,-10019514,8286741,-4482008,-12488585,-6714325,27803656,-16367898,-1813203,-7093361 },
+ },
+ {
+  { -8411477,8151476,3675597,-3715319,-11523257,-16679986,-18061191,2035568,-31574641,9900149 },
+  { -13966927,-14115602,5893488,-12236061,30263829,-4873750,-20317206,10972758,-24346414,44769 },
+  { -13460285,-4538769,17486465,-7469399,4959170,12454093,-33310938,-6693239,4957181,-5724073 },
+ },
+ {
+  { -15755379,3991544,24106352,-16680170,32549896,1059935,-25306315,-8806320,4619868,8266818 },
+  { 27223156,12632188,-17242749,5932654,6032259,13876663,31352056,-1958779,24518795,-1897650 },
+  { 18471665,-14571490,13319358,-5800023,-2911075,-233626,-14570047,4097065,-24013261,7109180 },
+ },
+ {
+  { 3408337,-4262303,-2370363,14132412,3288387,-11644227,-32698312,-15487970,-7640801,-4442594 },
+  { 17768860,16490824,-12040045,-10263510,-30426614,7900666,22075554,4467372,25148505,6512365 },
+  { 25667472,-4550627,-31375242,-3286969,-10776788,-16405497,30760022,11165052,-20870141,-12199707 },
+ },
+ {
+  { -3017432,10058206,1980837,3964243,22160966,12322533,-6431123,-12618185,12228557,-7003677 },
+  { 32944382,14922211,-22844894,5188528,21913450,-8719943,4001465,13238564,-6114803,8653815 },
+  { 22865569,-4652735,27603668,-12545395,14348958,8234005,24808405,5719875,28483275,2841751 },
+ },
+},
+{
+ {
+  { -16420968,-1113305,-327719,-12107856,21886282,-15552774,-1887966,-315658,19932058,-12739203 },
+  { -11656086,10087521,-8864888,-5536143,-19278573,-3055912,3999228,13239134,-4777469,-13910208 },
+  { 1382174,-11694719,17266790,9194690,-13324356,9720081,20403944,11284705,-14013818,3093230 },
+ },
+ {
+  { -11307610,6210372,13206574,5806320,-29017692,-13967200,-12331205,-7486601,-25578460,-16240689 },
+  { 14668462,-12270235,26039039,15305210,25515617,4542480,10453892,6577524,9145645,-6443880 },
+  { 5974874,3053895,-9433049,-10385191,-31865124,3225009,-7972642,3936128,-5652273,-3050304 },
+ },
+ {
+  { -20788824,14084654,-13531713,7842147,19119038,-13822605,4752377,-8714640,-21679658,2288038 },
+  { -26819236,-3283715,29965059,3039786,-14473765,2540457,29457502,14625692,-24819617,12570232 },
+  { -1063558,-11551823,16920318,12494842,1278292,-5869109,-21159943,-3498680,-11974704,4724943 },
+ },
+ {
+  { -27395711,8435796,4109644,12222639,-24627868,14818669,20638173,4875028,10491392,1379718 },
+  { -13159415,9197841,3875503,-8936108,-1383712,-5879801,33518459,16176658,21432314,12180697 },
+  { -11787308,11500838,13787581,-13832590,-22430679,10140205,1465425,12689540,-10301319,-13872883 },
+ },
+ {
+  { 6189866,5884791,-18043927,-14963935,5510523,4992297,10187182,-8517178,29115721,14444287 },
+  { 18230056,15241330,-1027740,220558,-29708308,6221539,22176695,4108531,-20339289,775652 },
+  { -10463957,-9780276,29727128,-4954180,205783,3954810,16236218,-10306863,-8748503,-16121158 },
+ },
+ {
+  { -17786733,4455810,-16630632,-11605422,24118087,5796943,-699565,8243389,13971094,-11588738 },
+  { 12653523,-7361337,-32470107,-4147694,-13403397,9459153,33225408,-9060131,21586820,-2680144 },
+  { 7227959,13438918,2928715,-14170533,31058785,-6796326,9901246,-9854666,-912179,898360 },
+ },
+ {
+  { -11666174,16430478,13139872,-737196,28064032,-6070948,-5872616,-7936049,17577386,11483416 },
+  { 27146448,11784627,-7394170,-1860035,-19938249,6449402,18137434,-10444810,-32443044,12846861 },
+  { 20177384,-15782643,-31082097,-4467808,14387416,2719303,-1929001,15981247,2351545,-12305474 },
+ },
+ {
+  { -3837602,13045718,28443955,15948611,-27578806,-14460236,-29347292,-252415,-28687142,11603313 },
+  { -14406401,916949,-27375369,6685201,9811730,-2545467,25034225,-8324028,29022371,-14440283 },
+  { 16286546,-893152,25911489,-3780305,3806294,2014063,-6126197,-16659809,19533296,-1102562 },
+ },
+ {
+  { -25239305,5957223,17612983,12865554,-7717664,160465,19574135,12649634,16802976,-14306366 },
+  { -26780097,-2339396,25409103,-3262811,-22511547,10172571,23865553,16266128,2127412,-6563710 },
+  { 27555328,-1744304,-28309140,11630286,-6845855,8455659,-8687096,-6769707,33470313,7717021 },
+ },
+ {
+  { 25268212,7082738,-7436044,-10571946,24745475,11625322,-11694433,13961182,3678942,-11787924 },
+  { -25519566,1108491,-4762600,-6787326,25745049,15846747,23544354,-10479150,-20626524,3688247 },
+  { 21103069,-7533112,-20233028,-13200578,-17817911,-3697981,29832725,9332632,6096382,-15037623 },
+ },
+ {
+  { -2163057,2187953,-21526499,-14723557,31048935,15893634,11023433,14684308,208813,-6700595 },
+  { -17910279,1153026,31808079,-4648400,23440254,-15533903,17834928,12938630,9869189,-12187869 },
+  { 32666220,-14951226,-26855673,5208586,-20166797,-6318271,8999549,7585962,2733319,-1336347 },
+ },
+ {
+  { 18281437,-8045800,10062697,-5082293,5003845,14644808,21791337,-9553102,-1292602,-1637500 },
+  { 20403942,5531162,-27008401,8927165,5405029,-7163568,-4644691,-12173608,20315279,7105713 },
+  { -18004017,-10163053,-30134751,-783770,-2031931,-16046455,28918344,-2878910,9081274,14638523 },
+ },
+ {
+  { -26906651,10007753,10158581,7216177,32323562,1534623,-15964979,-7525171,8798083,6654362 },
+  { 23015036,-8842936,-26325855,3510341,20326790,-871718,-2402349,10793431,-4804642,6320614 },
+  { 14677667,8535390,-28247954,1334148,29226814,1427576,19289451,4820344,12789749,8031351 },
+ },
+ {
+  { -7495081,-8130894,16330139,15070732,5126905,-8188488,26698321,-16297750,-24697416,-8913707 },
+  { 7076450,-13237628,7657139,4129265,-21671264,5867909,30683086,-4329440,31013527,9859727 },
+  { -29274151,15656364,-2090117,5270065,19574463,9584133,-8064468,-4778212,-14606286,7721261 },
+ },
+ {
+  { -1982247,287246,870886,-8682080,-5273111,-11091252,5866942,6048768,10688090,-1616780 },
+  { 4320510,-9874849,7336769,14645412,-10645889,-10252263,-16739027,-12560653,33323238,-11866118 },
+  { 18658497,-12712743,-1477736,-10302300,-2676798,1740325,27277447,427191,-570272,-994127 },
+ },
+ {
+  { 5383362,-13359103,-14007394,14372650,30801004,9041537,29182249,2690795,-33462474,7189273 },
+  { -3721620,-461813,-12849007,2632908,19840529,11366335,-28594834,14080560,12447689,-10691972 },
+  { 23299755,6701149,1736245,-559789,13956935,10200200,-29845082,6434963,-24888610,-7345734 },
+ },
+},
+{
+ {
+  { -33349104,-12968546,-10808498,8713650,33524436,13108626,-1419451,4669469,-5523721,-3186258 },
+  { -8099411,-5380176,-31015873,2560818,5636160,-9168869,12687448,15176521,15747510,15632705 },
+  { 28990153,11360283,28664170,8248719,-22786756,-16472522,11077326,12281365,-13134018,-6271260 },
+ },
+ {
+  { -26424185,-10781027,-13852000,-951650,15474996,10668212,24279721,13459047,-6237183,-10048830 },
+  { 24350163,12173425,-8529029,-5401735,-1631271,15818485,11878433,10161213,33224202,15370052 },
+  { -27349979,-12905691,-18411784,2293916,6365638,11138129,-6185985,-12006553,15502955,6395806 },
+ },
+ {
+  { -22956456,-756042,-15806360,3959375,29470269,6405422,-27353020,-3353214,2165810,-10267697 },
+  { 18128975,5634442,31759800,12307418,6560675,-8962366,-20761020,9034332,8644625,-7386993 },
+  { -32154091,-3311962,17434343,11896135,21065782,14346328,6089569,-12076264,-9727276,8877999 },
+ },
+ {
+  { 5414091,-15386041,-21007664,9643570,12834970,1186149,-2622916,-1342231,26128231,6032912 },
+  { -26337395,-13766162,32496025,-13653919,17847801,-12669156,3604025,8316894,-25875034,-10437358 },
+  { 3296484,6223048,24680646,-12246460,-23052020,5903205,-8862297,-4639164,12376617,3188849 },
+ },
+ {
+  { 17296638,780909,21844480,1934604,-28018544,-14365979,-26616478,11880703,-1115508,2027157 },
+  { -23584125,15911808,11574391,10424501,-31146037,-62594,31920545,-1724617,16711674,4124580 },
+  { 23743348,-2403564,-32480914,-7652749,13297745,1335568,-9836495,4925985,-29347163,-11063940 },
+ },
+ {
+  { 11147722,11314911,3355084,-4036110,-26193748,15008629,32383854,-5286168,29132241,-13964545 },
+  { 6154618,12714019,-30990643,-10586981,-7933783,9817885,-20069891,-12145040,-17129292,-6650685 },
+  { 14482931,12128407,218547,-2704432,-4670365,16745236,-22919619,1873104,-5505714,-9118365 },
+ },
+ {
+  { -24509315,9841588,-16615120,-5243643,-28819075,-560585,20998503,6809766,-23527876,9877156 },
+  { 29060853,6488951,16991721,-961615,-30788396,-13869599,15650073,-10850093,8549423,4803399 },
+  { -30110401,-16588592,-29597868,-16395199,25199716,6159962,-25320082,-361117,-6382094,-16235746 },
+ },
+ {
+  { 29190488,-14659046,27549113,-1183516,3520066,-10697301,32049515,-7309113,-16109234,-9852307 },
+  { -14744486,-9309156,735818,-598978,-20407687,-5057904,25246078,-15795669,18640741,-960977 },
+  { -6928835,-16430795,10361374,5642961,4910474,12345252,-31638386,-494430,10530747,1053335 },
+ },
+ {
+  { 23000366,50860,20712085,7163919,21806384,1254552,-1415187,9361080,25139581,-570800 },
+  { 7476509,-5916265,13646109,5015799,32979280,12023074,-29281926,14930217,-3068577,8497493 },
+  { 25862729,12429079,16117625,4038555,-16856495,-13144694,-11548949,-6450467,8834488,-14687553 },
+ },
+ {
+  { -13241385,-12533569,11941897,-2189936,5605667,-14759138,12913296,2426174,10948731,-4365096 },
+  { 8094601,-11259838,-24522630,16222245,-743918,10307728,-13821675,2069754,-20688122,3888516 },
+  { -18231972,15478811,32964717,-13141441,-1574144,12118301,-29255919,-14053330,-22244524,14655246 },
+ },
+ {
+  { 28703429,-10309782,-15750271,12196233,-19092830,-9092670,20946008,-11988684,-20646363,-10193975 },
+  { 6705071,7087511,-27643882,-16038721,-4990431,-3811454,12097637,12412739,6123734,2762379 },
+  { 10025899,3936505,-21192464,-14845349,-1241024,-15533606,-22114207,-13284116,16691797,-16190366 },
+ },
+ {
+  { -29265967,-14186805,-13538216,-12117373,-19457059,-10655384,-31462369,-2948985,24018831,15026644 },
+  { -22592535,-3145277,-2289276,5953843,-13440189,9425631,25310643,13003497,-2314791,-15145616 },
+  { -27419985,-603321,-8043984,-1669117,-26092265,13987819,-27297622,187899,-23166419,-2531735 },
+ },
+ {
+  { 16610038,15639351,-13245915,6045636,25187847,12290810,-4731180,10404441,-11767561,-216174 },
+  { -859781,-1162170,-25704266,-13202206,7293701,10981365,1993080,15980565,-28172962,5422449 },
+  { -5022751,2319483,-10174374,-6777734,-13774794,3324871,9930015,6975560,-2181959,14842495 },
+ },
+ {
+  { 8812340,12860015,-19871313,9274103,-20188739,254430,24098389,-5393370,-9236745,5681448 },
+  { 16394842,-10315047,-18674424,-14971991,-3458117,8394754,7620056,534935,-7925574,-15993780 },
+  { -18347813,-500770,11411006,-861708,-31186382,16479396,1229499,-7712512,-21178419,8166934 },
+ },
+ {
+  { -20536911,3413305,2178835,-13970167,11377952,-12709255,18974670,302196,-6384509,-8070910 },
+  { 2691926,422737,8874018,-2543294,30218759,2928198,31385119,999573,16303550,2726235 },
+  { 6657514,-2705190,24488691,-6525232,2847173,15485382,7710391,-3119134,33520892,14060871 },
+ },
+ {
+  { -21744398,-13810475,1844840,5021428,-10434399,-15911473,9716667,16266922,-5070217,726099 },
+  { 29370922,-6053998,7334071,-15342259,9385287,2247707,-13661962,-4839461,30007388,-15823341 },
+  { -936379,16086691,23751945,-543318,-1167538,-5189036,9137109,730663,9835848,4555336 },
+ },
+},
+{
+ {
+  { 21878590,-5001297,4338336,13643897,-3036865,13160960,19708896,5415497,-7360503,-4109293 },
+  { 27736861,10103576,12500508,8502413,-3413016,-9633558,10436918,-1550276,-23659143,-8132100 },
+  { 19492550,-12104365,-29681976,-852630,-3208171,12403437,30066266,8367329,13243957,8709688 },
+ },
+ {
+  { -31752550,-8452702,9056473,3887422,-2454335,-1493608,-13028399,-171987,14026798,1572583 },
+  { 27775746,11317923,17097773,15519649,14265191,-2278283,-27492312,-3385907,28653834,-16717595 },
+  { 20930892,-88067,26662083,-14115021,25414360,-12285276,6256602,3300085,5699050,-1530678 },
+ },
+ {
+  { -7851433,1181632,-6049515,3911952,-24025185,9008307,-26555798,12066665,22754743,-1029462 },
+  { -13821439,13615603,2415448,12828197,-7872583,-15441337,-187875,9780277,2087345,-13123095 },
+  { 20985853,-15618046,8703019,16070305,12305092,2476633,-6091766,12178121,-10338887,-16001527 },
+ },
+ {
+  { 23302914,-15658466,-1730796,10126900,19633094,1767878,28234852,196118,-11245455,15155201 },
+  { 3008648,7723116,29614439,-617974,24990778,14788928,-3003375,-9227048,-2108344,1321150 },
+  { -28255369,-15807254,24529008,15586857,28229536,-4730088,10491543,14278611,-20745542,11365884 },
+ },
+ {
+  { 20001188,-12238263,-13523785,-1577674,27056814,14284101,125357,821072,4888785,11789714 },
+  { -26393287,8632332,22472520,4213279,-6401060,-873175,22351741,1202362,-17746883,-15372356 },
+  { -28628291,2482965,31892772,-4114662,9451482,-12737667,12152295,-9180657,-19043317,731080 },
+ },
+ {
+  { 20629748,-15723688,15045843,-10496833,20984049,-3227120,8546576,-14823192,-13082549,7111039 },
+  { -717073,-15536287,-15935880,13395092,21118002,12052078,-5061660,-14997379,-29734918,4053335 },
+  { -28634308,-13939211,18967230,-1375802,17856594,2912238,-12463893,-6959955,29916687,352087 },
+ },
+ {
+  { -16323614,13957626,-23392056,9421336,-30452232,16499683,-744080,8305719,-7336089,6745880 },
+  { 375421,-12953744,25737448,-10172856,15200584,-6473446,-11155263,10779657,23200976,-12346781 },
+  { 9829803,-16675716,-10789795,-12425325,13627989,15819286,3480294,15345380,19558512,4554961 },
+ },
+ {
+  { -14764745,-6994634,11694757,716682,-6811806,-11671880,-26238841,-16121200,-13614211,-11907386 },
+  { -11222704,-1321919,23862869,2970041,-10583355,-6040463,14464259,3040525,-19389344,-7036015 },
+  { -3345863,3678291,-9280390,7081144,-28631785,-11264420,12367405,-13692564,-15990240,-16608968 },
+ },
+ {
+  { 26935962,-6155970,-9335811,-10188570,12802676,2924046,28241386,-10247883,-33258536,12092112 },
+  { 16893778,13669210,-8621619,-14446820,24840102,-12279664,1123574,548509,27065545,-14150990 },
+  { -11359981,137195,9111842,9847073,-9880353,11320354,-4646288,94430,-14241495,-14941732 },
+ },
+ {
+  { -3813227,6001747,610521,13100340,-3656446,2550366,-14760732,-10885913,23425437,15149273 },
+  { -14620054,1729108,12786517,9069328,-5746033,-15992641,16672133,-6419456,-30849046,14144417 },
+  { -7882916,1821660,922346,-16770473,-15166789,13848023,2847189,11658201,-32619506,1403952 },
+ },
+ {
+  { 24417065,-4668026,-16129094,11331382,-22096037,-5800526,22205712,3958100,-23579460,-5571141 },
+  { 31468563,-11890305,32656348,697046,15342300,-13507566,10562655,4600999,-13008442,2348507 },
+  { -3101023,-15153850,-16191120,12112991,-17876255,-2487374,25541367,4661490,-32748897,13924933 },
+ },
+ {
+  { -22856267,11014876,14395810,11475721,23018800,4512103,-28624137,-11169250,13805958,-7132974 },
+  { 24337682,6840162,-12702579,11481878,-9585505,3757698,30512181,-1788935,5056155,14216704 },
+  { 12882240,2328185,30241579,7398702,-4247315,6002902,24457341,-16570204,-21897653,-4091153 },
+ },
+ {
+  { 1146002,-16557989,-20465844,9499788,-31667249,-12335710,1556620,-3468336,585952,5110966 },
+  { 5156795,14381418,21655599,6498632,-3967320,-13694974,-22253144,14707460,31185666,-10720909 },
+  { 3082583,14442164,-21909738,1422910,-2130346,-16299110,25282875,-12660738,-20493185,-8209460 },
+ },
+ {
+  { -28040919,3151953,-9300910,-9046933,-3437813,11271708,-30642757,14154213,31997282,546283 },
+  { -25754028,7885911,472867,3830780,-22639733,-904950,-7174753,15822501,-16072069,-2774579 },
+  { -6683765,-5911929,-620599,-11274494,12139418,14398666,19151799,11300916,-24580912,6967612 },
+ },
+ {
+  { 29361852,-5757676,31947290,-8916235,-32338292,1576064,-25652823,426185,25592279,11724532 },
+  { -25600820,-12740996,18184808,-9929604,1499138,-6919670,-31940752,-5427838,27679153,-5791328 },
+  { -11038881,6248027,25112622,5347498,29591014,-1984441,14641832,-8414760,29845379,13996835 },
+ },
+ {
+  { 2319062,2758214,-11045016,-4435351,-18449066,-8037897,5903291,7033251,-25898398,10160192 },
+  { 17011570,4670548,14408373,-4403631,12275167,-13210773,16864895,-13454290,29190402,1884324 },
+  { 30155528,-12097542,-17855342,13190891,26931544,-14403119,32936115,-9885446,-19997959,-14202425 },
+ },
+},
+{
+ {
+  { 12015105,2801261,28198131,10151021,24818120,-4743133,-11194191,-5645734,5150968,7274186 },
+  { 2831366,-12492146,1478975,6122054,23825128,-12733586,31097299,6083058,31021603,-9793610 },
+  { -2529932,-2229646,445613,10720828,-13849527,-11505937,-23507731,16354465,15067285,-14147707 },
+ },
+ {
+  { 7840942,14037873,-33364863,15934016,-728213,-3642706,21403988,1057586,-19379462,-12403220 },
+  { 915865,-16469274,15608285,-8789130,-24357026,6060030,-17371319,8410997,-7220461,16527025 },
+  { 32922597,-556987,20336074,-16184568,10903705,-5384487,16957574,52992,23834301,6588044 },
+ },
+ {
+  { 32752030,11232950,3381995,-8714866,22652988,-10744103,17159699,16689107,-20314580,-1305992 },
+  { -4689649,9166776,-25710296,-10847306,11576752,12733943,7924251,-2752281,1976123,-7249027 },
+  { 21251222,16309901,-2983015,-6783122,30810597,12967303,156041,-3371252,12331345,-8237197 },
+ },
+ {
+  { 8651614,-4477032,-16085636,-4996994,13002507,2950805,29054427,-5106970,10008136,-4667901 },
+  { 31486080,15114593,-14261250,12951354,14369431,-7387845,16347321,-13662089,8684155,-10532952 },
+  { 19443825,11385320,24468943,-9659068,-23919258,2187569,-26263207,-6086921,31316348,14219878 },
+ },
+ {
+  { -28594490,1193785,32245219,11392485,31092169,15722801,27146014,6992409,29126555,9207390 },
+  { 32382935,1110093,18477781,11028262,-27411763,-7548111,-4980517,10843782,-7957600,-14435730 },
+  { 2814918,7836403,27519878,-7868156,-20894015,-11553689,-21494559,8550130,28346258,1994730 },
+ },
+ {
+  { -19578299,8085545,-14000519,-3948622,2785838,-16231307,-19516951,7174894,22628102,8115180 },
+  { -30405132,955511,-11133838,-15078069,-32447087,-13278079,-25651578,3317160,-9943017,930272 },
+  { -15303681,-6833769,28856490,1357446,23421993,1057177,24091212,-1388970,-22765376,-10650715 },
+ },
+ {
+  { -22751231,-5303997,-12907607,-12768866,-15811511,-7797053,-14839018,-16554220,-1867018,8398970 },
+  { -31969310,2106403,-4736360,1362501,12813763,16200670,22981545,-6291273,18009408,-15772772 },
+  { -17220923,-9545221,-27784654,14166835,29815394,7444469,29551787,-3727419,19288549,1325865 },
+ },
+ {
+  { 15100157,-15835752,-23923978,-1005098,-26450192,15509408,12376730,-3479146,33166107,-8042750 },
+  { 20909231,13023121,-9209752,16251778,-5778415,-8094914,12412151,10018715,2213263,-13878373 },
+  { 32529814,-11074689,30361439,-16689753,-9135940,1513226,22922121,6382134,-5766928,8371348 },
+ },
+ {
+  { -16515239,6451019,31507083,4332819,-33349349,9350252,-8772794,12290633,-26680430,14645399 },
+  { -29200239,5265404,-32024541,-3874059,-19735057,7918453,22216228,9812801,11243093,-201486 },
+  { 24242833,-5871366,12737683,-7107135,-28452610,-12933275,-23526274,-4514964,2106417,-16513350 },
+ },
+ {
+  { 1792751,-7600555,14367867,-3148440,14332423,14812948,-4397435,-7463918,24017565,-14345816 },
+  { -15116870,-12359479,12903923,14483699,9212942,8538584,-28566466,13691904,-20564568,5478553 },
+  { 26966131,1535286,12725537,-6080689,25637686,15899166,1507604,-15517567,9682699,1772795 },
+ },
+ {
+  { -12622164,-3886464,20086897,12735442,-23304391,-14548580,-15614743,-12051326,23516862,-7862710 },
+  { -16181489,7839148,11850892,-9919039,-8506808,-9640042,-390384,-3047267,28707025,-2430302 },
+  { 23611124,13236149,6157260,-5841803,28598277,10645329,-7748027,861594,13526892,5277730 },
+ },
+ {
+  { -29389482,-8845040,-4225500,-11286722,13340070,-4921762,-1248169,11884965,5686126,3330105 },
+  { -20252650,-10479602,31608063,16000234,-7646205,-10735245,3242114,13744167,27606535,-6077110 },
+  { -31134112,-14320517,12081570,-9703797,-26146736,11694318,-27910117,6306238,-25658934,6842388 },
+ },
+ {
+  { 26242700,-546854,-2971931,-3795888,-31495669,-14941140,-23480770,6930636,-24702940,-14283588 },
+  { -27283403,-16069328,-1406216,10974063,-32403998,-5412747,-23861931,1114519,31304776,11262106 },
+  { -8273624,13126357,-27791982,9531796,12205582,2984296,-1864743,4428618,30803485,-9110265 },
+ },
+ {
+  { -1795304,9814429,-33303036,-11707965,29886347,-12364730,-2004136,-1821413,17587560,-12050754 },
+  { 22124883,-7140642,-11074008,4837032,-24481385,-649812,31001574,-5631853,2558386,-6009887 },
+  { -16213003,-10716106,17069342,-4370547,-28195846,1664721,-17161121,-8090608,-5880004,-14091799 },
+ },
+ {
+  { -29913252,-3164571,20174689,11791987,-13036076,-13218564,19335233,15367612,9072649,16740406 },
+  { -9359736,-9581442,17890629,-316332,29569149,11800309,29478370,5913429,-32254849,-4490275 },
+  { -28609106,11400069,551906,6729680,-3504507,236709,20720982,11436838,-10399896,11444928 },
+ },
+ {
+  { 1466931,6920868,81906,-9248881,-3631797,-7282819,-4002752,-577600,-2046153,-12744640 },
+  { -9673188,-8089957,-14215533,2884955,-23247878,-4031904,14654684,-14180722,15170242,-12458993 },
+  { -2212300,4413816,-676769,9818067,-12803306,1459473,3636451,-7302343,4498007,9916704 },
+ },
+},
+{
+ {
+  { 16919400,-15661710,-29375088,788854,22709065,-4825587,-11475732,-10166778,-16952540,-16383675 },
+  { -1461905,574386,-13912147,921132,3852007,-4804097,31744587,-1323224,-31409235,12484286 },
+  { -28793381,-3171741,488608,3533994,-18241312,-2771362,-26159196,6255600,-27946083,5734944 },
+ },
+ {
+  { 8888927,-3934348,-23208510,11198962,-26094395,-5555530,-30697656,7752898,4539597,2184177 },
+  { -15359790,-5687054,-5659965,-7880287,21858547,-1533493,-5663516,-11218210,-4561268,16071223 },
+  { 32353580,15216981,-4404163,-555710,9622736,-4545032,-8252350,-3037329,-7763384,-6406645 },
+ },
+ {
+  { -16309084,-16434421,-20221227,605502,7260294,9063152,2403511,13364645,13423223,-6828350 },
+  { -20054243,-9162646,-25832804,11485713,22535108,-13643926,28295885,3009938,-11230337,1702788 },
+  { 26739191,11009990,-18481770,16585992,-25896844,-184502,9343419,-244546,-25100783,4797376 },
+ },
+ {
+  { -13113012,-11600435,31634969,-1011958,32691622,-13580464,-27929075,9242993,-129472,10712363 },
+  { 448786,5297823,6384904,-15869444,-14137103,-3415431,29201369,580246,5011189,7722222 },
+  { 13344599,2986769,-4722760,-10019693,6459271,-16492604,1721111,-14299322,-8871735,-13556176 },
+ },
+ {
+  { 3906956,-1031832,17868106,13808406,-17882791,8032106,26911948,4132809,-26545855,14179683 },
+  { -19481812,16207908,6528013,9802548,-17454901,-2916466,4159069,636259,-9727260,-4678886 },
+  { 21688061,2795034,25145284,-15563288,14505030,-8650304,31170101,1908281,-22539338,16355813 },
+ },
+ {
+  { -30169357,-6230170,21623240,2265329,18946221,16402207,-13846923,10877882,23387290,2344765 },
+  { -31609256,3494046,-25494466,9296323,1612505,-6277042,-1473712,12340803,25929144,2077329 },
+  { 11721232,12262430,-5433744,15195872,4544028,-10246989,25311266,-15403219,13249972,15111681 },
+ },
+ {
+  { -3251847,5836113,-23993021,-12913421,-20267775,-13861919,-14997010,4505356,-24299636,5578764 },
+  { 24760347,5626269,20850346,-13467471,337650,13200212,-17165428,1295493,31343097,-12353835 },
+  { 27504249,15524980,-6838398,-3914835,238634,13568998,17511308,2572536,-13816507,14287194 },
+ },
+ {
+  { 9923462,11271500,12616794,3544722,-29998368,-1721626,12891687,-8193132,-26442943,10486144 },
+  { -22597207,-7012665,8587003,-8257861,4084309,-12970062,361726,2610596,-23921530,-11455195 },
+  { 5408411,-1136691,-4969122,10561668,24145918,14240566,31319731,-4235541,19985175,-3436086 },
+ },
+ {
+  { 5765151,-9781776,-28828840,12359932,-3595536,-4080763,-27454585,15391673,27316853,11439754 },
+  { 24248028,12794867,-14262106,-7145257,29491789,11513227,-8722346,13947428,20163067,-16591583 },
+  { 3657933,-5607570,16934087,-13198235,25742959,-12864631,-17036154,-14347112,-20315729,-11289100 },
+ },
+ {
+  { 32894397,-8515889,9316258,-10620525,2079046,-7914191,-4689721,10015136,11705618,-5258634 },
+  { 1054389,-12962874,-21083317,-16175818,3747966,3727732,15914898,-5704027,-19528787,9083570 },
+  { -14772258,-16096341,-33270142,798054,27364462,7598361,-7191889,749570,3660929,1742343 },
+ },
+ {
+  { -5862181,6692383,12735646,8853067,-19494149,-6156623,18245644,-16544159,24841073,1666196 },
+  { -6360796,-6410017,3216170,525777,28310768,5251084,27713565,-6220414,11665925,-13693947 },
+  { -21211123,-8713221,-13941704,-2752140,-30666223,8139832,2032755,-6924179,15307320,8233924 },
+ },
+ {
+  { -26635516,-12867839,17426943,7444382,-2986251,15208419,-12357142,2720225,-21472728,6639421 },
+  { -13603610,5092216,2649538,-16759526,-23889908,6992933,-10280287,-3586998,-32450691,-2926207 },
+  { -6657959,5341825,797894,-16679716,-25091965,3129559,-22130685,-4025433,8984627,-10455019 },
+ },
+ {
+  { -19855490,13330151,-3593895,-15089694,12003375,-3216032,15839388,7578252,24248036,-7955026 },
+  { -27299180,-11245120,-533365,-15473670,-28051434,-9407771,-29975534,-11011604,32356739,-4960349 },
+  { 13411633,-7298431,-6138220,-12775279,24141824,-15276995,-26793896,-16549495,-1222288,1048712 },
+ },
+ {
+  { 4508868,290400,-24264183,2528718,12568496,4156960,-33094935,-3937334,30987438,15651794 },
+  { -22313346,5330387,-416864,1523900,21455330,3966859,-13173002,13842823,-2259201,-3822098 },
+  { -4956031,11932208,-7574041,14616661,-26007797,15375979,8695009,7148479,22801826,13487027 },
+ },
+ {
+  { 25266140,16123924,4221017,-2055887,16504646,-16539574,29118516,-10934151,-22435582,6712197 },
+  { -15855813,-4854302,-32717919,-197889,-11736815,-12367155,31118426,-998330,18093144,5799767 },
+  { 25885036,-14781935,2622163,-3785399,-15791835,-15618932,-4253906,-7831851,26795205,-4160780 },
+ },
+ {
+  { -13994457,16616821,14549246,3341099,32155958,13648976,-17577068,8849297,65030,8370684 },
+  { -8320926,-12049626,31204563,5839400,-20627288,-1057277,-19442942,6922164,12743482,-9800518 },
+  { -2361371,12678785,28815050,4759974,-23893047,4884717,23783145,11038569,18800704,255233 },
+ },
+},
+{
+ {
+  { 23838809,1822728,-15738443,15242727,8318092,-3733104,-21672180,-3492205,-4821741,14799921 },
+  { 13345610,9759151,3371034,-16137791,16353039,8577942,31129804,13496856,-9056018,7402518 },
+  { 2286874,-4435931,-20042458,-2008336,-13696227,5038122,11006906,-15760352,8205061,1607563 },
+ },
+ {
+  { -4283307,5368523,-31117018,8163389,-30323063,3209128,16557151,8890729,8840445,4957760 },
+  { -15447727,709327,-6919446,-10870178,-29777922,6522332,-21720181,12130072,-14796503,5005757 },
+  { -2114751,-14308128,23019042,15765735,-25269683,6002752,10183197,-13239326,-16395286,-2176112 },
+ },
+ {
+  { -18316774,-15480288,-28069362,-3360196,-29775698,-15731393,12916849,-13215678,-28714484,11439936 },
+  { -20788461,-11369289,-24368307,522913,-28036423,12241782,-27105971,3595873,-23681849,-11663902 },
+  { 16404041,-3535778,-27311072,-9601854,8973272,-5912499,24052682,-762501,10597938,14712498 },
+ },
+ {
+  { 6083246,12395507,-20041050,-713102,11444551,-15587007,23416873,10372699,26431488,-14797209 },
+  { 15803991,-10657305,29704098,10955216,-6242370,-4502552,-28051410,-15443577,-14004028,2921542 },
+  { 12255955,11948580,-31284309,-7834093,21202979,15865602,17908903,-16731059,-12339931,-13163379 },
+ },
+ {
+  { -19234360,-9372767,-24223524,13635188,-20466564,-4794700,-2113497,4635109,-33414046,2526380 },
+  { 27872793,4278863,-7551330,-6229230,-31016676,-4814746,17041096,-15730725,-12891312,-2800164 },
+  { -14960500,-10437731,-32027285,-4526899,-15735181,-13994233,-10136787,3142735,-33240852,-2884954 },
+ },
+ {
+  { -612041,2116917,-4837519,-13102446,-10458763,-1243850,-13710764,-1881587,-25842288,-11545880 },
+  { -22014229,11703879,19833672,-7555572,-7296253,16074808,12841177,13983296,15557782,-15474201 },
+  { -31089022,14691109,-6061582,-13692870,16228498,-877623,-28007803,-6126563,25334131,6402897 },
+ },
+ {
+  { -18536157,-14997709,3994238,-9668171,7655623,-2153492,4747420,-7369843,-6354815,1612651 },
+  { 14582695,13299034,29424201,-14437677,-14250945,4298790,-18419028,-15776795,9897732,4913912 },
+  { -24538434,14358512,17689949,4144444,19491822,-5189567,-16628378,14577998,-1830958,8692661 },
+ },
+ {
+  { -9680504,16317181,2402138,-14042063,-10652521,2467095,30023376,-16188146,-11779811,-5312013 },
+  { -8354103,10686468,28908656,-4408072,16637852,-774988,-9496537,15765471,-3446083,-11954714 },
+  { 10816854,-1624971,24102798,-4311051,-19361534,-8349905,14656539,-6328833,3879723,56674 },
+ },
+ {
+  { 14917733,-11136022,9683801,6965216,28513386,5248491,5542191,-14042491,-8452276,-5056251 },
+  { -21019443,1319250,-24046298,-14270302,-15082604,4464332,7698714,903952,5151297,-6914384 },
+  { 30915516,-8084834,-7348270,8454987,-22501978,-3812460,21736926,-5111909,14813936,-15461499 },
+ },
+ {
+  { -11667681,15547184,9001346,-3108210,15974747,-8234038,31291306,4698873,22954137,350166 },
+  { 1469431,11700556,20569887,1966347,3300264,6273443,32715875,-12468894,-23537299,3861945 },
+  { 32349549,4460138,-26832353,-4139669,25331201,5130025,-26583158,-10883265,-22778675,14575443 },
+ },
+ {
+  { 6557463,-2697993,7261485,-10267853,-1359321,-9378913,-27620459,-16028299,8626977,-9313455 },
+  { -5870110,-14942617,24644525,-8186875,15406401,-15374260,-22262274,-7299842,-6048467,6554257 },
+  { 7562511,-10927353,16550758,4969423,16975639,-10220945,-11398739,2939640,7848305,193706 },
+ },
+ {
+  { 7719343,16458075,-6383311,1818,-7272941,9467445,-4862499,-12918451,-11067592,-6653773 },
+  { 13306195,7123786,10035200,-16549663,26209607,14010929,-20756242,13375158,-2571184,-6517193 },
+  { 10212123,5954793,-28059294,-10937196,617142,-11150927,10452256,-8964465,-32242055,-3505130 },
+ },
+ {
+  { -8509474,10030479,14509958,3928559,6935624,9964460,-29649664,-106849,-2764546,12871624 },
+  { 27776277,419107,21602915,-13868438,-9578678,-5899289,24969040,-9072546,19060721,2924775 },
+  { 2590466,2101080,-10230367,11102159,23767486,-4748594,3504392,-428582,14158821,4502206 },
+ },
+ {
+  { -17451494,-5348306,-4368578,3348574,1103956,13216354,-25128787,2054191,-10409059,-2295243 },
+  { 18459759,-14015646,-751198,9029388,-31633434,654118,13283051,241977,-12967746,-12993779 },
+  { 1014286,-2043151,-23256133,-7615707,-26599218,-14267104,-30008002,-1323058,10550311,1001033 },
+ },
+ {
+  { 33500422,-2286432,9154062,-14655698,-6419729,14445458,-27470109,16161060,10263721,5168537 },
+  { -13717551,13458841,4129737,-1846667,-14099836,-4687154,-31767375,-12687116,-3252241,-4535209 },
+  { 19966949,-9508469,-12557168,6350384,-13362568,-218126,17977628,3789270,21237562,-461352 },
+ },
+ {
+  { -18545207,-11910535,-28966478,-10616503,-27055645,-5168344,-5589803,-9900290,-4713414,-926170 },
+  { 13182109,-6272313,-1371049,-9369335,25827772,-979250,-18686929,-4192873,27141691,957129 },
+  { -30204747,7174328,8658488,7385061,23756150,-2542927,-31688514,14480373,-16660972,11067504 },
+ },
+},
+{
+ {
+  { -16342477,-8800379,30990426,-15692932,32336203,-15320229,-12518815,13139001,6688050,9467092 },
+  { -12833317,9092398,12690062,16437288,-17753039,-8277969,-31500781,-7217133,-5114726,3738925 },
+  { -21212473,-15723708,-29446787,-2257603,-21423987,6140972,-32798871,13796702,23487581,7747574 },
+ },
+ {
+  { -19025756,1632005,13466291,-7995100,-23640451,16573537,-32013908,-3057104,22208662,2000468 },
+  { 3065073,-1412761,-25598674,-361432,-17683065,-5703415,-8164212,11248527,-3691214,-7414184 },
+  { 10379208,-6045554,8877319,1473647,-29291284,-12507580,16690915,2553332,-3132688,16400289 },
+ },
+ {
+  { -23704176,6842126,-22708915,-7557262,-15484115,-12399613,-17001679,-8974971,30459161,13279195 },
+  { 5252376,3089823,-20810680,15438668,15736327,15449422,-1029077,4703527,-18380122,5892835 },
+  { 3983844,12265021,13061169,-12005106,-25101187,-7822356,12781109,8371847,17339356,7975329 },
+ },
+ {
+  { 15716668,1254266,-18472690,7446274,-8448918,6344164,-22097271,-7285580,26894937,9132066 },
+  { 24158887,12938817,11085297,-8177598,-28063478,-4457083,-30576463,64452,-6817084,-2692882 },
+  { 13488534,7794716,22236231,5989356,25426474,-12578208,2350710,-3418511,-4688006,2364226 },
+ },
+ {
+  { 17975448,-8424896,25320137,7633150,-18977366,-8326709,20808385,14886143,-12551729,14201087 },
+  { -13021786,5077603,9130387,-4035674,237049,-12022519,-16911440,2901856,6723239,9760979 },
+  { -5413095,5333137,-30532674,243209,-33478724,-3885259,-15376401,10051475,-30033013,5560511 },
+ },
+ {
+  { 16335052,9132434,25640582,6678888,1725628,8517937,-11807024,-11697457,15445875,-7798101 },
+  { 29004207,-7867081,28661402,-640412,-12794003,-7943086,31863255,-4135540,-278050,-15759279 },
+  { -6122061,-14866665,-28614905,14569919,-10857999,-3591829,10343412,-6976290,-29828287,-10815811 },
+ },
+ {
+  { -4664833,2654291,-3590531,-4817753,-23178569,-12626044,-10309081,885415,3726338,15892620 },
+  { -4994085,14883030,2342815,9573778,-17620116,15410805,-31286919,1543414,23988054,-8441638 },
+  { -19046485,-6865919,-16216929,5911064,-31197891,1796410,-20516960,-4949449,23476155,13240968 },
+ },
+ {
+  { 27081650,3463984,14099042,-4517604,1616303,-6205604,29542636,15372179,17293797,960709 },
+  { 20263915,11434237,-5765435,11236810,13505955,-10857102,-16111345,6493122,-19384511,7639714 },
+  { -2830798,-14839232,25403038,-8215196,-8317012,-16173699,18006287,-16043750,29994677,-15808121 },
+ },
+ {
+  { -29024647,6077857,32887575,14181612,30670107,7616662,19438919,8954885,-6648034,-12904222 },
+  { 21868606,-11971671,-33015074,7025189,-23659203,1311605,5078789,-8207993,-18933908,-11394892 },
+  { -19185049,-12291287,-21375349,3507441,32573341,11683163,-15559526,-5062485,-26041438,-9453185 },
+ },
+ {
+  { 9769828,5202651,-24157398,-13631392,-28051003,-11561624,-24613141,-13860782,-31184575,709464 },
+  { 12286395,13076066,-21775189,-1176622,-25003198,4057652,-32018128,-8890874,16102007,13205847 },
+  { 13733362,5599946,10557076,3195751,-5557991,8536970,-25540170,8525972,10151379,10394400 },
+ },
+ {
+  { -31854398,-11302547,-5440642,12476403,11365774,421852,15615053,14552029,-18687983,16238797 },
+  { 14403657,-1629077,11820346,3578946,14356127,-8676492,28387018,6057474,-6958417,-9963552 },
+  { -6773625,-14532604,8748655,10566320,-18003562,-7304738,-14985915,15047627,-6841903,-9306560 },
+ },
+ {
+  { 4024660,-16137551,22436262,12276534,-9099015,-2686099,19698229,11743039,-33302334,8934414 },
+  { -15879800,-4525240,-8580747,-2934061,14634845,-698278,-9449077,3137094,-11536886,11721158 },
+  { 17555939,-5013938,8268606,2331751,-22738815,9761013,9319229,8835153,-9205489,-1280045 },
+ },
+ {
+  { 13021810,13515921,498522,13074880,6822646,-4899614,-14710881,-3865065,19627336,4859752 },
+  { 17947748,-16424713,18982429,7466883,-12079365,-3283172,-7720493,-12349469,-15750621,-2386618 },
+  { -11588975,-4621534,28423102,9664617,13125793,10806218,-11734048,2237998,-2122504,9965868 },
+ },
+ {
+  { -461409,-7830014,20614118,16688288,-7514766,-4807119,22300304,505429,6108462,-6183415 },
+  { -5070281,12367917,-30663534,3234473,32617080,-8422642,29880583,-13483331,-26898490,-7867459 },
+  { -31975283,5726539,26934134,10237677,-3173717,-605053,24199304,3795095,7592688,-14992079 },
+ },
+ {
+  { 20900254,-6523733,3951776,-4560232,-2338092,-4232282,-4361421,16701274,28776587,-8599203 },
+  { 29749111,13351265,-14474508,-3792121,3729426,-13981093,-31708667,-14352360,22602331,-6901220 },
+  { -13338540,2495704,-25442983,-4002768,14522994,3329272,24613256,-632965,-25518982,-10097595 },
+ },
+ {
+  { 21594432,-14964228,17466408,-4077222,32537084,2739898,6407723,12018833,-28256052,4298412 },
+  { -20650503,-11961496,-27236275,570498,3767144,-1717540,13891942,-1569194,13717174,10805743 },
+  { -14676630,-15644296,15287174,11927123,24177847,-8175568,-796431,14860609,-26938930,-5863836 },
+ },
+},
+{
+ {
+  { -30587084,-4629784,-20009115,-10744271,-15524787,10280576,-28667146,7716332,24015220,15147052 },
+  { -5646697,-13269764,-13947040,-14622668,3346795,-337258,-1015199,7124142,4664896,15322844 },
+  { -8229784,5997383,8085987,-15578361,-2326588,-4766867,25901074,5262370,25656743,3392425 },
+ },
+ {
+  { -5860243,11777295,769126,-15776754,-8901554,6810940,-33061713,-5528741,28019812,-9002317 },
+  { 30723280,-14669513,-5004498,15511447,9149397,14075675,-15080544,8780012,-6507584,-1125302 },
+  { -26208846,-6712689,29530263,7885954,30958908,617491,10886354,-6441812,17398271,-5028867 },
+ },
+ {
+  { 4956577,-12669076,-6361090,-1974546,-12324368,-8776931,-22792445,-11783036,18817572,-7313138 },
+  { -12310337,1702372,-21202916,-8048502,5377387,403765,-24479332,9674308,9302088,-7454061 },
+  { -33117989,-5351766,12466361,16089921,-29020674,16555776,26195362,-6322866,5646086,12810190 },
+ },
+ {
+  { 12375359,-4411558,31344248,-8172991,-15128721,-3466513,-8976863,16561847,-26205910,-9394891 },
+  { 29358073,-9242956,-18683448,1114915,-14399942,-15164073,-26780152,13440858,-23247769,7151756 },
+  { 22427521,-8216631,-13953689,5390460,9717898,-15420189,-24996943,-3843860,-27420816,8959577 },
+ },
+ {
+  { -30126184,-13656189,25625075,6569873,-5456214,14774032,15970087,-4369508,21072393,-15754951 },
+  { -9261855,6283629,-1899634,-11914810,-33141702,-4158631,-27884874,-97164,29917072,2936988 },
+  { -30028170,-8874873,5361707,7325840,-17285067,-8528659,392275,14456831,9885372,-10694473 },
+ },
+ {
+  { -26182647,15674824,15490680,6526093,13923950,14064179,1521517,1040394,32631944,-12010168 },
+  { 13523352,-4449934,22306302,8760927,-17036716,12043353,-28278000,-16076403,-14476251,13913407 },
+  { 27496510,-16264770,-8813338,-4404436,-14389617,-7726065,10852392,3110348,24164752,-1314133 },
+ },
+ {
+  { -8115330,5274428,14202128,3980639,22519493,-8892418,-28849278,1503631,-8717104,-9616760 },
+  { 12107329,-8694487,6010956,-16196217,-29313968,-1561933,-31909401,16345151,-27510098,4331499 },
+  { 20321045,-16524868,8205169,1278080,6363273,10637440,-22872718,6556862,-7078489,2662793 },
+ },
+ {
+  { -20210390,-6496548,22819522,4633575,-1324763,-10609782,-2827669,-12753155,-3455290,-9249699 },
+  { 8174749,12907021,7366869,10800649,14755747,-2733367,18391108,-2299491,-11855318,8180997 },
+  { -21517309,7971553,-17356463,-12788426,-3116187,-7501968,-10418063,-13057315,16249265,-871572 },
+ },
+ {
+  { -32947452,13000135,33143473,15163714,-28379906,-228337,23898400,-3389174,7251979,9640815 },
+  { 793741,-2102370,-6747559,16138876,-4943332,-14056571,-7503845,6462,-26274334,-12045047 },
+  { -1505900,-15079632,19336107,-7706505,26498272,-9055238,22018648,12500772,-10570238,-1292196 },
+ },
+ {
+  { -13504904,5912465,16758065,-12110999,-21274301,-2521299,-24238724,4662443,-18073122,-13489718 },
+  { 2872923,3219672,-8741158,6714954,-15691911,-16333096,5803453,-10411484,27867824,-6310242 },
+  { -3134328,-4062806,30545427,10696074,-17184076,-2202215,26604862,-10291849,19116491,-1410859 },
+ },
+ {
+  { -7632140,-6602064,5060300,7391028,-18620011,-9809338,6305839,-4883334,31909493,194500 },
+  { -17459798,-4864110,21859477,13826557,2636180,6091646,15706685,-16098975,-29459618,-10248569 },
+  { 3982473,-7221251,-18876593,12452547,12022982,3004021,-7192997,-4051505,13422114,-12054880 },
+ },
+ {
+  { -22590042,1919892,25447074,-5266273,2187698,14977524,14846029,-7211937,24051312,5026737 },
+  { 20707550,-1405233,-2152556,-2347406,-28641650,-15562210,-31752500,5218373,-3237522,-518431 },
+  { -26265854,16051925,10027634,9050638,-24267620,-11418879,-1441088,16006542,-28137925,15244680 },
+ },
+ {
+  { -3447633,3599518,7348220,3163230,-983758,-4748979,14222700,-5535145,5471649,2475346 },
+  { 8419476,-14167967,16248930,8109629,6375916,7561252,18371405,-13733749,15480997,8940209 },
+  { 1642164,-14414991,-22760173,-3676214,-6669169,3419726,7257886,-9075258,-1729647,-9762454 },
+ },
+ {
+  { 12569299,-15093697,3520502,7021022,14843286,-5392332,-10760380,5585960,13643919,-11880124 },
+  { -13598393,-373991,-2102054,8976415,7064959,-2925900,-22973106,9840623,-9585581,-910700 },
+  { 33412528,14587507,30535703,-9554771,-1797473,-1367618,18236487,-429605,20675635,-14319441 },
+ },
+ {
+  { 6592880,13175957,-13201712,14063443,23404307,1679364,-21722260,14579163,-28580832,-2439411 },
+  { -12961463,-4026361,3388303,3821391,-9520560,-16149080,-27209991,-14128345,-17777214,-3101057 },
+  { -457290,4764706,-27175759,-2587705,-30278271,-12965437,-17424110,-1734125,13515911,-15413467 },
+ },
+ {
+  { 12962541,5311799,-10060768,11658280,18855286,-7954201,13286263,-12808704,-4381056,9882022 },
+  { 18512079,11319350,-20123124,15090309,18818594,5271736,-22727904,3666879,-23967430,-3299429 },
+  { -6789020,-3146043,16192429,13241070,15898607,-14206114,-10084880,-6661110,-2403099,5276065 },
+ },
+},
+{
+ {
+  { 30169808,-5317648,26306206,-11750859,27814964,7069267,7152851,3684982,1449224,13082861 },
+  { 10342826,3098505,2119311,193222,25702612,12233820,23697382,15056736,-21016438,-8202000 },
+  { -33150110,3261608,22745853,7948688,19370557,-15177665,-26171976,6482814,-10300080,-11060101 },
+ },
+ {
+  { 25940115,-12658025,17324188,-10307374,-8671468,15029094,24396252,-16450922,-2322852,-12388574 },
+  { -21765684,9916823,-1300409,4079498,-1028346,11909559,1782390,12641087,20603771,-6561742 },
+  { -18882287,-11673380,24849422,11501709,13161720,-4768874,1925523,11914390,4662781,7820689 },
+ },
+ {
+  { -14822485,-5797269,-3707987,12689773,-898983,-10914866,-24183046,-10564943,3299665,-12424953 },
+  { -16777703,-15253301,-9642417,4978983,3308785,8755439,6943197,6461331,-25583147,8991218 },
+  { -17226263,1816362,-1673288,-6086439,31783888,-8175991,-32948145,7417950,-30242287,1507265 },
+ },
+ {
+  { -4811456,13761029,-31703877,-2483919,-3312471,7869047,-7113572,-9620092,13240845,10965870 },
+  { -7742563,-8256762,-14768334,-13656260,-23232383,12387166,4498947,14147411,29514390,4302863 },
+  { -13413405,-12407859,20757302,-13801832,14785143,8976368,-5061276,-2144373,17846988,-13971927 },
+ },
+ {
+  { 4600095,-11542827,31329368,14248170,-16883377,6035881,-15994801,12295805,-23011586,7913617 },
+  { 33525016,-12806934,12856974,-1644510,-24067144,-3858086,-29258430,11054825,2905888,4355083 },
+  { -17964763,192692,-9985780,8384890,-28588773,11631513,-23477206,6567645,-19602647,476737 },
+ },
+ {
+  { -23052603,6349008,-10689025,10115406,-15050853,-12161364,31674638,-3861323,-24585169,9756960 },
+  { -17504645,15541868,5187747,-8951455,-7819241,-4114216,-7705832,16750567,13947832,7967822 },
+  { 30410655,9713384,-14515484,38783,-10770080,-6394412,-22140082,-2675238,-11055267,6485636 },
+ },
+ {
+  { 16216966,6267671,20623661,14804291,11012567,-13526100,-8539554,-3190290,-3267787,6646111 },
+  { 7913555,-8961111,-15115097,14819781,12257956,15347494,20606074,-14926229,27709988,6064002 },
+  { 26749405,4843495,-17401959,12552897,32784228,15690826,13783489,-2362124,-16600975,5385403 },
+ },
+ {
+  { 10346599,-476640,-10862894,-11213802,-7409626,11386694,27912709,11780332,-10622439,-1151873 },
+  { -14368516,11729809,-8979461,4324523,1380618,3235999,-2796427,-6292513,6562440,-6112356 },
+  { 7457804,-13484963,5733892,-4539260,-28012359,-1807520,-5223958,12543215,27429848,11816789 },
+ },
+ {
+  { 6171704,6250150,15523910,7588083,4357476,14046191,32053989,-15167575,-14104917,15228519 },
+  { -29143832,4102311,-22500557,-6905997,14905179,-3841636,8065769,-13329198,22354714,7896707 },
+  { 10220768,1065851,-4501841,7429887,-25043100,-15726199,-1545878,10315800,20265524,-5251037 },
+ },
+ {
+  { 478112,9620675,19372907,-10108156,-26096775,5492370,17216566,-7640673,-5293882,2942546 },
+  { -18293739,-5373048,-22107453,-11764691,-20897307,-13559040,-14663084,9449120,27751208,-10068770 },
+  { 30964588,-2829950,31547100,-14713522,-32688295,16698271,-19154185,-15170969,-9488595,2083431 },
+ },
+ {
+  { -4331201,1872950,7933082,8307048,2085449,-3863334,-26684737,-8439420,31382036,-1833307 },
+  { 18633284,-10752705,-33432901,15425579,-9992224,-16015469,21646108,-3619444,-20994239,-16250832 },
+  { 4888147,-1004650,-3749152,-7105465,26762699,-5474948,-4825708,-2638254,-28113704,-4459860 },
+ },
+ {
+  { 27880480,-10894468,-29336964,-13944305,-29657426,-10603716,3720762,8469395,-3107918,-13231240 },
+  { -7749786,6781274,-13967806,6311363,3336707,10208282,31244375,12700856,21709549,-7783804 },
+  { 21878097,3886263,4519283,-9963546,-32091822,-9083915,-21400679,14087228,-16519566,727106 },
+ },
+ {
+  { 19235309,11102817,1622750,10763388,17249145,2507238,14966772,-13199044,1488281,5500178 },
+  { -21897406,-366792,-13954862,-7376201,6671324,-16720312,-26186190,11133983,28575869,7250556 },
+  { 19443910,11307268,16393702,-12878856,26436461,4230368,-11975109,11574390,-17194770,14581734 },
+ },
+ {
+  { 9074105,-157522,21234219,975801,25992577,13670365,22312868,-11241379,10245846,-270898 },
+  { -21965446,-14877841,-16358920,14795633,14852459,1771789,14327713,1239940,-28654705,2439651 },
+  { -2609758,-6511354,12528998,5224355,401125,-2589322,-27804912,-3078845,28570051,12045567 },
+ },
+ {
+  { 22748500,2083728,-4092135,1640334,-12930555,16661331,-28738845,4891914,-159013,2136861 },
+  { 21842188,-4084566,23913091,-5446005,-23483214,-415782,-23294113,623755,-6253576,-10541470 },
+  { -15623859,16002613,-2084455,16065906,-27482628,8182667,-15870155,14654591,-31153334,12835296 },
+ },
+ {
+  { -17925550,6763423,22706144,-4775257,-22840501,-5719270,13600196,14354316,24469649,14182103 },
+  { -13256467,-9141865,24575833,13904658,-22844886,-14562032,23414943,-5564006,-18301039,-5370616 },
+  { -24984379,8166081,32884399,-7176833,26433100,13158336,-17384044,-15010054,-21555397,-5617170 },
+ },
+},
+{
+ {
+  { 19073494,-4037188,-22594853,3100191,-9442162,-11197422,-16689028,-4093733,5601348,10233900 },
+  { 6033336,9711222,19885731,-13869448,-12140687,-16144022,-11316798,13313507,32398080,5470206 },
+  { -7984180,-4091862,25152576,13826189,-33084670,-3069252,-4095445,-15830519,-31898193,6722296 },
+ },
+ {
+  { -24476149,-13841201,-5563725,5192812,20614618,9319711,-3169617,-9007496,19645471,-11264161 },
+  { -15448412,-12956327,8297361,-16338695,26001315,11118805,20972297,-15046251,-6231662,-14424208 },
+  { 26571535,13254858,-31603811,-15423465,32650027,-3348869,-3007991,3994168,26626691,-10612448 },
+ },
+ {
+  { -16018211,319257,7021686,-15328656,-25422132,-9940820,2337136,-3421302,-25677495,-13084288 },
+  { 31112278,12898762,-20090742,-15525725,-20558313,6730956,33270733,815022,-19017024,16368401 },
+  { 30782267,13607481,30927192,-3724204,26318064,13157281,17546828,4467462,14433068,-7834329 },
+ },
+ {
+  { -2244452,-754728,-4597030,-1066309,-6247172,1455299,-21647728,-9214789,-5222701,12650267 },
+  { -9906797,-16070310,21134160,12198166,-27064575,708126,387813,13770293,-19134326,10958663 },
+  { 22470984,12369526,23446014,-5441109,-21520802,-9698723,-11772496,-11574455,-25083830,4271862 },
+ },
+ {
+  { 25571127,-5973985,30041809,-8447599,18688614,601798,-12011510,-3658248,7051663,-15922570 },
+  { -22780671,6963996,2424355,16092707,-12885540,-14339656,19395448,-16582077,3098011,-2409879 },
+  { -6185605,-2575726,26306600,6211099,-13341400,-6625518,32591885,-6298428,30631670,16464263 },
+ },
+ {
+  { 21224834,13940273,-10557586,-15567660,-5918630,-3343459,-9628714,13004579,20459409,-4957543 },
+  { 28703190,14517095,-31180693,-7973421,26305586,-570359,-20624991,9504946,-27344281,-3063413 },
+  { -19923884,-5897464,-2046418,4130469,-14757201,8162914,-18799644,-4803589,27970390,-2138711 },
+ },
+ {
+  { 37789,-873740,-2943662,-727197,4785088,12373847,-28641107,16726163,31107600,-13314555 },
+  { -18432352,-8015697,-3311537,-11413231,-18384795,-1421508,4304964,14270237,14187637,9991613 },
+  { 14853374,15813460,-20085261,2491200,-24420472,13052982,18400987,6087335,-12585806,-13217916 },
+ },
+ {
+  { -25169565,-10053642,-19909332,15361595,-5984358,2159192,75375,-4278529,-32526221,8469673 },
+  { 15854970,4148314,-8893890,7259002,11666551,13824734,-30531198,2697372,24154791,-9460943 },
+  { 15446137,-15806644,29759747,14019369,30811221,-9610191,-31582008,12840104,24913809,9815020 },
+ },
+ {
+  { 641396,10524828,21368180,13457590,5561279,-5076612,-29851909,5443549,-9023691,-12541512 },
+  { -9478184,16650100,26321143,-3860606,-1216358,-9368476,10447898,-11750303,31496417,4930733 },
+  { -30171790,-13615861,-22383584,2921009,-27916455,14953012,-6291358,6380156,-15050576,2577870 },
+ },
+ {
+  { -26352017,-10679244,-22783520,3217855,-23911955,-9261213,7883176,-15092141,-22013755,-2250794 },
+  { 17686040,-8709481,25154489,9674801,-24016313,15169893,4075961,6724552,-5831348,-4813848 },
+  { -6826331,5676773,-29041524,-1094661,31957433,11069627,31462873,-5072714,8407082,14864040 },
+ },
+ {
+  { 25435633,-9132020,18858410,15386898,20654587,885960,-732275,11540202,-19349035,9725890 },
+  { -8465958,14702931,-22393297,7754725,12302396,8178093,-21817440,-11727266,-13411133,7965962 },
+  { 21909566,6139948,-20835584,-3544788,26257179,10567795,4571641,-15827879,14933578,2030007 },
+ },
+ {
+  { -4709286,-5614269,-31841498,-12288893,-14443537,10799414,-9103676,13438769,18735128,9466238 },
+  { 11933045,9281483,5081055,-5183824,-2628162,-4905629,-7727821,-10896103,-22728655,16199064 },
+  { 14576810,379472,-26786533,-8317236,-29426508,-10812974,-102766,1876699,30801119,2164795 },
+ },
+ {
+  { -9796050,7325542,-9094704,-7515764,-31758711,3114024,-11354228,-12058104,-15600714,1510067 },
+  { 28977892,-15825945,3482267,11153228,11080576,-15240228,13465337,12377327,-23351334,11889648 },
+  { -21066088,-160301,32373155,7700663,20323030,9029603,15430317,-15787744,-30090796,12127338 },
+ },
+ {
+  { -18068761,4434245,8956995,-16098194,-13310796,-14589927,-6617189,1001343,29300674,12432123 },
+  { 21593519,14818090,-6096110,9642383,7370068,-2558891,-28476948,-2865282,-31888456,-2559733 },
+  { 22881314,-3437057,32547148,10060717,-6506174,-7987888,-26311530,-836599,-11482389,-11126440 },
+ },
+ {
+  { 25524213,12106105,2479170,-13291944,13111215,-9021711,16244605,-13766081,-552296,-14813810 },
+  { -25657646,-4321809,5233227,16335509,13626752,13795111,-13177618,5275415,33441011,10190019 },
+  { 18149106,8245975,7168399,-98292,18644547,-7822651,-26265789,-14642687,27447709,-15465443 },
+ },
+ {
+  { 15995086,3199873,13672555,13712240,-19378835,-4647646,-13081610,-15496269,-13492807,1268052 },
+  { -10290614,-3659039,-3286592,10948818,23037027,3794475,-3470338,-12600221,-17055369,3565904 },
+  { 29210088,-9419337,-5919792,-4952785,10834811,-13327726,-16512102,-10820713,-27162222,-14030531 },
+ },
+},
+{
+ {
+  { 12274201,-13175547,32627641,-1785326,6736625,13267305,5237659,-5109483,15663516,4035784 },
+  { -2951309,8903985,17349946,601635,-16432815,-4612556,-13732739,-15889334,-22258478,4659091 },
+  { -16916263,-4952973,-30393711,-15158821,20774812,15897498,5736189,15026997,-2178256,-13455585 },
+ },
+ {
+  { -28008380,2647815,-557320,-14434835,19427705,15870322,31787181,-4082468,22278890,6317806 },
+  { -13667269,11157205,5128927,-16632537,-9482053,-6380415,-5071418,-2069913,-14534284,-16673198 },
+  { -33280380,-1122728,-18708174,13874374,32782178,-105835,25547284,10785151,-26078720,14346764 },
+ },
+ {
+  { 28404102,52049,-7531874,15791713,4563283,-1914717,-22192283,7645255,7272963,5569456 },
+  { -11885178,12495860,14100701,-15564294,-3510560,1179316,6061033,16274857,-23308844,11038665 },
+  { 7846267,1583408,29944816,-6032804,-20018262,-2891776,25348686,-13275092,1711992,-1697400 },
+ },
+ {
+  { -14201112,-5815658,23263515,-7142398,18278913,5627820,-26408943,6765544,-30248805,-2144123 },
+  { -28971948,-5050927,14867138,15835556,-626782,2262239,-33194126,-4810459,9241906,-15610919 },
+  { 11375832,10181657,5007665,-1255503,-23668956,-4111883,7766691,11637141,3564243,11636475 },
+ },
+ {
+  { 13678114,11392635,-3180252,940768,27826138,-8512347,-13836860,13372313,31460487,-11418347 },
+  { -9668121,-10137166,-19325517,5801651,28520673,7001128,-21206800,-15130564,12215356,13283791 },
+  { -6229683,-8689109,-29905702,15213420,-4285821,-2058781,424330,-7114702,-25524865,-3551074 },
+ },
+ {
+  { 25622719,6475425,-19000502,-4825715,-25453460,3693811,-15535279,-15059647,-9577091,7842950 },
+  { -25659051,-8166661,3600381,-675936,-18386874,-13280049,-2077427,-2362823,-10927060,9020604 },
+  { 6737791,16017032,-6623060,6450788,16805878,-15888542,-11313305,777007,-12966005,-6340770 },
+ },
+ {
+  { 23748856,-3248479,29019279,-978117,-4260684,-11332407,32615807,8938207,-32758671,-7779808 },
+  { -17269746,1016871,29172119,-11014100,-17527953,-9936304,-27988119,-3537168,16715136,-11252123 },
+  { -15354539,5550208,-21551094,-453447,23631043,15151479,21136638,11750526,9826843,-15744630 },
+ },
+ {
+  { -28419990,-1416873,24102316,-14529035,26731487,1913811,-5837063,-4336319,-14566214,6386410 },
+  { -12655499,-15958340,-5090882,5566744,-26775554,2542258,-24597337,1518118,32425009,3373400 },
+  { 14928705,-5805827,-17837455,-5634115,-17035700,4602756,16940648,-2252724,-9834809,16458858 },
+ },
+ {
+  { 15600596,3337077,10157154,12922387,20102628,3297846,-19300782,7428882,2099888,-13860444 },
+  { 663497,-12797260,-944367,5947415,9422412,14557676,-11489935,15814861,-30785961,-16721306 },
+  { -20747507,-11841971,-29649055,-3803950,1763528,-14074232,-5184816,8879148,24456620,-4474531 },
+ },
+ {
+  { 10698818,-11801108,-23789066,6282064,18449787,-464218,-18979741,-15540503,-7034545,-1474910 },
+  { -8296787,-8530178,-17439788,-3712921,20444833,-1377912,1535073,-6318272,-2023628,5241709 },
+  { -3315807,-10229115,-22877613,810718,-27690110,8930740,-20523753,-11410723,-2799202,14021862 },
+ },
+ {
+  { 23707504,7784122,-6670917,-6970742,-35698,-966120,-18073227,3603438,-32495038,7545579 },
+  { 25671203,-4132674,8931873,-4175763,27404309,8770498,32864676,5255593,23665716,-6611659 },
+  { 16928195,14347314,5535802,-9568339,23187581,14951057,16673412,-7706203,4874381,1858606 },
+ },
+ {
+  { 21756920,-9753338,5449988,-7481556,20307856,-15502688,-30369985,-12835873,-1634313,15349274 },
+  { 12242540,-1566740,-12336168,6350205,-14364280,-8210917,-7446001,-157297,-22388875,11948678 },
+  { 28309867,3364693,-18600469,14920372,-18285911,-10149250,9555145,7065272,3944235,-5834675 },
+ },
+ {
+  { 7179749,-7206639,-16779554,-4824831,-10405553,-15100985,-22148330,-8791375,-1148843,-15160956 },
+  { -31761123,-13968840,19707536,-1669323,-6503989,13949543,18593035,5404457,-31720240,7584665 },
+  { 12233153,-14279925,19301258,6544215,22919448,-9972258,-17915490,8644907,-7618283,13475224 },
+ },
+ {
+  { 4951523,15690522,14880855,8519248,-24390881,9874089,-3572240,7259760,12989831,8402230 },
+  { 26724669,4675512,-30154303,16337449,20792326,3467676,-12788488,13812359,-18558388,-647099 },
+  { 9679678,12276434,-13859823,-658738,16510921,-5905145,24074350,-5072148,23600090,-5930513 },
+ },
+ {
+  { -8711578,-16094447,-32493834,-15284671,-22896670,-7076168,-12865196,4122919,20351640,-14211814 },
+  { -30761704,4731639,21349812,-11519305,-14896421,10306442,-27363911,-16202038,16168704,-9977420 },
+  { -10052307,16024569,8103037,-3679237,-26095358,-5485718,21453194,152536,14505883,-14539994 },
+ },
+ {
+  { -14440190,-3214043,30041968,11753827,32540373,7885479,21494429,-4186953,-27772691,10678751 },
+  { 14556385,-8354790,-8126760,-13076762,-6073244,-11205210,-71666,-385922,20790980,14145741 },
+  { -27426762,10365497,-23982985,303514,26055800,9233714,1544212,10783003,-6067369,15255216 },
+ },
+},
+{
+ {
+  { -8858980,-2219056,28571666,-10155518,-474467,-10105698,-3801496,278095,23440562,-290208 },
+  { 10226241,-5928702,15139956,120818,-14867693,5218603,32937275,11551483,-16571960,-7442864 },
+  { 17932739,-12437276,-24039557,10749060,11316803,7535897,22503767,5561594,-3646624,3898661 },
+ },
+ {
+  { 7749907,-969567,-16339731,-16464,-25018111,15122143,-1573531,7152530,21831162,1245233 },
+  { 26958459,-14658026,4314586,8346991,-5677764,11960072,-32589295,-620035,-30402091,-16716212 },
+  { -12165896,9166947,33491384,13673479,29787085,13096535,6280834,14587357,-22338025,13987525 },
+ },
+ {
+  { -24349909,7778775,21116000,15572597,-4833266,-5357778,-4300898,-5124639,-7469781,-2858068 },
+  { 9681908,-6737123,-31951644,13591838,-6883821,386950,31622781,6439245,-14581012,4091397 },
+  { -8426427,1470727,-28109679,-1596990,3978627,-5123623,-19622683,12092163,29077877,-14741988 },
+ },
+ {
+  { 5269168,-6859726,-13230211,-8020715,25932563,1763552,-5606110,-5505881,-20017847,2357889 },
+  { 32264008,-15407652,-5387735,-1160093,-2091322,-3946900,23104804,-12869908,5727338,189038 },
+  { 14609123,-8954470,-6000566,-16622781,-14577387,-7743898,-26745169,10942115,-25888931,-14884697 },
+ },
+ {
+  { 20513500,5557931,-15604613,7829531,26413943,-2019404,-21378968,7471781,13913677,-5137875 },
+  { -25574376,11967826,29233242,12948236,-6754465,4713227,-8940970,14059180,12878652,8511905 },
+  { -25656801,3393631,-2955415,-7075526,-2250709,9366908,-30223418,6812974,5568676,-3127656 },
+ },
+ {
+  { 11630004,12144454,2116339,13606037,27378885,15676917,-17408753,-13504373,-14395196,8070818 },
+  { 27117696,-10007378,-31282771,-5570088,1127282,12772488,-29845906,10483306,-11552749,-1028714 },
+  { 10637467,-5688064,5674781,1072708,-26343588,-6982302,-1683975,9177853,-27493162,15431203 },
+ },
+ {
+  { 20525145,10892566,-12742472,12779443,-29493034,16150075,-28240519,14943142,-15056790,-7935931 },
+  { -30024462,5626926,-551567,-9981087,753598,11981191,25244767,-3239766,-3356550,9594024 },
+  { -23752644,2636870,-5163910,-10103818,585134,7877383,11345683,-6492290,13352335,-10977084 },
+ },
+ {
+  { -1931799,-5407458,3304649,-12884869,17015806,-4877091,-29783850,-7752482,-13215537,-319204 },
+  { 20239939,6607058,6203985,3483793,-18386976,-779229,-20723742,15077870,-22750759,14523817 },
+  { 27406042,-6041657,27423596,-4497394,4996214,10002360,-28842031,-4545494,-30172742,-4805667 },
+ },
+ {
+  { -11025030,5682633,9525392,1810759,-23289593,-4124447,-14871726,-14478176,24745792,14938388 },
+  { 3334667,-3664312,31850349,1244239,-24197536,-1859222,-7234392,405074,-5912446,8710770 },
+  { -12802819,-5299988,-77855,-16695987,31759716,-6265070,-5276900,-14730428,1043880,2282289 },
+ },
+ {
+  { 28901759,9299043,10998926,5323889,-15565908,14448111,-4949695,-13726216,-30032796,-6301316 },
+  { 8796148,7605546,-9811829,12493901,-19438571,-16339479,25773503,7301419,-3787887,-16169478 },
+  { -23631515,1274400,30630226,-16481525,21113936,4036738,9601133,-7008001,-20890739,-3767219 },
+ },
+ {
+  { 27319357,9721936,-4613620,-3520173,-18188719,-3836506,-4305265,-1178316,-7886746,8982528 },
+  { 9356198,-3029177,32881215,1736171,26179939,5378740,23110079,11924862,18766836,3024186 },
+  { -31652542,-1850137,12716638,-686502,16589913,-5993910,26064585,-7452876,-31644762,-5493474 },
+ },
+ {
+  { -27516337,11363630,29805684,7475890,-5029415,15864023,17647130,7849763,28825940,12085845 },
+  { -15331312,-7654482,5742856,3551572,-20132646,10594578,-23466749,-2271701,11317560,-16017663 },
+  { 3261302,-11152494,-29874016,-3612593,-2283672,7389447,-6935149,-5160746,25748747,4058888 },
+ },
+ {
+  { -7971080,-6272031,-778066,-10065546,-27164065,-9059398,-31414655,16468249,6327623,2010793 },
+  { -6675147,-14042147,18732990,8148450,12884875,3005207,33282805,-4578570,22900820,11228872 },
+  { 22876448,14837242,19336390,-12233346,-6784375,-16080173,23234304,-10528303,22896767,-6758268 },
+ },
+ {
+  { -19670236,-14533720,24645435,4103602,6340365,-16713684,-13121981,-14460443,-12425683,-1341846 },
+  { 21229707,10464351,9178926,2730075,-27050864,16589710,-410044,-130438,22433863,13650160 },
+  { 2798906,15274624,6649131,651358,-17175255,-621194,-11140896,3474004,20185843,-12500110 },
+ },
+ {
+  { 4884566,2924321,-29338749,8926592,-23454530,12348522,-8113331,-15690198,25031751,-13292024 },
+  { -32247859,-14055639,33352672,624930,-22062928,11617980,-28996776,4667636,-14899528,4439764 },
+  { -5600458,8284625,-10831200,-1364515,-7902258,3972340,4444576,6092792,-23379450,-1003272 },
+ },
+ {
+  { 13709443,-5310645,30658614,-13647152,-27739891,14679756,29939045,1891282,27601955,-11772417 },
+  { 6456676,-7170684,-1668316,-1751641,11087586,-6058429,18004340,9296837,27258448,15922863 },
+  { 12181132,-14302828,-21793544,-2222066,16009888,-9772148,-23645078,-12877747,3515930,-1614618 },
+ },
+},
+{
+ {
+  { 22615882,7758979,26919993,9915811,-26236665,-7749685,-12447737,-58302,21424870,-1612162 },
+  { 20038096,-11305584,-16491737,-15976605,30802515,5895106,-25753230,5261453,-28528333,-5224460 },
+  { 6763013,13765978,-13787601,-12458665,14809004,16769926,-29819221,11742263,22770778,12963910 },
+ },
+ {
+  { 21711231,-16012093,26271973,3526118,8119692,1142597,-24864148,-10451213,-31452154,1382966 },
+  { -16550601,-687739,5065324,-4880418,-7847240,-1470289,-24818286,-8440430,9270014,-14909132 },
+  { 20080625,-10917250,30490655,7210668,-12894370,-15146353,-17731974,6968387,18462259,-15308870 },
+ },
+ {
+  { -16191937,10995446,16388152,2978592,-8966808,10742696,-10425367,-16370954,27860305,5652808 },
+  { -22671007,781773,1381250,15312553,-7194557,-6647433,-30299592,50892,12601078,13360121 },
+  { -7271732,15222706,16107540,-3699863,-29339776,-5138987,-7312298,9200467,5434008,7268345 },
+ },
+ {
+  { -17288697,9375896,-23677282,10374474,-22027693,-161800,4589981,2497038,17920358,6412770 },
+  { 9186017,1882711,-7769002,11741429,27738098,15184939,21462049,-2725754,1190574,-8952229 },
+  { -15970161,14138394,-25693621,1427938,-33132767,14483520,9915704,-7437809,-5840242,-10046162 },
+ },
+ {
+  { -25974727,-10793838,33144534,4173158,-23775855,16038131,-18033510,1339653,-4774219,-3200230 },
+  { 18309684,877899,16626648,-13310302,-4239494,-11158192,28942994,-7171156,16468899,-5983074 },
+  { -27723501,5322505,21680991,-13539082,-5234396,-10340930,2883705,2069408,-14289588,-2659728 },
+ },
+ {
+  { -25318116,-4171126,-26450286,5051839,12411739,467475,-19059545,13243119,-24982,-2722782 },
+  { -27997824,16402267,-13503358,-13653881,22358493,1008198,21190189,12053848,9985154,4288142 },
+  { 25845230,14694247,10024949,13402817,6012297,11232440,-13060839,-8426368,11403439,-11434670 },
+ },
+ {
+  { 23805268,5055144,22185329,-7325998,-3976826,3849614,-25019459,13424058,20153458,-12972302 },
+  { -4819752,-2762847,-12922003,-4658466,28843797,8191976,-15219138,-13100954,-14232670,-15206957 },
+  { 31282423,15316710,4904313,9625899,418464,14016530,-32236668,11791249,23148838,1698011 },
+ },
+ {
+  { 11374242,12660715,17861383,-12540833,10935568,1099227,-13886076,-9091740,-27727044,11358504 },
+  { -12730809,10311867,1510375,10778093,-2119455,-9145702,32676003,11149336,-26123651,4985768 },
+  { -19096303,341147,-6197485,-239033,15756973,-8796662,-983043,13794114,-19414307,-15621255 },
+ },
+ {
+  { -28549626,-4952341,-1558713,16449616,-18348829,13073759,-28001328,7930076,-7640965,5368305 },
+  { -18833855,991280,-28809599,3833017,-31080203,1208564,-25348838,-3297559,-5067976,5789003 },
+  { 33495715,5937099,-13364576,-2301004,-20764678,-14598547,-29227720,-8269759,25756876,10317370 },
+ },
+ {
+  { -3044277,2086738,-11996945,-2177249,21844395,-11401917,-13612009,1856793,17961173,-14827756 },
+  { -25914453,-5801387,-23160210,9310464,-8860341,-13601523,-27866948,-1074953,25848162,4389831 },
+  { -22955820,3449689,-19772387,-2926339,-28780948,8565919,-7752703,-7348849,32619486,-8753084 },
+ },
+ {
+  { -15673749,6107825,5547580,10278634,14658572,-13860427,1698242,7553157,-31601292,2154477 },
+  { 17098719,14237577,-28345891,15481963,-18527891,-12550146,13915868,-754396,12319085,3096240 },
+  { -3571823,12786622,-31439623,-8342057,3639354,-4271497,-25523769,-645075,-27794075,-12271130 },
+ },
+ {
+  { 32550464,-6081882,-12322793,7533617,-4917037,-7419035,-26893639,13135145,3848497,-12172930 },
+  { -21786925,9691488,28777301,-11745277,-14434602,-1174387,32842896,-9398560,4813753,-2463180 },
+  { -4469842,-9427414,20711093,8545373,-22727008,-13557943,19939287,3779622,-18679919,13327671 },
+ },
+ {
+  { -11799805,-7186293,16848301,8154761,-3357493,-2346444,-21935549,-2017238,-27374779,-5568970 },
+  { 1946180,6011657,-18230426,11760682,-14059710,53845,1807797,-8925466,8633074,5736944 },
+  { -7610141,8423788,-30366887,-11796882,-4554237,12774080,-18575702,9699006,15429478,-1020669 },
+ },
+ {
+  { 9243707,4382056,-16210659,9730800,-5340904,2406220,9929937,-15276365,30508314,-14521508 },
+  { -28185404,12970738,-22711643,-15280409,-13041678,-14540737,7877048,8925614,-6273896,8699848 },
+  { -11394894,6643304,-4988729,11784083,15895201,-16322077,-33125665,13226163,1082795,-10519217 },
+ },
+ {
+  { -16618235,14397933,-26500706,4239235,-8673064,-5361552,27818876,-4437044,-28759162,11452686 },
+  { -29367507,14859212,-29592624,12820240,27758476,-648400,4430317,-2875856,7725124,-13758641 },
+  { 21012825,-8303407,-15820276,5642865,-21589948,-12006708,24659311,-2459731,30841820,-7393430 },
+ },
+ {
+  { 6490081,11940286,25495923,-7726360,8668373,-8751316,3367603,6970005,-1691065,-9004790 },
+  { 1656497,13457317,15370807,6364910,13605745,8362338,-19174622,-5475723,-16796596,-5031438 },
+  { -22273315,-13524424,-64685,-4334223,-18605636,-10921968,-20571065,-7007978,-99853,-10237333 },
+ },
+},
+{
+ {
+  { 12501286,4044383,-8612957,-13392385,-32430052,5136599,-19230378,-3529697,330070,-3659409 },
+  { 6384877,2899513,17807477,7663917,-2358888,12363165,25366522,-8573892,-271295,12071499 },
+  { -8365515,-4042521,25133448,-4517355,-6211027,2265927,-32769618,1936675,-5159697,3829363 },
+ },
+ {
+  { -12863944,-13219986,-8318266,-11018091,-6810145,-4843894,13475066,-3133972,32674895,13715045 },
+  { 11423335,-5468059,32344216,8962751,24989809,9241752,-13265253,16086212,-28740881,-15642093 },
+  { -1409668,12530728,-6368726,10847387,19531186,-14132160,-11709148,7791794,-27245943,4383347 },
+ },
+ {
+  { 14843095,12054424,-13249219,7986432,18903413,8358874,20873056,12776186,-20109207,13745159 },
+  { -13562002,8931376,32098917,12651175,-6578092,-3706611,19323217,-5017573,18377290,2820170 },
+  { 11538533,-4193833,14048017,-5434360,17351142,-1952916,5655584,-5429011,-16765376,2474768 },
+ },
+ {
+  { 30624416,-13126242,-25953584,418414,-13619589,-10675952,-19780750,-133977,-22060553,12064616 },
+  { -10199003,9477007,10089317,8504039,13126086,-9573819,-25173649,-3230644,17558158,1638976 },
+  { -31724711,-1833290,16865417,-1626396,26770535,-3512281,2769244,-1784691,13565448,10809822 },
+ },
+ {
+  { 24089433,-7417630,-30794289,-12505712,-26212751,5902416,-9857533,566304,-14671484,-9327844 },
+  { -5647902,-11264529,16505867,9968507,21624609,-2772525,-32175654,-3294188,28542174,-12685975 },
+  { 3881623,-12656548,-8535941,8084400,-11719866,-15440336,30578201,10582753,15778735,4565880 },
+ },
+ {
+  { -9398173,5018368,19997586,13282789,153811,3571731,-7587215,-4168217,10372476,-5059022 },
+  { 3713845,-4488198,-24023252,-1241615,7634409,8593439,11309477,7320174,-18227055,-15081090 },
+  { 19473247,-6227160,23680490,-4698236,-8625971,9514552,-30611024,-80348,-14955913,-1119919 },
+ },
+ {
+  { -25314427,13975422,16860974,11926789,15904771,-14688527,-16377204,617164,-12440736,-1986488 },
+  { -18367061,2443873,1664298,4731278,305944,14522804,15749901,493959,22774229,2141430 },
+  { 3518812,-11341710,-12173993,6415970,-8645625,8722162,28345580,-7542133,-31523793,-1743638 },
+ },
+ {
+  { 18870803,-1739352,-21421351,-15365439,-13778108,-11299402,21598286,-9834178,16981576,-12393717 },
+  { -16346986,2595842,3223760,11478824,-22323860,1704264,28019409,-5521154,-15652842,1187792 },
+  { -24491659,-12385790,26429703,10127433,29357889,-9451299,-5790376,11625206,-11285062,-13888177 },
+ },
+ {
+  { -645871,-9774723,9352012,-5027890,-15803494,-4912788,32505997,-15503566,4755846,-9996287 },
+  { 26469404,-7615543,-7393094,14907562,-967568,-15907584,33232711,-12736387,-14960213,-12535954 },
+  { -14669745,-7885691,1957824,10652035,-24030167,-6268802,-30571725,-9124911,13855214,-15367707 },
+ },
+ {
+  { -15036198,-7249981,-12919532,6944155,-4449478,-6766895,7856874,-9088030,-4148787,603210 },
+  { -23032350,-15919045,-21481921,-16498913,3442190,5329611,-15493773,-3030337,-13530605,8505048 },
+  { 9598244,-13811679,7009441,-7029192,-7546673,9639252,-23199380,10083413,-10590939,7622661 },
+ },
+ {
+  { -6950579,12113815,-26268980,-15176405,-20362355,-2135943,-20644649,-14214373,-28529669,14049437 },
+  { -26054599,11589504,10587370,8658397,-7574196,8957875,12419676,952740,29895159,-3800612 },
+  { 29979475,14236855,28240219,2218374,1293716,10869584,-25838466,-797012,12482288,-4342793 },
+ },
+ {
+  { -4107564,-12040502,-20498463,5105880,24840609,7318424,26629447,-16249919,30739409,1389103 },
+  { -13435015,-8441977,32732045,16260520,-5384278,517639,-23775690,-14606434,22353688,13910451 },
+  { 30345040,2902983,5162772,-14827595,19759779,-12562534,-19524886,4538331,31805532,-3432267 },
+ },
+ {
+  { 7715142,-2536869,-17101189,-3944983,-29806023,-13361018,6034702,-2469604,-1376922,6142468 },
+  { -9703473,7532075,29742076,-518807,-14647502,-14147486,-3222826,-4223761,-21409127,6714128 },
+  { 8993562,-728206,16743299,-3628464,3123794,-3062882,14212156,-14210723,21258117,2008182 },
+ },
+ {
+  { 21433,9345223,-3433525,610177,12759771,-7941207,30640141,-8644810,21411690,15420189 },
+  { 7469040,-2803587,-31400455,4807392,2099339,15272327,-9237612,-7913265,6075105,-10093933 },
+  { -12324625,-9797469,13124713,2993704,-21520787,-7384625,-21089636,-9164479,27356476,12375799 },
+ },
+ {
+  { 21361608,-3391169,32558130,2960769,-9327499,-14201530,3453838,7688534,32773851,923498 },
+  { -14259177,10158852,12754864,-4626572,16858888,-2705616,-4181905,-13069106,24726160,11903553 },
+  { -11056011,-331901,7295489,-4816105,11452677,-12970075,-33399438,-11780490,17734397,5351152 },
+ },
+ {
+  { 24583426,7569242,-30425061,7038944,17041883,11611847,-23579122,-15980151,23229697,10575612 },
+  { 14173403,14311420,23670113,15125454,-18068511,-2486496,-23010463,4340309,-23753497,-1183599 },
+  { 16869553,6557632,-33508380,10353713,-10623105,-1372388,24588191,1741860,11830688,-12306463 },
+ },
+},
+{
+ {
+  { -28172399,1658246,-4767066,-3886846,26752027,6228089,12901930,16123303,-17330499,-13808625 },
+  { -30881170,-11597196,19381794,517552,-18133739,15347008,20409297,-15254296,15007530,2276981 },
+  { -21185048,2732272,30486111,5693908,20725545,-4202630,15365220,-2691595,-25577947,3620022 },
+ },
+ {
+  { -28970898,5271447,-1266009,-9736989,-12455236,16732599,-4862407,-4906449,27193557,6245191 },
+  { -15193956,5362278,-1783893,2695834,4960227,12840725,23061898,3260492,22510453,8577507 },
+  { -12632451,11257346,-32692994,13548177,-721004,10879011,31168030,13952092,-29571492,-3635906 },
+ },
+ {
+  { -22245613,-3090218,33356233,-16610409,16168822,4826668,-18643830,-4589720,-21999066,11122552 },
+  { -19371531,-12521474,8009131,5951832,-29730290,8053192,-23956861,2697344,-5489254,3884524 },
+  { 5434515,-16658051,-19436012,-5749816,18624391,7976744,-16725148,1265271,25239122,-16088357 },
+ },
+ {
+  { 3877321,-9572739,32416692,5405324,-11004407,-13656635,3759769,11935320,5611860,8164018 },
+  { -16275802,14667797,15906460,12155291,-22111149,-9039718,32003002,-8832289,5773085,-8422109 },
+  { -23788118,-8254300,1950875,8937633,18686727,16459170,-905725,12376320,31632953,190926 },
+ },
+ {
+  { -11873070,-11903583,-12978837,13754373,1734532,-6413244,31297869,11060757,13777512,-7476594 },
+  { 27439962,11906700,-7222249,-3510568,-15123804,13129935,-21720799,3532253,-13089009,-1908479 },
+  { 28057081,3801878,22292017,1021217,2857384,-6668261,7666803,-14526744,18620848,3559331 },
+ },
+ {
+  { -24593607,-16138885,-8423991,13378746,14162407,6901328,-8288749,4508564,-25341555,-3627528 },
+  { 8884438,-5884009,6023974,10104341,-6881569,-4941533,18722941,-14786005,-1672488,827625 },
+  { -32720583,-16289296,-32503547,7101210,13354605,2659080,-1800575,-14108036,-24878478,1541286 },
+ },
+ {
+  { 31128978,704253,-10034493,4770947,-33159327,-13151793,15055520,-15623398,-11313293,-1578851 },
+  { 13322748,-107070,-1165392,2708272,-8986699,13435986,24070967,-1151785,26852280,5013379 },
+  { 843131,4449693,-373566,-4191860,25476744,-14210854,4911137,-2923026,26765970,-8741776 },
+ },
+ {
+  { 2901347,-1117687,3880376,-10059388,-17620940,-3612781,-21802117,-3567481,20456845,-1885033 },
+  { 27019610,12299467,-13658288,-1603234,-12861660,-4861471,-19540150,-5016058,29439641,15138866 },
+  { 21536104,-6626420,-32447818,-10690208,-22408077,5175814,-5420040,-16361163,7779328,109896 },
+ },
+ {
+  { 16313060,-3109924,32693258,2218038,14039229,3629327,-3371271,7008188,5432775,-2912557 },
+  { 13123502,-15852902,21886331,-15267653,-30596814,-12599448,2743789,8889586,-23985605,1358838 },
+  { 1122173,3537823,-31012230,-5844610,9280619,-5918839,400338,8753255,-3717222,3435707 },
+ },
+ {
+  { 30279744,14648750,-8044871,6425558,13639621,-743509,28698390,12180118,23177719,-554075 },
+  { 26572847,3405927,-31701700,12890905,-19265668,5335866,-6493768,2378492,4439158,-13279347 },
+  { -22716706,3489070,-9225266,-332753,18875722,-1140095,14819434,-12731527,-17717757,-5461437 },
+ },
+ {
+  { -3927007,7040881,-17421390,-1610753,30737401,-3903730,-16103142,14384696,-1703423,13386343 },
+  { -26265871,1760992,24462067,-1423778,18867340,12144073,21511889,-16723635,28117147,-3876872 },
+  { -30148658,2661313,28117380,-8941936,21579083,-15041432,28578294,-3422281,-192765,-16553317 },
+ },
+ {
+  { -5056483,16566551,15953661,3767752,-10436499,15627060,-820954,2177225,8550082,-15114165 },
+  { -18473302,16596775,-381660,15663611,22860960,15585581,-27844109,-3582739,-23260460,-8428588 },
+  { -32480551,15707275,-8205912,-5652081,29464558,2713815,-22725137,15860482,-21902570,1494193 },
+ },
+ {
+  { -11010600,-13801616,-17422840,-3471578,4610202,-1363875,-27525764,-13276674,28980855,-15820700 },
+  { 1688077,7409046,-15261711,5307665,30509755,8976487,15868958,-6861205,12529284,-3409819 },
+  { -32761281,-2867669,-22777777,-6061741,3936868,-8512698,1622772,6969145,-21705186,2137613 },
+ },
+ {
+  { -19562091,-14087393,-25583872,-9299552,13127842,759709,21923482,16529112,8742704,12967017 },
+  { -28464899,1553205,32536856,-10473729,-24691605,-406174,-8914625,-2933896,-29903758,15553883 },
+  { 21877909,3230008,9881174,10539357,-4797115,2841332,11543572,14513274,19375923,-12647961 },
+ },
+ {
+  { 4840461,-7133808,18429570,-2930780,13891012,-15044185,-2384164,-9763313,8979099,-752831 },
+  { 14347773,-4700432,7094179,1549487,6381415,-9628903,8959096,-4588380,-19679609,7043995 },
+  { -31116752,15430787,16922830,-14686109,26031991,-2878383,15308393,-13588740,-9835351,8069760 },
+ },
+ {
+  { 8832269,-14495485,13253511,5137575,5037871,4078777,24880818,-6222716,2862653,9455043 },
+  { 29306751,5123106,20245049,-14149889,9592566,8447059,-2077124,-2990080,15511449,4789663 },
+  { -20679756,7004547,8824831,-9434977,-4045704,-3750736,-5754762,108893,23513200,16652362 },
+ },
+},
+{
+ {
+  { -7570426,-524391,20097620,-16661414,-8606086,-5438902,-2513010,10337285,10198951,-1104705 },
+  { -6980636,-15417090,2662804,-16317394,-24179607,8716369,17742056,5985806,15380671,2812132 },
+  { 1759737,-275552,-12102669,10734975,-32659979,-10917039,-10879009,-14934751,-8530948,629933 },
+ },
+ {
+  { 25995253,15321678,20676051,-13905342,-5344615,12928226,26535743,5834045,32469870,9220744 },
+  { -32995849,11707082,25397526,-10218086,-24075856,-684171,-15920372,5550704,12235466,-3115905 },
+  { 20957975,5279561,23238636,-11021873,2228468,5359535,-16683060,2719281,-33251788,1049551 },
+ },
+ {
+  { 7240454,15271080,11273695,2712681,5348885,8032711,-7735829,-4293645,7428075,13241387 },
+  { -27146917,-8315473,-18688646,12461725,14323547,14167305,19720948,14642646,-23573131,3294684 },
+  { -13145624,695982,29721039,-3953268,1212790,-3347743,19469174,-16513750,3686075,3532094 },
+ },
+ {
+  { -6102612,-15517206,-15274115,-534898,17071973,-10519397,-28251257,-10304793,-30207362,3511881 },
+  { -32172300,-8555800,29933543,8070229,-4587153,-12935436,-6416931,14179867,-14546646,2485296 },
+  { 27907910,15385928,-10176367,-11095850,-23393364,13320966,-30011805,-11735988,-22462796,-56256 },
+ },
+ {
+  { 8172112,-545433,645285,-11888318,-27963834,13577339,29966526,-12436792,-21004912,-5003785 },
+  { -10725063,3964808,25067649,15849772,6962365,-3729815,11063679,15714325,20748469,-6921286 },
+  { -17316702,-9815740,10896567,9140583,-5406512,-12720840,-5719565,-10454851,-32980692,-3389825 },
+ },
+ {
+  { 32798541,-9546936,-18551031,-10238786,-16938042,5657132,2875422,4345059,19486241,15948449 },
+  { -940853,304405,-17760858,5130154,-17590137,12511162,26577308,5349209,11135620,12621286 },
+  { -18044519,-13130609,2484222,202566,-17389204,9997023,13565515,445687,-24828319,16599809 },
+ },
+ {
+  { -20703546,3139196,-20041141,12406424,-21878464,14591148,-22751861,11349075,29986961,1524641 },
+  { -32288295,11084683,-25493507,10998779,10586397,-8200719,30732987,-7659157,12216683,-8191935 },
+  { -23282025,-8910792,32407716,11905118,-1564687,-15605914,-25800824,-3561742,-23414418,14292210 },
+ },
+ {
+  { -20584495,15739967,-6829946,2777159,29961914,9932699,19292707,-451010,-19519450,-14144514 },
+  { 15964992,7223198,-12744997,-7519682,33360822,-4374562,-26678467,-3316604,-20369475,-5652160 },
+  { 17388308,-71784,-27321053,10491141,-16512130,6691084,15825661,-3737631,-1176112,-6274009 },
+ },
+ {
+  { -2237861,11927939,-26760468,10020,-6525174,2716204,-7731368,6273350,11082172,5231661 },
+  { -9128308,13990339,22973692,-485471,5989278,7671110,7495423,-11381135,24255760,-3789653 },
+  { 29610480,-1596339,25810156,8089313,-29462764,-16341970,-26854287,-12622283,-24329099,3580658 },
+ },
+ {
+  { 4051816,-14074016,-22331714,11688225,-8901927,-7913251,-19553769,-5062204,-25404291,-3382785 },
+  { 8151704,9205666,17521223,4921459,11298819,-7084404,-23676578,15205662,-2453788,-7820682 },
+  { 11026945,330433,10006680,5592054,32891395,-15510005,27435628,-5191943,-27943253,15069893 },
+ },
+ {
+  { 13736861,11131089,-8380938,-2888802,-26441889,9652636,30871832,-10916755,18927872,-6105542 },
+  { 22181393,4393920,17169659,-8398385,31675704,-7983102,24394223,15475343,19291340,12064950 },
+  { 21435560,13294936,-26731259,-5536218,24877410,-5746784,-22244895,8607541,23465514,2373828 },
+ },
+ {
+  { -1944923,12919569,30734257,-12450012,-19827681,-13309084,-11816616,-7255404,-14392601,-10707248 },
+  { -11964089,1451880,7927972,-14247679,-3059297,-14547935,-9810248,-4248712,-13755475,8384832 },
+  { 26033805,12538621,-10765263,7597377,1870144,4707929,18559562,11102131,-6650109,-13915017 },
+ },
+ {
+  { 32152332,-526383,19452709,-5494869,-18266859,-14104009,2043844,2420728,-28710784,11441387 },
+  { -31944923,10563798,25388369,-13741698,-28515362,3784542,33305070,-11108317,1579218,3306223 },
+  { -13075977,-6879163,11156382,-14684916,-19616141,13766547,22374656,-3105781,-2090020,10823745 },
+ },
+ {
+  { 4802618,15611045,-21672380,15149769,18727715,-676083,7038874,-8396987,4291962,-8699178 },
+  { -1118195,5583658,33537736,-4184316,4081762,15942418,-4988004,-16346650,4521091,3569312 },
+  { 3817807,-7065289,-581440,5481936,-22429944,-16647995,11755323,2403523,4798248,12876271 },
+ },
+ {
+  { 3687165,-15558344,12606146,-16077355,12807275,-2445908,-6774543,-13292136,-16282523,-381475 },
+  { -28385782,3979177,-15242576,12710403,27669440,-4455289,13267131,11151486,-8014887,1628153 },
+  { 9601415,2681644,-398339,-12173272,2811053,-11064092,3564545,6929145,14859091,-9610855 },
+ },
+ {
+  { -33256173,4144782,-4476029,-6579123,10770039,-7155542,-6650416,-12936300,-18319198,10212860 },
+  { 2756081,8598110,7383731,-6859892,22312759,-1105012,21179801,2600940,-9988298,-12506466 },
+  { -24645692,13317462,-30449259,-15653928,21365574,-10869657,11344424,864440,-2499677,-16710063 },
+ },
+},
+{
+ {
+  { -26432803,6148329,-17184412,-14474154,18782929,-275997,-22561534,211300,2719757,4940997 },
+  { -1323882,3911313,-6948744,14759765,-30027150,7851207,21690126,8518463,26699843,5276295 },
+  { -13149873,-6429067,9396249,365013,24703301,-10488939,1321586,149635,-15452774,7159369 },
+ },
+ {
+  { 4377756,8115836,24567078,15495314,11625074,13064599,7390551,10589625,10838060,-15420424 },
+  { -19342404,867880,9277171,-3218459,-14431572,-1986443,19295826,-15796950,6378260,699185 },
+  { 7895026,4057113,-7081772,-13077756,-17886831,-323126,-716039,15693155,-5045064,-13373962 },
+ },
+ {
+  { -11229439,11243796,-17054270,-8040865,-788228,-8167967,-3897669,11180504,-23169516,7733644 },
+  { 17800790,-14036179,-27000429,-11766671,23887827,3149671,23466177,-10538171,10322027,15313801 },
+  { 26246234,11968874,32263343,-5468728,6830755,-13323031,-15794704,-101982,-24449242,10890804 },
+ },
+ {
+  { 32988917,-9603412,12499366,7910787,-10617257,-11931514,-7342816,-9985397,-32349517,7392473 },
+  { -8855661,15927861,9866406,-3649411,-2396914,-16655781,-30409476,-9134995,25112947,-2926644 },
+  { -2504044,-436966,25621774,-5678772,15085042,-5479877,-24884878,-13526194,5537438,-13914319 },
+ },
+ {
+  { -26137908,4422622,12520997,6114481,29633697,-2438368,-23716416,1194800,23588828,7738551 },
+  { -30125681,10203859,-25972257,-10522975,17612803,-11796736,20746446,-4055687,-25217137,5207173 },
+  { 2346821,11632359,-7700249,9503425,-26008542,13426164,-22273013,-13366259,-29010444,-3469966 },
+ },
+ {
+  { 24008528,-11272994,-74973,-10893336,-496950,-9736234,-21609619,-8901889,9261391,6521631 },
+  { 14257158,6197940,19941061,5058127,8037203,3014965,-24145136,11311329,4470280,-1737699 },
+  { 13612887,11088315,-9663414,-10541404,-8912648,10666697,10488169,-1954138,11190630,1072923 },
+ },
+ {
+  { -192860,1965711,-23601895,8846839,-5453292,13820452,15608253,-1054818,27922713,-6678336 },
+  { 4603204,13426583,28779957,-6282552,7456485,14937817,19938597,1500987,33094040,-479235 },
+  { 17409763,-6847523,-27796627,-2779568,-25127437,773304,27196294,11902077,24460223,14785734 },
+ },
+ {
+  { 5874757,7110952,27386301,-11380547,-8031533,-8796840,32909584,-16548809,-6486255,10014663 },
+  { 30546551,-2712447,-23426461,-15295030,-20774639,-10622243,16328175,-944709,-26611440,1916188 },
+  { 25925923,13655488,2627647,14901375,-23353213,-11221248,16380834,1006284,-26273228,-8704564 },
+ },
+ {
+  { 23807618,-12641972,-3732440,1686986,-5996965,-13777625,13697069,10382514,4406161,-12405444 },
+  { 4343219,-1125691,850574,4873586,-3230459,14033160,-11302291,5555044,-2148298,6634240 },
+  { -25794680,-5881594,13945731,-7857197,31222398,4281063,18696733,-9912087,24945378,-11289369 },
+ },
+ {
+  { 18603149,8531621,-27678958,-7948846,12158002,12961748,-24795492,-16643892,26030426,-8607933 },
+  { 15454618,-16425862,28308341,10770722,-31388885,-4966084,20952255,7633956,31206949,-16746119 },
+  { 20638954,3369314,-30779833,-12048841,7465354,4035635,-28701633,-13151051,-11687815,-12114667 },
+ },
+ {
+  { 13463296,-11245547,-29954164,14244733,-18154935,8271005,-24292731,-5225812,16306014,9459234 },
+  { 6448573,3088387,-26154429,-8485188,-9208853,3516820,10549309,-1909314,-23564393,-3414459 },
+  { 8719986,-2424627,-15802147,9334883,13211976,-1829229,-14012547,-10161199,-25141198,-5885752 },
+ },
+ {
+  { -2349892,11734760,12828281,14891979,-25571076,-15830577,-26431521,-10561506,-18880609,-16188989 },
+  { -28321009,15861961,7920146,-1566939,-8444740,-15744230,-10405127,-10565799,8780324,-5709548 },
+  { -30305863,-6621133,10593535,15998361,-25048870,-5042076,-18602487,-4740020,-10582750,-5847317 },
+ },
+ {
+  { -3296251,-16261988,27735525,749045,11699995,14790421,-6729225,-653615,20840119,3185796 },
+  { 17990928,-8688779,-6445089,-14041213,15800827,-9750908,21898588,-2581095,4289925,-13609229 },
+  { -18702250,9105867,-17502218,13528117,408172,15271055,-3541402,-7046464,20273995,16278772 },
+ },
+ {
+  { -18563479,10647583,-12854783,12914687,-8283081,14059741,28416475,14469421,7213660,-12791626 },
+  { -17661101,3578396,-11608775,2439715,11453766,5554793,-2952683,1396979,14409228,6036729 },
+  { -30391511,-15594700,22783857,2230758,-7144052,12345942,3154644,8677733,5345744,-8928301 },
+ },
+ {
+  { -12553342,1008813,-31889062,-9239347,-6426114,-15179705,30585555,-4044382,1315433,-2119071 },
+  { -7219545,-6419257,29557012,-3163454,977573,-3629061,-16430167,8990168,4605147,-7017819 },
+  { 32529233,7039141,-32236437,9522039,11290271,9118665,8756045,-10563521,-6254731,-3223593 },
+ },
+ {
+  { 15231383,12075450,-26181667,-211323,-27161394,453616,2361173,5902990,26037340,929186 },
+  { -27657394,-9910583,10876067,12148310,2458574,-13347637,-23595449,212407,-32749716,14727325 },
+  { -20033370,7423843,19471986,-3313303,12913475,-14366080,-22213312,-2811030,11899473,8829674 },
+ },
+},
+{
+ {
+  { 7337550,5873052,10988340,15232053,4384079,6032278,7402343,-7533815,-26138751,11939300 },
+  { -119159,-14583143,-27421804,8942753,-17273154,16514684,30754115,-9596433,33487209,4113918 },
+  { -3960789,-9335892,15011643,9719616,31254661,-16703303,24322161,-11683727,-15224142,2537614 },
+ },
+ {
+  { -678578,-12898735,29248392,15218180,-26007912,-7777208,20041027,-345609,-25108726,-9825940 },
+  { 28422467,-8382679,28591009,-3932530,28651951,-196633,-20235478,-2839073,-24371998,2486440 },
+  { 32216266,6254487,-7796323,-3906683,14893713,-9842537,-9999791,16283784,-33192,2640168 },
+ },
+ {
+  { 17278281,13024003,18975539,8663460,31955995,8256379,-31534884,-8322269,-31927111,-5643302 },
+  { 13689985,103296,-15508309,7783930,17321065,-3055474,-15436357,2963324,17990801,13444833 },
+  { 5480859,3913672,-48394,5871705,32596833,-5579228,32357847,2012618,-28862580,13899423 },
+ },
+ {
+  { -11225584,2320285,-9584280,10149187,-33444663,5808648,-14876251,-1729667,31234590,6090599 },
+  { -9633316,116426,26083934,2897444,-6364437,-2688086,609721,15878753,-6970405,-9034768 },
+  { -27757857,247744,-15194774,-9002551,23288161,-10011936,-23869595,6503646,20650474,1804084 },
+ },
+ {
+  { -7927624,8517204,17449040,876144,-1082587,-13435235,-7287236,5101860,31632326,7802391 },
+  { -6678993,-11183427,-19945483,-15103523,28588002,-10419114,28132155,324767,23359119,-8687572 },
+  { -17877079,-4886626,-552924,1820912,-15113006,14941513,31762257,551158,16825814,-16408586 },
+ },
+ {
+  { -24607839,-10664789,-2222456,-6069163,-16317947,-4632983,-22697359,-13908046,-6061820,-6987228 },
+  { -26197424,5363699,-27767315,641979,22168344,-14817900,-3399021,-6551236,-22639075,-8186989 },
+  { 11810905,16424036,-15497117,-3216280,7175490,9881952,2230646,-14471445,-23323343,-6218253 },
+ },
+ {
+  { -26664093,8738483,-24989677,10842183,-22409739,-4980558,-26126214,-5115723,-22882043,11979818 },
+  { -6935402,-6451083,19949530,-2073634,-12312727,16230259,-24324414,9666847,-11374,11000636 },
+  { -22554183,-14223040,29703046,7661989,-20997457,-16531593,31688803,7921971,-30280482,-9667424 },
+ },
+ {
+  { -27589786,15456424,8972517,8469608,15640622,4439847,3121995,-10329713,27842616,-202328 },
+  { -15306973,2839644,22530074,10026331,4602058,5048462,28248656,5031932,-11375082,12714369 },
+  { 20807691,-7270825,29286141,11421711,-27876523,-13868230,-21227475,1035546,-19733229,12796920 },
+ },
+ {
+  { 10596787,-5136883,-31681802,-10402323,12288807,7058279,22566420,-9647834,-27673288,-13632983 },
+  { -25473577,-8494034,17733282,35286,30143994,5200388,24233528,-4579445,-5705781,12778141 },
+  { -14974188,1530156,-8022489,10503549,-5912584,-6409993,-650857,-155086,22395066,-7386441 },
+ },
+ {
+  { -16876905,5489568,-9362937,4973196,-21504257,9730739,-30076661,7053705,-27690901,8504819 },
+  { 20084352,-3565798,10796020,-6846844,-11325871,-9135063,-29578159,6305995,-19441972,278528 },
+  { -29370154,7217291,-17029715,-8927548,-5144061,12687919,18018479,1555332,-12355183,2688287 },
+ },
+ {
+  { 31886748,1403596,-26085788,5192869,-11674933,-2220301,-32371500,-2890961,25657906,-16641275 },
+  { -1042714,-585056,-32391648,2504239,-29747902,12676835,-33223707,-13675799,6353339,-4434833 },
+  { -1179441,-7803479,-5314670,-7629870,-8062295,-692404,-19213790,-12125023,19586154,-14679848 },
+ },
+ {
+  { 12076899,-14301286,-8785001,-11848922,-25012791,16400684,-17591495,-12899438,3480665,-15182815 },
+  { -32361549,5457597,28548107,7833186,7303070,-11953545,-24363064,-15921875,-33374054,2771025 },
+  { -21389266,421932,26597266,6860826,22486084,-6737172,-17137485,-4210226,-24552282,15673397 },
+ },
+ {
+  { -4644496,-4707481,15413722,-1890989,-30719114,-1016857,24171479,13914687,30151988,-734555 },
+  { -18062448,-3096663,-23457563,6053130,-20159744,15175476,-16804149,-8435129,31402397,13412958 },
+  { -4067034,-10550967,-3394218,12067499,-14615944,1961217,9218632,16058157,-4491694,16742078 },
+ },
+ {
+  { -19039466,-105803,20473734,-4333051,-16644992,9546497,12717651,-7405437,33326511,-10589653 },
+  { 7310357,16380699,-30667759,-10590014,-29946398,8958541,3633435,-7259521,25445905,-12034452 },
+  { 24977330,15467472,-17715207,10543181,21949195,-10064750,2612028,-3583299,-30509133,386162 },
+ },
+ {
+  { -23656682,15010141,19449987,-14711483,1616689,4346488,-21448186,-4306507,-18243124,3776928 },
+  { -497018,-4383046,-29089158,1762737,12930884,3724377,31854608,-10335708,-14939678,15794315 },
+  { -29923746,-13855609,9692171,6485890,31371904,3689,-3816329,-16051048,-23895868,-8761323 },
+ },
+ {
+  { -20184622,2338216,19788685,-9620956,-4001265,-8740893,-20271184,4733254,3727144,-12934448 },
+  { 6120119,814863,-11794402,-622716,6812205,-15747771,2019594,7975683,31123697,-10958981 },
+  { 30069250,-11435332,30434654,2958439,18399564,-976289,12296869,9204260,-16432438,9648165 },
+ },
+},
+{
+ {
+  { 30374239,1595580,-16884039,13186931,4600344,406904,9585294,-400668,31375464,14369965 },
+  { -14370654,-7772529,1510301,6434173,-18784789,-6262728,32732230,-13108839,17901441,16011505 },
+  { 18171223,-11934626,-12500402,15197122,-11038147,-15230035,-19172240,-16046376,8764035,12309598 },
+ },
+ {
+  { 7184873,-15884065,-4733995,-8847922,-1636825,6148438,65127,-3521018,32228732,10657574 },
+  { 18746717,-11476172,-27193064,6954600,12791172,-7111732,17243081,4299795,28465943,-15375283 },
+  { 13737629,-10164614,8386336,6074657,-29227449,-3718492,10775460,9999959,-26378316,14666953 },
+ },
+ {
+  { -32066820,-10108139,27008061,15734497,-85484,11878647,-26811738,1961453,276157,-2883343 },
+  { -31766380,-3431729,-32336619,2521432,-3697791,-12748354,1943438,-13726237,-21186193,6229960 },
+  { 22819205,-7576590,-8321997,-4987240,-32025703,-15189908,-30198783,4945477,3450265,-16311997 },
+ },
+ {
+  { 2208029,4805874,3925618,1183512,26981643,4334333,-1701752,13754574,1841441,12708077 },
+  { 23031304,-6170131,-12566090,-6629118,19467983,11504761,19740480,16022638,18286074,4057599 },
+  { -21668621,14107100,-28618275,-176019,12522715,11978472,12683246,-1419312,5777339,-11161151 },
+ },
+ {
+  { -23589198,406967,-6320767,16700591,20801285,-2621229,1447442,3957137,-31157639,-9433823 },
+  { 285922,4747513,-3768326,-1447639,21622518,-10582720,-14882160,-15052127,-15809118,-9148002 },
+  { -10117352,16697470,18291462,-342821,23368200,11141172,-10894694,-7462302,29533508,8009347 },
+ },
+ {
+  { -769018,14942347,-22636759,-525178,-22065010,16280891,5550205,-2330944,28058403,12392111 },
+  { -18229046,13917377,-23260731,-11983815,-7367542,11100342,-2180186,-4900950,27025099,-4379386 },
+  { 15698557,-2997070,30133302,-909349,-6930796,-2873392,-1691976,4028086,-25042463,-5681587 },
+ },
+ {
+  { 7689650,-16517666,-6755408,-2906910,32229460,-9055281,16015019,-11614325,9123609,16675512 },
+  { -8965234,-16311488,-33411437,-2577782,-11151669,2706548,16479626,-4333404,-20622975,2602115 },
+  { -14469960,710942,2172786,-13079377,-26781077,8305933,32377663,-9052736,22409606,-8146522 },
+ },
+ {
+  { 9716706,-4112507,-4529664,13382375,21965595,-14757449,2982314,7579175,-3486448,-10413430 },
+  { 30535305,9719401,19996283,-1573733,-33221354,14780613,18347648,-12081172,22919350,4015328 },
+  { -21985513,-9213176,20417023,11306903,27239114,-8717671,10333970,-15316863,-19369844,3474736 },
+ },
+ {
+  { -18947321,14189316,-7694585,-10371107,-19693207,2248827,-2297590,-7220887,9627793,15272084 },
+  { -9959133,-7748348,8176500,13548024,3865755,4239429,-13156828,1433393,923944,-3326456 },
+  { -13145962,-1036900,14518595,9089128,-32129919,-10964018,-2945758,5691566,-14252266,15582264 },
+ },
+ {
+  { 21678587,1746058,16240689,3058346,9197741,-9348733,-2219518,8401562,28390588,-12341697 },
+  { 17724937,-6252161,14744055,-12198777,-7246599,-447365,22310736,6008392,1651488,-6198072 },
+  { -21810976,-3165770,33437719,3709309,-32272096,10870498,28944738,5918309,-15030323,-9047564 },
+ },
+ {
+  { -11953458,-13873233,-6611294,2379898,31182221,-3065380,4253595,-15419644,-33178512,16697751 },
+  { 22469852,-12672196,3505855,6197687,13377651,9838342,15450798,-5078928,-21789731,-1116877 },
+  { 22835413,-2950895,770218,14427006,5861131,15502682,-26294213,-1170565,-10362096,-5486043 },
+ },
+ {
+  { -9198219,4214695,14427770,12207969,-28740675,-12156839,-26015121,8852736,21096874,-1915925 },
+  { -28659806,13742047,-25020953,-10327545,-18998248,8132068,-7981723,-5660118,-22375286,16570687 },
+  { 17151112,-5698437,-7350293,-10165685,-23801958,-826085,-23734332,-7963379,367975,591360 },
+ },
+ {
+  { -1440795,13953323,32608381,-16731170,32569365,15061461,-3319145,15391755,6411850,8856301 },
+  { -6283484,-5717448,-30852525,-13886398,-11444742,-13439755,-962250,-984718,16980037,13220496 },
+  { 5806348,-11716984,31485217,10950107,20662314,-4659588,29140108,2024112,-6897120,-198031 },
+ },
+ {
+  { -13047276,-12378252,-11090681,365708,32617327,-9403657,-1581245,3937693,-21353062,-13328105 },
+  { -8758281,1965993,30865878,1518895,-9596740,-15568711,-9936220,5478493,22253125,-14825767 },
+  { 7368945,14678033,-17041558,1797803,-13722351,56268,-19815525,16718455,-26238979,-13915408 },
+ },
+ {
+  { 33085337,16018715,-7471092,6277004,14006424,13260123,-24911427,-9280938,27172028,2462930 },
+  { 21341068,574157,-16265645,-14785602,801086,-10226805,14444870,5617063,-9150435,15300767 },
+  { 7771719,8677494,22442316,13352980,-31350870,11065636,-13279488,-2957119,-28102362,-641318 },
+ },
+ {
+  { 11127026,5058353,29814084,14964337,-1055756,-15621957,24216141,-9191423,-32064374,1161450 },
+  { 14219148,288656,29501638,2745224,-25138577,-15671942,-23751995,10266894,-12734414,7975199 },
+  { 3737297,-7008068,-3849571,10951446,19400309,-4050745,-26216889,12815642,-330056,-791047 },
+ },
+},
+{
+ {
+  { 5975908,-5243188,-19459362,-9681747,-11541277,14015782,-23665757,1228319,17544096,-10593782 },
+  { 5811932,-1715293,3442887,-2269310,-18367348,-8359541,-18044043,-15410127,-5565381,12348900 },
+  { -31399660,11407555,25755363,6891399,-3256938,14872274,-24849353,8141295,-10632534,-585479 },
+ },
+ {
+  { -12675304,694026,-5076145,13300344,14015258,-14451394,-9698672,-11329050,30944593,1130208 },
+  { 8247766,-6710942,-26562381,-7709309,-14401939,-14648910,4652152,2488540,23550156,-271232 },
+  { 17294316,-3788438,7026748,15626851,22990044,113481,2267737,-5908146,-408818,-137719 },
+ },
+ {
+  { 16091085,-16253926,18599252,7340678,2137637,-1221657,-3364161,14550936,3260525,-7166271 },
+  { -4910104,-13332887,18550887,10864893,-16459325,-7291596,-23028869,-13204905,-12748722,2701326 },
+  { -8574695,16099415,4629974,-16340524,-20786213,-6005432,-10018363,9276971,11329923,1862132 },
+ },
+ {
+  { 14763076,-15903608,-30918270,3689867,3511892,10313526,-21951088,12219231,-9037963,-940300 },
+  { 8894987,-3446094,6150753,3013931,301220,15693451,-31981216,-2909717,-15438168,11595570 },
+  { 15214962,3537601,-26238722,-14058872,4418657,-15230761,13947276,10730794,-13489462,-4363670 },
+ },
+ {
+  { -2538306,7682793,32759013,263109,-29984731,-7955452,-22332124,-10188635,977108,699994 },
+  { -12466472,4195084,-9211532,550904,-15565337,12917920,19118110,-439841,-30534533,-14337913 },
+  { 31788461,-14507657,4799989,7372237,8808585,-14747943,9408237,-10051775,12493932,-5409317 },
+ },
+ {
+  { -25680606,5260744,-19235809,-6284470,-3695942,16566087,27218280,2607121,29375955,6024730 },
+  { 842132,-2794693,-4763381,-8722815,26332018,-12405641,11831880,6985184,-9940361,2854096 },
+  { -4847262,-7969331,2516242,-5847713,9695691,-7221186,16512645,960770,12121869,16648078 },
+ },
+ {
+  { -15218652,14667096,-13336229,2013717,30598287,-464137,-31504922,-7882064,20237806,2838411 },
+  { -19288047,4453152,15298546,-16178388,22115043,-15972604,12544294,-13470457,1068881,-12499905 },
+  { -9558883,-16518835,33238498,13506958,30505848,-1114596,-8486907,-2630053,12521378,4845654 },
+ },
+ {
+  { -28198521,10744108,-2958380,10199664,7759311,-13088600,3409348,-873400,-6482306,-12885870 },
+  { -23561822,6230156,-20382013,10655314,-24040585,-11621172,10477734,-1240216,-3113227,13974498 },
+  { 12966261,15550616,-32038948,-1615346,21025980,-629444,5642325,7188737,18895762,12629579 },
+ },
+ {
+  { -12985210,2232306,-19245727,13593841,21993069,8135687,-5796627,-12667581,-5248612,7727958 },
+  { 31014590,-3210030,8051177,7477488,-22595585,-1688574,-12710138,-13971834,22555828,9443904 },
+  { 20406719,13480001,-9586732,5462500,-6324254,-4954984,18464765,10190197,29305164,12651287 },
+ },
+ {
+  { 3183109,4683634,-23207796,-10363585,5282234,-16140883,24008332,-6521211,26673690,-9501990 },
+  { 21238823,-1798803,-11529034,16087566,4404308,-457826,-3275936,-7213640,3985587,-604474 },
+  { 10324605,-595874,11566535,-3934990,-29775914,-15655244,20381406,-3916325,3862564,13173910 },
+ },
+ {
+  { -21957963,13492071,-26665590,-2455291,-26336472,-9189245,14860663,-8432958,-3650002,15092584 },
+  { -15399726,-8574195,-6788827,45139,-9529197,5486710,-16775014,14372672,17653981,3209355 },
+  { -19321322,8270008,-10982885,15551010,15372283,3563700,-27142009,-15568290,26130544,-14943167 },
+ },
+ {
+  { -14714855,1032433,22864387,14196322,12795394,-5284021,25447033,-445588,-9532848,-38248 },
+  { 4055646,1174354,-27473301,11608482,-32016831,-12281361,29208446,7731819,-11168558,-10801590 },
+  { 31879923,16403627,25182783,571067,12709657,3477023,33359739,8500205,28891595,5571888 },
+ },
+ {
+  { -7852082,9694042,-17421415,-16555086,25603963,-13892491,26706975,2852359,-30181638,-2372293 },
+  { -3379817,4751536,-15017919,1116618,2822616,-10267218,6109822,-8112603,18962344,-15403693 },
+  { 2145750,370657,-27838250,10019748,6694181,-2118665,-5048406,9202666,15633945,9582675 },
+ },
+ {
+  { -16260779,13338275,-8543071,887524,17896284,-13707485,-25237644,-12057274,16170998,14682704 },
+  { 8590969,-11930721,-23778707,-4207163,-16714765,323589,16689111,7873298,-27842931,-1365914 },
+  { -21985136,16418196,30868187,728762,-13146445,6788087,9611773,11581761,-5914378,10115143 },
+ },
+ {
+  { 28352553,-15624484,-17118660,9409585,-664834,-11081144,26238194,-12894402,3277523,-12665476 },
+  { -30546688,6744533,-9180105,-1379581,14345903,-12652956,-8896037,9706624,15901529,-1340349 },
+  { 29446013,13842603,-1904844,12411287,21675552,6988455,-11644243,-10327647,-17982540,-12420404 },
+ },
+ {
+  { 32848944,14869187,-32304465,5534472,11039196,5740254,-2934758,-8833159,27856026,9081406 },
+  { -12649604,4231155,22186379,13513185,28360494,-3678076,13136226,10172232,-18198137,3756407 },
+  { 20950123,-9423069,25144688,-10012895,22175542,54021,-4289030,2542214,-1029927,-16422958 },
+ },
+},
+{
+ {
+  { -2996167,-12228049,23768721,4029825,31214093,-6119041,18178853,1976855,18066803,1578133 },
+  { 31661618,-10911218,-3537898,11280430,-2066321,14335082,-14668934,-13713663,21817116,5458167 },
+  { -22904939,6521443,-33251769,-2339570,28698123,-11677108,10502673,3702605,-17157584,-3756454 },
+ },
+ {
+  { -30583401,-2890881,-27163480,172985,9933425,-9760510,2716365,-7782376,-18662473,13577818 },
+  { -19129770,-15329384,15177281,-9255746,-25413540,7358525,23090983,-13120656,14859744,-7788452 },
+  { -15636196,655648,9235246,14742194,-32888048,2192264,12508915,7376392,-17843516,-3647329 },
+ },
+ {
+  { -20434804,-4393756,-23763600,-10252451,-32882848,-16373058,-31614109,2633744,-8185196,3332403 },
+  { 12414490,-499219,-3240435,1982096,28982280,13130288,-11200612,15815289,32757594,-2578956 },
+  { -11770997,4132053,17573382,15149583,-18510479,-5060823,13950829,-4627781,-29411466,-14381829 },
+ },
+ {
+  { 14881928,1929648,-23688957,-6876926,8802471,-14140571,31769881,16723524,11747879,13665112 },
+  { 785476,-625839,33222759,-15894132,30045363,-13885328,5395004,-13118456,-16537803,-15204164 },
+  { -104950,9353132,-20340908,10673924,31496315,-15318013,-33222888,7514244,23570557,-9721287 },
+ },
+ {
+  { 16056128,-1353553,-15304192,4028257,-31994371,3248829,22060621,4533772,20792306,-12599326 },
+  { 13152121,-8476780,18173074,6051397,2239079,-16168599,-30956256,4210683,8958954,-8180018 },
+  { 2324178,986936,-5008984,-7601464,23111464,-15229836,32645691,3875467,13533987,-2772723 },
+ },
+ {
+  { 6092522,-7333227,-32173404,-8770711,32794808,907419,32976293,5607119,-14159335,14084480 },
+  { -18707245,-5063481,-9210049,12047347,-24645977,13992659,8928024,4672946,13020035,-15503307 },
+  { -27567986,-3952412,30352925,12082256,-27690331,1430767,27331922,-8277601,23867239,-9621605 },
+ },
+ {
+  { 24363295,-1144212,-32311689,15928779,-1042063,-16520481,6015838,-10711561,-22565050,4489706 },
+  { 13607637,-1606316,15044220,10930942,-5636052,-5567052,-9727119,-2750805,-25402303,-5863579 },
+  { 6736871,11106916,16311491,-7500406,-13810474,-1043915,32027249,11864929,-33403410,-4601639 },
+ },
+ {
+  { 14741879,-14946887,22177208,-11721237,1279741,8058600,11758140,789443,32195181,3895677 },
+  { 10758205,15755439,-4509950,9243698,-4879422,6879879,-2204575,-3566119,-8982069,4429647 },
+  { -2453894,15725973,-20436342,-10410672,-5803908,-11040220,-7135870,-11642895,18047436,-15281743 },
+ },
+ {
+  { 11251988,-13742354,22637769,-3379199,2571617,7859736,-13109814,13171066,32318075,15754535 },
+  { -8626967,14630811,-32726600,14934658,-17654667,8272636,30263778,-3862035,-6550140,10272454 },
+  { -25989912,10147621,27347519,-88953,-25950903,15940730,33352808,11427355,-20237129,5241312 },
+ },
+ {
+  { 10454354,4473749,-2588519,-7652514,-27963709,-8003261,-1319423,-10236332,-27080742,-12657289 },
+  { -19297225,2168080,8423566,-7063677,-26516042,-726669,17141176,5767274,-7133782,-6959048 },
+  { -26522458,-13521946,-7234519,-9339664,-10664770,-7175841,-31291558,1692360,-9074406,11141094 },
+ },
+ {
+  { -32929618,-7630430,-1983493,-9226432,-24777984,13672430,7191669,-2651312,20491771,-281400 },
+  { -32966129,8324102,-22881252,136096,15477278,14952460,2899719,-11638050,-16283124,4028319 },
+  { 8564575,7270626,29429050,12799840,17498561,-93610,16153064,10720119,9400961,-10203598 },
+ },
+ {
+  { -10578473,-8239039,-24381569,-6909067,-16822583,-6784934,33444616,845760,20608081,11192735 },
+  { 30050982,-394538,-13273137,-10285815,-11500166,-7269472,10357942,14188715,-19397536,11657419 },
+  { -13148047,14181632,20106888,-12158976,30305109,-12398479,6783851,15356930,6396864,15352771 },
+ },
+ {
+  { -20966403,1609255,-29537428,-1717247,-21338045,6745989,18190639,11554264,25040958,-2573618 },
+  { 32108586,-14528523,-5841942,2581124,8176675,-5584741,23065897,-4647266,-19738061,11801781 },
+  { 18571740,-14979497,-26481390,-8196391,12570628,-14967062,24059954,-10019123,-4357320,14093199 },
+ },
+ {
+  { 2733071,-2779745,-13059891,-15297062,7688086,12984430,-32722312,-1710828,5047242,4090595 },
+  { 28364683,11601469,-27587682,-3486294,19109050,11351855,30966639,-14249006,-287471,-7010894 },
+  { 16517561,-8179866,-6266423,-14028960,-5163574,13480281,25817445,-3574804,-9949105,13120612 },
+ },
+ {
+  { -27690239,-11053489,31227663,5251497,14519826,-3482096,-10316238,10460872,-23713218,-2179094 },
+  { 28862817,-9101319,5471091,5745670,-7921551,3619241,29277749,-14268829,22638949,6687440 },
+  { -17097810,-3706414,31298014,-5004188,15999664,-14086673,-20637973,10386762,-23733516,-6487956 },
+ },
+ {
+  { -25173001,-11307165,29759956,11776784,-22262383,-15820455,10993114,-12850837,-17620701,-9408468 },
+  { 21987233,700364,-24505048,14972008,-7774265,-5718395,32155026,2581431,-29958985,8773375 },
+  { -25568350,454463,-13211935,16126715,25240068,8594567,20656846,12017935,-7874389,-13920155 },
+ },
+},
+{
+ {
+  { -30505967,-3821767,12074681,13582412,-19877972,2443951,-19719286,12746132,5331210,-10105944 },
+  { 30528811,3601899,-1957090,4619785,-27361822,-15436388,24180793,-12570394,27679908,-1648928 },
+  { 9402404,-13957065,32834043,10838634,-26580150,-13237195,26653274,-8685565,22611444,-12715406 },
+ },
+ {
+  { 29875063,12493613,2795536,-3786330,1710620,15181182,-10195717,-8788675,9074234,1167180 },
+  { -26205683,11014233,-9842651,-2635485,-26908120,7532294,-18716888,-9535498,3843903,9367684 },
+  { -10969595,-6403711,9591134,9582310,11349256,108879,16235123,8601684,-139197,4242895 },
+ },
+ {
+  { 9878253,14006920,-1396338,-8779282,-23114353,-9743395,-6371446,12165081,11500190,-2211678 },
+  { 33289110,2293677,32885825,-7250597,9212210,7873891,-7606588,-4575035,-30162256,822763 },
+  { -9554709,1468008,-6064228,-3944406,-4771871,1636531,-11516301,3715354,26021108,12947434 },
+ },
+ {
+  { -6069670,-5052251,-5462350,-15363256,-21086622,10493066,-4240204,10782758,19715924,-10609716 },
+  { -20837039,11879200,-28543308,-9107892,-15126666,-36018,4729185,-11056419,-9260288,-14375140 },
+  { -32242881,-1949709,-2333073,-12442631,-3258303,-14955346,-33321070,15757667,12526404,-13498899 },
+ },
+ {
+  { 6924812,3786709,32656832,-10703501,-29662375,9472810,-9760315,-16518851,33044309,-1742717 },
+  { 20074026,-7523902,-4254665,10223771,-25455705,-3109860,-1315051,14479447,836954,1554453 },
+  { 18434310,12703876,-2229523,-7120652,-14089649,1651615,9050147,-299459,17068758,5201829 },
+ },
+ {
+  { -15111099,11831190,-13797030,-3431460,14988762,-7741847,27834248,-14276076,-5518248,12357828 },
+  { -13080957,11750094,32949488,15147850,2273666,14753148,27580717,-13865781,-3452878,12615038 },
+  { -24951748,1647399,25256554,10447541,31117105,14123725,4981368,15006717,10955413,-969526 },
+ },
+ {
+  { 23498695,11936529,1580586,-4678573,10363508,13429786,-19959846,-4796642,-27573063,6119615 },
+  { -7628588,-11035017,3294813,-15035167,-14540722,14024832,-5870353,12650900,-30103905,-7172297 },
+  { -29771603,-7408358,-12353138,-1449843,14871170,-3579131,-7871622,-4199777,-17609318,-12003517 },
+ },
+ {
+  { 738455,15209961,21522471,13794043,-18272072,14800413,30429911,-7705559,27832414,-1931956 },
+  { 7453038,1368394,-29924865,-10811872,-8062337,-13351933,-22238829,9010656,-16295049,2678542 },
+  { -19900866,-8627185,3435928,-7976663,-29672159,-8117016,32080383,11402077,-29170196,-3492341 },
+ },
+ {
+  { -19346278,11274573,12354158,-3877472,-22606419,-13089305,-12672732,-8733188,4458050,-4226234 },
+  { 3344143,8832401,-18837190,540344,-28377230,4478894,10408786,16346735,10939288,-15863175 },
+  { -32926095,-16717020,-26572936,1719764,21771008,-9067011,-26429066,15761899,-29665237,-15441902 },
+ },
+ {
+  { -17100965,14590591,5738666,11643247,-22247897,-2974006,8640871,9334973,25570707,-11992505 },
+  { 18097883,7569823,14729847,-1032940,20954056,1793585,22893033,2614991,-27761733,9562499 },
+  { -30455686,-15172531,-13375379,14407395,-15545736,15765069,24889880,14417623,-5135243,-12517701 },
+ },
+ {
+  { 8620320,-7362650,33499987,10198900,7087849,-14319155,-13194335,-14299832,-27753224,6322725 },
+  { 13581247,-15819656,-31136786,-524669,28247530,4521734,14087135,6160282,1642091,-1017184 },
+  { 21080946,-6377210,26914265,1772885,10770049,-3796069,17486850,-11369436,-22065121,-3790843 },
+ },
+ {
+  { -16626749,2417754,33249389,-9811327,-29776058,6245162,24518258,-8872034,32127821,1670554 },
+  { -17078794,-6058641,-25942028,4690837,15161979,16163792,6736582,-3297897,1522395,6083038 },
+  { 20110157,2863573,-9031360,-14541031,-18766188,-5769962,-4019862,-8320702,-3996712,6731694 },
+ },
+ {
+  { 16445278,-4721559,27670256,5785530,-29313395,-14116121,-22851170,-10764558,31232897,-11227443 },
+  { 28953144,6474041,-32961869,4058091,-352824,7842933,-23074745,14548439,21727502,10965451 },
+  { 3443933,7254654,10199454,3941915,-9711704,-6403697,8296083,3546961,31234082,-8548677 },
+ },
+ {
+  { -10919240,-1336035,28362684,-8581164,-3720067,6507068,932604,4958210,14173156,-10170900 },
+  { -29363764,-14993174,-4064361,15725020,3864638,-99079,22771393,2402978,-28031901,16251972 },
+  { -575225,6826741,5320066,14004555,2891630,-21545,3022103,6468070,31240325,5047156 },
+ },
+ {
+  { 9483081,-2917371,30250088,-9340476,-28826409,-14992888,31550410,3171422,-11783057,-4277779 },
+  { 6946092,16468042,14760809,-2124897,-31841186,-532359,-3135990,-5272343,24289725,-9766853 },
+  { 25162946,10113803,-12331299,860931,19365102,-4860600,-10755550,-13179667,27312473,-14325519 },
+ },
+ {
+  { -3991660,-9527471,10802081,-222831,9552676,1668152,32465931,-9801628,25695594,10570178 },
+  { -1386077,3332181,7198948,-358053,22465318,168113,28159978,-2337220,-15485647,12543796 },
+  { -551221,-11413806,32145656,10133860,-11854144,-14354305,-23987682,3851704,24621200,-6994241 },
+ },
+},
+{
+ {
+  { -16254428,-4363307,22954637,-1086624,-33161422,-5987332,-17684638,-6201010,-10761944,-3138478 },
+  { -12626493,7542435,-28044909,-14024969,1591133,11995702,13303707,12795301,21854370,8234601 },
+  { -1578358,10796253,-12174098,9852963,10851551,-14200866,3317610,-13843590,4680659,12478641 },
+ },
+ {
+  { 22092954,-13191123,-2042793,-11968512,32186753,-11517388,-6574341,2470660,-27417366,16625501 },
+  { -11057722,3042016,13770083,-9257922,584236,-544855,-7770857,2602725,-27351616,14247413 },
+  { 6314175,-10264892,-32772502,15957557,-10157730,168750,-8618807,14290061,27108877,-1180880 },
+ },
+ {
+  { 21674879,5133395,19158564,12102231,-22916134,-14494339,1173546,4321238,-22648780,-563968 },
+  { 19986973,11398555,-29260091,-14615980,20903409,13032412,2996003,11996678,-7621565,14641239 },
+  { -22454232,-10974931,23173505,-5013386,15778062,9066347,27447605,-15232605,24321530,3811517 },
+ },
+ {
+  { -8586597,-7170966,13241782,10960156,-32991015,-13794596,33547976,-11058889,-27148451,981874 },
+  { 22833440,9293594,-32649448,-13618667,-9136966,14756819,-22928859,-13970780,-10479804,-16197962 },
+  { -7768587,3326786,-28111797,10783824,19178761,14905060,22680049,13906969,-15933690,3797899 },
+ },
+ {
+  { -22586086,11403334,-11496637,9393718,-16570609,-3001529,13859623,-4676735,-22124842,-5720447 },
+  { -31730991,-2919605,-19730182,13209498,-14487460,-3903039,24538959,-7458354,11760929,12877241 },
+  { -11801100,889063,31103186,83,-11754014,4535668,-6712831,-937800,-18920982,-13136440 },
+ },
+ {
+  { 21721356,-4212746,-12206123,9310182,-3882239,-13653110,23740224,-2709232,20491983,-8042152 },
+  { 9209270,-15135055,-13256557,-6167798,-731016,15289673,25947805,15286587,30997318,-6703063 },
+  { 7392032,16618386,23946583,-8039892,-13265164,-1533858,-14197445,-2321576,17649998,-250080 },
+ },
+ {
+  { 29103595,-16587311,-27993997,12919001,11698514,-2515002,-8180553,-14591092,21076361,14903757 },
+  { 6472030,-13690307,-31415687,-3492299,30832990,10878539,11296880,-6734064,-8217933,-2498057 },
+  { -4069450,9077685,-4684139,-1910725,-9008719,-3160619,-11020989,7596622,-20140443,16233255 },
+ },
+ {
+  { -9301088,-14193827,30609526,-3049543,-25175069,-1283752,-15241566,-9525724,-2233253,7662146 },
+  { -17558673,1763594,-33114336,15908610,-30040870,-12174295,7335080,-8472199,-3174674,3440183 },
+  { -19889700,-5977008,-24111293,-9688870,10799743,-16571957,40450,-4431835,4862400,1133 },
+ },
+ {
+  { -31465484,-8902297,-31906667,-16577854,21892899,-9119921,8152573,11129084,27316517,3165319 },
+  { -19734605,-2094127,-8383678,7111400,18205888,-7904603,20970686,4800605,18498534,5779487 },
+  { -21624423,14036360,-11014141,5664698,-10533646,13470461,12721521,-6866441,10236201,11827980 },
+ },
+ {
+  { -32856209,-7873957,-5422389,14860950,-16319031,7956142,7258061,311861,-30594991,-7379421 },
+  { -3773428,-1565936,28985340,7499440,24445838,9325937,29727763,16527196,18278453,15405622 },
+  { -4381906,8508652,-19898366,-3674424,-5984453,15149970,-13313598,843523,-21875062,13626197 },
+ },
+ {
+  { -553172,16668383,24052968,13667664,32935290,8706520,1036810,-10064335,20746107,-10466472 },
+  { -25047263,3154569,-27196936,4133954,-4561620,-14636629,-23015905,15357989,5589736,-8137479 },
+  { -16027981,-9700166,6891275,-13195701,-31300568,-7685475,26322596,14657950,6879058,-2424079 },
+ },
+ {
+  { 2281448,-13487055,-10915418,-2609910,1879358,16164207,-10783882,3953792,13340839,15928663 },
+  { 31727126,-7179855,-18437503,-8283652,2875793,-16390330,-25269894,-7014826,-23452306,5964753 },
+  { 4100420,-5959452,-17179337,6017714,-18705837,12227141,-26684835,11344144,2538215,-7570755 },
+ },
+ {
+  { -22707809,-35066,20760324,-9310329,13902833,-3840182,-6885840,-8624556,-1095775,-3589633 },
+  { -3698258,4432589,-12517800,6332704,3451509,-1566744,24929352,-13367976,-27305390,-11094160 },
+  { 16946225,9866450,33214689,7609689,-21711387,3127289,25557779,9627461,32439293,-10343647 },
+ },
+ {
+  { -9433605,6123113,11159803,-2156608,30016280,14966241,-20474983,1485421,-629256,-15958862 },
+  { -26804558,4260919,11851389,9658551,-32017107,16367492,-20205425,-13191288,11659922,-11115118 },
+  { 26180396,10015009,-30844224,-8581293,5418197,9480663,2231568,-10170080,33100372,-1306171 },
+ },
+ {
+  { -19342017,-3700663,32235094,9289272,-22662253,-13821443,-23509527,-7031025,-6088218,2805999 },
+  { -4773660,1562789,31421830,5513611,27929337,-3062628,-28100183,11132327,22279364,-4479142 },
+  { 25546840,6725049,16433100,-2099996,-5823109,2986307,-26156351,-9941216,-22669807,873584 },
+ },
+ {
+  { 15121113,-5201871,-10389905,15427821,-27509937,-15992507,21670947,4486675,-5931810,-14466380 },
+  { 16166486,-9483733,-11104130,6023908,-31926798,-1364923,2340060,-16254968,-10735770,-10039824 },
+  { 28042865,-3557089,-12126526,12259706,-3717498,-6945899,6766453,-8689599,18036436,5803270 },
+ },
+},
+{
+ {
+  { 22514622,-9142449,2166950,-6940349,11376442,13509235,-33293707,-9958222,5161867,2412512 },
+  { -5883134,12235213,11132467,15344146,11665129,-6953919,4018212,2010037,-31830517,-16465592 },
+  { 21587062,14311011,24712437,16246189,-33257813,-11299725,-32933954,10704060,6677587,2094364 },
+ },
+ {
+  { -18290749,8672615,5547528,-11754940,-3537207,-8236827,30807836,-14773950,9784229,338920 },
+  { 26029005,986953,-18351861,7174918,6031977,-9816191,-1774815,-10191038,-6059200,7371135 },
+  { -5020052,6668295,26687846,9592831,13369729,8921916,-7811955,7111975,-10234643,10773009 },
+ },
+ {
+  { 1750782,-11669265,4726644,10119869,718929,10871286,-6681860,3219099,-16724792,-10120239 },
+  { 4959226,-15072905,26746984,15903927,11556605,-6611653,-8187301,-2579591,17439217,16480865 },
+  { 17393683,8963403,20110473,13337651,24126229,11533166,-19200733,-5162010,2065776,-10599081 },
+ },
+ {
+  { 1566649,5953730,-33237314,-15081047,-33410651,13562370,21765546,6858313,8692869,-11599288 },
+  { -18822673,9680709,5436102,7311888,18492958,16085950,18594642,-14335181,-15144673,7995124 },
+  { 30126015,-16441220,-23283109,-5010676,9204919,10837144,-21288079,12501360,25340489,16405875 },
+ },
+ {
+  { 29047378,8190936,-14166681,-14060087,-29700094,12656501,-13146596,9696956,23228220,-6998534 },
+  { -19835853,-2828400,-32211822,-11506796,-12462683,14574472,32050901,12494879,8189001,5282082 },
+  { 8203499,-13371561,26688685,16169406,-32785729,-413524,-1199767,-4756447,3883865,2993835 },
+ },
+ {
+  { -16733893,11449742,-26319863,10408893,-17301361,-12929270,-8281294,8542988,4786208,75191 },
+  { -31261013,-7671070,-30019747,11957701,18733193,14943924,21585529,10494795,24661569,-744192 },
+  { -25271456,-13753487,10584975,-13342556,1909073,903984,-16925281,-10193879,28588036,4329724 },
+ },
+ {
+  { -14391122,-2503815,19937966,-9593691,-12096980,-9908242,28081993,4004783,13948268,-816869 },
+  { -10324259,4265294,-6604609,7256867,-13015978,-13210822,-13719409,14193247,-18536807,4545838 },
+  { -8339866,-15981664,-26020065,5875023,24965859,-3396820,11591322,13509397,-5002833,-3931880 },
+ },
+ {
+  { 27093406,-911231,-3329016,-15936755,9290559,-8241685,-14841576,9033888,-17137912,7629846 },
+  { 1807870,5197188,9490047,-3507334,-1327922,-15342237,12169160,-4969782,17140545,-94266 },
+  { 23852594,-7238535,5530489,8614556,-11671892,-12577138,6471427,-14906965,-30915538,-10909350 },
+ },
+ {
+  { 13608635,-1286487,-15097358,-5233120,-3921792,15537896,19944987,-3542094,-5100553,-6569620 },
+  { 7349180,2584028,13050262,14417310,27735952,-5108317,12929043,6138363,8685876,5308664 },
+  { 5293084,-947550,11541360,12852170,-18315713,6392997,6498722,6268805,-10250694,5937470 },
+ },
+ {
+  { 13756766,-1032929,30476417,-15455181,854830,-13845598,13418827,-13335817,12828590,13695739 },
+  { 6145266,13120682,-19179542,-3788964,10388329,-11436813,28922238,4061789,-25835062,-2428327 },
+  { -5500297,12302652,28955787,3292843,13597413,6257648,31959860,-3050978,-31634526,2734564 },
+ },
+ {
+  { 25961039,11669482,8573340,4570924,-33065176,324411,9037954,1546605,26796043,-7903044 },
+  { -19662614,-1784357,-22493037,16588997,11358057,1916700,27829748,-7390667,13330222,3608454 },
+  { 14639831,5919622,3895590,-9221357,-31308988,-13310843,-27556118,9457054,-5130095,-14172010 },
+ },
+ {
+  { -10216359,14296705,-27604717,9677452,28675827,9430074,16547056,14436332,14380435,-8410439 },
+  { 14085239,508471,-22177772,-1440142,1437001,3636721,-16063422,1750508,-9139302,2275253 },
+  { 20870270,8888610,20766036,-12520016,-17880963,4771438,30664839,-8165394,-33122003,11788841 },
+ },
+ {
+  { 22406140,9747943,6074525,13838139,25336966,-9267730,-31937273,-9462085,-12666208,-3633875 },
+  { -8798805,-8468272,-31170546,10847869,-29870653,-168272,-10249893,-6025012,-29244067,-9066739 },
+  { 14551152,-7870998,-9071203,628348,32899167,10599620,21550966,-6693276,18834583,2070353 },
+ },
+ {
+  { 25508286,8497410,-31341705,-16093386,9821414,8647651,-32512011,-15709615,20305794,-13538503 },
+  { 28218765,-14429006,4112288,-5360321,18974039,-1863576,-3547004,10135908,-26793938,-7063762 },
+  { 10652891,3002803,9118688,10646268,618621,2883775,736688,4319205,26183623,10098398 },
+ },
+ {
+  { -17117658,12150713,-14132432,-13904030,-4587984,12814106,13401580,8123604,-14448935,-13809928 },
+  { 24031065,-16588366,29052443,15920084,21324975,-9263464,32699806,-16254409,-28814959,-14337642 },
+  { 28719254,7751682,-9658795,12334236,32217809,-10485717,9502945,3379022,-2420594,13432289 },
+ },
+ {
+  { -817581,6763912,11803561,1585585,10958447,-2671165,23855391,4598332,-6159431,-14117438 },
+  { -31031306,-14256194,17332029,-2383520,31312682,-5967183,696309,50292,-20095739,11763584 },
+  { -594563,-2514283,-32234153,12643980,12650761,14811489,665117,-12613632,-19773211,-10713562 },
+ },
+},
+{
+ {
+  { 30464590,-11262872,-4127476,-12734478,19835327,-7105613,-24396175,2075773,-17020157,992471 },
+  { 18357185,-6994433,7766382,16342475,-29324918,411174,14578841,8080033,-11574335,-10601610 },
+  { 19598397,10334610,12555054,2555664,18821899,-10339780,21873263,16014234,26224780,16452269 },
+ },
+ {
+  { 30860103,12735208,-1888245,-4699734,-16974906,2256940,-8166013,12298312,-8550524,-10393462 },
+  { -5719826,-11245325,-1910649,15569035,26642876,-7587760,-5789354,-15118654,-4976164,12651793 },
+  { -2848395,9953421,11531313,-5282879,26895123,-12697089,-13118820,-16517902,9768698,-2533218 },
+ },
+ {
+  { 31490452,5568061,-2412803,2182383,-32336847,4531686,-32078269,6200206,-19686113,-14800171 },
+  { -17308668,-15879940,-31522777,-2831,-32887382,16375549,8680158,-16371713,28550068,-6857132 },
+  { -28126887,-5688091,16837845,-1820458,-6850681,12700016,-30039981,4364038,1155602,5988841 },
+ },
+ {
+  { 3960823,-14267803,-28026090,-15918051,-19404858,13146868,15567327,951507,-3260321,-573935 },
+  { 24740841,5052253,-30094131,8961361,25877428,6165135,-24368180,14397372,-7380369,-6144105 },
+  { -28888365,3510803,-28103278,-1158478,-11238128,-10631454,-15441463,-14453128,-1625486,-6494814 },
+ },
+ {
+  { -3783388,9065323,-32867915,-10920896,15856633,3515965,15354277,-12566277,-13957913,-15033019 },
+  { -10358403,2104610,-5770957,-4784962,2532632,-16012075,-11990193,11589597,-19298378,-7246273 },
+  { 31310221,10796042,-29188713,-3891450,32241733,-15158744,25335413,11577772,1614741,-6438557 },
+ },
+ {
+  { -29243477,15349577,24611191,-4748535,-14047034,1481603,-15100558,-3263208,-4867990,4210430 },
+  { -15309675,4320726,-27654870,-9262145,-519507,-4416085,2609387,11584514,-16062171,-5870550 },
+  { -5300025,13556398,-17251426,11700681,1785954,-13608610,-26102648,12320131,27548071,-3034036 },
+ },
+ {
+  { -27506510,-11903907,-21405178,-15645868,27213826,1168852,7236277,9772466,24832839,-2721828 },
+  { -8328381,4822688,-21369629,3021228,7207537,-13085309,14819778,-12481522,-30639199,12952226 },
+  { 13180558,11112987,26823804,13659368,-9679483,-10674032,-18937260,-13664904,-2804929,-13186873 },
+ },
+ {
+  { 30119711,-9784270,21311901,-11731286,4545195,-5268616,-7194613,-13285313,-24895243,8364851 },
+  { 529615,-9340280,-18344979,-16036583,-32500516,-3623762,-9921389,12824930,-16870557,131951 },
+  { 837674,6366159,-3502508,1326053,14882179,5587264,-26143641,-5363199,-32492502,1085539 },
+ },
+ {
+  { 6890575,5527694,-17011491,2146631,10417961,12060307,24350436,-11180698,8446603,810290 },
+  { -20607106,-5184611,-6117528,11732654,-1088824,-6682360,3588075,-1988374,842072,-10115134 },
+  { -23518105,-129156,27914842,7262460,-13125929,10755140,-16876622,-8490612,-26958503,8958194 },
+ },
+ {
+  { -8735425,4402379,29924356,15767990,-30195551,11944909,-246415,-10360500,-29554544,-12664620 },
+  { 29192125,-4541164,28673738,6970809,16828663,-8016550,-22853579,2921488,-30564147,-2643413 },
+  { 16453434,9825105,-26310350,-644456,30455264,-8593246,23450559,6834037,-32438645,-12437529 },
+ },
+ {
+  { -13206239,-1622438,-157665,-11174109,6526988,-7361385,-18650838,-14925256,32514542,16382109 },
+  { -18321280,-3018849,26576772,11383341,-21688833,-13730695,6623436,13842444,3200131,-7423885 },
+  { 31251215,6889060,-21809458,-8308214,-4422724,-11672932,21992889,2766073,-22514552,5237380 },
+ },
+ {
+  { -10815875,-16371205,-16855362,-6013761,21224669,-7653644,32010850,5008681,-10710620,4840014 },
+  { 30646302,-13872042,2030199,-10178750,32718801,-10327769,5591219,-14458671,-18347505,-11482874 },
+  { 16460326,8549012,-20511961,-4127942,26008971,3693983,24555814,14332513,-21900211,-15265429 },
+ },
+ {
+  { -5698582,10484170,-22602181,-6270029,-20910613,-1357085,9157628,5004724,20489936,-11074950 },
+  { 28200534,1035057,644925,-13361670,2937650,4501202,-26428017,-13741521,-19659239,-6164203 },
+  { -32006358,6221292,-18155482,-14668996,10213125,-11746139,22280664,11938688,13258950,-2153339 },
+ },
+ {
+  { 16568305,2838724,13600550,-13616032,13543527,5438410,22563149,-14577902,32244790,-3315489 },
+  { 1295829,-15372205,14754883,7897521,14718890,11888226,18231769,6476657,-6989094,-4919090 },
+  { 6111100,-9567453,-15453078,-7313140,-33123810,14088095,9317387,-7667652,23514176,10028788 },
+ },
+ {
+  { 27499816,-9740500,-28659226,-4812504,-19161335,15558839,-28420882,-11718284,18038171,16657511 },
+  { -23722909,5999641,9463683,8915620,-4995795,16057070,-30451774,13762242,-25891136,2142621 },
+  { -6196421,-9263524,-32334003,-14761764,-5691559,-14994351,6445395,9679780,-6810705,7029478 },
+ },
+ {
+  { 8479303,1252296,-17667299,-4777089,-29963573,-12038778,12659471,-8719634,16278315,2131977 },
+  { -786593,-8743829,-15249100,-13009385,-26325342,7257437,6671327,-9722489,4813412,4535646 },
+  { -14947165,7266075,-26298784,-9554087,22340862,-4791061,-23852980,-2854366,14275706,7033170 },
+ },
+},
+{
+ {
+  { -16994639,15280136,22189231,-8986236,31096112,248622,8877467,5184062,31974465,-16619719 },
+  { -13580849,-10411780,25270984,11606798,20140754,8660652,7503954,-2261550,-3044331,2872438 },
+  { -28237316,6525923,33293145,2547665,32946773,4394489,5572331,-610204,-28130141,-6698486 },
+ },
+ {
+  { 3598048,5152435,31306191,-14947645,-1578273,14808293,-3454627,9422666,-1051148,7361217 },
+  { -7767763,7827611,13407330,3592841,7127763,-15398823,-4348312,8454549,32616457,7835919 },
+  { 11031204,-14748603,-25828563,-7306841,22994355,-6459910,15573512,9596005,25601393,-8662791 },
+ },
+ {
+  { -18696226,1573839,16206360,-9715585,13790638,-7876141,-20128360,-10885001,3040978,-15017072 },
+  { 442335,2305512,9106877,7956597,20849759,11936775,-12134436,6214554,22873697,1360009 },
+  { 22346621,-8480788,-12777700,7574889,-14785126,-13661977,23258068,11746362,-13427956,-9401843 },
+ },
+ {
+  { 793299,-9230478,8836302,-6235707,-27360908,-2369593,33152843,-4885251,-9906200,-621852 },
+  { 5666233,525582,20782575,-8038419,-24538499,14657740,16099374,1468826,-6171428,-15186581 },
+  { -4859255,-3779343,-2917758,-6748019,7778750,11688288,-30404353,-9871238,-1558923,-9863646 },
+ },
+ {
+  { 13996835,-11187661,30304858,-10253687,-12082323,9075313,7646289,-10659464,25620368,-6312021 },
+  { 3004490,-7366189,22469549,16161597,-22823127,10053460,-25518163,-6763919,-23750661,-1317743 },
+  { -24319557,-8332209,2795281,-12105780,-24156161,-5141989,-33499610,12538904,6104076,9104367 },
+ },
+ {
+  { 25719065,370440,-24454836,-16282654,22605481,11276789,28650907,2812442,-15274290,14493745 },
+  { -20014357,-13198100,10193460,7588676,13635563,-9781533,4628093,1403495,22994885,15687418 },
+  { 17521553,-12980945,13263851,201576,-24719691,-12713898,24126746,-9224994,-30995382,-8953239 },
+ },
+ {
+  { 29219325,10400830,1797776,1988065,30983215,-11959902,-18481687,14422321,-8954510,1274847 },
+  { 610067,-11153919,10779639,-7125720,-24749333,16536193,33447005,-8252515,-3329887,1017120 },
+  { -18691844,-7504526,-21573764,7961401,33179150,8477887,21865241,1906277,-2041982,16361684 },
+ },
+ {
+  { 10896332,-7719704,824275,472601,-19460308,3009587,25248958,14783338,-30581476,-15757844 },
+  { 10566929,12612572,-31944212,11118703,-12633376,12362879,21752402,8822496,24003793,14264025 },
+  { 27713862,-7355973,-11008240,9227530,27050101,2504721,23886875,-13117525,13958495,-5732453 },
+ },
+ {
+  { 32208885,1241056,31524438,-2826535,9223262,15755589,2529397,13161242,13823414,-12316513 },
+  { -16215809,-15886425,-22715182,-5585899,28706052,8772993,-31810548,3444687,21976640,13034047 },
+  { 10500766,12500940,9585425,-2875337,29932328,11494540,-32673163,4950706,12058159,7381311 },
+ },
+ {
+  { 11496483,-16644084,21670178,-4953302,-31875164,-10782419,14756366,-3306957,-1471563,-4447166 },
+  { 19884282,-9209586,29002381,7226429,-8323216,-7322824,30082214,-5825864,-31643884,-11319822 },
+  { -8527226,8843699,-16076587,-16467792,11670755,1331905,13719030,-10253022,23033583,2367120 },
+ },
+ {
+  { -14655722,-15129881,-5310641,5905945,20945995,-6604759,19791647,-6843770,28863218,-9626401 },
+  { -5854722,3998094,31487773,-13819169,30575581,-3497189,-9803465,-1701827,6670639,7970937 },
+  { 4147362,-14549130,5359735,-11798081,-1971713,-5531717,-12399495,-16668336,29884862,13999668 },
+ },
+ {
+  { -23481610,4867226,-27247128,3900521,29838369,-8212291,-31889399,-10041781,7340521,-15410068 },
+  { 4646514,-8011124,-22766023,-11532654,23184553,8566613,31366726,-1381061,-15066784,-10375192 },
+  { -17270517,12723032,-16993061,14878794,21619651,-6197576,27584817,3093888,-8843694,3849921 },
+ },
+ {
+  { -8801027,-13977460,20803145,-13952848,-16590496,-15463448,13876628,3056392,-26356703,-4709708 },
+  { -21116935,6148160,31064252,10249238,3988509,4816541,11160761,-1158403,-23830284,-11433635 },
+  { 8228376,15021426,-30630267,-2272339,32170164,2282559,-4108878,8461870,23095865,12727734 },
+ },
+ {
+  { 14191562,-13094421,-19240175,-1626248,28026917,995498,4679412,6450329,-21229530,-10508513 },
+  { -10957009,2849895,-272551,-3788916,27737764,11080281,15742478,13653032,-29143976,4424345 },
+  { -25569182,15611687,6494389,-13738197,21362673,-8994144,-31531310,3086588,-15565581,-10758554 },
+ },
+ {
+  { 18076276,1656783,4957381,12301206,13329699,-13581722,-18851774,-2360210,8376961,-5954237 },
+  { 11203119,13637748,5990264,-14989603,-6181570,-15589594,-17746898,-12264697,18375058,5791518 },
+  { 1996667,-3648826,7069388,3563341,6639739,-1675406,18892688,-13201461,22496305,-10410429 },
+ },
+ {
+  { -9064912,2103172,25561640,-15125738,-5239824,9582958,32477045,-9017955,5002294,-15550259 },
+  { -12057553,-11177906,21115585,-13365155,8808712,-12030708,16489530,13378448,-25845716,12741426 },
+  { -5946367,10645103,-30911586,15390284,-3286982,-7118677,24306472,15852464,28834118,-7646072 },
+ },
+},
+{
+ {
+  { 16000882,-344896,3493092,-11447198,-29504595,-13159789,12577740,16041268,-19715240,7847707 },
+  { 10151868,10572098,27312476,7922682,14825339,4723128,-32855931,-6519018,-10020567,3852848 },
+  { -11430470,15697596,-21121557,-4420647,5386314,15063598,16514493,-15932110,29330899,-15076224 },
+ },
+ {
+  { 23839531,-1616502,30191244,10928297,-26946045,3795407,-19357780,3675677,-24296558,-12062547 },
+  { -4379010,-4481858,-1454303,11568342,1526211,-12474204,-25222435,5304748,-26097292,-15529886 },
+  { 31631775,-768539,5383026,-16164005,7420284,2405746,7571514,-10957978,-24853259,-4608392 },
+ },
+ {
+  { -26650689,-8094349,-17473652,-12114885,-17969800,15946158,1278250,1191613,-8123406,7975296 },
+  { 26798955,-5681804,-8620488,-12307983,7520474,-15123524,-1333943,-7525630,-11386868,-3692949 },
+  { 14557472,-6969312,-30755283,10062378,18207780,-266213,26704221,10544337,15248480,-2271092 },
+ },
+ {
+  { 831643,-15219650,2764144,14858017,30256467,15702468,-15707421,-1550249,-20170233,-8572415 },
+  { -14818991,9958291,310270,4131042,-10418429,7642248,-27663318,-4250453,26806497,11838609 },
+  { 17257197,-9290657,16782189,-3785737,-31427699,-10290716,-24479698,-5695369,22801425,-6572681 },
+ },
+ {
+  { -25028461,3702163,31974335,16263471,-24853428,-16660715,-5744010,670014,15420599,-7063505 },
+  { 20163239,2731939,20278639,8968361,25768028,-9923979,15042126,-16118967,-7537521,10627691 },
+  { 29204158,8982726,12138345,4058030,17047687,9973316,17351436,-1908305,6260849,-12059690 },
+ },
+ {
+  { -3537795,-8588685,32341526,6267561,-33091893,7561108,17340066,9542139,7856640,8162947 },
+  { -5109603,2650243,-25014361,-15944089,-33420076,9949972,-8010186,-1828715,-4182008,12235747 },
+  { 29103472,-11428103,-26108345,1076694,1002340,16375966,21844350,-7731990,-14036148,2163452 },
+ },
+ {
+  { 18265378,-9837114,29129996,15366562,6133228,-458116,32667082,15667125,-18393608,-4068764 },
+  { 31120304,-12725842,-20842354,-7737862,11811508,-13853555,15566509,15543347,-22041209,5648443 },
+  { -2508295,-12315882,33059916,-11327810,17330310,-1515225,-14597545,578930,-19965868,-15367849 },
+ },
+ {
+  { -13114133,-13100320,26827179,4173643,-30210690,-10912305,-28977046,104197,-33159356,9546751 },
+  { 1094279,-8467081,-28070098,7005184,10247599,-5093115,-22940572,5165032,-31908780,791511 },
+  { -1813727,2333247,-33143045,4589243,-31971883,-11924170,25819077,6597075,-20613827,9871603 },
+ },
+ {
+  { 6672734,-10381704,-10582489,-8678275,31538654,-8628183,-22396946,-12593278,-25270889,-14814502 },
+  { 8709177,8022964,25989939,-4014127,-11435175,-11364823,-19898785,-6243176,19930760,-16745368 },
+  { -15491790,-8149238,-20228031,9201773,-23949792,1172654,16233080,-926137,-26394639,-884115 },
+ },
+ {
+  { 22197986,-2520498,13595618,7358881,13593976,655068,-23947797,1654761,-10727314,1767492 },
+  { -19392911,9163324,31932932,-15049634,25755397,2222320,-30538527,12977091,33335170,-835946 },
+  { -30788494,-8033682,-2522285,11686552,8918065,12324350,20726420,14922996,10592750,-8779300 },
+ },
+ {
+  { 18000643,-8530605,15771696,11847736,22203519,-6566688,-17062783,-12724541,-29399139,-10289918 },
+  { 33417034,15488666,-10466222,-13044900,31031133,3036112,-5640607,9341897,-14403347,-7979579 },
+  { -26788867,-5646777,-14937950,3400889,31134821,10816476,-3091799,11121829,33399977,-2487777 },
+ },
+ {
+  { -30172044,12190353,-10699520,-13287424,13655366,4230318,-13725810,12437137,-20576836,11741793 },
+  { 25782876,9724139,-27343192,-2147221,-6185748,10706789,-8835127,2114957,-4999061,2572605 },
+  { 25017985,-11055802,-753754,-11247832,8515772,5957912,32271769,-5782334,24278850,-1521292 },
+ },
+ {
+  { -23543759,-1462332,30646797,-6873053,13554460,16202576,-19600090,1109014,-15269773,12483413 },
+  { -21497407,-13590880,-4218446,3799210,-11528667,12345213,-14904989,12074899,11847183,-10678915 },
+  { 14116014,-11079692,-24512243,-466058,27198863,6150412,-4585645,14739406,-33161933,-8693957 },
+ },
+ {
+  { -30800022,10436704,19651994,16298418,-10608222,-7195674,-15894455,-3372459,-15221989,11083384 },
+  { 23985653,-5345548,17119751,12461245,-24636067,-973208,-26954924,3150286,-7265380,-13308822 },
+  { -2414832,-4480115,-7031860,16168482,6447443,7438648,-32415031,-2919292,-7715930,10401109 },
+ },
+ {
+  { -17067288,1320524,-6663118,-15546815,-6122470,10067777,32367861,15404558,28567902,-11626902 },
+  { 21718364,2738233,32172999,-10596568,26133813,11188124,-16879261,-971015,6669102,4046931 },
+  { -32110595,11016280,25502736,-1648915,31790476,1931885,31818843,2466499,-24880523,-3246224 },
+ },
+ {
+  { -28899460,10442980,735595,-16186098,-29958834,-1180211,-15784250,15968916,-9108559,2098511 },
+  { 20254068,-4762939,3597545,4682921,-12517585,-7966005,-14996214,-12821234,-530471,-12305822 },
+  { -29436957,-5806909,14965685,-7443707,16048572,-5615898,-2708385,15030531,22347379,9370165 },
+ },
+},
+{
+ {
+  { -25499735,-4378794,-15222908,-6901211,16615731,2051784,3303702,15490,-27548796,12314391 },
+  { 15683520,-6003043,18109120,-9980648,15337968,-5997823,-16717435,15921866,16103996,-3731215 },
+  { -23169824,-10781249,13588192,-1628807,-3798557,-1074929,-19273607,5402699,-29815713,-9841101 },
+ },
+ {
+  { 23190676,2384583,-32714340,3462154,-29903655,-1529132,-11266856,8911517,-25205859,2739713 },
+  { 21374101,-3554250,-33524649,9874411,15377179,11831242,-33529904,6134907,4931255,11987849 },
+  { -7732,-2978858,-16223486,7277597,105524,-322051,-31480539,13861388,-30076310,10117930 },
+ },
+ {
+  { -29501170,-10744872,-26163768,13051539,-25625564,5089643,-6325503,6704079,12890019,15728940 },
+  { -21972360,-11771379,-951059,-4418840,14704840,2695116,903376,-10428139,12885167,8311031 },
+  { -17516482,5352194,10384213,-13811658,7506451,13453191,26423267,4384730,1888765,-5435404 },
+ },
+ {
+  { -25817338,-3107312,-13494599,-3182506,30896459,-13921729,-32251644,-12707869,-19464434,-3340243 },
+  { -23607977,-2665774,-526091,4651136,5765089,4618330,6092245,14845197,17151279,-9854116 },
+  { -24830458,-12733720,-15165978,10367250,-29530908,-265356,22825805,-7087279,-16866484,16176525 },
+ },
+ {
+  { -23583256,6564961,20063689,3798228,-4740178,7359225,2006182,-10363426,-28746253,-10197509 },
+  { -10626600,-4486402,-13320562,-5125317,3432136,-6393229,23632037,-1940610,32808310,1099883 },
+  { 15030977,5768825,-27451236,-2887299,-6427378,-15361371,-15277896,-6809350,2051441,-15225865 },
+ },
+ {
+  { -3362323,-7239372,7517890,9824992,23555850,295369,5148398,-14154188,-22686354,16633660 },
+  { 4577086,-16752288,13249841,-15304328,19958763,-14537274,18559670,-10759549,8402478,-9864273 },
+  { -28406330,-1051581,-26790155,-907698,-17212414,-11030789,9453451,-14980072,17983010,9967138 },
+ },
+ {
+  { -25762494,6524722,26585488,9969270,24709298,1220360,-1677990,7806337,17507396,3651560 },
+  { -10420457,-4118111,14584639,15971087,-15768321,8861010,26556809,-5574557,-18553322,-11357135 },
+  { 2839101,14284142,4029895,3472686,14402957,12689363,-26642121,8459447,-5605463,-7621941 },
+ },
+ {
+  { -4839289,-3535444,9744961,2871048,25113978,3187018,-25110813,-849066,17258084,-7977739 },
+  { 18164541,-10595176,-17154882,-1542417,19237078,-9745295,23357533,-15217008,26908270,12150756 },
+  { -30264870,-7647865,5112249,-7036672,-1499807,-6974257,43168,-5537701,-32302074,16215819 },
+ },
+ {
+  { -2270480,9905127,-19878473,1360660,24554722,-9687238,12782554,-7281466,17752100,6800758 },
+  { 29206677,-833038,-27323062,2480935,3611278,16277604,-31694519,8616913,-3425209,10519115 },
+  { 27037483,-13601464,-21387895,-6124304,-21179052,13082642,-14828899,-14459207,-7062435,-4484474 },
+ },
+ {
+  { -19363085,15205051,9763978,-9967203,-14560672,1056897,-13287485,14840805,-8567211,11673161 },
+  { 22107340,4221837,-6605758,6726757,32743190,10987537,-1506999,10174960,-23264021,7164324 },
+  { -7245606,-55316,-7840079,2582875,-7042442,-7552966,-19378814,14265903,-15298509,-7880024 },
+ },
+ {
+  { 10819259,3008016,-21355318,-12590520,30591691,-1769551,-24389986,9528500,18798290,16049143 },
+  { 8700151,-10093645,-5877839,7179258,17945227,-11873562,-18263959,7412431,21893461,-12816706 },
+  { 7564261,-12638048,5433207,2624316,-28925793,3051047,-3237697,12267615,21466137,14507011 },
+ },
+ {
+  { -20533817,-14783328,-16869356,1339533,20298815,11494437,-3226361,-5724234,10118034,-10578575 },
+  { -21507983,-1116176,13487118,-3339105,21520812,822992,-30311968,46042,-7961788,12053966 },
+  { -7043947,4070625,-9312750,5273755,-5275385,-4943067,-30210780,-2307834,-27852985,10344120 },
+ },
+ {
+  { -8254790,318274,29062800,14930521,-31111914,-11866822,-10448321,-8204325,-8126929,-3828000 },
+  { 20453873,-4752093,-24866351,-5506565,-2849229,13693867,-566795,-704715,9589134,-2910202 },
+  { -32525565,12739431,14163346,3690990,6360507,-14285678,-12620653,9659390,331582,11683454 },
+ },
+ {
+  { 1640018,11085374,-21915057,12742353,22572887,6958110,-14714037,15154622,-16637152,-16724003 },
+  { 5241041,6516,-8725560,14111021,-19545640,-10629416,-3939109,6187990,14762013,12703080 },
+  { 8888207,-2189055,13533791,13010868,-32431218,7548001,-2834203,9627309,515285,-4245802 },
+ },
+ {
+  { -13390918,261474,-14753252,-5082987,-6505372,9759596,-5920848,9024392,-637247,12633952 },
+  { 29487090,-10534426,31779264,15206873,-19983309,-5034336,14719410,-2562413,-8802194,11737987 },
+  { 22046370,12471572,-10870188,-7183198,-12696771,10419475,-25794991,12305469,6594993,-3900077 },
+ },
+ {
+  { 4863460,14069888,16285550,1692464,13072445,-14101095,-20389917,10588017,-27305040,-11077015 },
+  { -294417,2704020,1566698,4841377,-20479788,11152593,21433955,-12053643,-31481288,13143650 },
+  { -2409006,1487693,-21216864,-1833630,280270,-7803925,23803448,-8804078,-15314800,-2344265 },
+ },
+},
+{
+ {
+  { 5271993,15573096,-1614278,13741208,8920470,8512526,11834556,15322080,15231907,5962612 },
+  { -28407331,8288280,-14225270,-138294,-16675828,10897757,20597419,8350628,30016864,2529749 },
+  { 2570165,-13429813,-18846758,6385254,17751672,12860915,286247,14157436,984918,1771233 },
+ },
+ {
+  { 30650370,13564213,17829349,13324366,-20991793,12371149,-4599212,-13541268,-24877534,9115365 },
+  { 7352052,9905981,-26891998,16537902,18121436,2092926,9966376,-10131869,24939823,-6965722 },
+  { -12744391,3293073,-3532437,-9218964,-31030483,-278949,21670277,2150201,23910396,3246488 },
+ },
+ {
+  { -20954814,-10779007,18862854,2022087,-29103822,11635649,24829550,-7552968,16914092,-6178766 },
+  { -10353985,-8620115,-11224996,5150484,-28665864,651732,-14386306,-13946973,5323717,-2946256 },
+  { 21206458,-9521431,13452278,-16420755,-19896309,-6063096,16436318,6404067,-20061052,-5747997 },
+ },
+ {
+  { 22678277,4340058,7435910,-12228163,28491836,-11308159,23820114,4492251,21720515,16553995 },
+  { -32704058,13660549,11756599,9893485,-5584216,10783541,-6913787,-9627595,-25262124,8746293 },
+  { -3477092,9563543,13261078,1936790,19258999,-1252638,12606955,471348,-29561714,5227107 },
+ },
+ {
+  { 28783932,-12698051,-13349400,-9618007,-20326383,9388516,-14501625,4492104,-19228294,-16024889 },
+  { -708806,7102193,313847,-2323333,28137568,-10525907,8521642,-7978168,-16178927,8372921 },
+  { -13313904,4498154,26989776,3103197,7059606,774455,-28820342,-3428600,-53275,-13013048 },
+ },
+ {
+  { -17341005,-125833,-13040990,15021065,-33422055,-5047424,15969269,11220872,-13735572,-2636694 },
+  { -19028975,7112362,31402220,14790127,-14888714,1806080,29085488,3384202,32944930,-6078591 },
+  { -7781540,15652578,15960168,4497247,30109641,-12793112,14776934,-14383999,-13093675,-9901463 },
+ },
+ {
+  { 24085675,-5453946,-15391935,-13337727,-15224139,-10415060,12021640,-11461978,16285544,4185153 },
+  { 23345937,-8569095,-31175942,6839906,-2775835,7541249,-28243278,8593959,-28612710,3469781 },
+  { 23508503,3314814,10699982,-5521899,-19171370,5307193,25984419,-3283676,14069670,-9895519 },
+ },
+ {
+  { -6898905,9824394,-12304779,-4401089,-31397141,-6276835,32574489,12532905,-7503072,-8675347 },
+  { -27343522,-16515468,-27151524,-10722951,946346,16291093,254968,7168080,21676107,-1943028 },
+  { 21260961,-8424752,-16831886,-11920822,-23677961,3968121,-3651949,-6215466,-3556191,-7913075 },
+ },
+ {
+  { -30143103,15387925,24791034,13185272,-21750907,3077793,-29608293,14268502,-26358441,-6123287 },
+  { 32503483,15868814,-24497777,-1137418,-26072709,-961289,11528203,-12203554,-24182774,10642345 },
+  { -14851525,7693031,2517491,10084456,-8710095,3241060,17684341,-4864011,-13628374,-12495635 },
+ },
+ {
+  { 18538166,-4022660,32359278,-936047,5471050,8810957,32557074,-1909963,3776770,14052737 },
+  { 18317199,-16288586,1222279,-15425287,63751,-5068424,3848625,14611060,4306260,12642657 },
+  { -27377893,7801211,7241614,-5412018,5608568,11330892,8761420,5000679,13049303,10616180 },
+ },
+ {
+  { 29583013,-9626489,-134286,-5210291,28361116,-3257807,-28463622,3274402,-5080618,-1286197 },
+  { 19831286,5139494,-17663930,13484886,26655153,10936561,12454402,-7098060,20356571,10360229 },
+  { 30729083,-8057266,-16670360,11726414,-4625536,-11733925,-7788618,14222851,-5250209,-2168959 },
+ },
+ {
+  { 1242544,1715612,-30850216,-13283410,14411897,5951090,-15955317,13461368,8084288,1661886 },
+  { 16328849,-4932083,-9761319,1115002,-1040059,6922267,-27769502,-4016848,-28963249,10386838 },
+  { -11238562,-8056781,-11034174,9968000,-11441239,6471277,13752143,-15353846,11866294,-10994706 },
+ },
+ {
+  { 19963439,-12506301,29407115,-8458228,-32790668,12081594,2274827,-10808634,-29671206,10884218 },
+  { -8556327,-5149864,-11965975,14777772,14736176,-8679060,-16069552,12502076,-208184,6250601 },
+  { -1330261,-1942081,1871644,8734006,-11851150,5754624,19780144,-2873558,-29804240,2280701 },
+ },
+ {
+  { 7691453,8109451,9211176,13046119,4928041,5312322,-9428426,6766313,-18039509,375034 },
+  { -27650722,3108017,-9216163,-12263114,-208606,-2164990,978387,14554894,-14692912,-11032588 },
+  { -33081780,-15220393,281305,9277149,-6559428,6880767,20314438,-1349323,-4458282,-4799825 },
+ },
+ {
+  { -13199789,-13880397,-28472265,-10618250,-12994212,5316892,-11907531,16625367,-5263807,9685926 },
+  { 5441436,-11638526,10186809,-8135709,31425571,-6184814,-1818327,11361119,33180392,-5353692 },
+  { -13864517,-8962532,5066339,547158,-12875946,-591805,-26414646,7668693,28468126,10333358 },
+ },
+ {
+  { 16544754,13250366,-16804428,15546242,-4583003,12757258,-2462308,-8680336,-18907032,-9662799 },
+  { -2415239,-15577728,18312303,4964443,-15272530,-12653564,26820651,16690659,25459437,-4564609 },
+  { -25144690,11425020,28423002,-11020557,-6144921,-15826224,9142795,-2391602,-6432418,-1644817 },
+ },
+},
+{
+ {
+  { 31879134,-8918693,17258761,90626,-8041836,-4917709,24162788,-9650886,-17970238,12833045 },
+  { 19073683,14851414,-24403169,-11860168,7625278,11091125,-19619190,2074449,-9413939,14905377 },
+  { 24483667,-11935567,-2518866,-11547418,-1553130,15355506,-25282080,9253129,27628530,-7555480 },
+ },
+ {
+  { -16358878,-12663911,-12065183,4996454,-1256422,1073572,9583558,12851107,4003896,12673717 },
+  { -1731589,-15155870,-3262930,16143082,19294135,13385325,14741514,-9103726,7903886,2348101 },
+  { 24536016,-16515207,12715592,-3862155,1511293,10047386,-3842346,-7129159,-28377538,10048127 },
+ },
+ {
+  { -21278553,-6072320,8490289,-10836365,-4075270,-6316075,17090014,-7311317,6693065,5996898 },
+  { -24756121,-13297480,9506171,7614624,5789114,-15141643,-1032577,1810334,32205562,11185459 },
+  { -24483750,-1309509,-13748660,-6585594,29000503,-15278358,-26622727,97875,-21125378,4748377 },
+ },
+ {
+  { -11299124,15664638,15253659,12490691,27761291,-12670010,5164283,12212424,-10276126,-8288808 },
+  { -3240036,13514210,17935985,-15594547,-19359388,-11456146,29773433,12133902,-579801,-14398926 },
+  { 21030896,5096381,-32200700,-5435505,2376540,-16336889,-27957586,4630727,-11103153,-5707879 },
+ },
+ {
+  { -31519842,-3080072,15405259,13836713,28263557,-7451960,4913130,3631635,1186637,-8265334 },
+  { 28702401,-9396513,16043549,7058722,-2273212,1698242,-4727728,-3334935,-32853008,4980678 },
+  { -19043505,977678,-28178689,-5840877,16319278,-1869693,-3648041,-8262182,27789182,-1873636 },
+ },
+ {
+  { -783681,-1830880,-27635050,-8749223,-11010662,12327012,-6079838,4192874,-33137291,-1787460 },
+  { 28871833,-10458244,-16580862,-12480789,-28222537,735245,-17901325,-5128244,-16837981,-2955687 },
+  { -19277765,1360897,14639304,-13450208,28663069,-13882761,26043957,-2693879,23006997,16373845 },
+ },
+ {
+  { 32045881,12734144,10367801,13684803,-27222428,13119591,23531643,4923977,29569834,-3967947 },
+  { -8625002,5530070,-32014115,14278914,-29162159,-6906044,-33551754,-3159897,29670721,9199780 },
+  { -367711,-12593921,-32639112,15391485,-11169809,-15494750,15639250,11675013,-7478643,-14833554 },
+ },
+ {
+  { 302749,6657501,-22715468,-15939598,-1100357,5387943,31893606,14439993,-2885244,8223521 },
+  { -7277574,-11169736,12407514,7790545,28371416,-1884988,32998573,-3472226,-1756973,-16113030 },
+  { -24327307,13168845,31273439,4123707,-21165432,-333929,32337455,-1432545,-21992454,9468050 },
+ },
+ {
+  { 12814131,13437069,-32094213,7982846,5407237,3462543,1986897,-15863180,-9035357,-6035454 },
+  { -4551563,10381552,-29493602,7251666,21681778,-6709767,6311770,3161025,-24767724,5391989 },
+  { -3736368,12381987,-3672087,-13842074,-22746059,3747593,-26678946,4739275,-10108950,-434740 },
+ },
+ {
+  { -33211392,-13394939,19119895,5372356,5903064,-16278561,-20851525,1862578,-7702350,-10695433 },
+  { 22364507,6458329,267401,-15218100,16279028,-5148466,-25972684,-11697922,-8211878,13705223 },
+  { -25108544,-10686578,-14453656,-12532366,-25622749,6232287,21422470,-5290959,28330158,-6319871 },
+ },
+ {
+  { 28003379,4599731,-17745541,-902957,16200588,-78301,-3217324,-7417063,-29746051,-1417289 },
+  { 31427263,13131310,-5444013,10818477,12058150,-10597794,-11498932,-15337955,-5655533,11960822 },
+  { 1911196,-8525160,-3211408,-13115884,16516890,2062696,-8020041,-11550231,19412410,-13072005 },
+ },
+ {
+  { -25117768,12527257,-16699435,9936927,9083964,-226016,-14656114,8242746,-10581035,11475289 },
+  { 24025353,-6056469,828733,4217393,20072835,-14763189,4396883,1239008,-313127,-9499874 },
+  { 23834003,-8968214,16489755,-1118006,-6930746,-15179868,-23497421,-16380669,-5229400,8353201 },
+ },
+ {
+  { 28259121,-3627655,-25108049,47989,-5297537,-361313,-28765922,13329393,-32131714,2207381 },
+  { -22644519,13051469,29016031,2010550,-15662813,10069233,-19708894,-11799108,12971524,-7354932 },
+  { -20011298,-12626723,-23782713,2716810,738068,5721333,-18701540,-13502948,20961349,2392694 },
+ },
+ {
+  { -5125307,-5293529,27733640,-1100191,-8748525,10255767,-28714923,-16225793,-1434922,13972823 },
+  { -1263640,787046,7917005,15954962,-750220,15365766,-10676341,-6127853,-32487506,-14860572 },
+  { 55710,2666502,17445455,-1778469,1703577,-15101826,-28939376,186546,-3099292,-9179415 },
+ },
+ {
+  { -1289418,-5712208,23403851,7118402,-12483907,3699232,29089270,12062477,-5706514,2425180 },
+  { -1466102,16277658,-17533681,6382911,-20237494,-8461927,-25690186,-13448594,28767420,-13501797 },
+  { -23819514,5930938,-23605531,-12492054,-10341737,3614089,30303206,14890036,27102966,-2753878 },
+ },
+ {
+  { 30996412,15313227,22541186,6420462,11988094,587701,-15130577,-12799292,-31736211,-14474619 },
+  { 31201534,-13065451,24879437,13212879,-7373190,14870099,-31354440,-8270026,3386957,14155263 },
+  { 23356504,5676822,-20791416,12454214,-12021045,-280301,-18553725,-693241,19350570,-16032092 },
+ },
+},
+{
+ {
+  { -21952652,-4845097,-18293584,-16548214,29691257,-16624078,-4118681,-3185018,32147346,-13870944 },
+  { -18991199,-9788391,-19124071,26861,17331860,9585369,21174325,1789712,10916049,15825177 },
+  { -8309868,4224323,17111608,9156467,-8677316,4154378,-12301924,-16170601,-27299851,-7991530 },
+ },
+ {
+  { -12622226,-6204820,30718825,2591312,-10617028,12192840,18873298,-7297090,-32297756,15221632 },
+  { -26478122,-11103864,11546244,-1852483,9180880,7656409,-21343950,2095755,29769758,6593415 },
+  { -31994208,-2907461,4176912,3264766,12538965,-868111,26312345,-6118678,30958054,8292160 },
+ },
+ {
+  { -12708917,8335300,-9154327,-5196572,20106230,-2496239,-23145960,-4750508,19350003,-1402411 },
+  { -9279942,-8817415,6973579,-15092214,24523517,-7426296,13229454,-15796697,28353369,1438806 },
+  { 24157664,183307,-10474847,-3142563,16332077,4820687,-29088952,-14474108,20364090,-10522343 },
+ },
+ {
+  { 31429822,-13959116,29173532,15632448,12174511,-2760094,32808831,3977186,26143136,-3148876 },
+  { 22648901,1402143,-22799984,13746059,7936347,365344,-8668633,-1674433,-3758243,-2304625 },
+  { -15491917,8012313,-2514730,-12702462,-23965846,-10254029,-1612713,-1535569,-16664475,8194478 },
+ },
+ {
+  { -9325958,10940017,-7653183,6883682,-15966295,-16737629,3143781,4207716,4015874,16631961 },
+  { 32172961,-11937025,-31953715,-12793853,29121863,11311469,-29238510,10124811,6610555,-8432110 },
+  { 18671776,3556470,-14226237,6625511,-18470937,-4466713,10423551,7745330,28603575,10767153 },
+ },
+ {
+  { 27338066,-7507420,-7414224,10140405,-19026427,-6589889,27277191,8855376,28572286,3005164 },
+  { 26287124,4821776,25476601,-4145903,-3764513,-15788984,-18008582,1182479,-26094821,-13079595 },
+  { -7171154,3178080,23970071,6201893,-17195577,-4489192,-21876275,-13982627,32208683,-1198248 },
+ },
+ {
+  { 15952913,-11686366,19536607,-3078894,32555055,15084943,-3711374,-11281793,24831830,-5594168 },
+  { 12561094,6249054,11826537,-1209879,-511574,2092181,-905141,-9704670,2791467,1962676 },
+  { 19330412,-2656349,-14774076,-15427677,1792419,6343978,15924356,10739984,8996679,-12576742 },
+ },
+ {
+  { -16657702,2817643,-10286362,14811298,6024667,13349505,-27315504,-10497842,-27672585,-11539858 },
+  { 15941029,-9405932,-21367050,8062055,31876073,-238629,-15278393,-1444429,15397331,-4130193 },
+  { 8934485,-13485467,-23286397,-13423241,-32446090,14047986,31170398,-1441021,-27505566,15087184 },
+ },
+ {
+  { 15354728,14499154,-4065710,3753560,-14313922,-1838025,-23745039,-9846471,-23272273,476290 },
+  { 20648388,-4610680,-12087289,4470101,-9227670,3164826,4916086,7417363,-953297,-10083009 },
+  { 21592621,-2530084,33446941,7814437,-12084642,16180098,-4510243,12471603,22857658,8897890 },
+ },
+ {
+  { -18357243,-2156491,24524913,-16677868,15520427,-6360776,-15502406,11461896,16788528,-5868942 },
+  { -1947386,16013773,21750665,3714552,-17401782,-16055433,-3770287,-10323320,31322514,-11615635 },
+  { 21426655,-5650218,-13648287,-5347537,-28812189,-4920970,-18275391,-14621414,13040862,-12112948 },
+ },
+ {
+  { 3276286,-16553268,1273957,8087357,23524421,254080,-11432775,-6684677,10953068,-3665264 },
+  { 5182811,-6137595,19716489,-9216177,-19148851,7558065,-27374072,-9233287,21330231,10952707 },
+  { 26661595,-2553588,-11000021,4679715,-28318213,-5784078,4321129,-6799694,-16658617,-1961602 },
+ },
+ {
+  { 11293895,12478086,-27136401,15083750,-29307421,14748872,14555558,-13417103,1613711,4896935 },
+  { -25894883,15323294,-8489791,-8057900,25967126,-13425460,2825960,-4897045,-23971776,-11267415 },
+  { -15924766,-5229880,-17443532,6410664,3622847,10243618,20615400,12405433,-23753030,-8436416 },
+ },
+ {
+  { 31907191,360470,-6461662,-12284417,-10873412,-5836151,13025036,-5009930,-16245676,11837900 },
+  { -12297645,6775867,-25477139,-12125296,20573551,-9899000,-31091916,-16360086,-11937297,-11521528 },
+  { 6711013,-578677,12021051,-4107444,-8078088,-5573219,12119399,14924091,-7926857,13701969 },
+ },
+ {
+  { -7091295,12556208,-20191352,9025187,-17072479,4333801,4378436,2432030,23097949,-566018 },
+  { 4565804,-16025654,20084412,-7842817,1724999,189254,24767264,10103221,-18512313,2424778 },
+  { 366633,-11976806,8173090,-6890119,30788634,5745705,-7168678,1344109,-3642553,12412659 },
+ },
+ {
+  { 31907558,-14787067,-3571053,6455344,-5466409,4641851,-24878893,-12491578,-3357325,6762968 },
+  { -14266476,-3696879,-11283007,-476108,-5769932,-5868702,8899510,4142868,9499430,-15674762 },
+  { 17458947,-9291617,9615471,-6223386,12893526,-4066884,-21694596,-8930757,26263530,-10258089 },
+ },
+ {
+  { -24001791,7690286,14929416,-168257,-32210835,-13412986,24162697,-15326504,-3141501,11179385 },
+  { 18289522,-14724954,8056945,16430056,-21729724,7842514,-6001441,-1486897,-18684645,-11443503 },
+  { 476239,6601091,-6152790,-9723375,17503545,-4863900,27672959,13403813,11052904,5219329 },
+ },
+},
+{
+ {
+  { 7030396,10563936,1008588,-2147605,-15213978,-8859037,-1266598,-9563795,-22536999,16130906 },
+  { 207890,-9611941,-12101257,-4634292,-8534457,-1211972,-4615337,8304704,-4813856,-3754077 },
+  { 5166985,-6380344,29708655,6094085,30981931,-3258233,-661961,-626972,22609670,13681032 },
+ },
+ {
+  { -25480761,8798667,188316,-5418308,20310898,-12086492,20665156,-8560168,30539173,-4868491 },
+  { 32882505,-9934344,1203212,-9526373,10032630,-3394826,-27771974,-413956,23711190,2717266 },
+  { 28344707,6906554,-15637418,-7468318,-633022,-16120552,9550659,7066928,-5523469,13426995 },
+ },
+ {
+  { -31356019,-15163766,25962104,16661824,-5635384,-12673305,5805452,733835,-2039053,1935647 },
+  { 10667976,-1533437,33245070,2325938,7160328,3266270,26889770,-7258774,16169082,-11935026 },
+  { 1455981,4291973,24414812,-4969121,-5087555,-5866441,-10845422,-10476323,24067408,-9190495 },
+ },
+ {
+  { 28525224,-5010353,-16918570,14426478,-13726323,-8449040,-30207935,12115218,-22747283,7229667 },
+  { -18298188,5905607,-27738407,16145021,24674768,13483070,-23203130,-4266571,-31024783,12023803 },
+  { -26279123,1957766,6623562,-7832131,1699048,-15745674,-18558207,-14638299,-10696895,-4725034 },
+ },
+ {
+  { 13295188,-993582,5119388,16617876,27926812,10492778,19206688,-1757567,23069622,-14911138 },
+  { -606769,4606538,3754072,-3014165,-29473210,-6414494,-30592186,-935036,-8368447,5658642 },
+  { 15546303,-5313301,27089747,-5289724,32018575,11451106,-30533604,-3808102,-16923173,-12382885 },
+ },
+ {
+  { -13518473,-10012729,-10585602,2909481,-3007834,9183109,12137205,-8387951,31011501,-2021041 },
+  { 29557528,-13643568,-4603588,9181377,-4528104,1976738,14706542,11933743,9466867,7798254 },
+  { 16533792,8288197,-219725,6693453,31142616,-3211261,26631667,1922178,-30060800,16666465 },
+ },
+ {
+  { 31541624,-16468898,-1319594,-6430880,-112384,6540840,-13503997,12577119,-25093537,4148743 },
+  { -33239400,16374312,-26726352,15737395,27147996,8973740,16959411,-13412942,20263601,-9007805 },
+  { 3596135,-5555415,-19063221,-12225713,4337030,-10681492,12805558,-1440741,-6296021,-6986401 },
+ },
+ {
+  { 184492,5252852,-13314120,2993767,26843145,14583276,12509821,-1986490,11971966,784973 },
+  { 16909071,2891754,-30902827,-11033825,-1953318,7895649,4305694,9765558,21505658,2337476 },
+  { -4724108,-12828620,5610988,-6484390,9053657,15893986,-16373145,-11879782,4759879,12649008 },
+ },
+ {
+  { -30924448,4649014,-15361922,16270858,31714656,107669,2209995,-12802100,-25654383,-12399734 },
+  { -12140790,15455924,-6424621,-8267926,19891041,11279446,-19296730,2574771,-18462040,-1788928 },
+  { -5671072,14626162,-24704092,7610005,30384520,-1342910,-11893614,-12144566,-12009103,-8615882 },
+ },
+ {
+  { -3416568,-13252740,-18294243,-9033224,30419312,8347544,11948712,10533477,17395550,1669924 },
+  { 18399424,-2591112,12011535,6493037,21856190,6781557,-13136957,15155723,-25322852,-5421855 },
+  { -11005630,-14259534,-32676404,7892682,7658864,-3297042,4856198,4391270,7899383,14447090 },
+ },
+ {
+  { 19040224,-16028772,-2021508,-5331437,9898276,-6544097,27756703,-11214091,21900752,567340 },
+  { -11792585,2485093,17253851,-7460462,13528853,6903115,-11904604,3474079,4134234,3834930 },
+  { 18492120,921907,-29754665,3518473,12545487,9065141,-17183859,-6286505,-21543910,-9305172 },
+ },
+ {
+  { -24151113,-11633389,-16139042,-5790260,7995755,-3082528,-23607252,-12903200,-18630428,-14056531 },
+  { -21495927,8324688,17590058,6521210,-31989651,-5894442,-3029019,15863173,12105538,-16594537 },
+  { 22234366,-6780713,17379533,-291381,3527589,2634384,23030395,1994175,32268183,15512722 },
+ },
+ {
+  { 18837828,-16077763,28360953,4153046,-28887020,14165081,-17732033,-5726152,27689755,16076987 },
+  { 27547248,-14389531,-28087309,11125640,-30152308,-14400952,-29646177,-3280989,5822614,-14273476 },
+  { -17818651,-12057190,26173247,-7258734,32298306,4713502,26672948,4741318,-1681943,-16135972 },
+ },
+ {
+  { 11795510,-10008267,-32422197,14252135,30593358,3336763,10754416,8420270,-20426478,-1222980 },
+  { -9919852,-13466992,-31694102,-9041325,31189785,-2978527,20462252,435529,-290928,-10949935 },
+  { 30215222,-4612200,-9289638,751405,-8897204,-6493413,13360582,13122079,-15621685,-2367603 },
+ },
+ {
+  { -8372490,-13524773,-19804920,15624394,23909758,-4515917,17666420,12232825,-24706236,-9037727 },
+  { -18414563,15037749,-28115623,-5630895,-18674486,6272362,-12419605,10947232,27197497,-12665951 },
+  { -28563814,-7549633,22308726,-6190887,-12140211,-3112867,-5851388,-10593336,5716729,-15920919 },
+ },
+ {
+  { 20678546,-8375738,-32671898,8849123,-5009758,14574752,31186971,-3973730,9014762,-8579056 },
+  { -13644050,-10350239,-15962508,5075808,-1514661,-11534600,-33102500,9160280,8473550,-3256838 },
+  { 24900749,14435722,17209120,-15292541,-22592275,9878983,-7689309,-16335821,-24568481,11788948 },
+ },
+},
+{
+ {
+  { -3118155,-11395194,-13802089,14797441,9652448,-6845904,-20037437,10410733,-24568470,-1458691 },
+  { -15659161,16736706,-22467150,10215878,-9097177,7563911,11871841,-12505194,-18513325,8464118 },
+  { -23400612,8348507,-14585951,-861714,-3950205,-6373419,14325289,8628612,33313881,-8370517 },
+ },
+ {
+  { -28236598,-3390048,12312896,6213178,3117142,16078565,29266239,2557221,1768301,15373193 },
+  { -7243358,-3246960,-4593467,-7553353,-127927,-912245,-1090902,-4504991,-24660491,3442910 },
+  { -30210571,5124043,14181784,8197961,18964734,-11939093,22597931,7176455,-18585478,13365930 },
+ },
+ {
+  { 22258397,-16332233,-7869817,14613016,-22520255,-2950923,-20353881,7315967,16648397,7605640 },
+  { -8081308,-8464597,-8223311,9719710,19259459,-15348212,23994942,-5281555,-9468848,4763278 },
+  { -21699244,9220969,-15730624,1084137,-25476107,-2852390,31088447,-7764523,-11356529,728112 },
+ },
+ {
+  { 30322361,-6964110,11361005,-4143317,7433304,4989748,-7071422,-16317219,-9244265,15258046 },
+  { 13054562,-2779497,19155474,469045,-12482797,4566042,5631406,2711395,1062915,-5136345 },
+  { -19240248,-11254599,-29509029,-7499965,-5835763,13005411,-6066489,12194497,32960380,1459310 },
+ },
+ {
+  { 14989411,5639935,1640166,-2986041,-9639640,-1697382,-16469253,9139638,-29082437,-1015563 },
+  { 5723879,-4415315,25050177,-959064,-9923481,-4302987,30419953,-9510369,-11188667,-8219838 },
+  { -8925514,3739449,19808605,-2134211,-25250281,-5864638,30124877,2748787,2413248,-13309148 },
+ },
+ {
+  { -2368803,13277518,30569682,7432502,-13919070,11526808,8992258,9722245,1226997,-16521326 },
+  { 31265709,-12142106,-21928460,861193,25833514,-14980234,4070722,-383845,7107611,-8511726 },
+  { -16186671,13608974,-22598119,5178659,10858093,1484245,3534509,-11917410,-26738784,-585806 },
+ },
+ {
+  { -26035860,9186127,6509476,5822002,5097214,-13667001,-11920884,-3307585,-7963664,8373492 },
+  { 15255041,1485481,-11134680,-3399026,24396304,840064,10797533,12267021,-16086769,5690341 },
+  { -319081,-14073353,-24249582,15872868,4065882,-8252072,30062461,-2327719,-308827,10265703 },
+ },
+ {
+  { 33464231,6447153,-21430216,-11826305,-13265506,-6971257,2286057,-13610964,-14259000,-4674051 },
+  { -29884627,-13249106,-31941316,8277056,-5164846,-276552,-20364550,-11470373,7945759,13374677 },
+  { -3975518,596542,26638736,1100986,-25712918,-4713631,-7254437,-11774601,-5833748,-15497210 },
+ },
+ {
+  { -13111710,12756149,10131895,9321459,7549967,-4510955,-2786470,-2555620,22178714,-6721503 },
+  { 4265000,-11442736,-14617681,-11771039,-18320081,2593676,20614290,7789156,24781356,-16202666 },
+  { 23717031,-7086952,-27277668,14540133,-15702080,-13668570,-20630317,-12529027,41333,13250188 },
+ },
+ {
+  { 1124052,-15916188,24220918,422168,-13104582,-14810704,6226434,-4858098,-7585431,-15623636 },
+  { 24741568,-12477045,18735536,-9554464,5565333,7851356,33245416,-7243016,22530828,3293031 },
+  { -32730003,3214629,-21727355,-13277551,5133359,-1506946,30356650,8234585,-16470652,-5790937 },
+ },
+ {
+  { -29005714,8557316,12884258,3617520,25969191,1059571,-16474386,1025690,-30728422,-10420795 },
+  { 9724371,7905376,-82801,-2986735,-24171993,12654970,25697833,-13430442,25876698,8454248 },
+  { -25075956,-12796928,-29509385,11027546,32631735,-8115366,-8038707,-6626501,-10783322,-15929744 },
+ },
+ {
+  { -27933764,-15414147,-12185895,-15228070,12795029,13517299,-23861048,-11865301,-9181111,12812450 },
+  { -8696775,-5365369,-14499350,28331,-1068043,-16315554,-11745153,-4853120,-32125475,-6323158 },
+  { 15705120,-11382070,-9344356,4013531,24328267,-14815375,-4309724,5107,20474238,-2273852 },
+ },
+ {
+  { -1776198,6887358,-13821374,-1741360,-11583051,-5420345,-29316583,6644263,14867940,-5935889 },
+  { -19711431,-3578425,-19130508,615021,14747366,12187130,-28312836,-9205562,-9379352,15463495 },
+  { -16924883,-1144929,-29281919,-2914778,12588790,-16493583,-25752001,1501126,-13479280,8242627 },
+ },
+ {
+  { -1031755,-9184058,-10240857,3047341,-10927015,6131046,-25988241,-12647589,29781822,14823927 },
+  { 2680730,11642643,-16887572,-4028029,-21747008,5081906,1733111,15706686,-5646054,4708620 },
+  { 28356583,-5949664,-27418417,-4153313,-5419642,-1756743,31483741,7251067,-12660474,2486781 },
+ },
+ {
+  { 20053289,12162479,8802657,4470857,25358675,5211000,-12851576,-10259987,29084163,-7751 },
+  { 8164507,-6195075,-12564454,3308522,32177680,2736399,17138146,-12590169,-24633977,-2793800 },
+  { 33505807,10001101,3611713,-4821569,30552252,-15767195,15480267,16119360,-21264301,-15712790 },
+ },
+ {
+  { -20287776,736494,1593599,-997467,23084581,320855,9962387,-8150863,2452762,-5067349 },
+  { 14333831,11129045,6510744,-1936008,-29788879,8621848,-32380639,10311406,16158158,-2987994 },
+  { 12705395,-514037,-18121828,-356821,825752,-12927253,-31885180,12633474,21813176,-5627776 },
+ },
+},
+{
+ {
+  { 12233317,14834208,-25048942,2593837,20079295,5523638,22269394,-3146263,17455019,-11934956 },
+  { 2806510,-12366339,-8478133,2409744,-30547072,-7779149,25411866,-6190166,14935193,729401 },
+  { 21760935,-9167606,-600918,-3737400,-2788069,-5340313,-630073,2932238,-26732275,-10348194 },
+ },
+ {
+  { 22558130,-11266301,9265731,4186438,11042895,-1415602,5298117,-3939180,-7728847,-15727911 },
+  { -7332260,-22252,-17809020,-4649946,11283903,-15410296,-14207,2645169,-10192806,14437437 },
+  { -18015805,7199014,-28965056,-7902828,13074475,-3533391,21244866,-2561471,7711948,1747686 },
+ },
+ {
+  { 8172977,-11097200,-3200100,240783,11679624,10815900,18520167,-718077,14163065,-9103282 },
+  { -2046039,7950157,-23625292,-2779253,-25010909,-1621857,25466017,13673477,-18892937,14140641 },
+  { 24497818,-7431753,-31959599,-9225314,31804119,9755134,17243589,3797992,-9966819,-16533793 },
+ },
+ {
+  { 19852034,7027924,23669353,10020366,8586503,-6657907,394197,-6101885,18638003,-11174937 },
+  { 31395534,15098109,26581030,8030562,-16527914,-5007134,9012486,-7584354,-6643087,-5442636 },
+  { -9192165,-2347377,-1997099,4529534,25766844,607986,-13222,9677543,-32294889,-6456008 },
+ },
+ {
+  { -14086317,-16446700,27173569,-1776008,22502239,-14921721,-29705638,15997986,20097099,-16621995 },
+  { -19442519,6442733,-25358132,592229,-12095120,3279646,-25994264,13153184,-32192036,-14923735 },
+  { -31938619,-14051887,25288813,-11962048,27155504,16415583,23129692,-11245444,28091739,2530997 },
+ },
+ {
+  { -14387758,3367720,-18834161,8958280,32832172,14016506,7792226,-16751697,-5004105,-12084538 },
+  { -20891008,-11267666,7810735,853858,-13544260,-11925430,-5920573,833522,-20338484,14373232 },
+  { -27956159,1839074,30903787,-4071482,26799694,-13456781,19439231,8106367,15112633,-11824498 },
+ },
+ {
+  { -14228847,-2709402,-20994531,-14062792,-21808853,282276,19087141,8696936,14629942,-11600236 },
+  { -4348753,-15987779,1357757,9701250,-26881709,-8985848,29481074,3308220,-11613317,3959574 },
+  { -23948240,2784941,27658808,9978451,32024346,-7462061,-3082376,-11911834,28989534,12255980 },
+ },
+ {
+  { -2444496,-149937,29348902,8186665,1873760,12489863,-30934579,-7839692,-7852844,-8138429 },
+  { -15236356,-15433509,7766470,746860,26346930,-10221762,-27333451,10754588,-9431476,5203576 },
+  { 31834314,14135496,-770007,5159118,20917671,-16768096,-7467973,-7337524,31809243,7347066 },
+ },
+ {
+  { 3726090,4172485,17671261,-16756452,12296416,10386182,26754564,-5164171,-9520145,889881 },
+  { -28881832,-5497732,-29530544,-11406097,-5666715,4698992,-17934763,-7911760,-24566579,-5458166 },
+  { 18604338,4503882,-19702828,-15684236,4536680,6147654,999443,5106248,18072214,-3575380 },
+ },
+ {
+  { 23714325,16625584,24233226,14843819,-15131472,3633216,29744497,2919717,24827756,-3255838 },
+  { 3255451,2085018,19128936,-2155747,31392170,-15065400,-21424121,-2213769,22293421,-8759475 },
+  { 26201334,-8363777,11995529,-7966058,-26782770,-3483252,15353899,6925632,670970,-3917790 },
+ },
+ {
+  { 10384511,-12969788,-19856657,10915879,-7691895,4492720,16352046,10797632,-8979019,-1123927 },
+  { 20397822,-13285385,7346198,-8504036,-29084324,-8495476,16899734,14931950,-13554021,14514997 },
+  { -20248702,12685066,16778639,7490264,25018482,3523509,24958353,-12615174,15048002,489901 },
+ },
+ {
+  { -9606723,-11874240,20414459,13033986,13716524,-11691881,19797970,-12211255,15192876,-2087490 },
+  { -12663563,-2181719,1168162,-3804809,26747877,-14138091,10609330,12694420,33473243,-13382104 },
+  { 33184999,11180355,15832085,-11385430,-1633671,225884,15089336,-11023903,-6135662,14480053 },
+ },
+ {
+  { 9801247,13126175,-23954393,-13541932,-2743039,10035638,-24455653,12597709,2882642,-7363134 },
+  { -4530839,7698472,8747132,5803074,-17095133,14212241,-5813744,1275784,27937543,-5251661 },
+  { 26563193,-13185352,21826890,5925671,30101857,-3134149,12540498,-13642740,15737688,6002520 },
+ },
+ {
+  { 21487358,-7236003,16456317,-437449,-6218834,5936684,32080572,-1426786,17014562,10800944 },
+  { -16299633,-10130398,5442731,11049968,-20329053,-622205,-33433780,-3012123,5681051,16323226 },
+  { 11555755,-15066764,-19381707,15485982,-5318886,13011221,-3889239,12575173,31917967,11480537 },
+ },
+ {
+  { -24041384,1998095,2837015,-16119376,-2391569,15537436,26390771,-11904513,14937657,-13545568 },
+  { 26315735,-4095870,30283640,9004127,-2566652,14045326,12983031,-4202226,-20765081,4289862 },
+  { -4224990,-7714443,-12901336,9762736,20536074,2524923,18169693,1607655,1957895,-4696700 },
+ },
+ {
+  { 31308717,-5619998,31030840,-1897099,15674547,-6582883,5496208,13685227,27595050,8737275 },
+  { -20318852,-15150239,10933843,-16178022,8335352,-7546022,-31008351,-12610604,26498114,66511 },
+  { 22644454,-8761729,-16671776,4884562,-3105614,-13559366,30540766,-4286747,-13327787,-7515095 },
+ },
+},
+{
+ {
+  { 30098053,3089662,-9234387,16662135,-21306940,11308411,-14068454,12021730,9955285,-16303356 },
+  { 9734894,-14576830,-7473633,-9138735,2060392,11313496,-18426029,9924399,20194861,13380996 },
+  { -26378102,-7965207,-22167821,15789297,-18055342,-6168792,-1984914,15707771,26342023,10146099 },
+ },
+ {
+  { 2645815,-14611604,18609641,8535934,-31634334,2135963,-26195716,11481775,-33122795,3726902 },
+  { 20621035,10751310,-29776383,-7534242,11354181,9683490,-312328,-9064604,-7558269,-15980792 },
+  { -16295339,10771553,-287937,9656325,19885419,4058894,14063211,-15798523,9920468,1982229 },
+ },
+ {
+  { 30934294,-5787097,-6689457,9100960,25913411,5008364,-3635366,-7032226,17811501,-15434848 },
+  { -29386098,-7077867,-16100197,9583635,115453,-9725187,-10836585,5130516,-758596,-14126998 },
+  { -19137900,4915975,7535182,-12378285,22790690,-13539279,-966206,12958334,23657150,-9009722 },
+ },
+ {
+  { 3385738,1234670,-26862528,-10392990,17948024,11331859,19006271,1386324,-29533984,10262724 },
+  { 8884032,-1096438,3420412,15266977,5052635,-9223773,-1791853,-6878749,12243607,-8919499 },
+  { 13175655,-1838021,-21807507,14192674,-4193002,-10962788,19914268,-13253426,-22594958,-15951981 },
+ },
+ {
+  { -250736,-489920,-27328393,3343384,-13472583,-4543170,-24936605,-13605439,4846048,-555195 },
+  { -2576652,14929434,17138222,11951936,-6129469,13144837,26400673,15176797,-23337686,-8347009 },
+  { 21242256,5156726,-13508835,6011363,-3271691,-11242269,30843428,-9530680,27866984,4629413 },
+ },
+ {
+  { -9833040,-15161676,-8479323,7793366,11085939,11720315,-18542677,8758951,17054491,-9031261 },
+  { -12831578,-9323567,-15176528,16516832,26533242,-13161042,-23682258,-14096128,-6842648,-14312786 },
+  { -4969699,13325177,236998,-10963677,-10405527,-7625755,-31704188,8843013,-12483346,-2116485 },
+ },
+ {
+  { -13520712,-7590255,-1188232,1827642,-13551168,10673876,28480464,1405608,5601585,9858504 },
+  { -4862122,-3527795,24387940,3551336,-8994372,-11278313,31425564,-9148442,24754874,12223156 },
+  { -28498885,3720027,13089784,6902024,19408848,-9135277,-33029004,-7883515,1892272,-13345916 },
+ },
+ {
+  { -23925459,-11469272,-13057268,-11013575,-20895620,15744848,-2145197,-8672972,-17577894,-9032651 },
+  { 1587635,-13086776,-30656517,-15601168,-21250048,-10674204,25327670,-8907061,-5065168,-11828712 },
+  { 21820090,1997481,14475848,-11009831,-10710632,-8718338,31358693,-6271736,-21668179,1348305 },
+ },
+ {
+  { -13190953,10413691,-11320414,-11683398,-18415413,8845852,9802624,-12710450,-13638386,-557148 },
+  { -11849167,6826715,23071844,-4468672,13188601,-317268,-4746697,-10782556,18139611,-8581514 },
+  { -24769413,12565663,-32849987,-1590808,-25668058,10948823,-11108377,3506636,-8500614,-4923946 },
+ },
+ {
+  { -8216916,3615591,-12970109,-12210260,9353717,-13090253,-16181963,-7260055,-13730485,6915139 },
+  { 5523395,-11046983,12443554,13650176,28553428,7698891,-29613525,-12012747,-31363456,-10008309 },
+  { -26634305,13621946,-13334032,-11423550,27338201,-16075483,-17866548,11062577,10341151,-11792006 },
+ },
+ {
+  { -3292776,-8149230,6118368,10566748,-26213561,-4357204,-4419785,15946992,13625909,5240860 },
+  { -10817977,-14727705,31631930,-5950624,-19635884,12910056,33149099,4236466,32891735,4905473 },
+  { -6870228,9643124,22730871,2555072,31555317,704899,-20902175,-10849182,9676230,12977967 },
+ },
+ {
+  { 21364261,9385891,5918875,13050407,-17495288,-8505959,13319184,5657866,-695954,-2553051 },
+  { -11316261,15520182,-3909263,6124169,-789815,-16062736,-28925845,-9717387,-27308163,10194668 },
+  { 26605796,16165329,-2718620,6040534,-8805838,5845615,-28882162,-15251463,10575004,2931151 },
+ },
+ {
+  { 32832092,-11089580,25771976,5752554,22111972,-6962811,-11494989,4155939,-18998500,-13959844 },
+  { 3619460,-13178301,-31525840,-9758006,12898910,7852281,12265313,3389434,14964112,-11370184 },
+  { -15144289,-1162548,29677890,3316177,16424326,7494639,-3232101,-1779739,-6994408,13775454 },
+ },
+ {
+  { 29375061,-1053730,-10886712,2778587,12705468,-12721249,-22469906,-10552647,1341093,358819 },
+  { 25120806,13699632,-7013673,-14689579,-25507383,-15088059,30572941,12606575,14375334,8861920 },
+  { 420427,-11922296,31356987,9546629,-27950855,7047758,-13839471,-4640667,9566447,-8955356 },
+ },
+ {
+  { 23245919,-5967794,-5028385,-3830706,27905690,12286271,-8038125,2290035,9388260,9449052 },
+  { -4461357,-2332150,6738452,333910,16951929,11215671,33283168,4092385,7175207,2576941 },
+  { -3707981,-2207694,2122607,14572621,-29136040,-16530173,-29234362,15295258,-1591485,5610444 },
+ },
+ {
+  { 20000919,9004137,17712032,-8998600,-14109397,-15991519,9814680,15274196,-6629414,-10773743 },
+  { -2897834,-14600272,-28796554,4561664,5804813,-6509305,4646191,-8579329,14298159,15481181 },
+  { -21120282,-12594607,-1099551,-15362319,24676024,5438168,-19269205,-8897236,-8851313,2132693 },
+ },
+},
+{
+ {
+  { -26016874,-219943,21339191,-41388,19745256,-2878700,-29637280,2227040,21612326,-545728 },
+  { -13077387,1184228,23562814,-5970442,-20351244,-6348714,25764461,12243797,-20856566,11649658 },
+  { -10031494,11262626,27384172,2271902,26947504,-15997771,39944,6114064,33514190,2333242 },
+ },
+ {
+  { -21433588,-12421821,8119782,7219913,-21830522,-9016134,-6679750,-12670638,24350578,-13450001 },
+  { -4116307,-11271533,-23886186,4843615,-30088339,690623,-31536088,-10406836,8317860,12352766 },
+  { 18200138,-14475911,-33087759,-2696619,-23702521,-9102511,-23552096,-2287550,20712163,6719373 },
+ },
+ {
+  { 26656208,6075253,-7858556,1886072,-28344043,4262326,11117530,-3763210,26224235,-3297458 },
+  { -17168938,-14854097,-3395676,-16369877,-19954045,14050420,21728352,9493610,18620611,-16428628 },
+  { -13323321,13325349,11432106,5964811,18609221,6062965,-5269471,-9725556,-30701573,-16479657 },
+ },
+ {
+  { -23860538,-11233159,26961357,1640861,-32413112,-16737940,12248509,-5240639,13735342,1934062 },
+  { 25089769,6742589,17081145,-13406266,21909293,-16067981,-15136294,-3765346,-21277997,5473616 },
+  { 31883677,-7961101,1083432,-11572403,22828471,13290673,-7125085,12469656,29111212,-5451014 },
+ },
+ {
+  { 24244947,-15050407,-26262976,2791540,-14997599,16666678,24367466,6388839,-10295587,452383 },
+  { -25640782,-3417841,5217916,16224624,19987036,-4082269,-24236251,-5915248,15766062,8407814 },
+  { -20406999,13990231,15495425,16395525,5377168,15166495,-8917023,-4388953,-8067909,2276718 },
+ },
+ {
+  { 30157918,12924066,-17712050,9245753,19895028,3368142,-23827587,5096219,22740376,-7303417 },
+  { 2041139,-14256350,7783687,13876377,-25946985,-13352459,24051124,13742383,-15637599,13295222 },
+  { 33338237,-8505733,12532113,7977527,9106186,-1715251,-17720195,-4612972,-4451357,-14669444 },
+ },
+ {
+  { -20045281,5454097,-14346548,6447146,28862071,1883651,-2469266,-4141880,7770569,9620597 },
+  { 23208068,7979712,33071466,8149229,1758231,-10834995,30945528,-1694323,-33502340,-14767970 },
+  { 1439958,-16270480,-1079989,-793782,4625402,10647766,-5043801,1220118,30494170,-11440799 },
+ },
+ {
+  { -5037580,-13028295,-2970559,-3061767,15640974,-6701666,-26739026,926050,-1684339,-13333647 },
+  { 13908495,-3549272,30919928,-6273825,-21521863,7989039,9021034,9078865,3353509,4033511 },
+  { -29663431,-15113610,32259991,-344482,24295849,-12912123,23161163,8839127,27485041,7356032 },
+ },
+ {
+  { 1371167,-11963634,-2450739,-3466516,-13426033,12510196,-23372232,14216383,19254350,9028193 },
+  { 18033841,-1040873,3456561,-11652378,31146754,7384082,26567076,6662240,-32619486,10608615 },
+  { -12194008,-3286666,231243,14099788,-7970909,-11833777,-10583136,-15331031,-26838109,-9560707 },
+ },
+ {
+  { 12153526,-11777326,-3068316,-8099530,27745597,-12079103,-29204950,-1690199,-10977255,-640727 },
+  { 11305745,-5085826,-3505220,3634466,-29522810,13656962,-26901287,10992053,11120354,2213014 },
+  { 4929294,11074186,1093028,-15523645,-5558686,-14198858,-18578744,-147082,5202741,4756236 },
+ },
+ {
+  { 4525036,1638467,25029482,-8695127,7889502,-7138222,2509869,-939849,-24727046,-4164410 },
+  { -20139902,3157172,-26011260,4459040,10079910,-10301950,-13961656,11589226,21912285,-9546643 },
+  { 18023022,-400919,-14598257,6839966,26295100,12720126,-11364258,635719,-24050356,-12268728 },
+ },
+ {
+  { 11296155,-5415070,546640,14821338,2804136,-3023800,29290312,6234468,-24576308,-1154020 },
+  { -2413405,-13090070,-78472,14602504,24188531,16228800,-14159026,3540566,-33145582,14829313 },
+  { -31961037,-5757656,-18938919,9349993,-24449333,2176732,-16007350,-8245301,29050938,-3537636 },
+ },
+ {
+  { -31227095,6241277,25559461,5959922,2734298,495020,-242111,-357512,-871775,-11738931 },
+  { 2402732,16202435,-31479943,-11741204,32962728,6076539,-26557856,-4490980,2262470,16010910 },
+  { 1370845,-6635877,-11413705,8028567,-22684457,7643896,-3928754,-4572684,29975657,15942909 },
+ },
+ {
+  { -3230059,5098256,-6157219,2349385,26921097,-2617527,-21362686,-1139908,29213956,-5540314 },
+  { -28675651,5706527,18921163,5303521,12266480,6329835,-15338429,-975490,28735052,-12563057 },
+  { 8989419,6067900,6669875,-2433881,-20872680,-2085317,15746033,-9247001,4487081,16014383 },
+ },
+ {
+  { 19811918,7486361,-23654029,-2107447,-14975479,4140540,3643083,7680705,-4787503,1340723 },
+  { 26486867,-1846391,-22461881,-5302984,26504326,-10608503,9150489,-10024221,25741432,14608192 },
+  { 15501251,-10502063,12226672,9175889,-26549384,7235223,24904443,-10941703,-18907114,6818938 },
+ },
+ {
+  { 12926894,-4621803,-92124,612986,27798555,11958898,-33046416,8250987,3985534,5752383 },
+  { 8181413,-14871953,-4457237,-11061318,4090619,8617513,938880,3172702,30667196,-7426963 },
+  { 2684044,-12461844,13362767,174928,1574941,-11969704,32246114,1161895,28861941,2212274 },
+ },
+},
+{
+ {
+  { 11801177,4640846,5077395,9665750,9498225,-3429443,-5986596,-6285506,-2291665,-8460019 },
+  { 20200978,-14112049,12779120,-9697954,6959529,13434826,15735530,3617225,-18109923,-14495312 },
+  { 26483408,7918962,32543625,15966796,-18494165,6700637,33515571,1468472,-7434639,3882936 },
+ },
+ {
+  { -25723383,749559,-19675269,6315202,29803999,-15976807,-12439101,4072354,28610093,-9845167 },
+  { 22405748,-3140797,23752851,13509993,28416399,-5679308,-2593577,15179142,-32711793,9985925 },
+  { 5983061,1013072,10563044,2131346,13237016,2787398,-29812650,-9612409,-4120577,-2131800 },
+ },
+ {
+  { 25827808,9068954,21900720,-16013636,-9281400,13311816,3119355,-7722955,2870698,13933703 },
+  { 33496055,12104150,1499403,4839538,5391639,-887943,-787136,-11356019,11361396,-12862660 },
+  { 20957573,10900616,-18298618,6927441,4333372,12671653,19978419,-8113718,4386085,11889846 },
+ },
+ {
+  { -15795703,760921,31196422,1661734,-16035192,-10317121,1054758,-1900255,-5602642,-8443438 },
+  { -1946508,8121488,-4182057,16298638,16335826,-8024598,-6722031,2041813,24492929,6086127 },
+  { 2461349,8450263,27141221,-10265000,-31733527,4464999,-20543849,12937142,-3491992,1221197 },
+ },
+ {
+  { -7812506,10197285,11413361,-8289960,21151428,10748620,-28338898,-8724485,-26184364,-383706 },
+  { 23346323,14983521,16593517,9295931,18122497,-2875468,18052973,2724583,2914421,3295103 },
+  { -27696063,-11013114,-1763260,1688545,11841539,-5970676,-10133574,-8212453,26672069,-5860955 },
+ },
+ {
+  { 9724821,-14705845,4599769,-12772944,-71372,-4583470,11240419,7399748,25063220,10164580 },
+  { 22614988,13581180,-5163931,-5537914,-13447438,1531748,23813086,4212358,19511379,3701482 },
+  { 25673442,13993719,-10674680,9801431,11781623,-10381868,15049914,-16415812,11658689,15001097 },
+ },
+ {
+  { 22082607,-6965245,31996701,-242888,-96681,-3374967,12957950,-937503,27892139,14622264 },
+  { 890542,16183752,-31436392,-15963693,-23127948,13173783,16570645,-8735877,29516725,13055141 },
+  { 16196079,6216915,15708122,-9096241,-454892,-11074280,-376838,-6269278,-4981206,-6533407 },
+ },
+ {
+  { 9661027,705443,11980065,-5370154,-1628543,14661173,-6346142,2625015,28431036,-16771834 },
+  { -23839233,-8311415,-25945511,7480958,-17681669,-8354183,-22545972,14150565,15970762,4099461 },
+  { 29262576,16756590,26350592,-8793563,8529671,-11208050,13617293,-9937143,11465739,8317062 },
+ },
+ {
+  { -32375823,-5899091,-14899179,1269860,-18816854,-4589626,-6680502,-14193785,4614512,11818557 },
+  { 8771846,-12129735,31831402,8569399,-20286058,16166700,10818947,-14088578,22390914,7357020 },
+  { 18316028,-10995857,30054883,434645,-18390890,-1288726,3589005,-6667083,-116706,-8961108 },
+ },
+ {
+  { 11706570,-14505594,5024933,-15705543,-28044804,12995009,-9437536,7045631,-2215237,8099202 },
+  { 24585254,5848729,13119503,11355407,17368933,6804951,13082975,-9250092,15835566,-6245581 },
+  { -7932876,16199084,-8332238,-9979421,-3029788,16223465,32761945,3886384,10959127,-9298687 },
+ },
+ {
+  { -30691237,13632902,188975,-4963952,-31808501,4840608,10299947,-1543999,-19229644,7909207 },
+  { 888118,-11161992,-19048426,-10605600,16895723,6477240,-4812039,-1689310,-30204801,2695977 },
+  { 28198609,-16197582,30497474,14291728,30903293,-14559436,-23169389,-2939629,11411839,9209930 },
+ },
+ {
+  { 22126610,-4019487,7664391,-12047256,-18091772,13783550,3744827,3618456,-9080116,3128091 },
+  { 6480364,-11417664,-9927101,9282238,-3833129,4235774,-16304954,-9701112,-30002618,16557256 },
+  { -7595023,-16327215,10144122,-302349,12989121,-10042526,-26303572,16058150,27405309,-9655399 },
+ },
+ {
+  { -28689714,11118578,-25812720,-11789381,5116579,8925601,20301666,-11835984,-10367080,-14342981 },
+  { 5451761,8677846,-21520476,-16293564,15769226,-8304750,6087357,-11082770,15582937,7836688 },
+  { 19478707,9276331,8791857,3658898,-15434882,13230784,3634459,-1756699,-12999662,12230170 },
+ },
+ {
+  { -31578038,-5587130,32851685,-11060509,-260829,-2319096,33530607,-3115114,-18336243,2621437 },
+  { 29186657,-566638,15558774,7110616,8304788,-15337057,-455083,9962376,22948155,16643510 },
+  { -2517715,-15002205,-8043018,-8580381,-23007296,-8002556,-4664795,7709648,-3481370,-12955024 },
+ },
+ {
+  { 25939867,-6758781,19523788,3037472,9745668,-16148070,-23371883,2076046,-30657950,-9424233 },
+  { -26142517,-6140338,13894618,-4672239,3862302,6939811,19412179,9316927,-6014188,-7532167 },
+  { -32170653,16323157,-25898465,10352751,-7747203,4515817,32127253,-4791204,-6328805,6724155 },
+ },
+ {
+  { -25493081,-6962928,32500200,-9419051,-23038724,-2302222,14898637,3848455,20969334,-5157516 },
+  { -20384450,-14347713,-18336405,13884722,-33039454,2842114,-21610826,-3649888,11177095,14989547 },
+  { -24496721,-11716016,16959896,2278463,12066309,10137771,13515641,2581286,-28487508,9930240 },
+ },
+},
+{
+ {
+  { -19765507,2390526,-16551031,14161980,1905286,6414907,4689584,10604807,-30190403,4782747 },
+  { -1354539,14736941,-7367442,-13292886,7710542,-14155590,-9981571,4383045,22546403,437323 },
+  { 31665577,-12180464,-16186830,1491339,-18368625,3294682,27343084,2786261,-30633590,-14097016 },
+ },
+ {
+  { -22448644,15655569,7018479,-4410003,-30314266,-1201591,-1853465,1367120,25127874,6671743 },
+  { 29701166,-14373934,-10878120,9279288,-17568,13127210,21382910,11042292,25838796,4642684 },
+  { -20430234,14955537,-24126347,8124619,-5369288,-5990470,30468147,-13900640,18423289,4177476 },
+ },
+ {
+  { 20907598,-3658942,26397451,-11073340,-31142246,14221016,-23912337,-6179376,-2206935,11321450 },
+  { -27721707,-1178700,-29627157,-1988626,-23588930,-2977307,15632966,2529522,8920405,-14369895 },
+  { -6598005,-15862216,9834460,-12919055,-9225676,7665986,-1527134,5850767,800219,8765288 },
+ },
+ {
+  { -14936374,-8966633,16035159,-12459047,-28113932,-11200577,9309498,-699242,17539307,-14268189 },
+  { -14913844,2041963,16152106,-1002060,-17493443,8032684,-16924778,-2611573,31650478,-2759542 },
+  { -21329046,-14969697,9403807,3956363,5669425,-9408529,14897968,1748830,-7404637,-7530518 },
+ },
+ {
+  { -11401669,-6353295,-11867342,13525589,33334853,13616941,-31209096,5615463,-4349959,14199330 },
+  { 11392371,245287,-8450339,12894922,27005984,16110046,-21763464,-3987569,-20988032,10340091 },
+  { -28256068,-7687616,10839938,3755982,2153761,-305804,16674549,2835922,15390659,-10028499 },
+ },
+ {
+  { -24298365,-10949360,2719184,-11441151,10404192,7741745,22729829,-3258360,-14048427,-13318164 },
+  { 7809827,-10774836,-13727819,-3487369,-14616399,-16236688,9382709,-6547782,21430925,-1595732 },
+  { 17586195,-7749845,12602025,-6814782,2636275,-9024702,-9224124,5437631,11329632,6193547 },
+ },
+ {
+  { 24623330,12920831,-12976763,2640548,-2128362,13898404,-19544286,13347865,27896986,-4845001 },
+  { 2440354,-9481499,-8303156,38052,31913742,439810,-11441383,-2846298,13161246,6743805 },
+  { -17405570,-1301657,-24801095,-243260,14758222,-15964615,-1561959,12523445,28146425,256679 },
+ },
+ {
+  { 30994596,15923823,-27241862,14674108,-9677648,-15226762,-17942848,-2109512,13169703,16280007 },
+  { 1435572,12474308,5012448,15551904,31734544,-1437433,17256602,-15128153,-25283664,-11281360 },
+  { 12238178,-14092060,17201416,-13101938,-33310834,-8847163,1861226,-771824,-30282702,11632385 },
+ },
+ {
+  { 13343421,-2001338,16844942,-8085841,12622693,3483330,9474823,6339533,-27697083,-9696812 },
+  { 23752421,-6826818,-16440381,11789163,24149177,-5221652,2156507,10001810,26553704,6101454 },
+  { -32544233,12592510,8423051,14588827,9311673,2889529,-4012258,6703731,25652444,5554237 },
+ },
+ {
+  { -3076204,-570360,26748644,3614869,16073304,-6122038,-19330883,-14250708,-22901896,8097128 },
+  { -3071920,-11163227,-28990001,-5375167,4119450,1114399,-15351966,9787566,-12371588,5822682 },
+  { -31307972,-15740367,-32978253,-13738200,-21616023,-13982309,11625955,16502673,-13087631,109916 },
+ },
+ {
+  { 26592829,-12753630,1881926,7771843,21730591,-931066,-11994512,-9441572,25683687,-15548159 },
+  { -32499392,-12629607,-4452809,-10129894,-14952759,-4798797,-537422,-2368203,15711587,15726649 },
+  { -10543280,4841925,-30369608,-5662869,-4424296,11335631,-30394716,-231653,-25808849,16508234 },
+ },
+ {
+  { -29004168,12137537,-9291644,939684,-31652565,11993054,24206801,123570,-41951,-2660533 },
+  { -16544926,10765766,32522199,-15839497,-7059235,-15890379,-887889,-8862829,-6144572,-6111558 },
+  { -31004644,7150990,31173499,-4856575,-31041115,-1017932,9215665,9314632,2100453,12738185 },
+ },
+ {
+  { 26733552,-16759218,5244066,14353645,-17771783,14577922,-23661554,16550996,-21155033,-4640002 },
+  { -8254267,16569562,-28907343,3340150,-29186359,11105895,3956718,-1056249,-26462991,12044881 },
+  { 15523454,12803498,30482376,-7629674,2862238,-7956143,-17549221,-7205947,23489776,-2918583 },
+ },
+ {
+  { -18129587,5169233,20514605,7788344,-24612795,6069640,-2518978,7811367,-21315231,-4830878 },
+  { 7610549,4398182,27957550,-7531683,-30468721,-1346505,32164955,12233118,20191486,10337829 },
+  { -1640618,-5415355,-14188560,2929921,11407001,-4824312,-17685968,9641833,3287789,4067904 },
+ },
+ {
+  { 17278017,-16596787,-4655540,-14387719,-20113327,-14733795,27976340,-3939692,18317204,-13800727 },
+  { -24162918,720024,-21565264,-13680607,-21710354,6461173,-17080527,14831294,14436775,-8991930 },
+  { 14265347,9161670,-26439401,-6624127,-4100835,2505079,-12698846,-11660796,-15039439,-4616452 },
+ },
+ {
+  { -23739239,12175642,-20909012,-6181563,5010829,13707831,17477840,7104010,-19240197,-10895057 },
+  { -477089,10341682,-31642904,-1045100,-3864955,15033511,14090074,-5701542,19720252,-13711114 },
+  { -17231175,-15554091,-31910418,-10042564,24746366,-3617448,-19512878,-11548281,68185,11397287 },
+ },
+},
+{
+ {
+  { 26159853,5695496,-13021323,3774590,-12595062,13031688,19183275,-3499173,24071151,-11664630 },
+  { -6722558,8201802,-18197574,13042281,3329729,-3134402,-12301504,-2743312,-24332108,12474634 },
+  { -24539875,-3555046,-1092694,13129722,16000542,-2442683,-8801996,13867540,31961542,-2259691 },
+ },
+ {
+  { 30302609,1507411,-4220243,5392637,27758922,788191,9475265,-11183919,16762862,5235054 },
+  { -29051828,4162144,-4529587,1751108,-7520606,-5399747,30059417,-2947431,510175,-5095005 },
+  { 22476136,5975734,-12001269,5440911,-15967132,-2338610,-16391228,-11587281,-28566992,13012347 },
+ },
+ {
+  { 31054020,-9642448,-25812524,-13265510,-18818855,-9559152,-7047756,3651547,8973260,5711572 },
+  { -27485883,-11333015,-17808654,9380696,28411667,614115,7611740,-15372528,12919770,5175887 },
+  { -24549694,-3164464,30139004,-4843751,-26029918,15639016,25092129,498114,-31159265,-15006530 },
+ },
+ {
+  { 22087786,-613395,-12326417,-9343174,27930664,8927766,-11136746,-1654639,7561808,9366832 },
+  { -1654658,8374922,9842976,-11041300,1637017,10201573,19843967,6395364,-26134599,-865075 },
+  { -33301368,8703775,-17319747,804188,11537029,10461531,25199761,-4736749,7788809,-13978315 },
+ },
+ {
+  { 13018493,3550638,-21558861,-14050824,-4800091,-944759,-22456292,629267,24941042,4700187 },
+  { 496081,7115182,-11201563,-9540664,-11620579,2791915,5749641,13291124,-6939145,-15292463 },
+  { 11812184,-9016858,17048570,7787604,-13469832,14391827,29645306,-7030476,31377244,8926488 },
+ },
+ {
+  { 31539850,11324787,32396869,-15303915,18109281,10335166,-17336601,-11566294,9343611,-4238280 },
+  { 182937,-12063171,12449732,3168715,7255236,-14996100,4517249,-9949845,11104569,-14852781 },
+  { 12160226,-14183963,-8922092,-13669649,-30700184,-13023905,2831916,-9231996,17841167,-1893108 },
+ },
+ {
+  { -20603855,16038253,-26028191,11116862,-29412383,-1332012,3939049,-1737527,-497688,13533834 },
+  { 3827553,8019713,-16243229,10307672,-4122373,9236628,-21090784,7868895,645373,-14658412 },
+  { -26842338,-10260128,-8814751,680848,7609085,-4092276,26797014,8568940,-31008831,-16261398 },
+ },
+ {
+  { 16737505,6710538,-18210707,-15198379,-1699784,-15592754,20784945,5960118,-22442069,-555262 },
+  { -28025477,1430164,-30332639,15362338,5247678,-7732403,-28675877,-3212277,16712417,-6834810 },
+  { 7311565,6622492,-22982481,-8324571,-13470589,-16299730,12240986,-9283141,-10015917,4914302 },
+ },
+ {
+  { 104280,-6856255,-8645592,6796658,8787982,-4064496,-19952562,6965643,31947395,405133 },
+  { 28904346,-12053896,2722060,6967873,796017,4556126,-18327565,5168817,-11594316,12505437 },
+  { -18052379,-16609829,-26338159,2753389,28893889,-15855815,-10499197,-13431117,-17845343,13268647 },
+ },
+ {
+  { -29643338,-11845990,-8906806,7063479,29821186,-673691,-23349469,-10772895,18232173,-4191871 },
+  { 31761095,-3309418,-28325117,15388665,-7430670,5903601,7535350,-8151157,5582731,-4724480 },
+  { -8473434,-7543342,16906249,-14536538,15631243,-16360079,33397870,3563613,9212715,2371566 },
+ },
+ {
+  { -22720789,-16171480,-32928962,5123016,33144640,5300237,6493742,-10983694,14656567,9845992 },
+  { -12959775,14211419,13856202,-943471,11106057,-7474604,16058397,3893544,-11699071,-3754937 },
+  { -29727262,-9964670,31221525,-10114203,-28422671,-1887634,24351935,560403,-17094709,-7027288 },
+ },
+ {
+  { 425136,-10399417,7373901,12384811,-8946005,-1286606,-22397716,6168978,4764366,-6349073 },
+  { -1978429,-16383699,18236698,-2328478,-10962949,-9641061,27253738,-12454450,18774216,4689180 },
+  { 24950098,7177911,12615317,7966426,-21531130,-4100442,-28171771,-1289551,3044136,1265709 },
+ },
+ {
+  { -10706276,2226476,28945730,-8033114,28036581,10258542,-2410799,1868980,-11309943,2574764 },
+  { 31905838,11553261,-5294903,-13375447,31077151,-8322482,7490875,-11827717,22534939,3053914 },
+  { -23161584,16772876,-23393777,13483232,-28355847,11476058,-28634319,839249,21617687,-16414632 },
+ },
+ {
+  { -7860916,-11922754,28304596,-4642041,-6037401,4335743,-12751001,-930503,-33521268,379546 },
+  { 22162890,10666214,23275192,15660622,-9716713,9859774,32253345,-2658732,-13872495,-15743372 },
+  { 27772336,12272246,-12553859,1129292,11276698,-3403174,-2622676,46925,-1635072,-12736534 },
+ },
+ {
+  { 1941224,-8858106,-24869531,2629262,23394166,4950610,-15038598,1886157,27731325,-11786452 },
+  { -20995785,10418557,-24821502,14788199,-4900970,6620213,-11870312,-3137260,-18216311,-2371211 },
+  { 4555321,-4386021,-20166939,-3373302,23273248,-416776,30704903,978289,31716674,-9111707 },
+ },
+ {
+  { -29519435,7721766,29306264,3034774,17603837,-6820803,8333505,15727243,-28573388,3989062 },
+  { 3796254,-7286733,15117604,3840627,18547265,4965809,-16219294,-943052,17989627,-12332365 },
+  { 8409150,-5400205,-85437,-10712296,-11943978,12843056,-29132454,-15385837,14095211,5016004 },
+ },
+},
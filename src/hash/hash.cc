@@ -15,12 +15,13 @@ HashHelper* HashHelper::GetInstance() {
 }
 
 //static
-void HashHelper::HashClean(void *data, base::WeakPtr<base::Thread>& thread) {
-  if (data) free(data);
+void HashHelper::HashClean(void *data, base::WeakPtr<base::TaskRunner>& thread) {
   if (thread.get()) thread->DecComputational();
 }
 
 void HashHelper::SHA(int type, const HashData &data, rcib::async_req * req) {
+  if (!rcib::RcibHelper::StartWork(req))
+    return;
   if (256 == type || 384 == type || 512 == type) {
     const char *p = nullptr;
     size_t plen;
@@ -28,13 +29,17 @@ void HashHelper::SHA(int type, const HashData &data, rcib::async_req * req) {
     plen = data._plen;
     HashRe *hre = reinterpret_cast<HashRe *>(req->out);
     hre->_len = (type / 8) * sizeof(uint8_t);
-    hre->_data = (uint8_t *)malloc(hre->_len);
+    uint8_t *digest = hre->_out;
+    if (!digest) {
+      hre->_data = hre->_buf;
+      digest = hre->_data;
+    }
     if (256 == type) {
-      sha256((uint8_t *)p, (unsigned int)plen, hre->_data);
+      sha256((uint8_t *)p, (unsigned int)plen, digest);
     } else if (512 == type) {
-      sha512((uint8_t *)p, (unsigned int)plen, hre->_data);
+      sha512((uint8_t *)p, (unsigned int)plen, digest);
     } else {
-      sha384((uint8_t *)p, (unsigned int)plen, hre->_data);
+      sha384((uint8_t *)p, (unsigned int)plen, digest);
     }
     req->result = hre->_len;
   } else {
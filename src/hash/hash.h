@@ -15,9 +15,12 @@ public:
 
 class HashRe : public rcib::Param {
 public:
-  typedef void(*Clean)(void *, base::WeakPtr<base::Thread>& thread);
-  explicit HashRe(Clean f, base::WeakPtr<base::Thread> thr) :
+  POOLED(HashRe)
+
+  typedef void(*Clean)(void *, base::WeakPtr<base::TaskRunner>& thread);
+  explicit HashRe(Clean f, base::WeakPtr<base::TaskRunner> thr) :
     _data(nullptr),
+    _out(nullptr),
     _len(0),
     _encoding(node::HEX) {
     _fclean = f;
@@ -31,11 +34,13 @@ public:
     assert(_fclean);
     (*(_fclean))(_data, _thr);
   }
-  uint8_t * _data;
+  uint8_t * _data;  // _buf, once written
+  uint8_t * _out;  // caller's Buffer; written instead of _data when set
   ssize_t _len;
   node::encoding _encoding;
-  base::WeakPtr<base::Thread> _thr;
+  base::WeakPtr<base::TaskRunner> _thr;
   Clean _fclean;
+  uint8_t _buf[64];  // fits SHA-512
 };
 
 class HashHelper {
@@ -44,7 +49,7 @@ public:
   //static
   static HashHelper* GetInstance();
   //static
-  static void HashClean(void *data, base::WeakPtr<base::Thread>& thread);
+  static void HashClean(void *data, base::WeakPtr<base::TaskRunner>& thread);
   // sha
   void SHA(int type /*256|384|512*/, const HashData &data, rcib::async_req * req);
 };
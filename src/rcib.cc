@@ -18,59 +18,64 @@ static void NewThread(const v8::FunctionCallbackInfo<v8::Value>& args) {
   DCHECK(args.IsConstructCall());
   v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
   void * data = furThread_.Get().Wrap(args.This());
-  if(data) rcib::CallbackInfo::New(args.GetIsolate(), args.This(), rcib::CallbackInfo::Free, data);
+  if(data) {
+    rcib::CallbackInfo::New(args.GetIsolate(), args.This(), rcib::CallbackInfo::Free, data);
+    RcibHelper::GetInstance()->inline_policy().Calibrate(static_cast<base::TaskRunner*>(data));
+  }
 }
 
 static void Close(const v8::FunctionCallbackInfo<v8::Value>& args) {
-  furThread_.Get().Close(static_cast<base::Thread*>(furThread_.Get().Unwrap(args.Holder())));
+  base::TaskRunner* runner = static_cast<base::TaskRunner*>(furThread_.Get().Unwrap(args.Holder()));
+  RcibHelper::GetInstance()->SetSink(runner, nullptr);
+  furThread_.Get().Close(runner);
   furThread_.Get().Wrap(args.Holder(), (void*)(&rcib::bterminating_));
 }
 
 static void IsRunning(const v8::FunctionCallbackInfo<v8::Value>& args) {
   args.GetReturnValue().Set(v8::Boolean::New(v8::Isolate::GetCurrent(),
-    furThread_.Get().IsRunning(static_cast<base::Thread*>(furThread_.Get().Unwrap(args.Holder())))));
+    furThread_.Get().IsRunning(static_cast<base::TaskRunner*>(furThread_.Get().Unwrap(args.Holder())))));
 }
 
 static void DelayByMil(const v8::FunctionCallbackInfo<v8::Value>& args) {
   THREAD;
   DELAY_TASK_COMMON(args);
   req->w_t = TYPE_DELAY;
-  thr->message_loop()->PostDelayedTask(base::Bind(base::Unretained(DelayedHelper::GetInstance()),
+  thr->PostDelayedTask(base::BindOnce(DelayedHelper::GetInstance(),
     &DelayedHelper::DelayByMil, req),
-    base::TimeDelta::FromMilliseconds(delayed));
+    base::TimeDelta::FromMilliseconds(delayed), &req->cancel_flag);
 
-  RETURN_TRUE
+  RETURN_ID
 }
 
 static void DelayBySec(const v8::FunctionCallbackInfo<v8::Value>& args) {
   THREAD;
   DELAY_TASK_COMMON(args);
   req->w_t = TYPE_DELAY;
-  thr->message_loop()->PostDelayedTask(base::Bind(base::Unretained(DelayedHelper::GetInstance()),
+  thr->PostDelayedTask(base::BindOnce(DelayedHelper::GetInstance(),
     &DelayedHelper::DelayBySec, req),
-    base::TimeDelta::FromSeconds(delayed));
+    base::TimeDelta::FromSeconds(delayed), &req->cancel_flag);
 
-  RETURN_TRUE
+  RETURN_ID
 }
 
 static void DelayByMin(const v8::FunctionCallbackInfo<v8::Value>& args) {
   THREAD;
   DELAY_TASK_COMMON(args);
   req->w_t = TYPE_DELAY;
-  thr->message_loop()->PostDelayedTask(base::Bind(base::Unretained(DelayedHelper::GetInstance()),
+  thr->PostDelayedTask(base::BindOnce(DelayedHelper::GetInstance(),
     &DelayedHelper::DelayByMin, req),
-    base::TimeDelta::FromMinutes(delayed));
-  RETURN_TRUE
+    base::TimeDelta::FromMinutes(delayed), &req->cancel_flag);
+  RETURN_ID
 }
 
 static void DelayByHour(const v8::FunctionCallbackInfo<v8::Value>& args) {
   THREAD;
   DELAY_TASK_COMMON(args);
   req->w_t = TYPE_DELAY;
-  thr->message_loop()->PostDelayedTask(base::Bind(base::Unretained(DelayedHelper::GetInstance()),
+  thr->PostDelayedTask(base::BindOnce(DelayedHelper::GetInstance(),
     &DelayedHelper::DelayByHour, req),
-    base::TimeDelta::FromHours(delayed));
-  RETURN_TRUE
+    base::TimeDelta::FromHours(delayed), &req->cancel_flag);
+  RETURN_ID
 }
 
 static void QueueNum(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -81,23 +86,36 @@ static void QueueNum(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 static void Sha2(const v8::FunctionCallbackInfo<v8::Value>& args) {
   ISOLATE(args);
-  if (args.Length() != 3
+  if (args.Length() < 3 || args.Length() > 6
     || !args[0]->IsNumber()
     || !node::Buffer::HasInstance(args[1])
-    || !args[2]->IsFunction()) {
+    || !RESULT_TARGET(args[2])) {
     TYPEERROR;
   }
+  PRIORITY(args, 3);
+  OUTPUT(args, 4, args[0]->TOINT32(isolate) / 8);
   THREAD;  // if thread is not be created, return false in js
   INITHELPER(args, 2);
+  PIN(0, args[1]);
+  if (output) {
+    PIN(1, args[4]);
+  }
   HashData data;
   data._p = node::Buffer::Data(args[1]);
   data._plen = node::Buffer::Length(args[1]);
   req->w_t = TYPE_SHA;
   req->out = (char*)(new HashRe(&HashHelper::HashClean, thr->AsWeakPtr()));
   HashRe *hre = (HashRe *)(req->out);
-  thr->message_loop()->PostTask(base::Bind(base::Unretained(HashHelper::GetInstance()),
-    &HashHelper::SHA, args[0]->TOINT32(isolate), data, req));
-  RETURN_TRUE
+  hre->_out = reinterpret_cast<uint8_t *>(output);
+  int type = args[0]->TOINT32(isolate);
+  if (RcibHelper::GetInstance()->inline_policy().RunsInline(
+    256 == type ? InlinePolicy::SHA256 : InlinePolicy::SHA512, data._plen)) {
+    HashHelper::GetInstance()->SHA(type, data, req);
+  } else {
+    thr->PostTask(base::BindOnce(HashHelper::GetInstance(),
+      &HashHelper::SHA, type, data, req), priority);
+  }
+  RETURN_ID
 }
 
 static void MakeKeypair(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -126,40 +144,99 @@ static void MakeKeypair(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 static void Sign(const v8::FunctionCallbackInfo<v8::Value>& args) {
   ISOLATE(args);
-  if (args.Length() != 3
+  if (args.Length() < 3 || args.Length() > 6
     || !node::Buffer::HasInstance(args[0])
     || !(node::Buffer::HasInstance(args[1]) || args[1]->IsObject())
-    || !args[2]->IsFunction()) {
-    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }, callback));
+    || !RESULT_TARGET(args[2])) {
+    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }, callback));
   }
+  PRIORITY(args, 3);
+  OUTPUT(args, 4, 64);
   Ed25519Data data;
   data._msg = (unsigned char*)node::Buffer::Data(args[0]);
   data._mlen = node::Buffer::Length(args[0]);
-  if(args[1]->IsObject() && !node::Buffer::HasInstance(args[1])) {
+  v8::Local<v8::Value> key = args[1];
+  if ((data._signer = Ed25519Signer::Unwrap(isolate, args[1]))) {
+    // the handle keeps the signer alive while the request is pinned
+  } else if(args[1]->IsObject() && !node::Buffer::HasInstance(args[1])) {
     v8::Local<v8::Value> pKey = args[1]->ToObject()->Get(v8::String::NewFromUtf8(isolate, "privateKey"));
     if (!pKey->IsObject()) {
-      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }, callback));
+      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }, callback));
     }
     v8::Local<v8::Value> privateKeyBuffer = pKey->ToObject();
     if (!node::Buffer::HasInstance(privateKeyBuffer) || 64 != node::Buffer::Length(privateKeyBuffer)) {
-      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }, callback));
+      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }, callback));
     }
     data._privateKey = (unsigned char*)node::Buffer::Data(privateKeyBuffer);
+    key = privateKeyBuffer;
   } else if (32 == node::Buffer::Length(args[1])) {
     data._seed = (unsigned char*)node::Buffer::Data(args[1]);
   } else if (64 == node::Buffer::Length(args[1])) {
     data._privateKey = (unsigned char*)node::Buffer::Data(args[1]);
   } else {
-    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }, callback));
+    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }, callback));
   }
   THREAD;  // if thread is not be created, return false in js
   INITHELPER(args, 2);
+  PIN(0, args[0]);
+  PIN(1, key);
+  if (output) {
+    PIN(2, args[4]);
+  }
   req->w_t = TYPE_ED25519;
   req->out = (char*)(new Ed25519Re(thr->AsWeakPtr(), Ed25519Re::SIGN));
-  thr->message_loop()->PostTask(base::Bind(base::Unretained(Ed25519Helper::GetInstance()),
-    &Ed25519Helper::Sign, data, req));
+  reinterpret_cast<Ed25519Re *>(req->out)->_out = reinterpret_cast<unsigned char *>(output);
+  if (RcibHelper::GetInstance()->inline_policy().RunsInline(InlinePolicy::SIGN, data._mlen)) {
+    Ed25519Helper::GetInstance()->Sign(data, req);
+  } else {
+    thr->PostTask(base::BindOnce(Ed25519Helper::GetInstance(),
+      &Ed25519Helper::Sign, data, req), priority);
+  }
+
+  RETURN_ID
+}
+
+// createSigner(Buffer(32 or 64), callback, priority)
+static void CreateSigner(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() < 2 || args.Length() > 3
+    || !node::Buffer::HasInstance(args[0])
+    || (32 != node::Buffer::Length(args[0]) && 64 != node::Buffer::Length(args[0]))
+    || !RESULT_TARGET(args[1])) {
+    TYPEERROR2(createSigner requires(Buffer(32 or 64), callback));
+  }
+  PRIORITY(args, 2);
+  Ed25519Data data;
+  if (32 == node::Buffer::Length(args[0])) {
+    data._seed = (unsigned char*)node::Buffer::Data(args[0]);
+  } else {
+    data._privateKey = (unsigned char*)node::Buffer::Data(args[0]);
+  }
+  THREAD;  // if thread is not be created, return false in js
+  INITHELPER(args, 1);
+  PIN(0, args[0]);
+  req->w_t = TYPE_ED25519;
+  req->out = (char*)(new Ed25519SignerRe(thr->AsWeakPtr()));
+  thr->PostTask(base::BindOnce(Ed25519Helper::GetInstance(),
+    &Ed25519Helper::CreateSigner, data, req), priority);
+  RETURN_ID
+}
 
-  RETURN_TRUE
+static void CreateSignerSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1
+    || !node::Buffer::HasInstance(args[0])
+    || (32 != node::Buffer::Length(args[0]) && 64 != node::Buffer::Length(args[0]))) {
+    TYPEERROR2(createSigner requires a 32 or 64 byte buffer);
+  }
+  Ed25519Signer* signer = Ed25519Signer::New((unsigned char*)node::Buffer::Data(args[0]),
+    node::Buffer::Length(args[0]));
+  if (!signer) {
+    isolate->ThrowException(v8::Exception::Error(
+      v8::String::NewFromUtf8(isolate, "no memory for the signer", v8::NewStringType::kNormal).ToLocalChecked()));
+    return;
+  }
+  args.GetReturnValue().Set(Ed25519Signer::Wrap(isolate, signer));
 }
 
 static void SignSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -167,19 +244,29 @@ static void SignSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
   if (args.Length() != 2
     || !node::Buffer::HasInstance(args[0])
     || !(node::Buffer::HasInstance(args[1]) || args[1]->IsObject())) {
-    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }));
+    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }));
   }
   Ed25519Data data;
   data._msg = (unsigned char*)node::Buffer::Data(args[0]);
   data._mlen = node::Buffer::Length(args[0]);
+  if ((data._signer = Ed25519Signer::Unwrap(isolate, args[1]))) {
+    unsigned char signature[64];
+    if (crypto_sign_detached_expanded(signature, data._msg, data._mlen, data._signer->expanded()) != 0) {
+      isolate->ThrowException(v8::Exception::Error(
+        v8::String::NewFromUtf8(isolate, "no memory to hash the message", v8::NewStringType::kNormal).ToLocalChecked()));
+      return;
+    }
+    args.GetReturnValue().Set(node::Encode(isolate, reinterpret_cast<char *>(signature), 64, node::encoding::BUFFER));
+    return;
+  }
   if (args[1]->IsObject() && !node::Buffer::HasInstance(args[1])) {
     v8::Local<v8::Value> pKey = args[1]->ToObject()->Get(v8::String::NewFromUtf8(isolate, "privateKey"));
     if (!pKey->IsObject()) {
-      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }));
+      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }));
     }
     v8::Local<v8::Value> privateKeyBuffer = pKey->ToObject();
     if (!node::Buffer::HasInstance(privateKeyBuffer) || 64 != node::Buffer::Length(privateKeyBuffer)) {
-      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }));
+      TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }));
     }
     data._privateKey = (unsigned char*)node::Buffer::Data(privateKeyBuffer);
   } else if (32 == node::Buffer::Length(args[1])) {
@@ -187,7 +274,7 @@ static void SignSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
   } else if (64 == node::Buffer::Length(args[1])) {
     data._privateKey = (unsigned char*)node::Buffer::Data(args[1]);
   } else {
-    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object }));
+    TYPEERROR2(Sign requires(Buffer, { Buffer(32 or 64) | keyPair object | signer }));
   }
 
   unsigned char publicKeyData[32];
@@ -202,41 +289,48 @@ static void SignSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
   } else {
     privateKey = data._privateKey;
   }
-  unsigned long long sigLen = data._mlen + 64;
-  unsigned char *signatureMessageData = (unsigned char*)malloc(sigLen);
-  crypto_sign(signatureMessageData, &sigLen, data._msg, data._mlen, privateKey);
-  for (int i = 0; i < 64; ++i) {
-    privateKeyData[i] = signatureMessageData[i];
+  unsigned char signature[64];
+  if (crypto_sign_detached(signature, data._msg, data._mlen, privateKey) != 0) {
+    isolate->ThrowException(v8::Exception::Error(
+      v8::String::NewFromUtf8(isolate, "no memory to hash the message", v8::NewStringType::kNormal).ToLocalChecked()));
+    return;
   }
-  free(signatureMessageData);
-  args.GetReturnValue().Set(node::Encode(isolate, reinterpret_cast<char *>(privateKeyData), 64, node::encoding::BUFFER));
+  args.GetReturnValue().Set(node::Encode(isolate, reinterpret_cast<char *>(signature), 64, node::encoding::BUFFER));
 }
 
 static void Verify(const v8::FunctionCallbackInfo<v8::Value>& args) {
   ISOLATE(args);
   Ed25519Data data;
-  if (args.Length() != 4
+  if ((args.Length() != 4 && args.Length() != 5)
     || !node::Buffer::HasInstance(args[0])
     || !node::Buffer::HasInstance(args[1])
     || !node::Buffer::HasInstance(args[2])
-    || !args[3]->IsFunction()) {
+    || !RESULT_TARGET(args[3])) {
     TYPEERROR2(Verify requires(Buffer, Buffer(64), Buffer(32), callback));
   }
+  PRIORITY(args, 4);
   if (!( 64 == node::Buffer::Length(args[1]) && 32 == node::Buffer::Length(args[2]) )) {
     TYPEERROR2(Verify requires(Buffer, Buffer(64), Buffer(32), callback))
   }
   THREAD;  // if thread is not be created, return false in js
   INITHELPER(args, 3);
+  PIN(0, args[0]);
+  PIN(1, args[1]);
+  PIN(2, args[2]);
   data._msg = (unsigned char*)node::Buffer::Data(args[0]);
   data._mlen = node::Buffer::Length(args[0]);
   data._seed = (unsigned char*)node::Buffer::Data(args[1]);
   data._privateKey = (unsigned char*)node::Buffer::Data(args[2]); // here is pub
   req->w_t = TYPE_ED25519;
   req->out = (char*)(new Ed25519Re(thr->AsWeakPtr(), Ed25519Re::VERIFY));
-  thr->message_loop()->PostTask(base::Bind(base::Unretained(Ed25519Helper::GetInstance()),
-    &Ed25519Helper::Verify, data, req));
+  if (RcibHelper::GetInstance()->inline_policy().RunsInline(InlinePolicy::VERIFY, data._mlen)) {
+    Ed25519Helper::GetInstance()->Verify(data, req);
+  } else {
+    thr->PostTask(base::BindOnce(Ed25519Helper::GetInstance(),
+      &Ed25519Helper::Verify, data, req), priority);
+  }
 
-  RETURN_TRUE
+  RETURN_ID
 }
 
 static void VerifySync(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -257,10 +351,323 @@ static void VerifySync(const v8::FunctionCallbackInfo<v8::Value>& args) {
   data._seed = (unsigned char*)node::Buffer::Data(args[1]);
   data._privateKey = (unsigned char*)node::Buffer::Data(args[2]); // here is pub
 
-  bool relt = (crypto_sign_verify(data._seed, data._msg, data._mlen, data._privateKey) == 0);
+  bool relt = Ed25519Helper::VerifyOne(data._seed, data._msg, data._mlen, data._privateKey);
   args.GetReturnValue().Set(relt);
 }
 
+static void VerifyBatch(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if ((args.Length() != 4 && args.Length() != 5)
+    || !args[0]->IsArray()
+    || !args[1]->IsArray()
+    || !args[2]->IsArray()
+    || !RESULT_TARGET(args[3])) {
+    TYPEERROR2(verifyBatch requires([Buffer], [Buffer(64)], [Buffer(32)], callback));
+  }
+  PRIORITY(args, 4);
+  v8::Local<v8::Array> msgs = v8::Local<v8::Array>::Cast(args[0]);
+  v8::Local<v8::Array> sigs = v8::Local<v8::Array>::Cast(args[1]);
+  v8::Local<v8::Array> pks = v8::Local<v8::Array>::Cast(args[2]);
+  uint32_t n = msgs->Length();
+  if (sigs->Length() != n || pks->Length() != n) {
+    TYPEERROR2(verifyBatch requires arrays of the same length);
+  }
+  // the Buffers are held in one array of our own, so the caller may
+  // change theirs while the batch runs
+  v8::Local<v8::Array> held = v8::Array::New(isolate, 3 * n);
+  for (uint32_t i = 0; i < n; ++i) {
+    v8::Local<v8::Value> m = msgs->Get(i);
+    v8::Local<v8::Value> s = sigs->Get(i);
+    v8::Local<v8::Value> p = pks->Get(i);
+    if (!node::Buffer::HasInstance(m)
+      || !node::Buffer::HasInstance(s) || 64 != node::Buffer::Length(s)
+      || !node::Buffer::HasInstance(p) || 32 != node::Buffer::Length(p)) {
+      TYPEERROR2(verifyBatch requires([Buffer], [Buffer(64)], [Buffer(32)], callback));
+    }
+    held->Set(3 * i, m);
+    held->Set(3 * i + 1, s);
+    held->Set(3 * i + 2, p);
+  }
+  THREAD;
+  INITHELPER(args, 3);
+  PIN(0, held);
+  Ed25519BatchRe *hre = new Ed25519BatchRe(thr->AsWeakPtr(), n);
+  for (uint32_t i = 0; i < n; ++i) {
+    v8::Local<v8::Value> m = held->Get(3 * i);
+    hre->_msgs[i] = (unsigned char*)node::Buffer::Data(m);
+    hre->_mlens[i] = node::Buffer::Length(m);
+    hre->_sigs[i] = (unsigned char*)node::Buffer::Data(held->Get(3 * i + 1));
+    hre->_pks[i] = (unsigned char*)node::Buffer::Data(held->Get(3 * i + 2));
+  }
+  req->w_t = TYPE_ED25519;
+  req->out = (char*)hre;
+  thr->PostTask(base::BindOnce(Ed25519Helper::GetInstance(),
+    &Ed25519Helper::VerifyBatch, req), priority);
+
+  RETURN_ID
+}
+
+// Shards of at least this many records, so each is still worth a batch
+// (and a makeKeypairs shard a chunk per field inversion)
+#define MIN_SHARD 64
+
+// Cuts a job of n items into one shard per worker, or fewer for a small
+// job, and posts |shard| for each. |pending| counts the shards still running.
+static void PostShards(base::TaskRunner* thr, async_req* req, size_t n,
+  volatile base::subtle::Atomic32* pending,
+  void (Ed25519Helper::*shard)(async_req*, size_t, size_t),
+  base::MessageLoop::Priority priority) {
+  size_t workers = base::ThreadPool::GetInstance()->size();
+  size_t shards = (n + MIN_SHARD - 1) / MIN_SHARD;
+  if (shards > workers) shards = workers;
+  if (shards < 1) shards = 1;
+  // whole bytes of the bitmap per shard
+  size_t per = ((n + shards - 1) / shards + 7) & ~static_cast<size_t>(7);
+  shards = per ? (n + per - 1) / per : 1;
+  *pending = static_cast<base::subtle::Atomic32>(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    size_t begin = i * per;
+    size_t end = begin + per < n ? begin + per : n;
+    thr->PostShardTask(i, base::BindOnce(Ed25519Helper::GetInstance(),
+      shard, req, begin, end), priority);
+  }
+}
+
+// verifyRecords(records, messageLength, callback[, priority])
+// records: n records of signature(64) | public key(32) | message
+static void VerifyRecords(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if ((args.Length() != 3 && args.Length() != 4)
+    || !node::Buffer::HasInstance(args[0])
+    || !args[1]->IsNumber()
+    || !RESULT_TARGET(args[2])) {
+    TYPEERROR2(verifyRecords requires(Buffer, messageLength, callback));
+  }
+  PRIORITY(args, 3);
+  size_t mlen = args[1]->TOUINT32(isolate);
+  size_t stride = 64 + 32 + mlen;
+  size_t length = node::Buffer::Length(args[0]);
+  if (length % stride) {
+    TYPEERROR2(verifyRecords requires whole records);
+  }
+  THREAD;
+  INITHELPER(args, 2);
+  PIN(0, args[0]);
+  const unsigned char* records = (unsigned char*)node::Buffer::Data(args[0]);
+  Ed25519PackedRe *hre = new Ed25519PackedRe(thr->AsWeakPtr(), length / stride);
+  hre->_sigs = records;
+  hre->_sig_stride = stride;
+  hre->_pks = records + 64;
+  hre->_pk_stride = stride;
+  hre->_msgs = records + 96;
+  hre->_msg_stride = stride;
+  hre->_msg_len = mlen;
+  req->w_t = TYPE_ED25519;
+  req->out = (char*)hre;
+  PostShards(thr, req, hre->_n, &hre->_shards, &Ed25519Helper::VerifyShard, priority);
+
+  RETURN_ID
+}
+
+// verifyPacked(messages, offsets, signatures, publicKeys, callback[, priority])
+// message i is messages[offsets[i], offsets[i + 1]); offsets is a Uint32Array
+static void VerifyPacked(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if ((args.Length() != 5 && args.Length() != 6)
+    || !node::Buffer::HasInstance(args[0])
+    || !args[1]->IsUint32Array()
+    || !node::Buffer::HasInstance(args[2])
+    || !node::Buffer::HasInstance(args[3])
+    || !RESULT_TARGET(args[4])) {
+    TYPEERROR2(verifyPacked requires(Buffer, Uint32Array, Buffer, Buffer, callback));
+  }
+  PRIORITY(args, 5);
+  v8::Local<v8::Uint32Array> table = v8::Local<v8::Uint32Array>::Cast(args[1]);
+  size_t entries = table->Length();
+  size_t n = entries ? entries - 1 : 0;
+  // checked and used from a copy, the caller may change theirs
+  std::vector<uint32_t> offsets(entries);
+  if (entries) {
+    table->CopyContents(&offsets[0], entries * sizeof(uint32_t));
+  }
+  size_t mlen = node::Buffer::Length(args[0]);
+  for (size_t i = 0; i < n; ++i) {
+    if (offsets[i] > offsets[i + 1] || offsets[i + 1] > mlen) {
+      TYPEERROR2(verifyPacked offsets must rise within messages);
+    }
+  }
+  if (node::Buffer::Length(args[2]) != n * 64 || node::Buffer::Length(args[3]) != n * 32) {
+    TYPEERROR2(verifyPacked requires 64 bytes of signature and 32 of key per message);
+  }
+  THREAD;
+  INITHELPER(args, 4);
+  PIN(0, args[0]);
+  PIN(1, args[2]);
+  PIN(2, args[3]);
+  Ed25519PackedRe *hre = new Ed25519PackedRe(thr->AsWeakPtr(), n);
+  hre->_msgs = (unsigned char*)node::Buffer::Data(args[0]);
+  hre->_offsets.swap(offsets);
+  hre->_sigs = (unsigned char*)node::Buffer::Data(args[2]);
+  hre->_sig_stride = 64;
+  hre->_pks = (unsigned char*)node::Buffer::Data(args[3]);
+  hre->_pk_stride = 32;
+  req->w_t = TYPE_ED25519;
+  req->out = (char*)hre;
+  PostShards(thr, req, hre->_n, &hre->_shards, &Ed25519Helper::VerifyShard, priority);
+
+  RETURN_ID
+}
+
+// makeKeypairs(seeds, callback[, priority]); seeds are 32 bytes each
+static void MakeKeypairs(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if ((args.Length() != 2 && args.Length() != 3)
+    || !node::Buffer::HasInstance(args[0])
+    || node::Buffer::Length(args[0]) % 32
+    || !RESULT_TARGET(args[1])) {
+    TYPEERROR2(makeKeypairs requires(Buffer of 32 byte seeds, callback));
+  }
+  PRIORITY(args, 2);
+  THREAD;
+  INITHELPER(args, 1);
+  size_t n = node::Buffer::Length(args[0]) / 32;
+  // the seeds are copied, nothing to pin
+  Ed25519KeypairsRe *hre = new Ed25519KeypairsRe(thr->AsWeakPtr(),
+    (unsigned char*)node::Buffer::Data(args[0]), n);
+  req->w_t = TYPE_ED25519;
+  req->out = (char*)hre;
+  PostShards(thr, req, n, &hre->_shards, &Ed25519Helper::KeypairShard, priority);
+
+  RETURN_ID
+}
+
+static void SetSink(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !(args[0]->IsFunction() || args[0]->IsNull())) {
+    TYPEERROR2(setSink requires a function or null);
+  }
+  THREAD;
+  ResultSink* sink = nullptr;
+  if (args[0]->IsFunction())
+    sink = new ResultSink(isolate, v8::Local<v8::Function>::Cast(args[0]));
+  RcibHelper::GetInstance()->SetSink(thr, sink);
+  args.GetReturnValue().Set(true);
+}
+
+static void Cancel(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !args[0]->IsNumber()) {
+    TYPEERROR2(cancel requires a task id);
+  }
+  THREAD;
+  uint64_t id = static_cast<uint64_t>(args[0]->NumberValue(isolate->GetCurrentContext()).FromMaybe(0));
+  args.GetReturnValue().Set(RcibHelper::GetInstance()->Cancel(thr, id));
+}
+
+static void SetPoolSize(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !args[0]->IsNumber()) {
+    TYPEERROR2(setPoolSize requires a number);
+  }
+  uint32_t size = args[0]->TOUINT32(isolate);
+  args.GetReturnValue().Set(base::ThreadPool::GetInstance()->SetSize(size));
+}
+
+static void SetCompletionBudget(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    TYPEERROR2(setCompletionBudget requires two numbers);
+  }
+  uint32_t max_callbacks = args[0]->TOUINT32(isolate);
+  double max_millis = args[1]->NumberValue(isolate->GetCurrentContext()).FromMaybe(0);
+  RcibHelper::GetInstance()->SetBudget(max_callbacks, max_millis);
+}
+
+static void GetCompletionStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  RcibHelper* helper = RcibHelper::GetInstance();
+  const CompletionStats& stats = helper->stats();
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  obj->Set(v8::String::NewFromUtf8(isolate, "delivered"), v8::Number::New(isolate, stats.delivered));
+  obj->Set(v8::String::NewFromUtf8(isolate, "deferred"), v8::Number::New(isolate, stats.deferred));
+  obj->Set(v8::String::NewFromUtf8(isolate, "deferredRounds"), v8::Number::New(isolate, stats.deferred_rounds));
+  obj->Set(v8::String::NewFromUtf8(isolate, "backlog"), v8::Number::New(isolate, static_cast<double>(stats.backlog)));
+  obj->Set(v8::String::NewFromUtf8(isolate, "maxCallbacks"), v8::Integer::NewFromUnsigned(isolate, helper->max_callbacks()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "maxMillis"), v8::Number::New(isolate, helper->max_millis()));
+  args.GetReturnValue().Set(obj);
+}
+
+static void SetInlineThreshold(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !args[0]->IsNumber()) {
+    TYPEERROR2(setInlineThreshold requires a number of nanoseconds);
+  }
+  RcibHelper::GetInstance()->inline_policy().SetThreshold(
+    args[0]->NumberValue(isolate->GetCurrentContext()).FromMaybe(-1));
+}
+
+static void GetInlineStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  InlinePolicy& policy = RcibHelper::GetInstance()->inline_policy();
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  obj->Set(v8::String::NewFromUtf8(isolate, "thresholdNs"), v8::Number::New(isolate, policy.threshold_ns()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "calibratedNs"), v8::Number::New(isolate, policy.calibrated_ns()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "inlined"), v8::Number::New(isolate, policy.inlined()));
+  args.GetReturnValue().Set(obj);
+}
+
+static v8::Local<v8::Object> PoolStatsObject(v8::Isolate* isolate, const PoolStats& stats) {
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  obj->Set(v8::String::NewFromUtf8(isolate, "created"), v8::Number::New(isolate, stats.created));
+  obj->Set(v8::String::NewFromUtf8(isolate, "reused"), v8::Number::New(isolate, stats.reused));
+  obj->Set(v8::String::NewFromUtf8(isolate, "idle"), v8::Number::New(isolate, static_cast<double>(stats.idle)));
+  return obj;
+}
+
+static void GetAllocationStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  HandleTable& handles = RcibHelper::GetInstance()->handles();
+  v8::Local<v8::Object> handleStats = v8::Object::New(isolate);
+  handleStats->Set(v8::String::NewFromUtf8(isolate, "slots"), v8::Number::New(isolate, static_cast<double>(handles.slots())));
+  handleStats->Set(v8::String::NewFromUtf8(isolate, "idle"), v8::Number::New(isolate, static_cast<double>(handles.idle())));
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  obj->Set(v8::String::NewFromUtf8(isolate, "requests"), PoolStatsObject(isolate, FreeList<async_req>::stats()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "hashResults"), PoolStatsObject(isolate, FreeList<HashRe>::stats()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "ed25519Results"), PoolStatsObject(isolate, FreeList<Ed25519Re>::stats()));
+  obj->Set(v8::String::NewFromUtf8(isolate, "handles"), handleStats);
+  args.GetReturnValue().Set(obj);
+}
+
+static void SetKeyCacheSize(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !args[0]->IsNumber()) {
+    TYPEERROR2(setKeyCacheSize requires a number of bytes);
+  }
+  double bytes = args[0]->NumberValue(isolate->GetCurrentContext()).FromMaybe(0);
+  KeyCache::GetInstance()->SetCapacity(bytes > 0 ? static_cast<size_t>(bytes) : 0);
+}
+
+static void SetBaseWindow(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  if (args.Length() != 1 || !args[0]->IsNumber()) {
+    TYPEERROR2(setBaseWindow requires a number);
+  }
+  int window = args[0]->TOINT32(isolate);
+  args.GetReturnValue().Set(0 == crypto_sign_base_window(window));
+}
+
+static void GetKeyCacheStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  ISOLATE(args);
+  KeyCache::Stats stats = KeyCache::GetInstance()->stats();
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  obj->Set(v8::String::NewFromUtf8(isolate, "hits"), v8::Number::New(isolate, stats.hits));
+  obj->Set(v8::String::NewFromUtf8(isolate, "misses"), v8::Number::New(isolate, stats.misses));
+  obj->Set(v8::String::NewFromUtf8(isolate, "entries"), v8::Number::New(isolate, static_cast<double>(stats.entries)));
+  obj->Set(v8::String::NewFromUtf8(isolate, "bytes"), v8::Number::New(isolate, static_cast<double>(stats.bytes)));
+  obj->Set(v8::String::NewFromUtf8(isolate, "capacity"), v8::Number::New(isolate, static_cast<double>(stats.capacity)));
+  args.GetReturnValue().Set(obj);
+}
+
 void Terminate(void *) {
   RcibHelper::GetInstance()->Terminate();
 }
@@ -275,6 +682,7 @@ inline void NODE_CREATE_FUNCTION(const TypeName& target) {
     t->SetClassName(v8::String::NewFromUtf8(isolate, "THREAD"));
 
     NODE_SET_PROTOTYPE_METHOD(t, "close", Close);
+    NODE_SET_PROTOTYPE_METHOD(t, "setSink", SetSink);
     NODE_SET_PROTOTYPE_METHOD(t, "isRunning", IsRunning);
     NODE_SET_PROTOTYPE_METHOD(t, "delayByMil", DelayByMil);
     NODE_SET_PROTOTYPE_METHOD(t, "delayBySec", DelayBySec);
@@ -283,7 +691,13 @@ inline void NODE_CREATE_FUNCTION(const TypeName& target) {
     NODE_SET_PROTOTYPE_METHOD(t, "queNum", QueueNum);
     NODE_SET_PROTOTYPE_METHOD(t, "sha2", Sha2);
     NODE_SET_PROTOTYPE_METHOD(t, "sign", Sign);
+    NODE_SET_PROTOTYPE_METHOD(t, "createSigner", CreateSigner);
     NODE_SET_PROTOTYPE_METHOD(t, "verify", Verify);
+    NODE_SET_PROTOTYPE_METHOD(t, "verifyBatch", VerifyBatch);
+    NODE_SET_PROTOTYPE_METHOD(t, "verifyRecords", VerifyRecords);
+    NODE_SET_PROTOTYPE_METHOD(t, "verifyPacked", VerifyPacked);
+    NODE_SET_PROTOTYPE_METHOD(t, "makeKeypairs", MakeKeypairs);
+    NODE_SET_PROTOTYPE_METHOD(t, "cancel", Cancel);
 
     target->Set(v8::String::NewFromUtf8(isolate, "THREAD")
       , t->GetFunction());
@@ -295,7 +709,22 @@ void Init(v8::Local<v8::Object> target) {
   NODE_CREATE_FUNCTION(target);
   NODE_SET_METHOD(target, "makeKeypair", MakeKeypair);
   NODE_SET_METHOD(target, "signSync", SignSync);
+  NODE_SET_METHOD(target, "createSignerSync", CreateSignerSync);
   NODE_SET_METHOD(target, "verifySync", VerifySync);
+  NODE_SET_METHOD(target, "setPoolSize", SetPoolSize);
+  NODE_SET_METHOD(target, "setCompletionBudget", SetCompletionBudget);
+  NODE_SET_METHOD(target, "completionStats", GetCompletionStats);
+  NODE_SET_METHOD(target, "allocationStats", GetAllocationStats);
+  NODE_SET_METHOD(target, "setInlineThreshold", SetInlineThreshold);
+  NODE_SET_METHOD(target, "inlineStats", GetInlineStats);
+  NODE_SET_METHOD(target, "setKeyCacheSize", SetKeyCacheSize);
+  NODE_SET_METHOD(target, "keyCacheStats", GetKeyCacheStats);
+  NODE_SET_METHOD(target, "setBaseWindow", SetBaseWindow);
+  target->Set(v8::String::NewFromUtf8(target->GetIsolate(), "PRIORITY_INTERACTIVE"),
+    v8::Integer::New(target->GetIsolate(), base::MessageLoop::PRIORITY_INTERACTIVE));
+  target->Set(v8::String::NewFromUtf8(target->GetIsolate(), "PRIORITY_BULK"),
+    v8::Integer::New(target->GetIsolate(), base::MessageLoop::PRIORITY_BULK));
+  Ed25519Signer::Init(target->GetIsolate());
   RcibHelper::GetInstance()->Init();
   node::AtExit(Terminate);
 }
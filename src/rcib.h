@@ -16,30 +16,88 @@
 
 #define TOINT32(i)  ToInt32(i->GetCurrentContext()).FromMaybe(v8::Local<v8::Int32>())->Value()
 
-#define INITHELPER(V,I)  v8::Local<v8::Function> callback = v8::Local<v8::Function>::Cast((V)[(I)]);  \
+// a null callback sends the result to the thread's sink, an undefined one
+// settles a promise that RETURN_ID hands back
+#define INITHELPER(V,I)  ResultSink* sink = nullptr; \
+  if ((V)[(I)]->IsNull()) { \
+    sink = RcibHelper::GetInstance()->SinkOf(thr); \
+    if (!sink) { \
+      TYPEERROR2(a null callback requires a result sink) \
+    } \
+  } \
   async_req* req = new async_req; \
   RcibHelper::init_async_req(req);  \
   req->isolate = isolate; \
-  req->callback.Reset(isolate, callback);
+  req->runner_id = thr->id(); \
+  if (sink) { \
+    sink->AddRef(); \
+    req->sink = sink; \
+  } else if ((V)[(I)]->IsFunction()) { \
+    req->callback = RcibHelper::GetInstance()->handles().Put(isolate, (V)[(I)]); \
+  } else { \
+    req->resolver = RcibHelper::GetInstance()->handles().Put(isolate, \
+      v8::Promise::Resolver::New(isolate->GetCurrentContext()).ToLocalChecked()); \
+  }
 
 #define DELAY_TASK_COMMON(V) ISOLATE(V) \
-  if ((V).Length() != 2 || !(V)[0]->IsNumber() || !(V)[1]->IsFunction()) { \
+  if ((V).Length() < 1 || (V).Length() > 2 || !(V)[0]->IsNumber() \
+    || !((V)[1]->IsFunction() || (V)[1]->IsUndefined())) { \
     TYPEERROR \
     } \
   INT64 delayed = (V)[0]->TOUINT32(isolate); \
   INITHELPER(V, 1)
 
+// optional trailing lane argument, bulk when absent
+#define PRIORITY(V, I) base::MessageLoop::Priority priority = base::MessageLoop::PRIORITY_BULK; \
+  if ((V).Length() > (I)) { \
+    if (!(V)[(I)]->IsNumber() || (V)[(I)]->TOUINT32(isolate) >= base::MessageLoop::PRIORITY_COUNT) { \
+      TYPEERROR2(priority should be PRIORITY_INTERACTIVE or PRIORITY_BULK) \
+    } \
+    priority = static_cast<base::MessageLoop::Priority>((V)[(I)]->TOUINT32(isolate)); \
+  }
+
+// optional output Buffer and offset: the worker writes the N result bytes
+// there instead of allocating, and the result is the number of bytes written
+#define OUTPUT(V, I, N) char* output = nullptr; \
+  if ((V).Length() > (I)) { \
+    if (!node::Buffer::HasInstance((V)[(I)]) || (V).Length() <= (I) + 1 || !(V)[(I) + 1]->IsNumber()) { \
+      TYPEERROR2(output requires a Buffer and an offset) \
+    } \
+    size_t offset = (V)[(I) + 1]->TOUINT32(isolate); \
+    size_t capacity = node::Buffer::Length((V)[(I)]); \
+    if (offset > capacity || capacity - offset < static_cast<size_t>(N)) { \
+      TYPEERROR2(output Buffer is too small) \
+    } \
+    output = node::Buffer::Data((V)[(I)]) + offset; \
+  }
+
+// keeps a Buffer the worker uses alive until the request is freed; N is
+// its index in req->pinned
+#define PIN(N, B) req->pinned[(N)] = RcibHelper::GetInstance()->handles().Put(isolate, (B));
+
+// a callback, null for the sink or undefined for a promise
+#define RESULT_TARGET(V) ((V)->IsFunction() || (V)->IsNull() || (V)->IsUndefined())
+
 #define   NOTH     if (bterminating_) { \
                       return; \
                    }
 
-#define   THREAD     base::Thread* thr = furThread_.Get().Get(args.Holder()); \
+#define   THREAD     base::TaskRunner* thr = furThread_.Get().Get(args.Holder()); \
                      if (!thr) { \
                        args.GetReturnValue().Set(false);  \
                        return; \
                      }
 
-#define RETURN_TRUE  args.GetReturnValue().Set(true);
+// the task id, or the promise with the id as its taskId
+#define RETURN_ID  if (!req->resolver) { \
+    args.GetReturnValue().Set(static_cast<double>(req->id)); \
+  } else { \
+    v8::Local<v8::Promise> promise = RcibHelper::GetInstance()->handles() \
+      .Get(isolate, req->resolver).As<v8::Promise::Resolver>()->GetPromise(); \
+    promise->Set(v8::String::NewFromUtf8(isolate, "taskId"), \
+      v8::Number::New(isolate, static_cast<double>(req->id))); \
+    args.GetReturnValue().Set(promise); \
+  }
 
 #define GETATTRINUM(N, O, S) size_t N = -1;  \
    do{  \
@@ -0,0 +1,62 @@
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef MUL_CANCELLATION_FLAG_
+#define MUL_CANCELLATION_FLAG_
+
+#include "macros.h"
+#include "atomicops.h"
+
+namespace base {
+
+  // Settles the race between withdrawing a queued task and running it.
+  // Exactly one of Cancel() and Start() succeeds; after a successful
+  // Cancel() the task still runs, but must return at once when Start()
+  // fails.
+  class CancellationFlag {
+  public:
+    CancellationFlag() :state_(PENDING) {}
+
+    // May be called from any thread. True if the work had not started.
+    bool Cancel() {
+      return PENDING == subtle::Barrier_CompareAndSwap(&state_, PENDING, CANCELLED);
+    }
+
+    // Called by the task before doing the work. False if it was cancelled.
+    bool Start() {
+      return PENDING == subtle::Barrier_CompareAndSwap(&state_, PENDING, STARTED);
+    }
+
+    bool IsCancelled() const { return CANCELLED == state_; }
+
+  private:
+    enum State {
+      PENDING = 0,
+      STARTED,
+      CANCELLED,
+    };
+
+    volatile subtle::Atomic32 state_;
+
+    DISALLOW_COPY_AND_ASSIGN_(CancellationFlag);
+  };
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,186 @@
+/* Copyright chromium  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <list>
+#include <string>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "../macros.h"
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include <assert.h>
+#include "../time/time.h"
+#include "WaitableEvent.h"
+#include "FutexEvent.h"
+
+namespace base {
+
+  namespace {
+
+    const int kMinSpin = 16;
+    const int kInitialSpin = 256;
+    // A few tens of microseconds on current hardware, well below the cost
+    // of a sleep/wake round trip through the kernel.
+    const int kMaxSpin = 4096;
+
+    inline void SpinPause() {
+#if defined(_WIN32)
+      YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      __asm__ __volatile__("yield");
+#endif
+    }
+
+    bool IsMultiCore() {
+#ifdef _WIN32
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return info.dwNumberOfProcessors > 1;
+#else
+      return sysconf(_SC_NPROCESSORS_ONLN) > 1;
+#endif
+    }
+
+#ifdef __linux__
+    // |timeout| is relative; NULL waits indefinitely. Returns when woken, on
+    // timeout, on a signal, or at once if |*addr| no longer holds |value|.
+    inline void FutexWait(volatile subtle::Atomic32* addr, subtle::Atomic32 value,
+      const struct timespec* timeout) {
+      syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+    }
+
+    inline void FutexWake(volatile subtle::Atomic32* addr) {
+      syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+#endif
+
+  }  // namespace
+
+  FutexEvent::FutexEvent()
+    :state_(EMPTY), spin_limit_(IsMultiCore() ? kInitialSpin : 0)
+#ifndef __linux__
+    , event_(false, false)
+#endif
+  {
+  }
+
+  FutexEvent::~FutexEvent() {
+  }
+
+  void FutexEvent::Signal() {
+    // Already signaled: the waiter has yet to consume it, nothing to do.
+    if (SIGNALED == state_)
+      return;
+    if (SLEEPING != subtle::Barrier_Exchange(&state_, SIGNALED))
+      return;
+#ifdef __linux__
+    FutexWake(&state_);
+#else
+    event_.Signal();
+#endif
+  }
+
+  void FutexEvent::Wait() {
+    WaitInternal(NULL);
+  }
+
+  bool FutexEvent::TimedWait(const TimeDelta& max_time) {
+    return WaitInternal(&max_time);
+  }
+
+  bool FutexEvent::WaitInternal(const TimeDelta* max_time) {
+    if (Spin()) {
+      if (spin_limit_ < kMaxSpin)
+        spin_limit_ *= 2;
+      return true;
+    }
+    if (spin_limit_ > kMinSpin)
+      spin_limit_ /= 2;
+    return Park(max_time);
+  }
+
+  bool FutexEvent::Spin() {
+    for (int i = 0; i < spin_limit_; ++i) {
+      if (SIGNALED == state_) {
+        // Only the waiter moves the state away from SIGNALED.
+        subtle::Barrier_Exchange(&state_, EMPTY);
+        return true;
+      }
+      SpinPause();
+    }
+    return false;
+  }
+
+  bool FutexEvent::Park(const TimeDelta* max_time) {
+    if (EMPTY != subtle::Barrier_CompareAndSwap(&state_, EMPTY, SLEEPING)) {
+      // Signaled since the spin gave up.
+      subtle::Barrier_Exchange(&state_, EMPTY);
+      return true;
+    }
+    TimeTicks deadline;
+    if (max_time)
+      deadline = TimeTicks::Now() + *max_time;
+    for (;;) {
+      if (!max_time) {
+#ifdef __linux__
+        FutexWait(&state_, SLEEPING, NULL);
+#else
+        event_.Wait();
+#endif
+      } else {
+        TimeDelta remaining = deadline - TimeTicks::Now();
+        if (remaining > TimeDelta()) {
+#ifdef __linux__
+          INT64 us = remaining.InMicroseconds();
+          struct timespec ts;
+          ts.tv_sec = static_cast<time_t>(us / Time::kMicrosecondsPerSecond);
+          ts.tv_nsec = static_cast<long>((us % Time::kMicrosecondsPerSecond) *
+            Time::kNanosecondsPerMicrosecond);
+          FutexWait(&state_, SLEEPING, &ts);
+#else
+          event_.TimedWait(remaining);
+#endif
+        }
+      }
+      // Wakeups may be spurious, check why we are back.
+      if (SLEEPING != state_)
+        break;
+      if (max_time && deadline <= TimeTicks::Now()) {
+        if (SLEEPING == subtle::Barrier_CompareAndSwap(&state_, SLEEPING, EMPTY))
+          return false;
+        // Lost the race against Signal().
+        break;
+      }
+    }
+    subtle::Barrier_Exchange(&state_, EMPTY);
+    return true;
+  }
+
+} //end base
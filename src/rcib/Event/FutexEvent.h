@@ -0,0 +1,81 @@
+/* Copyright chromium  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MUL_FUTEX_EVENT_
+#define MUL_FUTEX_EVENT_
+
+#include "../atomicops.h"
+
+namespace base {
+
+  class TimeDelta;
+
+  // An auto-reset event with a single waiter, made for a message pump. The
+  // state lives in one word, so Signal() is a plain store when the event is
+  // already signaled and an atomic exchange when it is not; only when the
+  // waiter has actually gone to sleep does it cost a syscall (a futex wake on
+  // Linux, a WaitableEvent signal elsewhere).
+  //
+  // Before parking, Wait() spins for a while in case a signal is about to
+  // arrive. The spin budget adapts: it grows while spinning pays off and
+  // shrinks while the waiter ends up parking anyway. There is no spinning on
+  // single core machines.
+  class FutexEvent {
+  public:
+    FutexEvent();
+    ~FutexEvent();
+
+    // May be called from any thread.
+    void Signal();
+
+    // Only one thread may wait at a time.
+    void Wait();
+
+    // Returns true if the event was signaled, false on timeout.
+    bool TimedWait(const TimeDelta& max_time);
+
+  private:
+    enum State {
+      EMPTY = 0,
+      SIGNALED = 1,
+      // The waiter is parked, or about to be.
+      SLEEPING = 2,
+    };
+
+    bool Spin();
+    // |max_time| is NULL to wait indefinitely.
+    bool Park(const TimeDelta* max_time);
+    bool WaitInternal(const TimeDelta* max_time);
+
+    volatile subtle::Atomic32 state_;
+    // Iterations of the spin loop to try before parking. Touched by the
+    // waiter only.
+    int spin_limit_;
+#ifndef __linux__
+    WaitableEvent event_;
+#endif
+
+    DISALLOW_COPY_AND_ASSIGN_(FutexEvent);
+  };
+
+} //end base
+
+#endif
@@ -0,0 +1,257 @@
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// InlineTask is a move-only, run-once callable. Unlike fastdelegate::Task it
+// is neither reference counted nor heap allocated: the bound object, method
+// and arguments live in a small buffer inside the InlineTask itself, and the
+// task is moved, never copied, on its way through a MessageLoop.
+//
+//   loop->PostTask(base::BindOnce(HashHelper::GetInstance(),
+//     &HashHelper::SHA, type, data, req));
+//
+// BindOnce does not retain |obj|; it must outlive the task. Arguments are
+// stored by value. State that does not fit in kInlineSize bytes falls back to
+// the heap.
+
+#ifndef MUL_INLINE_TASK_
+#define MUL_INLINE_TASK_
+
+#include <new>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include "aligned_memory.h"
+
+namespace base {
+
+  namespace internal {
+
+    template <size_t... I>
+    struct IndexSequence {};
+
+    template <size_t N, size_t... I>
+    struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+    template <size_t... I>
+    struct MakeIndexSequence<0, I...> {
+      typedef IndexSequence<I...> type;
+    };
+
+    template <typename X, typename Method, typename... Args>
+    struct BoundMethod {
+      template <typename... A>
+      BoundMethod(X* o, Method m, A&&... a)
+        :obj(o), method(m), args(std::forward<A>(a)...) {}
+
+      void Run() {
+        RunImpl(typename MakeIndexSequence<sizeof...(Args)>::type());
+      }
+
+      template <size_t... I>
+      void RunImpl(IndexSequence<I...>) {
+        (obj->*method)(std::get<I>(args)...);
+      }
+
+      X* obj;
+      Method method;
+      std::tuple<Args...> args;
+    };
+
+    template <typename Function, typename... Args>
+    struct BoundFunction {
+      template <typename... A>
+      BoundFunction(Function f, A&&... a)
+        :function(f), args(std::forward<A>(a)...) {}
+
+      void Run() {
+        RunImpl(typename MakeIndexSequence<sizeof...(Args)>::type());
+      }
+
+      template <size_t... I>
+      void RunImpl(IndexSequence<I...>) {
+        (*function)(std::get<I>(args)...);
+      }
+
+      Function function;
+      std::tuple<Args...> args;
+    };
+
+    // Adapts the reference counted tasks made by base::Bind.
+    struct LegacyTask {
+      explicit LegacyTask(fastdelegate::Task<void>* t) :task(t) {}
+
+      void Run() {
+        if (task.get())
+          task->Run();
+      }
+
+      scoped_refptr<fastdelegate::Task<void> > task;
+    };
+
+  }  // namespace internal
+
+  class InlineTask {
+  public:
+    // Room for a helper pointer, a member function pointer, a request pointer
+    // and a HashData or Ed25519Data sized argument.
+    static const size_t kInlineSize = 96;
+
+    InlineTask() :ops_(NULL) {}
+
+    explicit InlineTask(fastdelegate::Task<void>* task) :ops_(NULL) {
+      Emplace<internal::LegacyTask>(task);
+    }
+
+    InlineTask(InlineTask&& other) :ops_(NULL) {
+      *this = std::move(other);
+    }
+
+    ~InlineTask() {
+      Reset();
+    }
+
+    InlineTask& operator=(InlineTask&& other) {
+      if (this != &other) {
+        Reset();
+        if (other.ops_) {
+          other.ops_->relocate(storage_.void_data(), other.storage_.void_data());
+          ops_ = other.ops_;
+          other.ops_ = NULL;
+        }
+      }
+      return *this;
+    }
+
+    bool is_null() const { return NULL == ops_; }
+
+    void Run() {
+      if (ops_)
+        ops_->run(storage_.void_data());
+    }
+
+    void Reset() {
+      if (ops_) {
+        ops_->destroy(storage_.void_data());
+        ops_ = NULL;
+      }
+    }
+
+    // Constructs the bound state in place. Used by BindOnce.
+    template <typename State, typename... A>
+    void Emplace(A&&... a) {
+      Reset();
+      Place<State>(std::integral_constant<bool, IsInline<State>::value>(), std::forward<A>(a)...);
+    }
+
+  private:
+    struct Ops {
+      void (*run)(void* storage);
+      // Move constructs |dst| from |src| and destroys |src|.
+      void (*relocate)(void* dst, void* src);
+      void (*destroy)(void* storage);
+    };
+
+    template <typename State>
+    struct IsInline {
+      static const bool value = sizeof(State) <= kInlineSize &&
+        std::alignment_of<State>::value <= 8;
+    };
+
+    template <typename State>
+    struct InlineOps {
+      static void Run(void* p) {
+        static_cast<State*>(p)->Run();
+      }
+      static void Relocate(void* dst, void* src) {
+        new (dst) State(std::move(*static_cast<State*>(src)));
+        static_cast<State*>(src)->~State();
+      }
+      static void Destroy(void* p) {
+        static_cast<State*>(p)->~State();
+      }
+      static const Ops ops;
+    };
+
+    template <typename State>
+    struct HeapOps {
+      static void Run(void* p) {
+        (*static_cast<State**>(p))->Run();
+      }
+      static void Relocate(void* dst, void* src) {
+        *static_cast<State**>(dst) = *static_cast<State**>(src);
+      }
+      static void Destroy(void* p) {
+        delete *static_cast<State**>(p);
+      }
+      static const Ops ops;
+    };
+
+    template <typename State, typename... A>
+    void Place(std::true_type, A&&... a) {
+      new (storage_.void_data()) State(std::forward<A>(a)...);
+      ops_ = &InlineOps<State>::ops;
+    }
+
+    template <typename State, typename... A>
+    void Place(std::false_type, A&&... a) {
+      *storage_.data_as<State*>() = new State(std::forward<A>(a)...);
+      ops_ = &HeapOps<State>::ops;
+    }
+
+    AlignedMemory<kInlineSize, 8> storage_;
+    const Ops* ops_;
+
+    DISALLOW_COPY_AND_ASSIGN_(InlineTask);
+  };
+
+  template <typename State>
+  const InlineTask::Ops InlineTask::InlineOps<State>::ops = {
+    &InlineTask::InlineOps<State>::Run,
+    &InlineTask::InlineOps<State>::Relocate,
+    &InlineTask::InlineOps<State>::Destroy
+  };
+
+  template <typename State>
+  const InlineTask::Ops InlineTask::HeapOps<State>::ops = {
+    &InlineTask::HeapOps<State>::Run,
+    &InlineTask::HeapOps<State>::Relocate,
+    &InlineTask::HeapOps<State>::Destroy
+  };
+
+  template <typename X, typename Y, typename... Params, typename... Args>
+  inline InlineTask BindOnce(Y* obj, void (X::*method)(Params...), Args&&... args) {
+    typedef internal::BoundMethod<X, void (X::*)(Params...),
+      typename std::decay<Args>::type...> State;
+    InlineTask task;
+    task.Emplace<State>(static_cast<X*>(obj), method, std::forward<Args>(args)...);
+    return task;
+  }
+
+  template <typename... Params, typename... Args>
+  inline InlineTask BindOnce(void (*function)(Params...), Args&&... args) {
+    typedef internal::BoundFunction<void (*)(Params...),
+      typename std::decay<Args>::type...> State;
+    InlineTask task;
+    task.Emplace<State>(function, std::forward<Args>(args)...);
+    return task;
+  }
+
+}  // namespace base
+
+#endif
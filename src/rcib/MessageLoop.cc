@@ -9,6 +9,7 @@
 #include <list>
 #include <vector>
 #include <queue>
+#include <utility>
 #include "macros.h"
 #include "ref_counted.h"
 #include "WrapperObj.h"
@@ -17,6 +18,7 @@
 #include "time/time.h"
 #include "util_tools.h"
 #include "Event/WaitableEvent.h"
+#include "Event/FutexEvent.h"
 #include "PendingTask.h"
 #include "observer_list.h"
 #include "thread_local.h"
@@ -28,6 +30,14 @@ namespace base {
 
   static base::ThreadLocalPointer<MessageLoop> tls_ptr ;
 
+  static const int kInteractiveBurst = 16;
+  // Sweep the timer wheel once this many of its tasks, and at least half of
+  // them, have been cancelled...
+  static const int kSweepThreshold = 64;
+  // ...and in any case this long after the first cancel, so that a
+  // cancelled timer does not hold on to its request until its deadline.
+  static const INT64 kSweepDelayMs = 100;
+
   void MessageLoop::AddDestructionObserver(
     DestructionObserver* destruction_observer) {
       assert(this == current());
@@ -41,7 +51,7 @@ namespace base {
   }
 
   MessageLoop::MessageLoop(Type type)
-    :type_(type), running_(false), recent_time_() {
+    :type_(type), running_(false), recent_time_(), interactive_run_(0), work_source_(NULL), work_source_slot_(0), idle_(false), cancelled_(0) {
       Init();
       pump_.reset(CreateMessagePumpForType(type));
   }
@@ -55,25 +65,70 @@ namespace base {
   }
 
   void MessageLoop::PostTask(fastdelegate::Task<void>* task) {
-    PostDelayedTask(task, TimeDelta());
+    PostDelayedTask(InlineTask(task), TimeDelta());
   }
 
   void MessageLoop::PostDelayedTask(fastdelegate::Task<void>* task, TimeDelta delay) {
+    PostDelayedTask(InlineTask(task), delay);
+  }
+
+  void MessageLoop::PostTask(InlineTask &&task, Priority priority) {
+    PendingTask t(std::move(task));
+    AppendTask(t, priority);
+    pump_->ScheduleWork();
+  }
+
+  void MessageLoop::PostDelayedTask(InlineTask &&task, TimeDelta delay,
+    const CancellationFlag* cancel_flag) {
     assert(delay >= TimeDelta());
 
     do {
       if (delay == TimeDelta()) {
-        PendingTask t = PendingTask(task);
-        AppendTask(t);
+        PendingTask t(std::move(task));
+        AppendTask(t, PRIORITY_BULK);
         break;
       }
-      PendingTask t = PendingTask(task, CalculateDelayedRuntime(delay));
-      AppendTask(t);
+      PendingTask t(std::move(task), CalculateDelayedRuntime(delay));
+      t.cancel_flag_ = cancel_flag;
+      AppendTask(t, PRIORITY_BULK);
     } while (false);
 
     pump_->ScheduleWork();
   }
 
+  void MessageLoop::PostSharedTask(InlineTask &&task, Priority priority) {
+    PendingTask t(std::move(task));
+    t.stealable_ = true;
+    AppendTask(t, priority);
+    pump_->ScheduleWork();
+  }
+
+  bool MessageLoop::StealTask(PendingTask &out) {
+    AutoCritSecLock<CriticalSection> lock(work_cs_, true);
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+      TaskQueue &lane = working_queue_[i];
+      if (lane.empty() && 0 == incoming_queue_[i].drain_to(lane))
+        continue;
+      // Leave the oldest work to the owner, take the newest.
+      if (!lane.back().stealable_)
+        continue;
+      out = lane.pick_back();
+      return true;
+    }
+    return false;
+  }
+
+  void MessageLoop::NoteCancelled() {
+    // The loop may be asleep until a far deadline; wake it to set the
+    // sweep's own. Later cancels find it set.
+    if (subtle::Barrier_AtomicIncrement(&cancelled_, 1) == 1)
+      pump_->ScheduleWork();
+  }
+
+  void MessageLoop::WakeUp() {
+    pump_->ScheduleWork();
+  }
+
   void MessageLoop::Run() {
     running_ = true;
     pump_->Run(this);
@@ -96,14 +151,13 @@ namespace base {
     return NULL;
   }
 
-  void MessageLoop::AppendTask(PendingTask &task) {
-    AutoCritSecLock<CriticalSection> lock(m_cs, false);
-    lock.Lock();
-    incoming_queue_.push_back(task);
+  void MessageLoop::AppendTask(PendingTask &task, Priority priority) {
+    assert(priority >= 0 && priority < PRIORITY_COUNT);
+    incoming_queue_[priority].push(std::move(task));
   }
 
-  void MessageLoop::AddToDelayedWorkQueue(const PendingTask& pending_task) {
-    delayed_work_queue_.push(pending_task);
+  void MessageLoop::AddToDelayedWorkQueue(PendingTask &&pending_task) {
+    delayed_work_queue_.push(std::move(pending_task));
   }
 
   void MessageLoop::QuitInternal() {
@@ -124,28 +178,42 @@ namespace base {
   }
 
   void MessageLoop::DeletePendingTasks() {
-    size_t size = working_queue_.size();
-    for (size_t i = 0; i < size; ++i) {
-      PendingTask pending_task = working_queue_.pick_front();
-      pending_task.Reset();
-    }
-    while (!delayed_work_queue_.empty()) {
-      PendingTask pending_task = delayed_work_queue_.top();
-      delayed_work_queue_.pop();
+    PendingTask pending_task;
+    while (PickWorkTask(pending_task)) {
       pending_task.Reset();
     }
+    delayed_work_queue_.clear();
   }
 
   void MessageLoop::ReloadWorkQueue() {
-    if (!working_queue_.empty())
+    // Nothing came in: spare the lock, most passes through DoWork find so.
+    bool incoming = false;
+    for (int i = 0; i < PRIORITY_COUNT; ++i)
+      incoming = incoming || !incoming_queue_[i].empty();
+    if (!incoming)
       return;
+    AutoCritSecLock<CriticalSection> work_lock(work_cs_, true);
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+      // Takes the whole incoming batch with one atomic exchange.
+      if (working_queue_[i].empty())
+        incoming_queue_[i].drain_to(working_queue_[i]);
+    }
+  }
 
-    AutoCritSecLock<CriticalSection> lock(m_cs, false);
-    lock.Lock();
-    if (0 == incoming_queue_.size()) {
-    } else {
-      incoming_queue_.swap(working_queue_);
+  bool MessageLoop::PickWorkTask(PendingTask &task) {
+    AutoCritSecLock<CriticalSection> lock(work_cs_, true);
+    TaskQueue &interactive = working_queue_[PRIORITY_INTERACTIVE];
+    TaskQueue &bulk = working_queue_[PRIORITY_BULK];
+    if (!interactive.empty() && (bulk.empty() || interactive_run_ < kInteractiveBurst)) {
+      task = interactive.pick_front();
+      ++interactive_run_;
+      return true;
     }
+    if (bulk.empty())
+      return false;
+    task = bulk.pick_front();
+    interactive_run_ = 0;
+    return true;
   }
 
   bool MessageLoop::RunPendingTask(PendingTask &pending_task) {
@@ -159,24 +227,25 @@ namespace base {
   }
 
   bool MessageLoop::DoWork() {
+    idle_ = false;
     for (;;) {
       ReloadWorkQueue();
-      if (working_queue_.empty())
-        break;
 
       //Execute oldest task.
+      PendingTask pending_task;
+      if (!PickWorkTask(pending_task))
+        break;
+
       do {
-        PendingTask pending_task = working_queue_.pick_front();
         if (!pending_task.delayed_run_time_.is_null()) {
-          AddToDelayedWorkQueue(pending_task);
-          // If we changed the topmost task, then it is time to reschedule.
-          if (delayed_work_queue_.top().Equals(&pending_task))
-            pump_->ScheduleDelayedWork(pending_task.delayed_run_time_);
+          AddToDelayedWorkQueue(std::move(pending_task));
+          // The new task may be the earliest, so reschedule.
+          pump_->ScheduleDelayedWork(delayed_work_queue_.next_run_time());
         } else {
           if (RunPendingTask(pending_task))
             return true;
         }
-      } while (!working_queue_.empty());
+      } while (PickWorkTask(pending_task));
     }
     //Nothing runned.
     return false;
@@ -188,27 +257,53 @@ namespace base {
       return false;
     }
 
-    TimeTicks next_run_time = delayed_work_queue_.top().delayed_run_time_;
+    subtle::Atomic32 cancelled = cancelled_;
+    if (cancelled > 0) {
+      if (sweep_due_.is_null())
+        sweep_due_ = TimeTicks::Now() + TimeDelta::FromMilliseconds(kSweepDelayMs);
+      bool sweep = cancelled >= kSweepThreshold &&
+        static_cast<size_t>(cancelled) * 2 >= delayed_work_queue_.size();
+      if (!sweep && sweep_due_ > recent_time_)
+        recent_time_ = TimeTicks::Now();
+      if (sweep || sweep_due_ <= recent_time_) {
+        subtle::Barrier_AtomicIncrement(&cancelled_, -cancelled);
+        delayed_work_queue_.sweep();
+        // Cancels noted meanwhile get a deadline of their own.
+        sweep_due_ = cancelled_ > 0 ?
+          TimeTicks::Now() + TimeDelta::FromMilliseconds(kSweepDelayMs) : TimeTicks();
+      }
+    }
+
+    TimeTicks next_run_time = delayed_work_queue_.next_run_time();
     if (next_run_time > recent_time_) {
       recent_time_ = TimeTicks::Now();
       if (next_run_time > recent_time_) {
-        *next_delayed_work_time = next_run_time;
+        *next_delayed_work_time = WakeTime(next_run_time);
         return false;
       }
     }
 
-    PendingTask pending_task = delayed_work_queue_.top();
-    delayed_work_queue_.pop();
-
-    if (!delayed_work_queue_.empty()) {
-      *next_delayed_work_time = delayed_work_queue_.top().delayed_run_time_;
-    }
+    PendingTask pending_task;
+    bool due = delayed_work_queue_.pick_due(recent_time_, pending_task);
+    // The wheel may only have had tasks to move down a level.
+    *next_delayed_work_time = WakeTime(delayed_work_queue_.next_run_time());
+    if (!due)
+      return false;
 
     RunPendingTask(pending_task);
     return true;
   }
 
+  TimeTicks MessageLoop::WakeTime(TimeTicks next_run_time) const {
+    if (!sweep_due_.is_null() && sweep_due_ < next_run_time)
+      return sweep_due_;
+    return next_run_time;
+  }
+
   bool MessageLoop::DoIdleWork() {
+    if (work_source_ && work_source_->StealWork(work_source_slot_))
+      return true;
+    idle_ = true;
     return false;
   }
 
@@ -11,6 +11,15 @@ namespace base {
       TYPE_IO,
     };
 
+    // Work lanes. DoWork always serves the interactive lane first, except
+    // that every kInteractiveBurst interactive tasks in a row it lets one
+    // waiting bulk task through, so the bulk lane cannot starve.
+    enum Priority {
+      PRIORITY_INTERACTIVE = 0,
+      PRIORITY_BULK,
+      PRIORITY_COUNT,
+    };
+
     template <class T>
     class DeleteHelper {
     public:
@@ -28,6 +37,18 @@ namespace base {
       virtual ~DestructionObserver() {}
     };
 
+    // Supplies work to a loop that has drained its own queues. ThreadPool
+    // implements it to let idle workers steal from busy siblings.
+    class WorkSource {
+    public:
+      // Called on the thief's thread with the slot it was given in
+      // set_work_source. Returns true if a task was run.
+      virtual bool StealWork(size_t thief) = 0;
+
+    protected:
+      virtual ~WorkSource() {}
+    };
+
     void AddDestructionObserver(DestructionObserver* destruction_observer);
     // Remove a DestructionObserver.  It is safe to call this method while a
     // DestructionObserver is receiving a notification callback.
@@ -38,6 +59,34 @@ namespace base {
     static MessageLoop* current();
     void PostTask(fastdelegate::Task<void>* task);
     void PostDelayedTask(fastdelegate::Task<void>* task, TimeDelta delay);
+    // Preferred over the Task* overloads: a task made by BindOnce is moved
+    // through the queues without a heap allocation or a refcount update.
+    void PostTask(InlineTask &&task, Priority priority = PRIORITY_BULK);
+    // Delayed tasks run in deadline order once due, whatever their lane.
+    // Once |cancel_flag| is cancelled the task runs early so that it can
+    // clean up; it must check the flag.
+    void PostDelayedTask(InlineTask &&task, TimeDelta delay,
+      const CancellationFlag* cancel_flag = NULL);
+    // Tells the loop that a delayed task was cancelled. May be called from
+    // any thread. Cancelled timers are swept out in batches, at the latest
+    // a fixed delay after the first of them.
+    void NoteCancelled();
+    // Like PostTask, but the task may be taken over and run by an idle loop
+    // that shares this loop's WorkSource.
+    void PostSharedTask(InlineTask &&task, Priority priority = PRIORITY_BULK);
+    // Takes the newest queued shared task, if any, interactive lane first.
+    // May be called from any thread; used by a WorkSource on behalf of a
+    // thief loop.
+    bool StealTask(PendingTask &out);
+    // Wakes the loop up so that it polls its WorkSource again.
+    void WakeUp();
+    // True while the loop has nothing to do and is about to sleep. This is
+    // only a hint for other threads.
+    bool is_idle() const { return idle_; }
+    void set_work_source(WorkSource* work_source, size_t slot) {
+      work_source_ = work_source;
+      work_source_slot_ = slot;
+    }
     template<typename T>
     void DeleteSoon(T *object) {
       PostTask(Bind(DeleteHelper<T>::DoDelete, object));
@@ -62,13 +111,16 @@ namespace base {
 
   private:
     void Init();
-    void AddToDelayedWorkQueue(const PendingTask& pending_task);
+    void AddToDelayedWorkQueue(PendingTask &&pending_task);
     TimeTicks CalculateDelayedRuntime(TimeDelta delay);
     void QuitInternal();
     void DeletePendingTasks();
     void ReloadWorkQueue();
     bool RunPendingTask(PendingTask &pending_task);
-    void AppendTask(PendingTask &task);
+    void AppendTask(PendingTask &task, Priority priority);
+    bool PickWorkTask(PendingTask &task);
+    // |next_run_time|, or the sweep's deadline if that comes first.
+    TimeTicks WakeTime(TimeTicks next_run_time) const;
     // MessagePump::Delegate methods:
     virtual bool DoWork() OVERRIDE;
     virtual bool DoDelayedWork(TimeTicks* next_delayed_work_time) OVERRIDE;
@@ -79,11 +131,21 @@ namespace base {
     Type type_;
     std::auto_ptr<MessagePump> pump_;
     ObserverList<DestructionObserver> destruction_observers_;
-    TaskQueue incoming_queue_;
-    TaskQueue working_queue_;
+    IncomingTaskQueue incoming_queue_[PRIORITY_COUNT];
+    TaskQueue working_queue_[PRIORITY_COUNT];
     DelayedTaskQueue delayed_work_queue_;
-    CriticalSection m_cs;
+    // Guards |working_queue_| against thieves.
+    CriticalSection work_cs_;
+    // Interactive tasks run since the last bulk one. Under |work_cs_|.
+    int interactive_run_;
     TimeTicks recent_time_;
+    WorkSource* work_source_;
+    size_t work_source_slot_;
+    volatile bool idle_;
+    // Delayed tasks cancelled since the last sweep.
+    volatile subtle::Atomic32 cancelled_;
+    // When the cancelled tasks are swept at the latest; null if none are.
+    TimeTicks sweep_due_;
   };
 
 }// end base
@@ -9,6 +9,8 @@ namespace base {
 
   class NOVTABLE MessagePump {
   public: 
+    virtual ~MessagePump() {}
+
     class NOVTABLE Delegate {
     public:
       // Called from within Run in response to ScheduleWork or when the message
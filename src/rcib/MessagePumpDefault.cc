@@ -8,11 +8,12 @@
 #include "time/time.h"
 #include "MessagePump.h"
 #include "Event/WaitableEvent.h"
+#include "Event/FutexEvent.h"
 #include "MessagePumpDefault.h"
 
 namespace base {
 
-  MessagePumpDefault::MessagePumpDefault(): keep_running_(true), event_(false, false) {
+  MessagePumpDefault::MessagePumpDefault(): keep_running_(true) {
 
   }
 
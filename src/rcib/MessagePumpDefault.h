@@ -18,8 +18,9 @@ namespace base {
     // This flag is set to false when Run should return.
     bool keep_running_;
 
-    // Used to sleep until there is more work to do.
-    WaitableEvent event_;
+    // Used to sleep until there is more work to do. Posting to a busy pump
+    // stays in user space.
+    FutexEvent event_;
 
     // The time at which we should call DoDelayedWork.
     TimeTicks delayed_work_time_;
@@ -19,9 +19,11 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#include <intrin.h>
 #else
 #include <assert.h>
 #endif
+#include <string.h>
 #include <string>
 #include <memory>
 #include <list>
@@ -32,35 +34,57 @@
 #include "FastDelegateImpl.h"
 #include "time/time.h"
 #include <queue>
+#include <utility>
+#include "thread_local.h"
 #include "PendingTask.h"
 
 namespace base {
 
-  PendingTask::PendingTask():task_(NULL), sequence_num_(0) {}
+  PendingTask::PendingTask()
+    :sequence_num_(0), stealable_(false), cancel_flag_(NULL) {}
 
-  PendingTask::PendingTask(fastdelegate::Task<void>* task):task_(task),sequence_num_(0) {}
+  PendingTask::PendingTask(fastdelegate::Task<void>* task)
+    :sequence_num_(0), stealable_(false), cancel_flag_(NULL), task_(task) {}
 
   PendingTask::PendingTask(fastdelegate::Task<void>* task, const TimeTicks delayed_run_time)
-    :task_(task), delayed_run_time_(delayed_run_time), sequence_num_(0) {}
+    :delayed_run_time_(delayed_run_time), sequence_num_(0), stealable_(false),
+    cancel_flag_(NULL), task_(task) {}
+
+  PendingTask::PendingTask(InlineTask &&task)
+    :sequence_num_(0), stealable_(false), cancel_flag_(NULL), task_(std::move(task)) {}
+
+  PendingTask::PendingTask(InlineTask &&task, const TimeTicks delayed_run_time)
+    :delayed_run_time_(delayed_run_time), sequence_num_(0), stealable_(false),
+    cancel_flag_(NULL), task_(std::move(task)) {}
+
+  PendingTask::PendingTask(PendingTask&& other)
+    :delayed_run_time_(other.delayed_run_time_), sequence_num_(other.sequence_num_),
+    stealable_(other.stealable_), cancel_flag_(other.cancel_flag_),
+    task_(std::move(other.task_)) {}
 
   PendingTask::~PendingTask() {}
 
-  bool PendingTask::is_null() {
-    return NULL == task_.get();
+  PendingTask& PendingTask::operator=(PendingTask&& other) {
+    if (this != &other) {
+      task_ = std::move(other.task_);
+      delayed_run_time_ = other.delayed_run_time_;
+      sequence_num_ = other.sequence_num_;
+      stealable_ = other.stealable_;
+      cancel_flag_ = other.cancel_flag_;
+    }
+    return *this;
   }
 
-  void PendingTask::Reset() {
-    task_ = NULL;
+  bool PendingTask::is_null() {
+    return task_.is_null();
   }
 
-  bool PendingTask::Equals(PendingTask* other) const {
-    return task_.get() == other->task_.get();
+  void PendingTask::Reset() {
+    task_.Reset();
   }
 
   void PendingTask::Run() {
-    if(task_.get()) {
-      task_->Run();
-    }
+    task_.Run();
   }
 
   bool PendingTask::operator<(const PendingTask& other) const {
@@ -80,33 +104,432 @@ namespace base {
   }
   //task queue
   namespace taskqueue {
-    bool queue::empty() {
-      return _val.empty();
+    queue::queue()
+      :buffer_(NULL), capacity_(0), head_(0), size_(0), sequence_num_(0) {
     }
 
-    size_t queue::size() {
-      return _val.size();
+    queue::~queue() {
+      delete[] buffer_;
     }
 
-    void queue::push_back(const PendingTask &val) {
-      val.sequence_num_ = ++sequence_num_;
-      _val.push_back(val);
+    void queue::push_back(PendingTask &&val) {
+      if (size_ == capacity_)
+        Grow();
+      PendingTask &slot = buffer_[(head_ + size_) & (capacity_ - 1)];
+      slot = std::move(val);
+      slot.sequence_num_ = ++sequence_num_;
+      ++size_;
     }
 
     PendingTask queue::pick_front() {
-      assert(_val.size());
-      PendingTask o = _val.front();
-      _val.pop_front();
+      assert(size_);
+      PendingTask o(std::move(buffer_[head_]));
+      head_ = (head_ + 1) & (capacity_ - 1);
+      --size_;
       return o;
     }
 
-    PendingTask queue::front() {
-      assert(_val.size());
-      return _val.front();
+    const PendingTask &queue::front() const {
+      assert(size_);
+      return buffer_[head_];
+    }
+
+    PendingTask queue::pick_back() {
+      assert(size_);
+      --size_;
+      return PendingTask(std::move(buffer_[(head_ + size_) & (capacity_ - 1)]));
+    }
+
+    const PendingTask &queue::back() const {
+      assert(size_);
+      return buffer_[(head_ + size_ - 1) & (capacity_ - 1)];
     }
 
     void queue::swap(taskqueue::queue &val) {
-      _val.swap(val._val);
+      std::swap(buffer_, val.buffer_);
+      std::swap(capacity_, val.capacity_);
+      std::swap(head_, val.head_);
+      std::swap(size_, val.size_);
+    }
+
+    void queue::Grow() {
+      size_t capacity = capacity_ ? capacity_ * 2 : 16;
+      PendingTask* buffer = new PendingTask[capacity];
+      for (size_t i = 0; i < size_; ++i) {
+        buffer[i] = std::move(buffer_[(head_ + i) & (capacity_ - 1)]);
+      }
+      delete[] buffer_;
+      buffer_ = buffer;
+      capacity_ = capacity;
+      head_ = 0;
+    }
+
+    // timer wheel
+    static const INT64 kMicrosecondsPerTick = Time::kMicrosecondsPerMillisecond;
+    static const INT64 kMaxDelta = (1LL << 32) - 1;
+
+    static inline INT64 TickOf(TimeTicks t) {
+      return t.ToInternalValue() / kMicrosecondsPerTick;
+    }
+
+    // Rounds up, so a task never runs early.
+    static inline INT64 DeadlineTickOf(TimeTicks t) {
+      return (t.ToInternalValue() + kMicrosecondsPerTick - 1) / kMicrosecondsPerTick;
+    }
+
+    static inline int LevelShift(int level) {
+      return 8 + (level - 1) * 6;
+    }
+
+    static inline int LowestBit(UINT64 bits) {
+#ifdef _WIN32
+      unsigned long index;
+      _BitScanForward64(&index, bits);
+      return static_cast<int>(index);
+#else
+      return __builtin_ctzll(bits);
+#endif
+    }
+
+    // Tasks are filed at the tail; one posted out of order walks in.
+    static inline bool SeqBefore(unsigned int a, unsigned int b) {
+      return static_cast<int>(a - b) < 0;
+    }
+
+    timer_wheel::timer_wheel():free_(NULL), current_(0), size_(0) {
+      memset(root_, 0, sizeof(root_));
+      memset(levels_, 0, sizeof(levels_));
+      memset(root_bits_, 0, sizeof(root_bits_));
+      memset(level_bits_, 0, sizeof(level_bits_));
+      ready_.head = ready_.tail = NULL;
+    }
+
+    timer_wheel::~timer_wheel() {
+      clear();
+      while (free_) {
+        node* n = free_;
+        free_ = n->next;
+        delete n;
+      }
+    }
+
+    timer_wheel::node* timer_wheel::NewNode() {
+      node* n = free_;
+      if (!n)
+        return new node;
+      free_ = n->next;
+      return n;
+    }
+
+    void timer_wheel::FreeNode(node* n) {
+      n->next = free_;
+      free_ = n;
+    }
+
+    void timer_wheel::push(PendingTask &&task) {
+      if (0 == size_) {
+        // Nothing was filed, so the wheel may have stood still for a while.
+        INT64 now = TickOf(TimeTicks::Now());
+        if (now > current_)
+          current_ = now;
+      }
+      node* n = NewNode();
+      n->expires = DeadlineTickOf(task.delayed_run_time_);
+      n->task = std::move(task);
+      ++size_;
+      Insert(n);
+    }
+
+    void timer_wheel::Insert(node* n) {
+      n->next = NULL;
+      INT64 delta = n->expires - current_;
+      if (delta < 0) {
+        // Already due.
+        AppendReady(n);
+        return;
+      }
+      if (delta < kRootSize) {
+        int index = static_cast<int>(n->expires & (kRootSize - 1));
+        slot &s = root_[index];
+        root_bits_[index >> 6] |= 1ULL << (index & 63);
+        if (!s.tail || !SeqBefore(n->task.sequence_num_, s.tail->task.sequence_num_)) {
+          if (s.tail)
+            s.tail->next = n;
+          else
+            s.head = n;
+          s.tail = n;
+          return;
+        }
+        node** link = &s.head;
+        while (!SeqBefore(n->task.sequence_num_, (*link)->task.sequence_num_))
+          link = &(*link)->next;
+        n->next = *link;
+        *link = n;
+        return;
+      }
+      INT64 expires = n->expires;
+      if (delta > kMaxDelta)
+        expires = current_ + kMaxDelta;  // re-filed when this slot comes up
+      int level = 1;
+      while (level < kLevels - 1 && delta >= (1LL << LevelShift(level + 1)))
+        ++level;
+      int index = static_cast<int>((expires >> LevelShift(level)) & (kLevelSize - 1));
+      slot &s = levels_[level - 1][index];
+      level_bits_[level - 1] |= 1ULL << index;
+      if (s.tail)
+        s.tail->next = n;
+      else
+        s.head = n;
+      s.tail = n;
+    }
+
+    void timer_wheel::Cascade(int level, int index) {
+      slot &s = levels_[level - 1][index];
+      node* n = s.head;
+      s.head = s.tail = NULL;
+      level_bits_[level - 1] &= ~(1ULL << index);
+      while (n) {
+        node* next = n->next;
+        if (n->task.IsCancelled())
+          AppendReady(n);
+        else
+          Insert(n);
+        n = next;
+      }
+    }
+
+    void timer_wheel::AppendReady(node* n) {
+      n->next = NULL;
+      if (ready_.tail)
+        ready_.tail->next = n;
+      else
+        ready_.head = n;
+      ready_.tail = n;
+    }
+
+    void timer_wheel::Expire(int index) {
+      slot &s = root_[index];
+      node* n = s.head;
+      s.head = s.tail = NULL;
+      root_bits_[index >> 6] &= ~(1ULL << (index & 63));
+      while (n) {
+        node* next = n->next;
+        if (n->expires > current_ && !n->task.IsCancelled()) {
+          // Was parked past the top level; file it again.
+          Insert(n);
+        } else {
+          AppendReady(n);
+        }
+        n = next;
+      }
+    }
+
+    void timer_wheel::Advance(INT64 tick) {
+      while (current_ <= tick) {
+        int index = static_cast<int>(current_ & (kRootSize - 1));
+        if (0 == index) {
+          for (int level = 1; level < kLevels; ++level) {
+            int i = static_cast<int>((current_ >> LevelShift(level)) & (kLevelSize - 1));
+            Cascade(level, i);
+            if (i)
+              break;
+          }
+        }
+        if (root_bits_[index >> 6] & (1ULL << (index & 63)))
+          Expire(index);
+        ++current_;
+        INT64 next = NextEventTick();
+        current_ = next > tick ? tick + 1 : next;
+      }
+    }
+
+    INT64 timer_wheel::NextEventTick() const {
+      INT64 best = current_ + kMaxDelta + 1;
+      int index = static_cast<int>(current_ & (kRootSize - 1));
+      int first = index >> 6;
+      // The word holding |index| from |index| up, the following words, and
+      // last the bits of the first word below |index|, which are next round.
+      for (int i = 0; i <= kRootSize / 64; ++i) {
+        int w = (first + i) % (kRootSize / 64);
+        UINT64 bits = root_bits_[w];
+        if (0 == i)
+          bits &= ~0ULL << (index & 63);
+        if (bits) {
+          int b = (w << 6) + LowestBit(bits);
+          best = current_ + ((b - index) & (kRootSize - 1));
+          break;
+        }
+      }
+      for (int level = 1; level < kLevels; ++level) {
+        UINT64 bits = level_bits_[level - 1];
+        if (!bits)
+          continue;
+        int shift = LevelShift(level);
+        INT64 base = current_ >> shift;
+        int ci = static_cast<int>(base & (kLevelSize - 1));
+        INT64 when;
+        if (0 == (current_ & ((1LL << shift) - 1)) && (bits & (1ULL << ci))) {
+          // Sitting on the boundary that has yet to cascade this slot.
+          when = current_;
+        } else {
+          int rot = (ci + 1) & (kLevelSize - 1);
+          UINT64 rotated = rot ? ((bits >> rot) | (bits << (kLevelSize - rot))) : bits;
+          when = (base + 1 + LowestBit(rotated)) << shift;
+        }
+        if (when < best)
+          best = when;
+      }
+      return best;
+    }
+
+    bool timer_wheel::pick_due(TimeTicks now, PendingTask &out) {
+      if (!ready_.head)
+        Advance(TickOf(now));
+      node* n = ready_.head;
+      if (!n)
+        return false;
+      ready_.head = n->next;
+      if (!ready_.head)
+        ready_.tail = NULL;
+      out = std::move(n->task);
+      FreeNode(n);
+      --size_;
+      return true;
+    }
+
+    TimeTicks timer_wheel::next_run_time() const {
+      if (0 == size_)
+        return TimeTicks();
+      if (ready_.head)
+        return TimeTicks((current_ - 1) * kMicrosecondsPerTick);
+      return TimeTicks(NextEventTick() * kMicrosecondsPerTick);
+    }
+
+    void timer_wheel::clear() {
+      DropList(ready_);
+      for (int i = 0; i < kRootSize; ++i)
+        DropList(root_[i]);
+      for (int level = 0; level < kLevels - 1; ++level) {
+        for (int i = 0; i < kLevelSize; ++i)
+          DropList(levels_[level][i]);
+      }
+      memset(root_bits_, 0, sizeof(root_bits_));
+      memset(level_bits_, 0, sizeof(level_bits_));
+      size_ = 0;
+    }
+
+    void timer_wheel::sweep() {
+      for (int i = 0; i < kRootSize; ++i) {
+        SweepList(root_[i]);
+        if (!root_[i].head)
+          root_bits_[i >> 6] &= ~(1ULL << (i & 63));
+      }
+      for (int level = 0; level < kLevels - 1; ++level) {
+        for (int i = 0; i < kLevelSize; ++i) {
+          SweepList(levels_[level][i]);
+          if (!levels_[level][i].head)
+            level_bits_[level] &= ~(1ULL << i);
+        }
+      }
+    }
+
+    void timer_wheel::SweepList(slot &s) {
+      node** link = &s.head;
+      s.tail = NULL;
+      while (*link) {
+        node* n = *link;
+        if (n->task.IsCancelled()) {
+          *link = n->next;
+          AppendReady(n);
+        } else {
+          s.tail = n;
+          link = &n->next;
+        }
+      }
+    }
+
+    void timer_wheel::DropList(slot &s) {
+      for (node* n = s.head; n;) {
+        node* next = n->next;
+        n->task.Reset();
+        FreeNode(n);
+        n = next;
+      }
+      s.head = s.tail = NULL;
+    }
+
+    // Consumers hand drained nodes back here in one piece; a producer that
+    // runs out takes the whole list into its own cache with one exchange.
+    // Nobody ever pops a single node off the shared list, so it is immune
+    // to ABA.
+    static mpsc_queue::node* volatile free_nodes_ = NULL;
+    static base::ThreadLocalPointer<mpsc_queue::node> node_cache_;
+
+    static mpsc_queue::node* AcquireNode() {
+      mpsc_queue::node* n = node_cache_.Get();
+      if (!n) {
+        n = static_cast<mpsc_queue::node*>(subtle::Barrier_ExchangePointer(
+          reinterpret_cast<void* volatile*>(&free_nodes_), NULL));
+      }
+      if (!n)
+        return new mpsc_queue::node;
+      node_cache_.Set(n->next);
+      return n;
+    }
+
+    static void ReleaseNodes(mpsc_queue::node* first, mpsc_queue::node* last) {
+      for (;;) {
+        mpsc_queue::node* old = free_nodes_;
+        last->next = old;
+        if (subtle::Barrier_CompareAndSwapPointer(reinterpret_cast<void* volatile*>(&free_nodes_),
+          old, first) == old)
+          return;
+      }
+    }
+
+    mpsc_queue::mpsc_queue():head_(NULL) {
+    }
+
+    mpsc_queue::~mpsc_queue() {
+      queue dropped;
+      drain_to(dropped);
+    }
+
+    void mpsc_queue::push(PendingTask &&task) {
+      node* n = AcquireNode();
+      n->task = std::move(task);
+      for (;;) {
+        node* old = head_;
+        n->next = old;
+        if (subtle::Barrier_CompareAndSwapPointer(reinterpret_cast<void* volatile*>(&head_),
+          old, n) == old)
+          return;
+      }
+    }
+
+    size_t mpsc_queue::drain_to(queue &out) {
+      // Cheap check first; most polls of a quiet lane find nothing.
+      if (!head_)
+        return 0;
+      node* newest = static_cast<node*>(subtle::Barrier_ExchangePointer(
+        reinterpret_cast<void* volatile*>(&head_), NULL));
+      if (!newest)
+        return 0;
+      // The list is newest first; reverse it to keep FIFO order.
+      node* oldest = NULL;
+      for (node* n = newest; n;) {
+        node* next = n->next;
+        n->next = oldest;
+        oldest = n;
+        n = next;
+      }
+      size_t count = 0;
+      for (node* n = oldest; n; n = n->next) {
+        out.push_back(std::move(n->task));
+        ++count;
+      }
+      ReleaseNodes(oldest, newest);
+      return count;
     }
   }
 
@@ -20,6 +20,10 @@
 #ifndef MUL_PENDING_TASK_
 #define MUL_PENDING_TASK_
 
+#include "atomicops.h"
+#include "InlineTask.h"
+#include "CancellationFlag.h"
+
 namespace base {
 
   class PendingTask {
@@ -27,52 +31,171 @@ namespace base {
     explicit PendingTask();
     explicit PendingTask(fastdelegate::Task<void>* task);
     explicit PendingTask(fastdelegate::Task<void>* task, const TimeTicks delayed_run_time);
+    explicit PendingTask(InlineTask &&task);
+    explicit PendingTask(InlineTask &&task, const TimeTicks delayed_run_time);
+    // Tasks are move-only; moving hands the bound state over in place.
+    PendingTask(PendingTask&& other);
     ~PendingTask();
 
+    PendingTask& operator=(PendingTask&& other);
+
     bool is_null();
 
     void Reset();
 
-    bool Equals(PendingTask* other) const;
-
     void Run();
+    bool IsCancelled() const {
+      return cancel_flag_ && cancel_flag_->IsCancelled();
+    }
     // Used to support sorting.
     bool operator<(const PendingTask& other) const;
     // The time when the task should be run.
     base::TimeTicks delayed_run_time_;
     // Secondary sort key for run time.
     mutable unsigned int sequence_num_;
+    // Whether an idle sibling loop may take this task over. Only set for
+    // work posted through MessageLoop::PostSharedTask.
+    bool stealable_;
+    // Set for delayed tasks that may be withdrawn. A cancelled task still
+    // runs, just sooner; the flag must outlive it.
+    const CancellationFlag* cancel_flag_;
 
   private:
-    scoped_refptr<fastdelegate::Task<void> > task_;
+    InlineTask task_;
+    DISALLOW_COPY_AND_ASSIGN_(PendingTask);
   };
 
   namespace taskqueue {
+    // A growable ring buffer of tasks. It never shrinks, so once it has seen
+    // the peak load, pushing and picking neither allocate nor copy.
     class queue {
     public:
-      queue():sequence_num_(0) {
-        _val.clear();
-      }
-      ~queue() {
-        _val.clear();
-      }
-      bool empty();
-      size_t size();
-      void push_back(const PendingTask &task);
-      //_val.empty() is false
+      queue();
+      ~queue();
+      bool empty() const { return 0 == size_; }
+      size_t size() const { return size_; }
+      // Moves |task| in; |task| is left null.
+      void push_back(PendingTask &&task);
+      //empty() is false
       PendingTask pick_front();
-      PendingTask front();
+      const PendingTask &front() const;
+      //empty() is false
+      PendingTask pick_back();
+      const PendingTask &back() const;
+      // Exchanges storage, so neither queue frees its buffer.
       void swap(queue &val);
 
     private:
-      std::list<PendingTask> _val;
+      void Grow();
+
+      PendingTask* buffer_;
+      size_t capacity_;  // always a power of 2
+      size_t head_;
+      size_t size_;
       unsigned int sequence_num_;
+      DISALLOW_COPY_AND_ASSIGN_(queue);
+    };
+
+    // Intrusive multi-producer/single-consumer queue. push() never takes a
+    // lock, and the consumer takes everything pushed so far with a single
+    // atomic exchange. Nodes are recycled through a process wide free list,
+    // so a steady stream of posts does not hit the allocator.
+    class mpsc_queue {
+    public:
+      struct node {
+        PendingTask task;
+        node* next;
+      };
+
+      mpsc_queue();
+      ~mpsc_queue();
+      // May be called from any thread. |task| is moved in.
+      void push(PendingTask &&task);
+      // Moves all pushed tasks, oldest first, to the back of |out|. Returns
+      // the number of tasks moved. Only one thread may drain at a time.
+      size_t drain_to(queue &out);
+      // Only a hint when other threads push.
+      bool empty() const { return NULL == head_; }
+
+    private:
+      node* volatile head_;
+      DISALLOW_COPY_AND_ASSIGN_(mpsc_queue);
+    };
+    // Hierarchical timing wheel for delayed tasks, after the classic Linux
+    // timer wheel. Resolution is one millisecond. Level 0 has 256 slots of
+    // 1ms; each of the four levels above has 64 slots as wide as the whole
+    // level below, covering about 16 seconds, 17 minutes, 18 hours and 49
+    // days. Filing a task is O(1). A task drops one level each time its slot
+    // comes up and is due when its level 0 slot does. Tasks due at the same
+    // tick come out in posting order. Owned and used by one thread.
+    class timer_wheel {
+    public:
+      timer_wheel();
+      ~timer_wheel();
+      bool empty() const { return 0 == size_; }
+      size_t size() const { return size_; }
+      // Files |task| by its delayed_run_time_; |task| is left null.
+      void push(PendingTask &&task);
+      // Takes the oldest task that is due at |now|, if any.
+      bool pick_due(TimeTicks now, PendingTask &out);
+      // When the wheel next needs a look: exact for tasks within level 0,
+      // otherwise when the next occupied upper slot comes up. Null if empty.
+      TimeTicks next_run_time() const;
+      // Drops all tasks without running them.
+      void clear();
+      // Makes every cancelled task due right away, so that it can let go of
+      // its resources instead of waiting out its delay.
+      void sweep();
+
+    private:
+      enum {
+        kLevels = 5,
+        kRootBits = 8,
+        kRootSize = 1 << kRootBits,
+        kLevelBits = 6,
+        kLevelSize = 1 << kLevelBits,
+      };
+
+      struct node {
+        PendingTask task;
+        INT64 expires;  // in ticks
+        node* next;
+      };
+
+      struct slot {
+        node* head;
+        node* tail;
+      };
+
+      node* NewNode();
+      void FreeNode(node* n);
+      void DropList(slot &s);
+      void Insert(node* n);
+      void Cascade(int level, int index);
+      void AppendReady(node* n);
+      void SweepList(slot &s);
+      void Expire(int index);
+      void Advance(INT64 tick);
+      INT64 NextEventTick() const;
+
+      slot root_[kRootSize];
+      slot levels_[kLevels - 1][kLevelSize];
+      // Which slots are occupied, so that empty stretches are skipped.
+      UINT64 root_bits_[kRootSize / 64];
+      UINT64 level_bits_[kLevels - 1];
+      // Due tasks, oldest first.
+      slot ready_;
+      node* free_;
+      // The next tick to process.
+      INT64 current_;
+      size_t size_;
+      DISALLOW_COPY_AND_ASSIGN_(timer_wheel);
     };
-    // PendingTasks are sorted by their |delayed_run_time| property.
   }// end namespace taskqueue
 
-  typedef std::priority_queue<base::PendingTask> DelayedTaskQueue;
+  typedef taskqueue::timer_wheel DelayedTaskQueue;
   typedef taskqueue::queue TaskQueue;
+  typedef taskqueue::mpsc_queue IncomingTaskQueue;
 
 }// end base
 
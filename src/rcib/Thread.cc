@@ -54,6 +54,7 @@
 #include "MessagePump.h"
 #include "util_tools.h"
 #include "Event/WaitableEvent.h"
+#include "Event/FutexEvent.h"
 #include "PendingTask.h"
 #include "observer_list.h"
 #include "MessagePumpDefault.h"
@@ -78,10 +79,10 @@ namespace base {
   void * ThreadFunc(void* params);
 #endif
   Thread::Options::Options()
-    :message_loop_type_(MessageLoop::TYPE_DEFAULT), stack_size_(0) {
+    :message_loop_type_(MessageLoop::TYPE_DEFAULT), stack_size_(0), work_source_(NULL), work_source_slot_(0) {
   }
   Thread::Options::Options(MessageLoop::Type type, size_t size)
-    :message_loop_type_(type), stack_size_(size) {
+    :message_loop_type_(type), stack_size_(size), work_source_(NULL), work_source_slot_(0) {
 
   }
 
@@ -193,6 +194,8 @@ namespace base {
     thread_id_ = syscall(__NR_gettid);
 #endif
     message_loop->set_thread_name(name_);
+    message_loop->set_work_source(startup_data_->options_.work_source_,
+      startup_data_->options_.work_source_slot_);
     message_loop_ = message_loop.get();
 #ifdef _WIN32
     std::auto_ptr<ScopedCOMInitializer> com_initializer;
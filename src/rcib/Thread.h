@@ -39,6 +39,10 @@ namespace base {
 
       size_t stack_size_;
       MessageLoop::Type message_loop_type_;
+      // Handed to the thread's MessageLoop before it starts running.
+      MessageLoop::WorkSource* work_source_;
+      // What the loop tells |work_source_| it is when it asks for work.
+      size_t work_source_slot_;
     };
     enum ThreadPriority {
       kThreadPriority_Normal,
@@ -0,0 +1,292 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <assert.h>
+#endif
+
+#include <string>
+#include <memory>
+#include <list>
+#include <queue>
+#include <vector>
+#include <map>
+#include "macros.h"
+#include "ref_counted.h"
+#include "WrapperObj.h"
+#include "WeakPtr.h"
+#include "FastDelegateImpl.h"
+#include "time/time.h"
+#include "MessagePump.h"
+#include "util_tools.h"
+#include "Event/WaitableEvent.h"
+#include "Event/FutexEvent.h"
+#include "PendingTask.h"
+#include "observer_list.h"
+#include "MessagePumpDefault.h"
+#include "MessageLoop.h"
+#include "roler.h"
+#include "Thread.h"
+#include "ThreadPool.h"
+
+namespace base {
+
+  static void YieldThread() {
+#ifdef _WIN32
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+  }
+
+  ThreadPool::ThreadPool()
+    :size_(DefaultSize()), next_runner_(0), started_(false),
+    steal_flags_(NULL), open_(0), posting_(0) {
+  }
+
+  ThreadPool::~ThreadPool() {
+    Stop();
+  }
+
+  //static
+  ThreadPool* ThreadPool::GetInstance() {
+    static ThreadPool This;
+    return &This;
+  }
+
+  //static
+  size_t ThreadPool::DefaultSize() {
+    long cpus = 0;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    cpus = static_cast<long>(info.dwNumberOfProcessors);
+#else
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return cpus > 0 ? static_cast<size_t>(cpus) : 1;
+  }
+
+  bool ThreadPool::SetSize(size_t size) {
+    AutoCritSecLock<CriticalSection> lock(lock_, true);
+    if (started_ || 0 == size)
+      return false;
+    size_ = size;
+    return true;
+  }
+
+  bool ThreadPool::Start() {
+    AutoCritSecLock<CriticalSection> lock(lock_, true);
+    if (started_)
+      return true;
+
+    Thread::Options options;
+    options.work_source_ = this;
+    steal_flags_ = new StealFlag[size_];
+    for (size_t i = 0; i < size_; ++i)
+      steal_flags_[i].busy = 0;
+    // New workers start stealing right away; they find nothing to steal
+    // until |workers_| is complete.
+    for (size_t i = 0; i < size_; ++i) {
+      options.work_source_slot_ = i;
+      Thread* worker = new Thread("distribute_task_thread");
+      if (!worker->StartWithOptions(options)) {
+        delete worker;
+        break;
+      }
+      workers_.push_back(worker);
+    }
+    started_ = !workers_.empty();
+    if (started_) {
+      subtle::Release_Store(&open_, 1);
+    } else {
+      delete[] steal_flags_;
+      steal_flags_ = NULL;
+    }
+    return started_;
+  }
+
+  void ThreadPool::Stop() {
+    AutoCritSecLock<CriticalSection> lock(lock_, true);
+    if (!started_)
+      return;
+    // Workers steal from each other and runners post from any thread, so
+    // no loop may go away while a thief or a poster could still be looking
+    // at it. Both raise a flag before their look at |open_|; with full
+    // barriers on both sides either they see 0 or the waits below see the
+    // flag.
+    subtle::Barrier_Exchange(&open_, 0);
+    while (subtle::Acquire_Load(&posting_))
+      YieldThread();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      while (subtle::Acquire_Load(&steal_flags_[i].busy))
+        YieldThread();
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i]->Stop();
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      delete workers_[i];
+    }
+    workers_.clear();
+    delete[] steal_flags_;
+    steal_flags_ = NULL;
+    started_ = false;
+  }
+
+  TaskRunner* ThreadPool::CreateTaskRunner() {
+    if (!Start())
+      return NULL;
+    uint64_t id = next_runner_++;
+    return new TaskRunner(this, static_cast<size_t>(id % workers_.size()), id);
+  }
+
+  bool ThreadPool::Enter() {
+    subtle::Barrier_AtomicIncrement(&posting_, 1);
+    if (subtle::Acquire_Load(&open_))
+      return true;
+    Leave();
+    return false;
+  }
+
+  void ThreadPool::Leave() {
+    subtle::Barrier_AtomicIncrement(&posting_, -1);
+  }
+
+  void ThreadPool::PostTask(size_t worker, InlineTask &&task, MessageLoop::Priority priority) {
+    if (!Enter())
+      return;
+    worker %= workers_.size();
+    MessageLoop* loop = workers_[worker]->message_loop();
+    loop->PostSharedTask(std::move(task), priority);
+    // The home worker is busy; let an idle sibling come and take the task.
+    if (!loop->is_idle())
+      WakeIdleWorker(worker);
+    Leave();
+  }
+
+  void ThreadPool::PostDelayedTask(size_t worker, InlineTask &&task, TimeDelta delay,
+    const CancellationFlag* cancel_flag) {
+    if (!Enter())
+      return;
+    assert(worker < workers_.size());
+    workers_[worker]->message_loop()->PostDelayedTask(std::move(task), delay, cancel_flag);
+    Leave();
+  }
+
+  void ThreadPool::NoteCancelled(size_t worker) {
+    if (!Enter())
+      return;
+    assert(worker < workers_.size());
+    workers_[worker]->message_loop()->NoteCancelled();
+    Leave();
+  }
+
+  bool ThreadPool::StealWork(size_t thief) {
+    PendingTask pending_task;
+    if (!StealTaskFor(thief, pending_task))
+      return false;
+    pending_task.Run();
+    return true;
+  }
+
+  // Takes no pool wide lock: thieves only lock the victim's queue, in
+  // MessageLoop::StealTask.
+  bool ThreadPool::StealTaskFor(size_t self, PendingTask &out) {
+    if (!subtle::Acquire_Load(&open_))
+      return false;
+    size_t num = workers_.size();
+    assert(self < num);
+    volatile subtle::Atomic32* busy = &steal_flags_[self].busy;
+    subtle::Barrier_Exchange(busy, 1);
+    bool stolen = false;
+    if (subtle::Acquire_Load(&open_)) {
+      // Start with the next sibling so that thieves spread over victims.
+      for (size_t i = 1; i < num && !stolen; ++i) {
+        MessageLoop* victim = workers_[(self + i) % num]->message_loop();
+        stolen = victim->StealTask(out);
+      }
+    }
+    subtle::Release_Store(busy, 0);
+    return stolen;
+  }
+
+  void ThreadPool::WakeIdleWorker(size_t busy) {
+    size_t num = workers_.size();
+    for (size_t i = 1; i < num; ++i) {
+      MessageLoop* loop = workers_[(busy + i) % num]->message_loop();
+      if (loop->is_idle()) {
+        loop->WakeUp();
+        return;
+      }
+    }
+  }
+
+  TaskRunner::TaskRunner(ThreadPool* pool, size_t home, uint64_t id)
+    :pool_(pool), home_(home), id_(id), closed_(false), computational_(0) {
+  }
+
+  TaskRunner::~TaskRunner() {
+  }
+
+  void TaskRunner::PostTask(InlineTask &&task, MessageLoop::Priority priority) {
+    pool_->PostTask(home_, std::move(task), priority);
+  }
+
+  void TaskRunner::PostShardTask(size_t shard, InlineTask &&task,
+    MessageLoop::Priority priority) {
+    pool_->PostTask(home_ + shard, std::move(task), priority);
+  }
+
+  void TaskRunner::PostDelayedTask(InlineTask &&task, TimeDelta delay,
+    const CancellationFlag* cancel_flag) {
+    pool_->PostDelayedTask(home_, std::move(task), delay, cancel_flag);
+  }
+
+  void TaskRunner::NoteCancelled() {
+    pool_->NoteCancelled(home_);
+  }
+
+  bool TaskRunner::IsRunning() const {
+    return !closed_ && pool_->IsRunning();
+  }
+
+  void TaskRunner::Close() {
+    closed_ = true;
+  }
+
+  void TaskRunner::IncComputational() {
+    ++computational_;
+  }
+
+  void TaskRunner::DecComputational() {
+    --computational_;
+  }
+
+  size_t TaskRunner::Computational() {
+    return computational_;
+  }
+
+} //end base
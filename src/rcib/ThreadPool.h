@@ -0,0 +1,130 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MUL_THREAD_POOL_
+#define MUL_THREAD_POOL_
+
+namespace base {
+
+  class TaskRunner;
+
+  // A process wide set of worker threads. Every worker runs its own
+  // MessageLoop; shared tasks queued on a busy worker are stolen by idle
+  // ones, so the load evens out no matter which worker a task was posted to.
+  class ThreadPool : public MessageLoop::WorkSource {
+  public:
+    explicit ThreadPool();
+    virtual ~ThreadPool();
+    //static
+    static ThreadPool* GetInstance();
+    //static
+    static size_t DefaultSize();
+
+    // Only takes effect before the pool is started.
+    bool SetSize(size_t size);
+    bool Start();
+    void Stop();
+    bool IsRunning() const { return started_; }
+    size_t size() const { return workers_.size(); }
+
+    // Starts the pool if necessary. The caller owns the returned runner.
+    TaskRunner* CreateTaskRunner();
+
+    // |worker| is taken modulo size(). Once Stop has begun, tasks are
+    // dropped rather than posted to loops on their way out.
+    void PostTask(size_t worker, InlineTask &&task, MessageLoop::Priority priority);
+    void PostDelayedTask(size_t worker, InlineTask &&task, TimeDelta delay,
+      const CancellationFlag* cancel_flag);
+    void NoteCancelled(size_t worker);
+
+    // MessageLoop::WorkSource methods:
+    virtual bool StealWork(size_t thief) OVERRIDE;
+
+  private:
+    bool StealTaskFor(size_t thief, PendingTask &out);
+    // Bracket every use of |workers_| from outside Start and Stop. Enter
+    // fails once Stop has begun.
+    bool Enter();
+    void Leave();
+    void WakeIdleWorker(size_t busy);
+
+    // Set by a worker while it looks at its siblings' queues. Each on a
+    // cache line of its own, so marking one does not disturb the others.
+    struct StealFlag {
+      volatile subtle::Atomic32 busy;
+      char pad[64 - sizeof(subtle::Atomic32)];
+    };
+
+    std::vector<Thread*> workers_;
+    size_t size_;
+    // numbers the runners; also deals out their home workers
+    uint64_t next_runner_;
+    bool started_;
+    CriticalSection lock_;
+    // One per worker, while the pool runs.
+    StealFlag* steal_flags_;
+    // 1 once |workers_| is complete, 0 again before any loop goes away.
+    volatile subtle::Atomic32 open_;
+    // Posters between Enter and Leave.
+    volatile subtle::Atomic32 posting_;
+
+    DISALLOW_COPY_AND_ASSIGN_(ThreadPool);
+  };
+
+  // What a js THREAD object holds: a cheap handle that submits work to the
+  // shared pool. Tasks prefer the handle's home worker but may run anywhere.
+  class TaskRunner : public SupportsWeakPtr<TaskRunner> {
+  public:
+    TaskRunner(ThreadPool* pool, size_t home, uint64_t id);
+    ~TaskRunner();
+
+    void PostTask(InlineTask &&task,
+      MessageLoop::Priority priority = MessageLoop::PRIORITY_BULK);
+    // For the parts of one job: part |shard| is queued on the shard-th
+    // worker after home, so a job cut in size() parts starts everywhere
+    // at once instead of waiting to be stolen.
+    void PostShardTask(size_t shard, InlineTask &&task,
+      MessageLoop::Priority priority = MessageLoop::PRIORITY_BULK);
+    // Timers always fire on the home worker.
+    void PostDelayedTask(InlineTask &&task, TimeDelta delay,
+      const CancellationFlag* cancel_flag = NULL);
+    // Call after cancelling the flag of a delayed task.
+    void NoteCancelled();
+    bool IsRunning() const;
+    // Unique for the life of the process, unlike the runner's address.
+    uint64_t id() const { return id_; }
+    void Close();
+    void IncComputational();
+    void DecComputational();
+    size_t Computational();
+
+  private:
+    ThreadPool* pool_;
+    size_t home_;
+    uint64_t id_;
+    bool closed_;
+    size_t computational_;
+
+    DISALLOW_COPY_AND_ASSIGN_(TaskRunner);
+  };
+
+} //end base
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A minimal set of atomic operations, in the spirit of chromium's
+// base/atomicops.h. All the read-modify-write operations below are full
+// barriers. Prefer the locks in util_tools.h unless there is a measured need.
+
+#ifndef MUL_ATOMICOPS_
+#define MUL_ATOMICOPS_
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace base {
+  namespace subtle {
+
+#ifdef _WIN32
+    typedef LONG Atomic32;
+#else
+    // int rather than long: it has to be 32 bits wide to back a futex.
+    typedef int Atomic32;
+#endif
+
+#ifdef _WIN32
+    // Returns the value |*ptr| had before the call.
+    inline Atomic32 Barrier_CompareAndSwap(volatile Atomic32* ptr, Atomic32 old_value, Atomic32 new_value) {
+      return InterlockedCompareExchange(ptr, new_value, old_value);
+    }
+
+    inline Atomic32 Barrier_Exchange(volatile Atomic32* ptr, Atomic32 new_value) {
+      return InterlockedExchange(ptr, new_value);
+    }
+
+    // Returns the new value.
+    inline Atomic32 Barrier_AtomicIncrement(volatile Atomic32* ptr, Atomic32 increment) {
+      return InterlockedExchangeAdd(ptr, increment) + increment;
+    }
+
+    inline void* Barrier_CompareAndSwapPointer(void* volatile* ptr, void* old_value, void* new_value) {
+      return InterlockedCompareExchangePointer(ptr, new_value, old_value);
+    }
+
+    inline void* Barrier_ExchangePointer(void* volatile* ptr, void* new_value) {
+      return InterlockedExchangePointer(ptr, new_value);
+    }
+
+    inline void MemoryBarrier() {
+      ::MemoryBarrier();
+    }
+#else
+    inline Atomic32 Barrier_CompareAndSwap(volatile Atomic32* ptr, Atomic32 old_value, Atomic32 new_value) {
+      return __sync_val_compare_and_swap(ptr, old_value, new_value);
+    }
+
+    inline Atomic32 Barrier_Exchange(volatile Atomic32* ptr, Atomic32 new_value) {
+      return __atomic_exchange_n(ptr, new_value, __ATOMIC_SEQ_CST);
+    }
+
+    inline Atomic32 Barrier_AtomicIncrement(volatile Atomic32* ptr, Atomic32 increment) {
+      return __sync_add_and_fetch(ptr, increment);
+    }
+
+    inline void* Barrier_CompareAndSwapPointer(void* volatile* ptr, void* old_value, void* new_value) {
+      return __sync_val_compare_and_swap(ptr, old_value, new_value);
+    }
+
+    inline void* Barrier_ExchangePointer(void* volatile* ptr, void* new_value) {
+      return __atomic_exchange_n(ptr, new_value, __ATOMIC_SEQ_CST);
+    }
+
+    inline void MemoryBarrier() {
+      __sync_synchronize();
+    }
+#endif
+
+    inline Atomic32 Acquire_Load(volatile const Atomic32* ptr) {
+      Atomic32 value = *ptr;
+      MemoryBarrier();
+      return value;
+    }
+
+    inline void Release_Store(volatile Atomic32* ptr, Atomic32 value) {
+      MemoryBarrier();
+      *ptr = value;
+    }
+
+  }  // namespace subtle
+}  // namespace base
+
+#endif
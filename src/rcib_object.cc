@@ -1,9 +1,20 @@
 #include "rcib_object.h"
 #include "ed25519/ed25519.h"
 #include "hash/hash.h"
+#include "hash/sha/sha.h"
 
 #define ONE ((char*)1)
 
+// Default budget per loop iteration: enough to keep up with the workers,
+// short enough not to stall network handlers.
+#define DEFAULT_MAX_MILLIS 5
+
+// A request id is a serial number above the request's slot in live_, so
+// that a stale id does not reach the request now in its slot. Both fit in
+// the 53 bits js numbers hold exactly.
+#define SLOT_BITS 22
+#define SERIAL_MASK 0x7fffffffu
+
 namespace rcib {
   extern bool bterminating_;
 }
@@ -22,7 +33,9 @@ namespace rcib {
 
   // constructor
   RcibHelper::RcibHelper()
-    :handle_(nullptr) {
+    :completed_(nullptr), backlog_head_(nullptr), backlog_tail_(nullptr),
+    max_callbacks_(0), max_nanos_(DEFAULT_MAX_MILLIS * 1000000ULL),
+    next_serial_(0), handle_(nullptr), idle_(nullptr) {
   }
   //static
   RcibHelper* RcibHelper::GetInstance() {
@@ -30,14 +43,30 @@ namespace rcib {
     return &This;
   }
 
-  static void RunCallBack(async_req * req) {
+  static void FreeReq(async_req * req) {
+    if (req->out && ONE != req->out) {
+      Param *hre = reinterpret_cast<Param *>(req->out);
+      delete hre;
+    }
+    req->out = nullptr;
+    HandleTable& handles = RcibHelper::GetInstance()->handles();
+    handles.Drop(req->isolate, req->callback);
+    handles.Drop(req->isolate, req->resolver);
+    for (int i = 0; i < async_req::kMaxPinned; ++i)
+      handles.Drop(req->isolate, req->pinned[i]);
+    if (req->sink)
+      req->sink->Release();
+    RcibHelper::GetInstance()->Forget(req);
+    delete req;
+  }
+
+  // Turns the outcome of |req| into (error, result) and frees req->out.
+  // Returns the number of values set.
+  static int MakeResult(async_req * req, v8::Local<v8::Value> argv[2]) {
     v8::Isolate* isolate = req->isolate;
-    v8::HandleScope scope(isolate);
     // there is always at least one argument. "error"
     int argc = 1;
 
-    v8::Local<v8::Value> argv[2];
-
     if (-1 == req->result || !req->out) {
       argv[0] = node::UVException(-1, req->error.c_str());
     } else if (ONE == req->out) {
@@ -49,7 +78,32 @@ namespace rcib {
           argv[0] = v8::Null(isolate);
           argc = 2;
           Ed25519Re *hre = reinterpret_cast<Ed25519Re *>(req->out);
-          if (hre->_type == Ed25519Re::SIGN) {
+          if (hre->_type == Ed25519Re::VERIFY_BATCH) {
+            const std::vector<int>& valid = static_cast<Ed25519BatchRe *>(hre)->_valid;
+            v8::Local<v8::Array> flags = v8::Array::New(isolate, static_cast<int>(valid.size()));
+            for (size_t i = 0; i < valid.size(); ++i) {
+              flags->Set(static_cast<uint32_t>(i), v8::Boolean::New(isolate, valid[i] != 0));
+            }
+            argv[1] = flags;
+          } else if (hre->_type == Ed25519Re::VERIFY_PACKED) {
+            const std::vector<unsigned char>& bitmap = static_cast<Ed25519PackedRe *>(hre)->_bitmap;
+            argv[1] = node::Encode(isolate, reinterpret_cast<const char *>(bitmap.data()),
+              bitmap.size(), node::encoding::BUFFER);
+          } else if (hre->_type == Ed25519Re::MAKE_KEYPAIRS) {
+            Ed25519KeypairsRe *kre = static_cast<Ed25519KeypairsRe *>(hre);
+            v8::Local<v8::Object> keys = v8::Object::New(isolate);
+            keys->Set(v8::String::NewFromUtf8(isolate, "publicKeys"), node::Encode(isolate,
+              reinterpret_cast<const char *>(kre->_publicKeys.data()), kre->_publicKeys.size(), node::encoding::BUFFER));
+            keys->Set(v8::String::NewFromUtf8(isolate, "privateKeys"), node::Encode(isolate,
+              reinterpret_cast<const char *>(kre->_privateKeys.data()), kre->_privateKeys.size(), node::encoding::BUFFER));
+            argv[1] = keys;
+          } else if (hre->_type == Ed25519Re::CREATE_SIGNER) {
+            Ed25519SignerRe *sre = static_cast<Ed25519SignerRe *>(hre);
+            argv[1] = Ed25519Signer::Wrap(isolate, sre->_signer);
+            sre->_signer = nullptr;  // the handle owns it now
+          } else if (hre->_out) {
+            argv[1] = v8::Integer::New(isolate, 64);
+          } else if (hre->_type == Ed25519Re::SIGN) {
             argv[1] = node::Encode(isolate, reinterpret_cast<char *>(hre->data), 64, node::encoding::BUFFER);
           } else {
             argv[1] = v8::Boolean::New(isolate, req->result);
@@ -62,7 +116,11 @@ namespace rcib {
           argv[0] = v8::Null(isolate);
           argc = 2;
           HashRe *hre = reinterpret_cast<HashRe *>(req->out);
-          argv[1] = node::Encode(isolate, reinterpret_cast<char *>(hre->_data), hre->_len, node::encoding::BUFFER);
+          if (hre->_out) {
+            argv[1] = v8::Integer::New(isolate, static_cast<int>(hre->_len));
+          } else {
+            argv[1] = node::Encode(isolate, reinterpret_cast<char *>(hre->_data), hre->_len, node::encoding::BUFFER);
+          }
           delete hre;
           req->out = nullptr;
         }
@@ -73,22 +131,56 @@ namespace rcib {
         break;
       }
     }
+    return argc;
+  }
+
+  // Sink results are only collected here; the caller's HandleScope keeps
+  // them alive until the round is flushed.
+  static void RunCallBack(async_req * req, std::vector<ResultSink*>& pending) {
+    if (req->sink) {
+      v8::Isolate* isolate = req->isolate;
+      v8::Local<v8::Value> argv[2] = { v8::Undefined(isolate), v8::Undefined(isolate) };
+      if (req->cancel_flag.IsCancelled()) {
+        argv[0] = node::UVException(UV_ECANCELED, "cancel");
+      } else {
+        MakeResult(req, argv);
+      }
+      req->sink->Add(isolate, req->id, argv[0], argv[1], pending);
+      FreeReq(req);
+      return;
+    }
+    if (req->cancel_flag.IsCancelled()) {
+      // settled when it was cancelled
+      FreeReq(req);
+      return;
+    }
+    v8::Isolate* isolate = req->isolate;
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Value> argv[2];
+    int argc = MakeResult(req, argv);
+
+    HandleTable& handles = RcibHelper::GetInstance()->handles();
+    if (req->resolver) {
+      v8::Local<v8::Promise::Resolver> resolver =
+        handles.Get(isolate, req->resolver).As<v8::Promise::Resolver>();
+      v8::Local<v8::Context> context = isolate->GetCurrentContext();
+      if (argv[0]->IsNull()) {
+        resolver->Resolve(context, argc > 1 ? argv[1] : v8::Undefined(isolate).As<v8::Value>()).FromJust();
+      } else {
+        resolver->Reject(context, argv[0]).FromJust();
+      }
+      FreeReq(req);
+      return;
+    }
 
     v8::TryCatch try_catch(isolate);
     try_catch.SetVerbose(false);
 
     v8::Local<v8::Function> callback =
-      v8::Local<v8::Function>::New(isolate, req->callback);
+      handles.Get(isolate, req->callback).As<v8::Function>();
     callback->Call(isolate->GetCurrentContext()->Global(), argc, argv);
 
-    // cleanup
-    req->callback.Reset();
-    if (req->out) {
-      free(req->out);
-      req->out = nullptr;
-    }
-
-    delete req;
+    FreeReq(req);
 
     if (try_catch.HasCaught()) {
       node::FatalException(isolate, try_catch);
@@ -96,15 +188,83 @@ namespace rcib {
   }
   //static
   void RcibHelper::AfterAsync(uv_async_t* h) {
-    RcibHelper::GetInstance()->PickFinished();
+    RcibHelper::GetInstance()->Drain();
+  }
+  //static
+  void RcibHelper::AfterIdle(uv_idle_t* h) {
+    RcibHelper::GetInstance()->Drain();
+  }
 
-    async_req * req = nullptr;
-    while (true) {
-      req = RcibHelper::GetInstance()->Pop();
-      if (!req)
-        break;
-      RunCallBack(req);
-    }//end while
+  //this function runs in main
+  void RcibHelper::Drain() {
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope scope(isolate);
+    async_req * req = TakeCompleted();
+    size_t arrived = 0;
+    if (req) {
+      if (backlog_tail_)
+        backlog_tail_->next = req;
+      else
+        backlog_head_ = req;
+      for (; req; req = req->next) {
+        backlog_tail_ = req;
+        ++arrived;
+      }
+      stats_.backlog += arrived;
+    }
+
+    uint32_t count = 0;
+    if (backlog_head_) {
+      // Like any callback from node: under the async context of the
+      // helper, with the nextTick queue and the microtasks (the promises
+      // settled below) run as the scope closes.
+      node::CallbackScope callback_scope(isolate,
+        v8::Local<v8::Object>::New(isolate, resource_), async_context_);
+      uint64_t start = uv_hrtime();
+      while (backlog_head_) {
+        if (count > 0 && ((max_callbacks_ && count >= max_callbacks_) ||
+          (max_nanos_ && uv_hrtime() - start >= max_nanos_)))
+          break;
+        req = backlog_head_;
+        backlog_head_ = req->next;
+        if (!backlog_head_)
+          backlog_tail_ = nullptr;
+        --stats_.backlog;
+        ++count;
+        RunCallBack(req, pending_sinks_);
+      }//end while
+
+      for (size_t i = 0; i < pending_sinks_.size(); ++i) {
+        pending_sinks_[i]->Flush(isolate);
+        pending_sinks_[i]->Release();
+      }
+      pending_sinks_.clear();
+    }
+    stats_.delivered += count;
+
+    if (backlog_head_) {
+      // The backlog runs oldest first, so what is left of this round's
+      // arrivals is at its tail; the older leftovers were counted before.
+      stats_.deferred += static_cast<double>(
+        stats_.backlog < arrived ? stats_.backlog : arrived);
+      ++stats_.deferred_rounds;
+      if (!uv_is_active((uv_handle_t*)idle_))
+        uv_idle_start((uv_idle_t*)idle_, RcibHelper::AfterIdle);
+    } else if (uv_is_active((uv_handle_t*)idle_)) {
+      uv_idle_stop((uv_idle_t*)idle_);
+    }
+  }
+
+  void RcibHelper::SetBudget(uint32_t max_callbacks, double max_millis) {
+    max_callbacks_ = max_callbacks;
+    max_nanos_ = max_millis > 0 ? static_cast<uint64_t>(max_millis * 1e6) : 0;
+  }
+  //static
+  bool RcibHelper::StartWork(async_req* req) {
+    if (req->cancel_flag.Start())
+      return true;
+    RcibHelper::GetInstance()->Uv_Send(req, NULL);
+    return false;
   }
   //static
   void RcibHelper::DoNopAsync(async_req* req) {
@@ -118,12 +278,8 @@ namespace rcib {
     req->error = message;
   }
   //static
+  // Leaves req->out to be freed on the main thread, where the pools live.
   void RcibHelper::EMark2(async_req* req, std::string message) {
-    if (req->out) {
-      Param *hre = reinterpret_cast<Param *>(req->out);
-      delete hre;
-      req->out = nullptr;
-    }
     req->result = -1;
     req->error = message;
   }
@@ -132,18 +288,38 @@ namespace rcib {
     if (!req) {
       return;
     }
-    req->finished = false;
     req->out = nullptr;
     req->result = 0;
     req->w_t = TYPE_START;
-    RcibHelper::GetInstance()->Push(req);
+    RcibHelper* helper = RcibHelper::GetInstance();
+    uint32_t slot;
+    if (!helper->free_slots_.empty()) {
+      slot = helper->free_slots_.back();
+      helper->free_slots_.pop_back();
+      helper->live_[slot] = req;
+    } else {
+      slot = static_cast<uint32_t>(helper->live_.size());
+      DCHECK(slot < (1u << SLOT_BITS));
+      helper->live_.push_back(req);
+    }
+    helper->next_serial_ = (helper->next_serial_ + 1) & SERIAL_MASK;
+    if (!helper->next_serial_)
+      helper->next_serial_ = 1;
+    req->id = (static_cast<uint64_t>(helper->next_serial_) << SLOT_BITS) | slot;
   }
 
   void RcibHelper::Init() {
     array_buffer_allocator_.Get();
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Object> resource = v8::Object::New(isolate);
+    resource_.Reset(isolate, resource);
+    async_context_ = node::EmitAsyncInit(isolate, resource, "THREADOBJECT");
     //init this
     handle_ = new async_t_handle;
     uv_async_init(uv_default_loop(), (uv_async_t*)handle_, RcibHelper::AfterAsync);
+    idle_ = new idle_t_handle;
+    uv_idle_init(uv_default_loop(), (uv_idle_t*)idle_);
   }
 
   void RcibHelper::Terminate() {
@@ -152,27 +328,244 @@ namespace rcib {
 
   void RcibHelper::Uv_Send(async_req* req, uv_async_t* h) {
     h = h ? h : (uv_async_t*)handle_;
-    req->finished = true;
+    for (;;) {
+      async_req* old = completed_;
+      req->next = old;
+      if (base::subtle::Barrier_CompareAndSwapPointer(
+        reinterpret_cast<void* volatile*>(&completed_), old, req) == old)
+        break;
+    }
     uv_async_send(h);
   }
 
+  void RcibHelper::Forget(async_req *req) {
+    uint32_t slot = static_cast<uint32_t>(req->id & ((1u << SLOT_BITS) - 1));
+    if (!req->id || slot >= live_.size() || live_[slot] != req)
+      return;
+    live_[slot] = nullptr;
+    free_slots_.push_back(slot);
+  }
+
+  bool RcibHelper::Cancel(base::TaskRunner* runner, uint64_t id) {
+    uint32_t slot = static_cast<uint32_t>(id & ((1u << SLOT_BITS) - 1));
+    if (slot >= live_.size() || !live_[slot] || live_[slot]->id != id)
+      return false;
+    async_req* req = live_[slot];
+    if (req->runner_id != runner->id() || !req->cancel_flag.Cancel())
+      return false;
+    if (TYPE_DELAY == req->w_t)
+      runner->NoteCancelled();
+    // A sink hears of it with the round the request comes back in.
+    if (req->sink)
+      return true;
+    // The task still holds |req|; it hands it back without running and
+    // RunCallBack then only frees it.
+    v8::Isolate* isolate = req->isolate;
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Value> argv[1] = { node::UVException(UV_ECANCELED, "cancel") };
+    if (req->resolver) {
+      v8::Local<v8::Promise::Resolver> resolver =
+        handles_.Get(isolate, req->resolver).As<v8::Promise::Resolver>();
+      handles_.Drop(isolate, req->resolver);
+      resolver->Reject(isolate->GetCurrentContext(), argv[0]).FromJust();
+      return true;
+    }
+    v8::TryCatch try_catch(isolate);
+    try_catch.SetVerbose(false);
+    v8::Local<v8::Function> callback =
+      handles_.Get(isolate, req->callback).As<v8::Function>();
+    handles_.Drop(isolate, req->callback);
+    callback->Call(isolate->GetCurrentContext()->Global(), 1, argv);
+    if (try_catch.HasCaught()) {
+      node::FatalException(isolate, try_catch);
+    }
+    return true;
+  }
+
+  InlinePolicy::InlinePolicy()
+    :threshold_ns_(0), calibrated_ns_(0), inlined_(0), calibrating_(false), tuned_(false),
+    measured_(0) {
+    for (int i = 0; i < KIND_COUNT; ++i) {
+      fixed_ns_[i] = 0;
+      per_byte_ns_[i] = 0;
+    }
+  }
+
+  static void SignalEvent(base::FutexEvent* event) {
+    event->Signal();
+  }
+
+  static int CompareDoubles(const void* a, const void* b) {
+    double x = *static_cast<const double*>(a);
+    double y = *static_cast<const double*>(b);
+    return x < y ? -1 : (x > y ? 1 : 0);
+  }
+
+  // Median time of |rounds| runs of |run|, in ns.
+  template <typename F>
+  static double MedianNs(int rounds, F run) {
+    double samples[16];
+    DCHECK(rounds <= 16);
+    for (int i = 0; i < rounds; ++i) {
+      uint64_t start = uv_hrtime();
+      run();
+      samples[i] = static_cast<double>(uv_hrtime() - start);
+    }
+    qsort(samples, rounds, sizeof(double), CompareDoubles);
+    return samples[rounds / 2];
+  }
+
+  void InlinePolicy::Calibrate(base::TaskRunner* runner) {
+    if (calibrating_)
+      return;
+    calibrating_ = true;
+    runner->PostTask(base::BindOnce(this, &InlinePolicy::Measure),
+      base::MessageLoop::PRIORITY_BULK);
+  }
+
+  void InlinePolicy::Measure() {
+    enum { kShort = 64, kLong = 4096 };
+    static unsigned char message[kLong];
+    unsigned char digest[64];
+    unsigned char pk[32];
+    unsigned char sk[64];
+    unsigned char signature[64];
+    memset(sk, 7, 32);
+    crypto_sign_keypair(pk, sk);
+
+    // Fixed and per byte cost from a short and a long input.
+    double short_ns = MedianNs(9, [&] { sha256(message, kShort, digest); });
+    double long_ns = MedianNs(9, [&] { sha256(message, kLong, digest); });
+    per_byte_ns_[SHA256] = (long_ns - short_ns) / (kLong - kShort);
+    fixed_ns_[SHA256] = short_ns - per_byte_ns_[SHA256] * kShort;
+
+    short_ns = MedianNs(9, [&] { sha512(message, kShort, digest); });
+    long_ns = MedianNs(9, [&] { sha512(message, kLong, digest); });
+    per_byte_ns_[SHA512] = (long_ns - short_ns) / (kLong - kShort);
+    fixed_ns_[SHA512] = short_ns - per_byte_ns_[SHA512] * kShort;
+
+    // Both hash their input with SHA-512, the curve work is the fixed part.
+    fixed_ns_[SIGN] = MedianNs(5, [&] { crypto_sign_detached(signature, message, kShort, sk); });
+    per_byte_ns_[SIGN] = 2 * per_byte_ns_[SHA512];
+    fixed_ns_[VERIFY] = MedianNs(5, [&] { crypto_sign_verify(signature, message, kShort, pk); });
+    per_byte_ns_[VERIFY] = per_byte_ns_[SHA512];
+
+    // What handing a job to a sleeping thread and hearing back costs. A
+    // thread of its own: posting to the pool could land on this worker.
+    base::Thread peer("inline_calibration");
+    base::Thread::Options options;
+    if (peer.StartWithOptions(options)) {
+      calibrated_ns_ = MedianNs(9, [&] {
+        base::FutexEvent done;
+        peer.message_loop()->PostTask(base::BindOnce(&SignalEvent, &done));
+        done.Wait();
+      });
+      peer.Stop();
+    }
+    base::subtle::Release_Store(&measured_, 1);
+  }
+
+  void InlinePolicy::SetThreshold(double ns) {
+    tuned_ = ns >= 0;
+    threshold_ns_ = tuned_ ? ns : 0;
+  }
+
+  HandleTable::HandleTable()
+    :next_(1) {
+  }
+
+  uint32_t HandleTable::Put(v8::Isolate* isolate, v8::Local<v8::Value> value) {
+    if (values_.IsEmpty())
+      values_.Reset(isolate, v8::Array::New(isolate));
+    uint32_t slot;
+    if (!free_.empty()) {
+      slot = free_.back();
+      free_.pop_back();
+    } else {
+      slot = next_++;
+    }
+    v8::Local<v8::Array>::New(isolate, values_)->Set(slot, value);
+    return slot;
+  }
+
+  v8::Local<v8::Value> HandleTable::Get(v8::Isolate* isolate, uint32_t slot) {
+    return v8::Local<v8::Array>::New(isolate, values_)->Get(slot);
+  }
+
+  void HandleTable::Drop(v8::Isolate* isolate, uint32_t& slot) {
+    if (!slot)
+      return;
+    v8::Local<v8::Array>::New(isolate, values_)->Set(slot, v8::Undefined(isolate));
+    free_.push_back(slot);
+    slot = 0;
+  }
+
+  void RcibHelper::SetSink(base::TaskRunner* runner, ResultSink* sink) {
+    std::map<base::TaskRunner*, ResultSink*>::iterator it = sinks_.find(runner);
+    if (it != sinks_.end()) {
+      it->second->Release();
+      sinks_.erase(it);
+    }
+    if (sink)
+      sinks_[runner] = sink;
+  }
+
+  ResultSink::ResultSink(v8::Isolate* isolate, v8::Local<v8::Function> fn)
+    :fn_(isolate, fn), count_(0), refs_(1) {
+  }
+
+  ResultSink::~ResultSink() {
+    fn_.Reset();
+  }
+
+  void ResultSink::Add(v8::Isolate* isolate, uint64_t id, v8::Local<v8::Value> error,
+    v8::Local<v8::Value> result, std::vector<ResultSink*>& pending) {
+    if (!count_) {
+      ids_ = v8::Array::New(isolate);
+      errors_ = v8::Array::New(isolate);
+      results_ = v8::Array::New(isolate);
+      AddRef();
+      pending.push_back(this);
+    }
+    ids_->Set(count_, v8::Number::New(isolate, static_cast<double>(id)));
+    errors_->Set(count_, error);
+    results_->Set(count_, result);
+    ++count_;
+  }
+
+  void ResultSink::Flush(v8::Isolate* isolate) {
+    if (!count_)
+      return;
+    v8::Local<v8::Value> argv[3] = { ids_, errors_, results_ };
+    count_ = 0;
+    ids_.Clear();
+    errors_.Clear();
+    results_.Clear();
+
+    v8::TryCatch try_catch(isolate);
+    try_catch.SetVerbose(false);
+    v8::Local<v8::Function> fn = v8::Local<v8::Function>::New(isolate, fn_);
+    fn->Call(isolate->GetCurrentContext()->Global(), 3, argv);
+    if (try_catch.HasCaught()) {
+      node::FatalException(isolate, try_catch);
+    }
+  }
+
   //this function runs in main
-  void RcibHelper::PickFinished() {
-    std::list<async_req *> tmp_q;
-    async_req * item = nullptr;
-    while (!pending_queue_.empty()){
-      item = pending_queue_.front();
-      pending_queue_.pop_front();
-      if (!item)
-        continue;
-      if (item->finished) {
-        working_queue_.push_back(item);
-      } else {
-        tmp_q.push_back(item);
-      }
-    }// end while
-    pending_queue_.swap(tmp_q);
-    DCHECK_EQ(tmp_q.size(), 0);
+  async_req* RcibHelper::TakeCompleted() {
+    if (!completed_)
+      return nullptr;
+    async_req* newest = static_cast<async_req*>(base::subtle::Barrier_ExchangePointer(
+      reinterpret_cast<void* volatile*>(&completed_), nullptr));
+    // The stack is newest first; reverse it to call back in completion order.
+    async_req* oldest = nullptr;
+    while (newest) {
+      async_req* next = newest->next;
+      newest->next = oldest;
+      oldest = newest;
+      newest = next;
+    }
+    return oldest;
   }// end func
 
 } // end rcib
@@ -18,7 +18,10 @@
 #include <queue>
 #include <stack>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include "rcib/macros.h"
+#include "rcib/atomicops.h"
 #include "rcib/aligned_memory.h"
 #include "rcib/lazy_instance.h"
 #include "rcib/ref_counted.h"
@@ -29,12 +32,14 @@
 #include "rcib/MessagePump.h"
 #include "rcib/util_tools.h"
 #include "rcib/Event/WaitableEvent.h"
+#include "rcib/Event/FutexEvent.h"
 #include "rcib/PendingTask.h"
 #include "rcib/observer_list.h"
 #include "rcib/MessagePumpDefault.h"
 #include "rcib/MessageLoop.h"
 #include "rcib/roler.h"
 #include "rcib/Thread.h"
+#include "rcib/ThreadPool.h"
 #include "rcib/at_exist.h"
 
 namespace rcib {
@@ -43,6 +48,83 @@ namespace rcib {
     uv_async_t handle_;
   };
 
+  struct idle_t_handle {
+    uv_idle_t handle_;
+  };
+
+  // What AfterAsync has delivered and put off, for monitoring.
+  struct CompletionStats {
+    CompletionStats() :delivered(0), deferred(0), deferred_rounds(0), backlog(0) {}
+    double delivered;        // callbacks run
+    double deferred;         // completions put off by a budget, each counted once
+    double deferred_rounds;  // rounds that ran out of budget
+    size_t backlog;          // completions waiting right now
+  };
+
+  // Decides whether a job is cheaper to run on the calling thread than to
+  // hand to a worker. A job's cost is estimated as fixed + per byte time,
+  // measured per kernel on a worker, off the js thread; until then nothing
+  // runs inline. By default only hashes estimated far below a measured
+  // round trip run inline: sign and verify cost about a round trip, so
+  // they stay on the workers unless SetThreshold asks for them. Inline
+  // jobs still report through the completion queue, so callers see no
+  // difference.
+  class InlinePolicy {
+  public:
+    enum Kind {
+      SHA256 = 0,
+      SHA512,  // and SHA-384
+      SIGN,
+      VERIFY,
+      KIND_COUNT
+    };
+    // the default threshold is the round trip over this
+    enum { kDefaultShare = 8 };
+
+    InlinePolicy();
+    // Has a worker of |runner| measure the kernels and a round trip. Once.
+    void Calibrate(base::TaskRunner* runner);
+    inline bool RunsInline(Kind kind, size_t len) {
+      if (!base::subtle::Acquire_Load(&measured_))
+        return false;
+      double threshold = tuned_ ? threshold_ns_ :
+        (SIGN == kind || VERIFY == kind ? 0 : calibrated_ns_ / kDefaultShare);
+      if (fixed_ns_[kind] + per_byte_ns_[kind] * len >= threshold)
+        return false;
+      ++inlined_;
+      return true;
+    }
+    // Jobs of any kind estimated below |ns| run inline; 0 turns it off, a
+    // negative value goes back to the default.
+    void SetThreshold(double ns);
+    // what hashes are held to; 0 until measured
+    inline double threshold_ns() const {
+      if (tuned_)
+        return threshold_ns_;
+      return base::subtle::Acquire_Load(&measured_) ? calibrated_ns_ / kDefaultShare : 0;
+    }
+    inline double calibrated_ns() const {
+      return base::subtle::Acquire_Load(&measured_) ? calibrated_ns_ : 0;
+    }
+    inline double inlined() const {
+      return inlined_;
+    }
+
+  private:
+    // runs on a worker
+    void Measure();
+
+    double fixed_ns_[KIND_COUNT];
+    double per_byte_ns_[KIND_COUNT];
+    double threshold_ns_;
+    double calibrated_ns_;
+    double inlined_;
+    bool calibrating_;
+    bool tuned_;  // SetThreshold was called
+    // set by the worker once the fields above it wrote are complete
+    volatile base::subtle::Atomic32 measured_;
+  };
+
   enum WORKTYPE {
     TYPE_START = 0,
     TYPE_SHA,
@@ -52,20 +134,163 @@ namespace rcib {
     TYPE_END
   };
 
+  // Objects made and freed by a FreeList, for monitoring.
+  struct PoolStats {
+    PoolStats() :created(0), reused(0), idle(0) {}
+    double created;  // taken from the heap
+    double reused;   // taken from the free list
+    size_t idle;     // on the free list right now
+  };
+
+  // Recycles the memory of one class, which routes its operator new and
+  // delete here. Once the list has grown to the peak number of live
+  // objects nothing more comes from the heap. Main thread only.
+  template <typename T>
+  class FreeList {
+  public:
+    static void* Alloc(size_t size) {
+      DCHECK_EQ(size, sizeof(T));
+      PoolStats& s = stats();
+      if (head_) {
+        node* n = head_;
+        head_ = n->next;
+        --s.idle;
+        ++s.reused;
+        return n;
+      }
+      ++s.created;
+      return ::operator new(sizeof(T) > sizeof(node) ? sizeof(T) : sizeof(node));
+    }
+    static void Free(void* p) {
+      if (!p)
+        return;
+      node* n = static_cast<node*>(p);
+      n->next = head_;
+      head_ = n;
+      ++stats().idle;
+    }
+    static PoolStats& stats() {
+      static PoolStats s;
+      return s;
+    }
+
+  private:
+    struct node {
+      node* next;
+    };
+    static node* head_;
+  };
+
+  template <typename T>
+  typename FreeList<T>::node* FreeList<T>::head_ = nullptr;
+
+#define POOLED(T) \
+  static void* operator new(size_t size) { \
+    return rcib::FreeList<T>::Alloc(size); \
+  } \
+  static void operator delete(void* p) { \
+    rcib::FreeList<T>::Free(p); \
+  }
+
+  // JS values held for requests in flight, in slots of one persistent
+  // array rather than a global handle each. Slot 0 is never handed out and
+  // stands for "none". Freed slots are reused. Main thread only.
+  class HandleTable {
+  public:
+    HandleTable();
+    uint32_t Put(v8::Isolate* isolate, v8::Local<v8::Value> value);
+    v8::Local<v8::Value> Get(v8::Isolate* isolate, uint32_t slot);
+    // Empties |slot|, if set, and sets it to 0.
+    void Drop(v8::Isolate* isolate, uint32_t& slot);
+    inline size_t slots() const {
+      return next_ - 1;
+    }
+    inline size_t idle() const {
+      return free_.size();
+    }
+
+  private:
+    v8::Persistent<v8::Array> values_;
+    std::vector<uint32_t> free_;
+    uint32_t next_;
+    DISALLOW_COPY_AND_ASSIGN_(HandleTable);
+  };
+
+  class ResultSink;
+
   class async_req {
   public:
+    POOLED(async_req)
+
     async_req() {
       out = NULL;
       isolate = NULL;
       result = 0;
+      id = 0;
+      runner_id = 0;
+      sink = NULL;
+      next = NULL;
+      callback = 0;
+      resolver = 0;
+      for (int i = 0; i < kMaxPinned; ++i)
+        pinned[i] = 0;
     }
     std::string error;
     char *out;
     ssize_t result;
     v8::Isolate* isolate;
-    v8::Persistent<v8::Function> callback;
-    bool finished;
+    // slots in RcibHelper::handles()
+    uint32_t callback;
+    // set instead of |callback| when js asked for a promise
+    uint32_t resolver;
+    // Buffers the worker reads or writes, kept alive until the request is
+    // freed so that js need not copy them. Node Buffers do not move; only
+    // transferring the ArrayBuffer away while the request runs is unsafe.
+    enum { kMaxPinned = 4 };
+    uint32_t pinned[kMaxPinned];
     WORKTYPE w_t;
+    // what js holds to cancel the request, see RcibHelper::init_async_req
+    uint64_t id;
+    // TaskRunner::id() of the thread it was posted to; an id, since the
+    // runner may be gone and its address reused
+    uint64_t runner_id;
+    base::CancellationFlag cancel_flag;
+    // set instead of |callback| when the result goes to a sink; holds a ref
+    ResultSink* sink;
+    // link in RcibHelper's completion stack
+    async_req* next;
+  };
+
+  // Receives the results of a thread's sink-mode requests: one call per
+  // completion round, fn(ids, errors, results) with parallel arrays. Only
+  // used on the main thread. Requests hold a ref, as does the thread.
+  class ResultSink {
+  public:
+    ResultSink(v8::Isolate* isolate, v8::Local<v8::Function> fn);
+    inline void AddRef() {
+      ++refs_;
+    }
+    inline void Release() {
+      if (!--refs_)
+        delete this;
+    }
+    // Adds a result to this round. The values must stay alive until Flush.
+    // The first result of a round puts the sink, with a ref, on |pending|.
+    void Add(v8::Isolate* isolate, uint64_t id, v8::Local<v8::Value> error,
+      v8::Local<v8::Value> result, std::vector<ResultSink*>& pending);
+    // Hands the round to js.
+    void Flush(v8::Isolate* isolate);
+
+  private:
+    ~ResultSink();
+
+    v8::Persistent<v8::Function> fn_;
+    v8::Local<v8::Array> ids_;
+    v8::Local<v8::Array> errors_;
+    v8::Local<v8::Array> results_;
+    uint32_t count_;
+    int refs_;
+    DISALLOW_COPY_AND_ASSIGN_(ResultSink);
   };
 
   /*A thread - safe allocator
@@ -89,34 +314,83 @@ namespace rcib {
     //static
     static RcibHelper* GetInstance();
     static void AfterAsync(uv_async_t* h);
+    static void AfterIdle(uv_idle_t* h);
     static void DoNopAsync(async_req* r);
     static void EMark(async_req* req, std::string message);
     static void EMark2(async_req* req, std::string message);
     static void init_async_req(async_req *req);
+    // Called by a task before doing the work. Hands a cancelled request
+    // straight back and returns false.
+    static bool StartWork(async_req* req);
 
     void Init();
     void Terminate();
 
+    // May be called from any thread once |req| is done; |req| must not be
+    // touched afterwards.
     void Uv_Send(async_req* req, uv_async_t* h);
-    inline void Push(async_req *itme) {
-      pending_queue_.push_back(itme);
+    // Withdraws a queued request of |runner| and settles its callback with
+    // an ECANCELED error. False if it already started or is unknown.
+    bool Cancel(base::TaskRunner* runner, uint64_t id);
+    void Forget(async_req *req);
+    inline HandleTable& handles() {
+      return handles_;
     }
-    inline async_req* Pop() {
-      if (working_queue_.empty())
-        return NULL;
-      async_req * item = working_queue_.front();
-      working_queue_.pop_front();
-      return item;
+    inline InlinePolicy& inline_policy() {
+      return inline_policy_;
+    }
+    // Sends the results of |runner|'s requests posted without a callback
+    // to |sink| from now on; null drops the sink. Takes over the ref.
+    void SetSink(base::TaskRunner* runner, ResultSink* sink);
+    inline ResultSink* SinkOf(base::TaskRunner* runner) {
+      std::map<base::TaskRunner*, ResultSink*>::iterator it = sinks_.find(runner);
+      return it == sinks_.end() ? nullptr : it->second;
+    }
+    // Takes every completed request, oldest first, linked through |next|.
+    async_req* TakeCompleted();
+    // Bounds the callbacks run per loop iteration; 0 lifts a bound. The
+    // rest wait for the next iteration.
+    void SetBudget(uint32_t max_callbacks, double max_millis);
+    inline uint32_t max_callbacks() const {
+      return max_callbacks_;
+    }
+    inline double max_millis() const {
+      return max_nanos_ / 1e6;
+    }
+    inline const CompletionStats& stats() const {
+      return stats_;
     }
-    inline void PickFinished();
     inline size_t taskNum() {
       return 0;
     }
 
   private:
-    std::list<async_req *> pending_queue_;
-    std::list<async_req *> working_queue_;
+    // Treiber stack of completed requests, newest first. Workers push,
+    // the main thread takes the whole stack in one exchange.
+    async_req* volatile completed_;
+    // taken off |completed_| but not yet called back, oldest first
+    async_req* backlog_head_;
+    async_req* backlog_tail_;
+    uint32_t max_callbacks_;
+    uint64_t max_nanos_;
+    CompletionStats stats_;
+    // requests by the slot in their id, until they are freed
+    std::vector<async_req *> live_;
+    std::vector<uint32_t> free_slots_;
+    HandleTable handles_;
+    InlinePolicy inline_policy_;
+    std::map<base::TaskRunner*, ResultSink*> sinks_;
+    // sinks with results in the round being drained
+    std::vector<ResultSink*> pending_sinks_;
+    uint32_t next_serial_;
     async_t_handle *handle_;
+    // runs while there is a backlog, keeping the loop from blocking in poll
+    idle_t_handle *idle_;
+    // what async_hooks sees calling back each round of Drain
+    v8::Persistent<v8::Object> resource_;
+    node::async_context async_context_;
+
+    void Drain();
   };
 
   class furOfThread {
@@ -129,14 +403,10 @@ namespace rcib {
     void* Wrap(v8::Local<v8::Object> object) {
       DCHECK_EQ(false, object.IsEmpty());
       DCHECK_G(object->InternalFieldCount(), 0);
-      base::Thread *thread = new base::Thread();
-      if (!thread) return nullptr;
-      if (!thread->IsRunning()) {
-        thread->set_thread_name("distribute_task_thread");
-        thread->StartWithOptions(base::Thread::Options());
-      }
-      object->SetAlignedPointerInInternalField(0, (void*)thread);
-      return thread;
+      base::TaskRunner *runner = base::ThreadPool::GetInstance()->CreateTaskRunner();
+      if (!runner) return nullptr;
+      object->SetAlignedPointerInInternalField(0, (void*)runner);
+      return runner;
     }
 
     void Wrap(v8::Local<v8::Object> object, void *tmp) {
@@ -151,21 +421,22 @@ namespace rcib {
       return object->GetAlignedPointerFromInternalField(0);
     }
 
-    bool IsRunning(base::Thread* thread) {
-      if (thread) {
-        return thread->IsRunning();
+    bool IsRunning(base::TaskRunner* runner) {
+      if (runner) {
+        return runner->IsRunning();
       }
       return false;
     }
 
-    void Close(base::Thread* thread) {
-      if (thread) {
-        delete thread;
+    // The runner itself is freed once the js object is collected.
+    void Close(base::TaskRunner* runner) {
+      if (runner) {
+        runner->Close();
       }
     }
 
-    base::Thread* Get(v8::Local<v8::Object> object) {
-      return static_cast<base::Thread*>(Unwrap(object));
+    base::TaskRunner* Get(v8::Local<v8::Object> object) {
+      return static_cast<base::TaskRunner*>(Unwrap(object));
     }
   };
 
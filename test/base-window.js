@@ -0,0 +1,15 @@
+const assert = require('assert');
+const childProcess = require('child_process');
+const path = require('path');
+
+describe('setBaseWindow()', function() {
+  this.timeout(30000)
+  const fixture = path.join(__dirname, 'fixtures', 'base-window.js')
+  const run = (window) => childProcess.execFileSync(process.execPath, [fixture, String(window)]).toString()
+
+  it('keys and signs like the built-in tables with window 5', function() {
+    const builtIn = run(0)
+    assert.equal(builtIn.length, 102 * 64)
+    assert.equal(run(5), builtIn)
+  })
+})
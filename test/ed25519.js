@@ -37,6 +37,21 @@ var data = {
   invalidSignature: '88c8351675ade54b3aedc14f0b9c40b47569d9da191db066312ed6423d20dff8a52988f869fc3fbf4402971034b387ac7fbcfa704eb4c1e86e48e15de5e3d205'
 };
 
+// R is rB plus a point of order 8, s = r + ha: sB - hA does not encode
+// to R, so verify rejects it as ref10 does, and every batch has to
+var torsion = {
+  publicKey: 'e4030998cfd5ad1723c169f956aa0b9eb8619b5992bd612c2af428ebc79f8df0',
+  message: 'a signature with an order 8 component in R',
+  signature: '4d2beb15be16dc81d6db66d882ede166f2ea2846ef6a9cc0e57e9d70c6163a2fc6886d40908ab99f2554699e8455ebee70851508f4c14df55f741dca9bcfb504'
+};
+
+// A and R the identity, s = 0: sB - hA encodes to R for every message
+var smallOrderKey = {
+  publicKey: '0100000000000000000000000000000000000000000000000000000000000000',
+  signature: '0100000000000000000000000000000000000000000000000000000000000000' +
+    '0000000000000000000000000000000000000000000000000000000000000000'
+};
+
 describe('#ed25519', function() {
   describe('makeKeypair()', function () {
     it('returns a public and private key', function () {
@@ -80,6 +95,22 @@ describe('#ed25519', function() {
     });
   });
 
+  describe('createSigner()', function () {
+    it('signs like the key it was made from', function() {
+      return co(function*() {
+        var message = new Buffer(data.message);
+        var signer = yield thread.createSigner(new Buffer(data.seed, 'hex'));
+        assert.equal(signer.publicKey.toString('hex'), data.publicKey);
+        var signature = yield thread.sign(message, signer);
+        assert.equal(signature.toString('hex'), data.signature);
+
+        var sync = Thread.createSigner({ privateKey: new Buffer(data.privateKey, 'hex') });
+        assert.equal(Thread.sign(message, sync).toString('hex'), data.signature);
+        assert.equal(typeof sync.locked, 'boolean');
+      })();
+    });
+  });
+
   describe('yield sign', function () {
     it('Generates a valid signature using a seed', function() {
       return co(function*() {
@@ -121,6 +152,24 @@ describe('#ed25519', function() {
         done();
       });
     });
+
+    it('runs interactive verifies ahead of bulk work', function(done) {
+      var publicKey = new Buffer(data.publicKey, 'hex');
+      var signature = new Buffer(data.signature, 'hex');
+      var message = new Buffer(data.message);
+      var order = [];
+      for (var i = 0; i < 32; ++i) {
+        thread.sha2({data: crypto.randomBytes(1 << 20)}, function(err) {
+          order.push('bulk');
+        });
+      }
+      thread.verify(message, signature, publicKey, { priority: 'interactive' }, function(err, Is) {
+        assert.ok(Is);
+        order.push('interactive');
+        assert(order.indexOf('interactive') < 32);
+        done();
+      });
+    });
   });
 
   describe('yield verify', function() {
@@ -170,5 +219,218 @@ describe('#ed25519', function() {
         assert(hash.toString('hex') === thisHash.toString('hex'))
       })()
     })
+    it('writes results into a caller slab', function () {
+      return co(function* () {
+        const slab = Buffer.alloc(64 + 32)
+        const seed = crypto.createHash('sha256').update('slab').digest()
+        const pair = Thread.makeKeypair(seed)
+        const hash = crypto.createHash('sha256').update(seed).digest()
+        assert.equal(yield thread.sign(hash, pair, { out: slab, offset: 0 }), 64)
+        assert.equal(yield thread.sha2({ data: seed, out: slab, offset: 64 }), 32)
+        assert(slab.slice(64).equals(hash))
+        assert(Thread.verify(hash, slab.slice(0, 64), pair.publicKey))
+      })()
+    })
+  })
+
+  describe('verifyBatch()', function() {
+    it('flags each signature', function () {
+      return co(function* () {
+        const messages = [], signatures = [], publicKeys = []
+        for (var i = 0; i < 40; ++i) {
+          const seed = crypto.createHash('sha256').update('batch' + i).digest()
+          const pair = Thread.makeKeypair(seed)
+          messages.push(seed)
+          signatures.push(Thread.sign(seed, pair))
+          publicKeys.push(pair.publicKey)
+        }
+        assert.deepEqual(yield thread.verifyBatch(messages, signatures, publicKeys),
+          messages.map(() => true))
+        signatures[7] = Buffer.from(signatures[7])
+        signatures[7][3] ^= 1
+        messages[31] = Buffer.from('tampered')
+        const valid = yield thread.verifyBatch(messages, signatures, publicKeys)
+        assert.deepEqual(valid, messages.map((m, i) => i !== 7 && i !== 31))
+      })()
+    })
+
+    it('rejects a torsion component in R, as verify does', function () {
+      return co(function* () {
+        const publicKey = new Buffer(torsion.publicKey, 'hex')
+        const signature = new Buffer(torsion.signature, 'hex')
+        const message = new Buffer(torsion.message)
+        assert(!Thread.verify(message, signature, publicKey))
+        assert(!(yield thread.verify(message, signature, publicKey)))
+        const messages = [], signatures = [], publicKeys = []
+        for (var i = 0; i < 16; ++i) {
+          const seed = crypto.createHash('sha256').update('torsion' + i).digest()
+          const pair = Thread.makeKeypair(seed)
+          messages.push(i % 4 ? seed : message)
+          signatures.push(i % 4 ? Thread.sign(seed, pair) : signature)
+          publicKeys.push(i % 4 ? pair.publicKey : publicKey)
+        }
+        // z is odd half the time: a batch must not let it pass when z is even
+        for (var round = 0; round < 32; ++round) {
+          assert.deepEqual(yield thread.verifyBatch(messages, signatures, publicKeys),
+            messages.map((m, i) => i % 4 !== 0))
+        }
+      })()
+    })
+
+    it('accepts a small order key, as verify does', function () {
+      return co(function* () {
+        const publicKey = new Buffer(smallOrderKey.publicKey, 'hex')
+        const signature = new Buffer(smallOrderKey.signature, 'hex')
+        const message = Buffer.from('any message')
+        assert(Thread.verify(message, signature, publicKey))
+        assert(yield thread.verify(message, signature, publicKey))
+        const messages = [], signatures = [], publicKeys = []
+        for (var i = 0; i < 16; ++i) {
+          const seed = crypto.createHash('sha256').update('small' + i).digest()
+          const pair = Thread.makeKeypair(seed)
+          messages.push(i % 4 ? seed : message)
+          signatures.push(i % 4 ? Thread.sign(seed, pair) : signature)
+          publicKeys.push(i % 4 ? pair.publicKey : publicKey)
+        }
+        signatures[8] = Buffer.from(signatures[8])
+        signatures[8][40] ^= 1
+        assert.deepEqual(yield thread.verifyBatch(messages, signatures, publicKeys),
+          messages.map((m, i) => i !== 8))
+      })()
+    })
+  })
+
+  describe('verifyPacked()', function() {
+    it('takes records or parallel buffers', function () {
+      return co(function* () {
+        const n = 300
+        const records = Buffer.alloc(n * (96 + 32))
+        const messages = [], signatures = [], publicKeys = []
+        for (var i = 0; i < n; ++i) {
+          const seed = crypto.createHash('sha256').update('packed' + i).digest()
+          const pair = Thread.makeKeypair(seed)
+          const message = Buffer.from('message ' + i)
+          const signature = Thread.sign(seed, pair)
+          signature.copy(records, i * 128)
+          pair.publicKey.copy(records, i * 128 + 64)
+          seed.copy(records, i * 128 + 96)
+          messages.push(message)
+          signatures.push(Thread.sign(message, pair))
+          publicKeys.push(pair.publicKey)
+        }
+        records[5 * 128 + 100] ^= 1
+        records[260 * 128 + 10] ^= 1
+        const bitmap = yield thread.verifyPacked({ records: records, messageLength: 32 })
+        assert.equal(bitmap.length, Math.ceil(n / 8))
+        assert.deepEqual(Thread.invalidOf(bitmap, n), [5, 260])
+
+        const offsets = [0]
+        messages.forEach((m) => offsets.push(offsets[offsets.length - 1] + m.length))
+        signatures[99][0] ^= 1
+        const bits = yield thread.verifyPacked({
+          messages: Buffer.concat(messages),
+          offsets: offsets,
+          signatures: Buffer.concat(signatures),
+          publicKeys: Buffer.concat(publicKeys)
+        })
+        assert.deepEqual(Thread.invalidOf(bits, n), [99])
+      })()
+    })
+
+    it('gives the bitmap of per record verify', function () {
+      return co(function* () {
+        const n = 200, messageLength = torsion.message.length
+        const records = Buffer.alloc(n * (96 + messageLength))
+        for (var i = 0; i < n; ++i) {
+          const at = i * (96 + messageLength)
+          const message = Buffer.alloc(messageLength, i)
+          if (i % 6 === 0) {
+            new Buffer(torsion.signature, 'hex').copy(records, at)
+            new Buffer(torsion.publicKey, 'hex').copy(records, at + 64)
+            Buffer.from(torsion.message).copy(records, at + 96)
+          } else if (i % 6 === 3) {
+            new Buffer(smallOrderKey.signature, 'hex').copy(records, at)
+            new Buffer(smallOrderKey.publicKey, 'hex').copy(records, at + 64)
+            message.copy(records, at + 96)
+          } else {
+            const pair = Thread.makeKeypair(crypto.createHash('sha256').update('bitmap' + i).digest())
+            Thread.sign(message, pair).copy(records, at)
+            pair.publicKey.copy(records, at + 64)
+            message.copy(records, at + 96)
+          }
+        }
+        records[(96 + messageLength) * 40 + 96] ^= 1
+        records[(96 + messageLength) * 41 + 7] ^= 1
+        const expected = []
+        for (var i = 0; i < n; ++i) {
+          const at = i * (96 + messageLength)
+          if (!Thread.verify(records.slice(at + 96, at + 96 + messageLength), records.slice(at, at + 64),
+            records.slice(at + 64, at + 96))) expected.push(i)
+        }
+        const torsionOrTampered = []
+        for (var i = 0; i < n; ++i) {
+          if (i % 6 === 0 || i === 40 || i === 41) torsionOrTampered.push(i)
+        }
+        assert.deepEqual(expected, torsionOrTampered)
+        for (var round = 0; round < 16; ++round) {
+          const bitmap = yield thread.verifyPacked({ records: records, messageLength: messageLength })
+          assert.deepEqual(Thread.invalidOf(bitmap, n), expected)
+        }
+      })()
+    })
+  })
+
+  describe('makeKeypairs()', function() {
+    it('matches makeKeypair', function () {
+      return co(function* () {
+        const seeds = []
+        for (let i = 0; i < 150; ++i) {
+          seeds.push(crypto.createHash('sha256').update('seed' + i).digest())
+        }
+        const keys = yield thread.makeKeypairs(seeds)
+        assert.equal(keys.publicKeys.length, 150 * 32)
+        assert.equal(keys.privateKeys.length, 150 * 64)
+        seeds.forEach((seed, i) => {
+          const pair = Thread.makeKeypair(seed)
+          assert(pair.publicKey.equals(keys.publicKeys.slice(32 * i, 32 * i + 32)))
+          assert(pair.privateKey.equals(keys.privateKeys.slice(64 * i, 64 * i + 64)))
+        })
+      })()
+    })
+  })
+
+  // the windows themselves are tested in processes of their own, see
+  // base-window.js
+  describe('setBaseWindow()', function() {
+    it('switches the base tables while workers run', function () {
+      assert.equal(Thread.setBaseWindow(6), false)
+      assert.equal(Thread.setBaseWindow(5), true)
+      assert.equal(Thread.sign(new Buffer(data.message), new Buffer(data.seed, 'hex')).toString('hex'),
+        data.signature)
+      assert.equal(Thread.setBaseWindow(0), true)
+      assert.equal(Thread.sign(new Buffer(data.message), new Buffer(data.seed, 'hex')).toString('hex'),
+        data.signature)
+    })
+  })
+
+  describe('setKeyCacheSize()', function() {
+    it('caches the keys of repeat signers', function () {
+      const seed = crypto.createHash('sha256').update('cached').digest()
+      const pair = Thread.makeKeypair(seed)
+      const signature = Thread.sign(seed, pair)
+      assert(Thread.verify(seed, signature, pair.publicKey))
+      const before = Thread.keyCacheStats()
+      assert(Thread.verify(seed, signature, pair.publicKey))
+      assert(!Thread.verify(Buffer.from('other'), signature, pair.publicKey))
+      const after = Thread.keyCacheStats()
+      assert.equal(after.hits, before.hits + 2)
+      assert.equal(after.misses, before.misses)
+      assert(after.entries > 0 && after.bytes <= after.capacity)
+
+      Thread.setKeyCacheSize(0)
+      assert.equal(Thread.keyCacheStats().entries, 0)
+      assert(Thread.verify(seed, signature, pair.publicKey))
+      Thread.setKeyCacheSize(8 << 20)
+    })
   })
 })
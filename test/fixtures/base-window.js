@@ -0,0 +1,50 @@
+// Run by test/base-window.js, one process per window, so nothing else
+// has used the other tables first.
+const assert = require('assert');
+const crypto = require('crypto');
+const Thread = require('../../index.js');
+
+const vectors = [{
+  // RFC 8032, test 1
+  seed: '9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60',
+  publicKey: 'd75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a',
+  message: '',
+  signature: 'e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b'
+}, {
+  seed: 'af9881fe34edfd3463cf3e14e22ad95a0608967e084d3ca1fc57be023040de59',
+  publicKey: '0c32c468980d40237f4e44a66dec3beb564b3e1394a4c6df1da2065e3afc1d81',
+  message: '74657374',
+  signature: '98c8351675ade54b3aedc14f0b9c40b47569d9da191db066312ed6423d20dff8a52988f869fc3fbf4402971034b387ac7fbcfa704eb4c1e86e48e15de5e3d206'
+}];
+
+const window = Number(process.argv[2])
+assert.equal(Thread.setBaseWindow(window), true)
+const thread = new Thread()
+
+vectors.forEach((v) => {
+  const pair = Thread.makeKeypair(v.seed)
+  assert.equal(pair.publicKey.toString('hex'), v.publicKey)
+  assert.equal(Thread.sign(Buffer.from(v.message, 'hex'), pair).toString('hex'), v.signature)
+})
+
+const seeds = vectors.map((v) => Buffer.from(v.seed, 'hex'))
+for (let i = 0; i < 100; ++i) {
+  seeds.push(crypto.createHash('sha256').update('window' + i).digest())
+}
+
+Promise.all([
+  thread.makeKeypairs(seeds),
+  Promise.all(vectors.map((v) => thread.sign(Buffer.from(v.message, 'hex'), Buffer.from(v.seed, 'hex'))))
+]).then((results) => {
+  const keys = results[0]
+  vectors.forEach((v, i) => {
+    assert.equal(keys.publicKeys.slice(32 * i, 32 * i + 32).toString('hex'), v.publicKey)
+    assert.equal(results[1][i].toString('hex'), v.signature)
+  })
+  // the parent compares these across windows
+  process.stdout.write(keys.publicKeys.toString('hex'))
+  thread.close()
+}).catch((err) => {
+  console.error(err)
+  process.exit(1)
+})
@@ -0,0 +1,242 @@
+const assert = require('assert');
+const Thread = require('../index.js');
+const crypto = require('crypto');
+
+describe('thread', function() {
+  it('cancels a queued delay', function(done) {
+    const thread = new Thread()
+    const id = thread.delayBySec(10, function(err) {
+      assert(err)
+      assert.equal(err.code, 'ECANCELED')
+      thread.close()
+      done()
+    })
+    assert(thread.cancel(id))
+    assert(!thread.cancel(id))
+  })
+
+  it('rejects a cancelled promise', function() {
+    const thread = new Thread()
+    const p = thread.delayBySec(10)
+    assert(thread.cancel(p.taskId))
+    return p.then(() => assert.fail('should be cancelled'), (err) => {
+      assert.equal(err.code, 'ECANCELED')
+      thread.close()
+    })
+  })
+
+  it('does not cancel a finished task', function(done) {
+    const thread = new Thread()
+    const id = thread.delayByMil(1, function(err) {
+      assert(!err)
+      setImmediate(() => {
+        assert(!thread.cancel(id))
+        thread.close()
+        done()
+      })
+    })
+  })
+
+  // the timer wheel: 256 1ms slots, then levels of 64 slots each, so
+  // 256ms and 16384ms are where delays move up a level
+  const fireOrder = (thread, delays) => {
+    const order = []
+    return Promise.all(delays.map((ms) => thread.delayByMil(ms).then(() => order.push(ms))))
+      .then(() => order)
+  }
+
+  it('fires delays across the first level boundary in deadline order', function() {
+    const thread = new Thread()
+    const delays = [300, 5, 262, 250, 520, 40, 1000]
+    return fireOrder(thread, delays).then((order) => {
+      thread.close()
+      assert.deepEqual(order, delays.slice().sort((a, b) => a - b))
+    })
+  })
+
+  it('fires delays across the second level boundary in deadline order', function() {
+    this.timeout(25000)
+    const thread = new Thread()
+    const delays = [16500, 16000, 16390, 300]
+    return fireOrder(thread, delays).then((order) => {
+      thread.close()
+      assert.deepEqual(order, [300, 16000, 16390, 16500])
+    })
+  })
+
+  it('fires delays due in the same tick in posting order', function() {
+    const thread = new Thread()
+    const order = []
+    const tasks = []
+    for (let i = 0; i < 50; ++i) {
+      tasks.push(thread.delayByMil(20).then(() => order.push(i)))
+    }
+    return Promise.all(tasks).then(() => {
+      thread.close()
+      assert.deepEqual(order, Array.from({ length: 50 }, (_, i) => i))
+    })
+  })
+
+  it('frees a cancelled far timer long before its deadline', function() {
+    const thread = new Thread()
+    const p = thread.delayBySec(3600)
+    assert(thread.cancel(p.taskId))
+    return p.catch((err) => {
+      assert.equal(err.code, 'ECANCELED')
+      // the request stays with the worker until the wheel is swept
+      const idle = Thread.allocationStats().requests.idle
+      return new Promise((resolve) => setTimeout(resolve, 500)).then(() => {
+        thread.close()
+        assert.equal(Thread.allocationStats().requests.idle, idle + 1)
+      })
+    })
+  })
+
+  it('keeps results right while the task queues grow and wrap', function() {
+    const thread = new Thread()
+    const expect = (data) => crypto.createHash('sha256').update(data).digest()
+    const check = (data) => thread.sha2({ data }).then((digest) => {
+      assert(digest.equals(expect(data)))
+    })
+    // a burst past the initial ring size makes it grow...
+    const burst = []
+    for (let i = 0; i < 300; ++i) {
+      burst.push(check('grow' + i))
+    }
+    // ...and a steady trickle walks its head around many times
+    let left = 2000
+    const trickle = () => left-- > 0 ? check('wrap' + left).then(trickle) : null
+    const streams = []
+    for (let i = 0; i < 10; ++i) {
+      streams.push(trickle())
+    }
+    return Promise.all(burst.concat(streams)).then(() => thread.close())
+  })
+
+  it('loses no task posted to every worker while they drain', function() {
+    // runners are dealt out over the workers, so this feeds all their
+    // incoming queues, both lanes, while the workers take from them
+    const threads = Array.from({ length: 16 }, () => new Thread())
+    const tasks = []
+    for (let i = 0; i < 3200; ++i) {
+      const data = 'mpsc' + i
+      const priority = i & 1 ? 'interactive' : 'bulk'
+      tasks.push(threads[i % threads.length].sha2({ data, priority }).then((digest) => {
+        assert(digest.equals(crypto.createHash('sha256').update(data).digest()))
+      }))
+    }
+    return Promise.all(tasks).then(() => threads.forEach((thread) => thread.close()))
+  })
+
+  it('spreads a burst of results over loop turns', function() {
+    const thread = new Thread()
+    Thread.setCompletionBudget({ callbacks: 8 })
+    const before = Thread.completionStats()
+    const tasks = []
+    for (let i = 0; i < 100; ++i) {
+      tasks.push(thread.sha2({ data: 'burst' + i }))
+    }
+    return Promise.all(tasks).then(() => {
+      const stats = Thread.completionStats()
+      Thread.setCompletionBudget({ millis: 5 })
+      thread.close()
+      assert.equal(stats.maxCallbacks, 8)
+      assert.equal(stats.backlog, 0)
+      assert(stats.delivered - before.delivered >= 100)
+      // each put-off result counts once, however many turns it waits
+      assert(stats.deferred - before.deferred <= 100)
+    })
+  })
+
+  it('delivers sink results in batches', function(done) {
+    const thread = new Thread()
+    const expected = {}
+    let seen = 0
+    let calls = 0
+    thread.setSink(function(ids, errors, results) {
+      ++calls
+      assert.equal(ids.length, errors.length)
+      assert.equal(ids.length, results.length)
+      for (let i = 0; i < ids.length; ++i) {
+        assert.equal(errors[i], null)
+        assert(results[i].equals(expected[ids[i]]))
+        ++seen
+      }
+      if (seen === 200) {
+        assert(calls < 200)
+        thread.close()
+        done()
+      }
+    })
+    for (let i = 0; i < 200; ++i) {
+      const data = 'sink' + i
+      const id = thread.sha2({ data, sink: true })
+      expected[id] = crypto.createHash('sha256').update(data).digest()
+    }
+  })
+
+  it('recycles requests in a steady state', function() {
+    const thread = new Thread()
+    const burst = () => {
+      const tasks = []
+      for (let i = 0; i < 100; ++i) {
+        tasks.push(thread.sha2({ data: 'steady' + i }))
+      }
+      return Promise.all(tasks)
+    }
+    let warm
+    return burst().then(() => {
+      warm = Thread.allocationStats()
+      return burst()
+    }).then(() => {
+      const stats = Thread.allocationStats()
+      thread.close()
+      assert.equal(stats.requests.created, warm.requests.created)
+      assert.equal(stats.hashResults.created, warm.hashResults.created)
+      assert.equal(stats.handles.slots, warm.handles.slots)
+    })
+  })
+
+  // the costs are measured on a worker after the first Thread is created
+  const measured = () => new Promise((resolve) => {
+    const poll = () => Thread.inlineStats().calibratedNs > 0 ? resolve() : setTimeout(poll, 10)
+    poll()
+  })
+
+  it('runs tiny jobs inline with the same results', function() {
+    const thread = new Thread()
+    return measured().then(() => {
+      Thread.setInlineThreshold(1e12)
+      const before = Thread.inlineStats().inlined
+      let settled = false
+      const p = thread.sha2({ data: 'tiny' }).then((digest) => {
+        settled = true
+        Thread.setInlineThreshold(-1)
+        thread.close()
+        assert(digest.equals(crypto.createHash('sha256').update('tiny').digest()))
+        assert.equal(Thread.inlineStats().inlined, before + 1)
+      })
+      // still delivered asynchronously
+      assert(!settled)
+      return p
+    })
+  })
+
+  it('keeps sign and verify on the workers by default', function() {
+    const thread = new Thread()
+    return measured().then(() => {
+      const stats = Thread.inlineStats()
+      assert(stats.thresholdNs < stats.calibratedNs)
+      const before = stats.inlined
+      const seed = crypto.createHash('sha256').update('inline').digest()
+      const pair = Thread.makeKeypair(seed)
+      return thread.sign(seed, pair).then((signature) => {
+        return thread.verify(seed, signature, pair.publicKey)
+      }).then((valid) => {
+        thread.close()
+        assert(valid)
+        assert.equal(Thread.inlineStats().inlined, before)
+      })
+    })
+  })
+})